@@ -0,0 +1,196 @@
+#ifndef PROJECT_BASE_MICROBENCH_H
+#define PROJECT_BASE_MICROBENCH_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+    // keeps the compiler from dropping a computation whose result is never used
+    template<typename T>
+    inline void doNotOptimize(const T &value) {
+        asm volatile("" : : "r,m"(value) : "memory");
+    }
+
+    // A small benchmark runner. A benchmark is a function that performs its operation a
+    // given number of times. Each one is calibrated first: the count doubles until a batch
+    // takes at least MIN_BATCH_MS. Then REPETITIONS batches are timed, and the median, the
+    // minimum and the mean time per operation are reported.
+    // Results are written as JSON with one benchmark object per line, and can be compared
+    // against an earlier run's file: a median more than threshold percent slower than the
+    // baseline's is a regression.
+    class Microbench {
+    public:
+        static const int REPETITIONS = 5;
+        static constexpr double MIN_BATCH_MS = 10.0;
+
+        struct Result {
+            std::string name;
+            long long iterations;
+            double medianNs;
+            double minNs;
+            double meanNs;
+        };
+
+        // --filter text    only the benchmarks whose names contain text
+        // --json path      write the results there, "-" for stdout
+        // --baseline path  compare against an earlier --json file
+        // --threshold p    percent slowdown that counts as a regression, 10 by default
+        bool parse(int argc, char **argv) {
+            for (int i = 1; i < argc; ++i) {
+                std::string arg = argv[i];
+                bool hasValue = i + 1 < argc;
+                if (arg == "--filter" && hasValue) {
+                    m_Filter = argv[++i];
+                } else if (arg == "--json" && hasValue) {
+                    m_JsonPath = argv[++i];
+                } else if (arg == "--baseline" && hasValue) {
+                    m_BaselinePath = argv[++i];
+                } else if (arg == "--threshold" && hasValue) {
+                    m_Threshold = std::atof(argv[++i]);
+                } else {
+                    std::cout << "ERROR::BENCHMARKS::UNKNOWN_ARGUMENT " << arg << std::endl;
+                    std::cout << "usage: benchmarks [--filter text] [--json path] [--baseline path] [--threshold percent]"
+                              << std::endl;
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        void add(const std::string &name, std::function<void(long long)> body) {
+            if (m_Filter.empty() || name.find(m_Filter) != std::string::npos)
+                m_Benchmarks.push_back(Benchmark{name, std::move(body)});
+        }
+
+        // runs everything added; the exit code: 1 on a regression or a failed write, else 0
+        int run() {
+            std::vector<Result> results;
+            std::ostream &table = m_JsonPath == "-" ? std::cerr : std::cout;
+            table << std::left << std::setw(64) << "benchmark" << std::right << std::setw(14) << "median ns"
+                  << std::setw(14) << "min ns" << std::setw(12) << "iterations" << std::endl;
+            for (const Benchmark &benchmark : m_Benchmarks) {
+                results.push_back(measure(benchmark));
+                const Result &result = results.back();
+                table << std::left << std::setw(64) << result.name << std::right << std::fixed
+                      << std::setprecision(1) << std::setw(14) << result.medianNs << std::setw(14) << result.minNs
+                      << std::setw(12) << result.iterations << std::endl;
+            }
+            int exitCode = 0;
+            if (!m_JsonPath.empty() && !writeJSON(results))
+                exitCode = 1;
+            if (!m_BaselinePath.empty() && !compare(results, table))
+                exitCode = 1;
+            return exitCode;
+        }
+
+    private:
+        struct Benchmark {
+            std::string name;
+            std::function<void(long long)> body;
+        };
+
+        typedef std::chrono::steady_clock Clock;
+
+        static double batchNs(const Benchmark &benchmark, long long iterations) {
+            Clock::time_point start = Clock::now();
+            benchmark.body(iterations);
+            return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        }
+
+        static Result measure(const Benchmark &benchmark) {
+            long long iterations = 1;
+            while (batchNs(benchmark, iterations) < MIN_BATCH_MS * 1e6 && iterations < (1ll << 40))
+                iterations *= 2;
+            std::vector<double> perOp;
+            for (int i = 0; i < REPETITIONS; ++i)
+                perOp.push_back(batchNs(benchmark, iterations) / iterations);
+            std::sort(perOp.begin(), perOp.end());
+            double sum = 0.0;
+            for (double ns : perOp)
+                sum += ns;
+            return Result{benchmark.name, iterations, perOp[perOp.size() / 2], perOp.front(), sum / perOp.size()};
+        }
+
+        bool writeJSON(const std::vector<Result> &results) const {
+            std::ofstream file;
+            if (m_JsonPath != "-") {
+                file.open(m_JsonPath);
+                if (!file) {
+                    std::cout << "ERROR::BENCHMARKS::WRITE_FAILED " << m_JsonPath << std::endl;
+                    return false;
+                }
+            }
+            std::ostream &out = m_JsonPath == "-" ? std::cout : file;
+            out << "{\"benchmarks\": [\n" << std::setprecision(3) << std::fixed;
+            for (size_t i = 0; i < results.size(); ++i) {
+                const Result &result = results[i];
+                out << "{\"name\": \"" << result.name << "\", \"iterations\": " << result.iterations
+                    << ", \"median_ns\": " << result.medianNs << ", \"min_ns\": " << result.minNs
+                    << ", \"mean_ns\": " << result.meanNs << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+            }
+            out << "]}\n";
+            return true;
+        }
+
+        // name -> median, from a file writeJSON produced
+        bool readBaseline(std::map<std::string, double> &medians) const {
+            std::ifstream in(m_BaselinePath);
+            if (!in) {
+                std::cout << "ERROR::BENCHMARKS::BASELINE_NOT_FOUND " << m_BaselinePath << std::endl;
+                return false;
+            }
+            const std::string nameKey = "{\"name\": \"", medianKey = "\"median_ns\": ";
+            std::string line;
+            while (std::getline(in, line)) {
+                size_t name = line.find(nameKey), median = line.find(medianKey);
+                if (name == std::string::npos || median == std::string::npos)
+                    continue;
+                name += nameKey.size();
+                size_t nameEnd = line.find('"', name);
+                medians[line.substr(name, nameEnd - name)] = std::atof(line.c_str() + median + medianKey.size());
+            }
+            return true;
+        }
+
+        bool compare(const std::vector<Result> &results, std::ostream &out) const {
+            std::map<std::string, double> baseline;
+            if (!readBaseline(baseline))
+                return false;
+            int regressions = 0;
+            out << "\ncompared with " << m_BaselinePath << ", regression above +" << m_Threshold << "%" << std::endl;
+            for (const Result &result : results) {
+                auto it = baseline.find(result.name);
+                if (it == baseline.end() || it->second <= 0.0) {
+                    out << std::left << std::setw(64) << result.name << "  new" << std::endl;
+                    continue;
+                }
+                double change = (result.medianNs / it->second - 1.0) * 100.0;
+                bool regressed = change > m_Threshold;
+                regressions += regressed;
+                out << std::left << std::setw(64) << result.name << std::right << std::showpos << std::setw(9)
+                    << std::setprecision(1) << change << "%" << std::noshowpos << (regressed ? "  REGRESSION" : "")
+                    << std::endl;
+            }
+            out << regressions << " regression" << (regressions == 1 ? "" : "s") << std::endl;
+            return regressions == 0;
+        }
+
+        std::vector<Benchmark> m_Benchmarks;
+        std::string m_Filter;
+        std::string m_JsonPath;
+        std::string m_BaselinePath;
+        double m_Threshold = 10.0;
+    };
+
+};
+#endif //PROJECT_BASE_MICROBENCH_H
@@ -0,0 +1,249 @@
+// Micro-benchmarks for the asset loading and per-frame CPU paths. GL runs against
+// rg::loadNullGL(), so what is measured is the CPU side only: no context, no driver.
+//
+//   benchmarks [--filter text] [--json path] [--baseline path] [--threshold percent]
+//
+// e.g. save a baseline with --json baseline.json, then check a change with --baseline baseline.json.
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <stb_image.h>
+
+#include <learnopengl/filesystem.h>
+#include <learnopengl/shader.h>
+#include <learnopengl/model.h>
+#include <rg/Cubemap.h>
+#include <rg/LightGrid.h>
+#include <rg/MemoryTracker.h>
+#include <rg/NullGL.h>
+#include <rg/ThreadPool.h>
+
+#include "Microbench.h"
+
+static bool isDirectory(const std::string &path) {
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+}
+
+static bool hasExtension(const std::string &name, const std::vector<std::string> &extensions) {
+    for (const std::string &extension : extensions) {
+        if (name.size() > extension.size() &&
+            name.compare(name.size() - extension.size(), extension.size(), extension) == 0)
+            return true;
+    }
+    return false;
+}
+
+// the entries of a directory, sorted, so the benchmarks always run in the same order
+static std::vector<std::string> listDirectory(const std::string &path) {
+    std::vector<std::string> names;
+    if (DIR *dir = opendir(path.c_str())) {
+        while (dirent *entry = readdir(dir)) {
+            if (entry->d_name[0] != '.')
+                names.push_back(entry->d_name);
+        }
+        closedir(dir);
+    }
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+// Model::processMesh on every shipped OBJ. The import is done once, up front; a benchmark
+// turns the scene into meshes. The model keeps its loaded textures between batches, so
+// after the first one the textures are found in textures_loaded, as for a scene whose
+// meshes share materials.
+static void addModels(rg::Microbench &bench, std::vector<std::unique_ptr<Assimp::Importer>> &importers) {
+    const std::string objects = FileSystem::getPath("resources/objects");
+    for (const std::string &dirName : listDirectory(objects)) {
+        std::string dir = objects + "/" + dirName;
+        if (!isDirectory(dir))
+            continue;
+        for (const std::string &file : listDirectory(dir)) {
+            if (!hasExtension(file, {".obj"}))
+                continue;
+            importers.emplace_back(new Assimp::Importer);
+            const aiScene *scene = importers.back()->ReadFile(dir + "/" + file, Model::importFlags);
+            if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+                std::cout << "ERROR::ASSIMP:: " << importers.back()->GetErrorString() << std::endl;
+                continue;
+            }
+            std::shared_ptr<Model> model(new Model);
+            bench.add("Model::processMesh/" + dirName + "/" + file, [model, scene, dir](long long n) {
+                for (long long i = 0; i < n; ++i) {
+                    model->meshes.clear();
+                    model->processScene(scene, dir);
+                    rg::doNotOptimize(model->meshes.data());
+                }
+            });
+        }
+    }
+}
+
+// TextureFromFile, i.e. the stbi_load decode and the (null) upload, for every shipped image
+static void addTextures(rg::Microbench &bench) {
+    const std::vector<std::string> images = {".jpg", ".jpeg", ".png"};
+    std::vector<std::string> dirs = {"resources/textures"};
+    for (const std::string &dirName : listDirectory(FileSystem::getPath("resources/objects"))) {
+        if (isDirectory(FileSystem::getPath("resources/objects/" + dirName)))
+            dirs.push_back("resources/objects/" + dirName);
+    }
+    for (const std::string &relative : dirs) {
+        std::string dir = FileSystem::getPath(relative);
+        for (const std::string &file : listDirectory(dir)) {
+            if (!hasExtension(file, images))
+                continue;
+            bench.add("TextureFromFile/" + relative.substr(relative.find('/') + 1) + "/" + file,
+                      [file, dir](long long n) {
+                          for (long long i = 0; i < n; ++i)
+                              rg::doNotOptimize(TextureFromFile(file.c_str(), dir));
+                      });
+        }
+    }
+}
+
+static void addCubemap(rg::Microbench &bench) {
+    // the skybox, in the order main.cpp loads it
+    std::vector<std::string> faces = {
+            FileSystem::getPath("resources/textures/right.jpg"),
+            FileSystem::getPath("resources/textures/left.jpg"),
+            FileSystem::getPath("resources/textures/bottom.jpg"),
+            FileSystem::getPath("resources/textures/top.jpg"),
+            FileSystem::getPath("resources/textures/front.jpg"),
+            FileSystem::getPath("resources/textures/back.jpg")
+    };
+    bench.add("loadCubemap/skybox", [faces](long long n) {
+        for (long long i = 0; i < n; ++i)
+            rg::doNotOptimize(rg::loadCubemap(faces));
+    });
+}
+
+// the windows as main.cpp places them: three default entries, then the three it pushes
+struct triD {
+    glm::vec3 trans;
+    glm::vec3 skal;
+    glm::vec3 rotatV;
+    float rotatU;
+};
+
+static std::vector<triD> windowPositions() {
+    std::vector<triD> winPos(3);
+    winPos.push_back({glm::vec3(-1.25f, 1.75f, -3.25f), glm::vec3(0.39f, 0.45f, 0.4f), glm::vec3(1.0, 0, 0), 43.0f});
+    winPos.push_back({glm::vec3(-1.25f, 3.05f, 2.35f), glm::vec3(0.39f, 0.45f, 0.4f), glm::vec3(1.0, 0, 0), 43.0f});
+    winPos.push_back({glm::vec3(3.2753f, 1.72f, 1.35f), glm::vec3(0.39f, 0.45f, 0.4f), glm::vec3(0.0f, 0.0f, 1.0f), 43.0f});
+    return winPos;
+}
+
+static void addFrameWork(rg::Microbench &bench) {
+    // the back-to-front sort of the transparent windows, with the camera circling the scene
+    // so that the order changes from one sort to the next, as it does while flying around
+    bench.add("transparentSort/winPos", [](long long n) {
+        std::vector<triD> winPos = windowPositions();
+        for (long long i = 0; i < n; ++i) {
+            float angle = (float) (i % 360) * 0.0174533f;
+            glm::vec3 camera(6.0f * glm::cos(angle), 2.0f, 6.0f * glm::sin(angle));
+            std::sort(winPos.begin(), winPos.end(), [&camera](triD a, triD b) {
+                float d1 = glm::distance(a.trans, camera);
+                float d2 = glm::distance(b.trans, camera);
+                return d1 > d2;
+            });
+            rg::doNotOptimize(winPos.data());
+        }
+    });
+    // one window's model matrix, per operation
+    bench.add("modelMatrix/window", [](long long n) {
+        std::vector<triD> winPos = windowPositions();
+        for (long long i = 0; i < n; ++i) {
+            const triD &window = winPos[i % winPos.size()];
+            glm::mat4 model = glm::mat4(1.0f);
+            model = glm::translate(model, window.trans);
+            model = glm::scale(model, window.skal);
+            model = glm::rotate(model, glm::radians(window.rotatU), window.rotatV);
+            rg::doNotOptimize(model);
+        }
+    });
+}
+
+// LightGridBuilder::build for 4 to 4096 of the scattered lights the "Extra lights" slider adds,
+// seen from the default camera; on the calling thread alone and across a pool of the size the
+// app starts
+static void addLightGrid(rg::Microbench &bench) {
+    rg::ClusterGridConfig config = rg::ClusterGridConfig::fromPerspective(glm::radians(45.0f), 16.0f / 9.0f,
+                                                                          0.1f, 100.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 2.0f, 10.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    std::shared_ptr<rg::ThreadPool> pool(new rg::ThreadPool);
+    for (int count = 4; count <= 4096; count *= 4) {
+        std::shared_ptr<std::vector<rg::ClusterLight>> lights(new std::vector<rg::ClusterLight>);
+        rg::addScatteredLights(*lights, count);
+        for (bool threaded : {false, true}) {
+            std::string name = "LightGridBuilder::build/" + std::to_string(count) + " lights/"
+                               + (threaded ? "pool" : "serial");
+            bench.add(name, [config, view, lights, pool, threaded](long long n) {
+                rg::LightGridBuilder builder(threaded ? pool.get() : nullptr);
+                rg::LightGrid grid;
+                for (long long i = 0; i < n; ++i) {
+                    builder.build(config, view, *lights, grid);
+                    rg::doNotOptimize(grid.indices.data());
+                }
+            });
+        }
+    }
+}
+
+// the Shader uniform setters: a name lookup through glGetUniformLocation, then the upload
+static void addUniforms(rg::Microbench &bench) {
+    std::shared_ptr<Shader> shader(new Shader(FileSystem::getPath("resources/shaders/modelLightingShader.vs").c_str(),
+                                              FileSystem::getPath("resources/shaders/modelLightingShader.fs").c_str()));
+    shader->use();
+    glm::mat4 matrix = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+    glm::vec3 vector(1.0f, 2.0f, 3.0f);
+    bench.add("Shader::setMat4", [shader, matrix](long long n) {
+        for (long long i = 0; i < n; ++i)
+            shader->setMat4("projection", matrix);
+    });
+    bench.add("Shader::setVec3", [shader, vector](long long n) {
+        for (long long i = 0; i < n; ++i)
+            shader->setVec3("viewPosition", vector);
+    });
+    bench.add("Shader::setFloat", [shader](long long n) {
+        for (long long i = 0; i < n; ++i)
+            shader->setFloat("material.shininess", 32.0f);
+    });
+    bench.add("Shader::setInt", [shader](long long n) {
+        for (long long i = 0; i < n; ++i)
+            shader->setInt("material.texture_diffuse1", 0);
+    });
+}
+
+int main(int argc, char **argv) {
+    rg::Microbench bench;
+    if (!bench.parse(argc, argv))
+        return 2;
+    if (!rg::loadNullGL()) {
+        std::cout << "ERROR::BENCHMARKS::NULL_GL" << std::endl;
+        return 2;
+    }
+    stbi_set_flip_vertically_on_load(true);
+    // the loaders report every texture and buffer they make, and nothing here releases them,
+    // so the tracker's maps would grow inside the timed loops
+    rg::memoryTracker().setEnabled(false);
+
+    // the importers own their scenes, so they outlive the run
+    std::vector<std::unique_ptr<Assimp::Importer>> importers;
+    addModels(bench, importers);
+    addTextures(bench);
+    addCubemap(bench);
+    addFrameWork(bench);
+    addLightGrid(bench);
+    addUniforms(bench);
+    return bench.run();
+}
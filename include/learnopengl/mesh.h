@@ -7,6 +7,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <learnopengl/shader.h>
+#include <rg/MemoryTracker.h>
 
 #include <string>
 #include <vector>
@@ -41,6 +42,8 @@ public:
     vector<Texture>      textures;
 
     unsigned int VAO;
+    // positions only, tightly packed; depth-only passes fetch 12 bytes per vertex instead of 56
+    unsigned int positionVAO;
     std::string glslIdentifierPrefix;
     // constructor
     Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
@@ -93,9 +96,17 @@ public:
         glActiveTexture(GL_TEXTURE0);
     }
 
+    // draw without textures from the position-only stream, for depth pre-passes
+    void DrawPositions()
+    {
+        glBindVertexArray(positionVAO);
+        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+        glBindVertexArray(0);
+    }
+
 private:
     // render data
-    unsigned int VBO, EBO;
+    unsigned int VBO, EBO, positionVBO;
 
     // initializes all the buffer objects/arrays
     void setupMesh()
@@ -115,6 +126,9 @@ private:
 
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+        const string &asset = rg::memoryTracker().asset("(mesh)");
+        rg::memoryTracker().buffer(VBO, asset, rg::MemoryTracker::VERTEX_BUFFERS, vertices.size() * sizeof(Vertex));
+        rg::memoryTracker().buffer(EBO, asset, rg::MemoryTracker::INDEX_BUFFERS, indices.size() * sizeof(unsigned int));
 
         // set the vertex attribute pointers
         // vertex Positions
@@ -133,6 +147,21 @@ private:
         glEnableVertexAttribArray(4);
         glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
 
+        // position-only stream sharing the same index buffer
+        vector<glm::vec3> positions(vertices.size());
+        for(unsigned int i = 0; i < vertices.size(); i++)
+            positions[i] = vertices[i].Position;
+        glGenVertexArrays(1, &positionVAO);
+        glGenBuffers(1, &positionVBO);
+        glBindVertexArray(positionVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, positionVBO);
+        glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec3), &positions[0], GL_STATIC_DRAW);
+        rg::memoryTracker().buffer(positionVBO, asset, rg::MemoryTracker::VERTEX_BUFFERS,
+                                   positions.size() * sizeof(glm::vec3));
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+
         glBindVertexArray(0);
     }
 };
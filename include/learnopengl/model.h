@@ -12,6 +12,8 @@
 
 #include <learnopengl/mesh.h>
 #include <learnopengl/shader.h>
+#include <rg/MemoryTracker.h>
+#include <rg/Profiler.h>
 
 #include <string>
 #include <fstream>
@@ -33,43 +35,78 @@ public:
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
+    // profiler scope shared by every Draw of this model, named after its directory
+    int profileScope;
+
+    // the flags every model is imported with
+    static const unsigned int importFlags = aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+
+    // an empty model, to be filled by processScene
+    Model() : gammaCorrection(false)
+    {
+        profileScope = rg::profiler().scope("Model::Draw");
+    }
 
     // constructor, expects a filepath to a 3D model.
     Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
     {
         loadModel(path);
+        string dir = path.substr(0, path.find_last_of('/'));
+        profileScope = rg::profiler().scope("Model::Draw " + dir.substr(dir.find_last_of('/') + 1));
     }
 
     // draws the model, and thus all its meshes
     void Draw(Shader &shader)
     {
+        rg::ProfileScope scope(profileScope);
         for(unsigned int i = 0; i < meshes.size(); i++)
             meshes[i].Draw(shader);
     }
 
+    // geometry only, the caller has bound a program that reads nothing but positions
+    void DrawPositions()
+    {
+        rg::ProfileScope scope(profileScope);
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].DrawPositions();
+    }
+
     void SetShaderTextureNamePrefix(std::string prefix) {
         for (Mesh& mesh: meshes) {
             mesh.glslIdentifierPrefix = prefix;
         }
     }
+
+    // appends the meshes of an imported scene; textures are looked up in directory
+    void processScene(const aiScene *scene, string const &dir)
+    {
+        directory = dir;
+        // process ASSIMP's root node recursively
+        processNode(scene->mRootNode, scene);
+    }
+
 private:
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
     void loadModel(string const &path)
     {
+        rg::TraceScope trace("load", "Load model", rg::traceDetail(path));
         // read file via ASSIMP
         Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+        const aiScene* scene = importer.ReadFile(path, importFlags);
         // check for errors
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
             cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
             return;
         }
-        // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
-
-        // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+        // retrieve the directory path of the filepath; the meshes and textures are the model's
+        rg::MemoryTracker::AssetScope asset(rg::memoryTracker(), path);
+        processScene(scene, path.substr(0, path.find_last_of('/')));
+        // the meshes keep their vertices and indices after the upload
+        size_t bytes = 0;
+        for (const Mesh &mesh : meshes)
+            bytes += mesh.vertices.capacity() * sizeof(Vertex) + mesh.indices.capacity() * sizeof(unsigned int);
+        rg::memoryTracker().cpu(this, path, rg::MemoryTracker::CPU_GEOMETRY, bytes);
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
@@ -205,7 +242,9 @@ private:
             if(!skip)
             {   // if texture hasn't been loaded already, load it
                 Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
+                // colour maps are authored in sRGB, the others (normals, specular) hold linear data
+                texture.id = TextureFromFile(str.C_Str(), this->directory,
+                                             gammaCorrection && typeName == "texture_diffuse");
                 texture.type = typeName;
                 texture.path = str.C_Str();
                 textures.push_back(texture);
@@ -221,6 +260,7 @@ unsigned int TextureFromFile(const char *path, const string &directory, bool gam
 {
     string filename = string(path);
     filename = directory + '/' + filename;
+    rg::TraceScope trace("load", "Load texture", rg::traceDetail(filename));
 
     unsigned int textureID;
     glGenTextures(1, &textureID);
@@ -236,10 +276,18 @@ unsigned int TextureFromFile(const char *path, const string &directory, bool gam
             format = GL_RGB;
         else if (nrComponents == 4)
             format = GL_RGBA;
+        // gamma: the texels are sRGB-encoded, the sampler decodes them to linear
+        GLenum internalFormat = format;
+        if (gamma && format == GL_RGB)
+            internalFormat = GL_SRGB8;
+        else if (gamma && format == GL_RGBA)
+            internalFormat = GL_SRGB8_ALPHA8;
 
         glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, data);
         glGenerateMipmap(GL_TEXTURE_2D);
+        rg::memoryTracker().texture(textureID, rg::memoryTracker().asset(filename), rg::MemoryTracker::TEXTURES,
+                                    internalFormat, width, height, 1, rg::mipLevels(width, height));
 
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -8,7 +8,24 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <chrono>
+#include <cstdio>
+#include <iterator>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <cerrno>
+#include <cstring>
+#include <sys/stat.h>
 #include <common.h>
+#include <learnopengl/filesystem.h>
+#include <rg/GLExtensions.h>
+#include <rg/Trace.h>
+
+// linked program binaries are kept here between runs, under the project root like the other
+// resources, see loadProgramBinary/storeProgramBinary
+#define SHADER_CACHE_DIRECTORY "resources/shader_cache"
+
 class Shader
 {
 public:
@@ -16,9 +33,17 @@ public:
     // constructor generates the shader on the fly
     // ------------------------------------------------------------------------
     Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
+        : Shader(vertexPath, fragmentPath, std::vector<std::string>(), geometryPath)
+    {
+    }
+    // same as above, but every entry of defines ("NAME" or "NAME VALUE") is injected
+    // as a #define right after the #version line of each stage
+    // ------------------------------------------------------------------------
+    Shader(const char* vertexPath, const char* fragmentPath, const std::vector<std::string> &defines, const char* geometryPath = nullptr)
     {
         std::string vertexPathString(vertexPath);
         std::string fragmentPathString(fragmentPath);
+        rg::TraceScope trace("load", "Load shader", rg::traceDetail(fragmentPathString));
 
         vertexPath = vertexPathString.c_str();
         fragmentPath= fragmentPathString.c_str();
@@ -64,49 +89,144 @@ public:
         {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
         }
+        vertexCode = injectDefines(vertexCode, defines);
+        fragmentCode = injectDefines(fragmentCode, defines);
+        if(geometryPath != nullptr)
+            geometryCode = injectDefines(geometryCode, defines);
+        label = vertexPath;
+        for (const std::string &define : defines)
+            label += " +" + define;
+        // 2. try the on-disk program cache before compiling anything
+        typedef std::chrono::steady_clock clock;
+        clock::time_point start = clock::now();
+        cachePath = programCachePath(vertexCode, fragmentCode, geometryCode);
+        ID = glCreateProgram();
+        if (loadProgramBinary(cachePath))
+        {
+            std::cout << "SHADER::" << label << " loaded from cache in "
+                      << std::chrono::duration<double, std::milli>(clock::now() - start).count() << "ms" << std::endl;
+            return;
+        }
+        // the driver rejected the binary (or there was none), start over with a clean program
+        glDeleteProgram(ID);
+        ID = glCreateProgram();
+
         const char* vShaderCode = vertexCode.c_str();
         const char * fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
+        // 3. compile and link shaders. Nothing here asks the driver for a result, so with
+        // KHR_parallel_shader_compile the work runs on driver threads while we carry on;
+        // status is only checked in finish(), on first use
+        clock::time_point compileStart = clock::now();
         unsigned int vertex, fragment;
         // vertex shader
         vertex = glCreateShader(GL_VERTEX_SHADER);
         glShaderSource(vertex, 1, &vShaderCode, NULL);
         glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
         // fragment Shader
         fragment = glCreateShader(GL_FRAGMENT_SHADER);
         glShaderSource(fragment, 1, &fShaderCode, NULL);
         glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
         // if geometry shader is given, compile geometry shader
-        unsigned int geometry;
+        unsigned int geometry = 0;
         if(geometryPath != nullptr)
         {
             const char * gShaderCode = geometryCode.c_str();
             geometry = glCreateShader(GL_GEOMETRY_SHADER);
             glShaderSource(geometry, 1, &gShaderCode, NULL);
             glCompileShader(geometry);
-            checkCompileErrors(geometry, "GEOMETRY");
         }
+        clock::time_point compiled = clock::now();
         // shader Program
-        ID = glCreateProgram();
         glAttachShader(ID, vertex);
         glAttachShader(ID, fragment);
         if(geometryPath != nullptr)
             glAttachShader(ID, geometry);
+        if (rg::glExtensions().programBinary)
+            rg::glExtensions().ProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
         glLinkProgram(ID);
+        clock::time_point linked = clock::now();
+
+        pending = true;
+        stages[0] = vertex;
+        stages[1] = fragment;
+        stages[2] = geometry;
+        submitTime = start;
+        compileSubmitMs = std::chrono::duration<double, std::milli>(compiled - compileStart).count();
+        linkSubmitMs = std::chrono::duration<double, std::milli>(linked - compiled).count();
+    }
+    // false while the driver is still compiling/linking in the background. Without
+    // KHR_parallel_shader_compile there is no way to ask without blocking, so it reports true
+    // ------------------------------------------------------------------------
+    bool isReady() const
+    {
+        if (!pending || !rg::glExtensions().parallelShaderCompile)
+            return true;
+        GLint completed = GL_FALSE;
+        glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &completed);
+        return completed == GL_TRUE;
+    }
+    // submitted and not finished yet
+    // ------------------------------------------------------------------------
+    bool isPending() const
+    {
+        return pending;
+    }
+    // callback runs with the program bound as soon as it has been checked, e.g. to set samplers
+    // ------------------------------------------------------------------------
+    void whenReady(std::function<void(Shader&)> callback)
+    {
+        if (pending)
+        {
+            onReady = std::move(callback);
+            return;
+        }
+        glUseProgram(ID);
+        callback(*this);
+    }
+    // waits for the driver if needed, reports errors, releases the stage objects and stores the binary
+    // ------------------------------------------------------------------------
+    void finish()
+    {
+        if (!pending)
+            return;
+        pending = false;
+        typedef std::chrono::steady_clock clock;
+        clock::time_point start = clock::now();
+        checkCompileErrors(stages[0], "VERTEX");
+        checkCompileErrors(stages[1], "FRAGMENT");
+        if (stages[2])
+            checkCompileErrors(stages[2], "GEOMETRY");
+        clock::time_point compiled = clock::now();
         checkCompileErrors(ID, "PROGRAM");
+        clock::time_point end = clock::now();
+        // each step's time on this thread, submitting it and then waiting on its status; a
+        // driver that compiles in the background shows it in the wait or not at all
+        double compileWaitMs = std::chrono::duration<double, std::milli>(compiled - start).count();
+        double linkWaitMs = std::chrono::duration<double, std::milli>(end - compiled).count();
+        std::cout << "SHADER::" << label << " compiled in " << compileSubmitMs + compileWaitMs << "ms ("
+                  << compileSubmitMs << "ms submitting, " << compileWaitMs << "ms waiting), linked in "
+                  << linkSubmitMs + linkWaitMs << "ms (" << linkSubmitMs << "ms submitting, " << linkWaitMs
+                  << "ms waiting), ready " << std::chrono::duration<double, std::milli>(end - submitTime).count()
+                  << "ms after submission" << std::endl;
         // delete the shaders as they're linked into our program now and no longer necessery
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
-        if(geometryPath != nullptr)
-            glDeleteShader(geometry);
-
+        for (unsigned int stage : stages)
+        {
+            if (stage)
+                glDeleteShader(stage);
+        }
+        storeProgramBinary(cachePath);
+        if (onReady)
+        {
+            glUseProgram(ID);
+            onReady(*this);
+            onReady = nullptr;
+        }
     }
     // activate the shader
     // ------------------------------------------------------------------------
     void use() 
     { 
+        finish();
         glUseProgram(ID); 
     }
     // utility uniform functions
@@ -144,6 +264,11 @@ public:
         glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
     }
     // ------------------------------------------------------------------------
+    void setUVec3(const std::string &name, unsigned int x, unsigned int y, unsigned int z) const
+    {
+        glUniform3ui(glGetUniformLocation(ID, name.c_str()), x, y, z);
+    }
+    // ------------------------------------------------------------------------
     void setVec4(const std::string &name, const glm::vec4 &value) const
     { 
         glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
@@ -169,6 +294,132 @@ public:
     }
 
 private:
+    bool pending = false;
+    unsigned int stages[3] = {0, 0, 0};
+    std::string label;
+    std::string cachePath;
+    std::chrono::steady_clock::time_point submitTime;
+    double compileSubmitMs = 0.0;
+    double linkSubmitMs = 0.0;
+    std::function<void(Shader&)> onReady;
+
+    // ------------------------------------------------------------------------
+    static std::string injectDefines(const std::string &source, const std::vector<std::string> &defines)
+    {
+        if (defines.empty())
+            return source;
+        std::string block;
+        for (const std::string &define : defines)
+            block += "#define " + define + "\n";
+        // #version has to stay the first statement, so the block goes on the line after it
+        size_t version = source.find("#version");
+        size_t insertAt = version == std::string::npos ? 0 : source.find('\n', version);
+        if (insertAt == std::string::npos)
+            return source + "\n" + block;
+        if (version != std::string::npos)
+            insertAt++;
+        return source.substr(0, insertAt) + block + source.substr(insertAt);
+    }
+    // 64-bit FNV-1a, good enough to tell shader sources apart
+    // ------------------------------------------------------------------------
+    static uint64_t hashString(const std::string &text, uint64_t hash = 14695981039346656037ULL)
+    {
+        for (unsigned char c : text)
+        {
+            hash ^= c;
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+    // the key covers the full source text (including injected defines) and the driver identity,
+    // so a driver update or a shader edit simply misses the cache instead of loading a stale binary
+    // ------------------------------------------------------------------------
+    std::string programCachePath(const std::string &vertexCode, const std::string &fragmentCode, const std::string &geometryCode) const
+    {
+        uint64_t hash = hashString(vertexCode);
+        hash = hashString(fragmentCode, hash ^ 0x01);
+        hash = hashString(geometryCode, hash ^ 0x02);
+        const GLenum driverStrings[] = {GL_VENDOR, GL_RENDERER, GL_VERSION};
+        for (GLenum name : driverStrings)
+        {
+            const char* value = (const char*) glGetString(name);
+            hash = hashString(value ? value : "", hash);
+        }
+        char fileName[32];
+        snprintf(fileName, sizeof(fileName), "%016llx.bin", (unsigned long long) hash);
+        return cacheDirectory() + "/" + fileName;
+    }
+    // ------------------------------------------------------------------------
+    static const std::string& cacheDirectory()
+    {
+        static const std::string directory = FileSystem::getPath(SHADER_CACHE_DIRECTORY);
+        return directory;
+    }
+    // creates the cache directory and any missing parents; a failure is reported once, after
+    // which the cache just isn't written
+    // ------------------------------------------------------------------------
+    static bool makeCacheDirectory()
+    {
+        static int state = 0; // 0 not tried yet, 1 there, -1 failed
+        if (state != 0)
+            return state > 0;
+        const std::string &directory = cacheDirectory();
+        for (size_t slash = directory.find('/', 1); ; slash = directory.find('/', slash + 1))
+        {
+            std::string part = directory.substr(0, slash);
+            if (mkdir(part.c_str(), 0755) != 0 && errno != EEXIST)
+            {
+                std::cout << "ERROR::SHADER::CACHE_DIRECTORY " << part << ": " << strerror(errno) << std::endl;
+                state = -1;
+                return false;
+            }
+            if (slash == std::string::npos)
+                break;
+        }
+        state = 1;
+        return true;
+    }
+    // ------------------------------------------------------------------------
+    bool loadProgramBinary(const std::string &path)
+    {
+        if (!rg::glExtensions().programBinary)
+            return false;
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+            return false;
+        GLenum format = 0;
+        in.read((char*) &format, sizeof(format));
+        if (!in)
+            return false;
+        std::vector<char> binary((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        if (binary.empty())
+            return false;
+        rg::glExtensions().ProgramBinary(ID, format, binary.data(), (GLsizei) binary.size());
+        GLint success = 0;
+        glGetProgramiv(ID, GL_LINK_STATUS, &success);
+        if (!success)
+            std::cout << "SHADER::" << path << " rejected by the driver, recompiling" << std::endl;
+        return success;
+    }
+    // ------------------------------------------------------------------------
+    void storeProgramBinary(const std::string &path) const
+    {
+        GLint success = 0, length = 0;
+        glGetProgramiv(ID, GL_LINK_STATUS, &success);
+        if (!rg::glExtensions().programBinary || !success)
+            return;
+        glGetProgramiv(ID, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return;
+        std::vector<char> binary(length);
+        GLenum format = 0;
+        rg::glExtensions().GetProgramBinary(ID, length, NULL, &format, binary.data());
+        if (!makeCacheDirectory())
+            return;
+        std::ofstream out(path, std::ios::binary);
+        out.write((const char*) &format, sizeof(format));
+        out.write(binary.data(), binary.size());
+    }
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
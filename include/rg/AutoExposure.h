@@ -0,0 +1,203 @@
+#ifndef PROJECT_BASE_AUTOEXPOSURE_H
+#define PROJECT_BASE_AUTOEXPOSURE_H
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <glad/glad.h>
+#include <learnopengl/shader.h>
+#include <rg/MemoryTracker.h>
+
+namespace rg {
+
+    // Eye adaptation from the average log luminance of the HDR scene. measure() draws the
+    // scene's log2 luminance into a SIZE x SIZE R16F target and lets glGenerateMipmap
+    // average it down to the 1x1 level, all on the GPU. That texel is copied into one of
+    // LATENCY pixel pack buffers with a fence behind it. update() only maps a buffer once
+    // its fence has signalled, checked with glGetSynciv, which never waits. So the CPU never
+    // stalls on the GPU, and the exposure follows the scene a few frames late.
+    class AutoExposure {
+    public:
+        static const int SIZE = 256;
+        static const int LATENCY = 3;
+
+        AutoExposure() : m_LogLuminance("resources/shaders/hdr.vs", "resources/shaders/logLuminance.fs") {
+            m_LogLuminance.whenReady([](Shader &shader) {
+                shader.setInt("scene", 0);
+            });
+
+            glGenTextures(1, &m_Texture);
+            glBindTexture(GL_TEXTURE_2D, m_Texture);
+            for (int level = 0, size = SIZE; size > 0; ++level, size /= 2)
+                glTexImage2D(GL_TEXTURE_2D, level, GL_R16F, size, size, 0, GL_RED, GL_FLOAT, NULL);
+            memoryTracker().texture(m_Texture, "Auto exposure", MemoryTracker::RENDER_TARGETS, GL_R16F, SIZE, SIZE,
+                                    1, mipLevels(SIZE, SIZE));
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glBindTexture(GL_TEXTURE_2D, 0);
+
+            glGenFramebuffers(1, &m_Framebuffer);
+            glBindFramebuffer(GL_FRAMEBUFFER, m_Framebuffer);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_Texture, 0);
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+                std::cout << "ERROR::FRAMEBUFFER::AUTO_EXPOSURE!" << std::endl;
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+            glGenBuffers(LATENCY, m_Buffers);
+            for (int i = 0; i < LATENCY; ++i) {
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, m_Buffers[i]);
+                glBufferData(GL_PIXEL_PACK_BUFFER, sizeof(float), NULL, GL_STREAM_READ);
+                memoryTracker().buffer(m_Buffers[i], "Auto exposure", MemoryTracker::OTHER_BUFFERS, sizeof(float));
+            }
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        }
+
+        ~AutoExposure() {
+            for (GLsync fence : m_Fences) {
+                if (fence)
+                    glDeleteSync(fence);
+            }
+            glDeleteBuffers(LATENCY, m_Buffers);
+            glDeleteFramebuffers(1, &m_Framebuffer);
+            glDeleteTextures(1, &m_Texture);
+            for (GLuint buffer : m_Buffers)
+                memoryTracker().releaseBuffer(buffer);
+            memoryTracker().releaseTexture(m_Texture);
+        }
+
+        AutoExposure(const AutoExposure&) = delete;
+        AutoExposure& operator=(const AutoExposure&) = delete;
+
+        // the target measure() writes, for the frame graph
+        GLuint texture() const {
+            return m_Texture;
+        }
+
+        // reduces the scene to its average log luminance and queues the asynchronous read-back
+        void measure(GLuint scene, unsigned int quadVAO) {
+            GLint viewport[4];
+            glGetIntegerv(GL_VIEWPORT, viewport);
+            glBindFramebuffer(GL_FRAMEBUFFER, m_Framebuffer);
+            glViewport(0, 0, SIZE, SIZE);
+            m_LogLuminance.use();
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, scene);
+            glBindVertexArray(quadVAO);
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            glBindVertexArray(0);
+            glBindTexture(GL_TEXTURE_2D, m_Texture);
+            glGenerateMipmap(GL_TEXTURE_2D);
+
+            int slot = (int) (m_Frame % LATENCY);
+            // still pending after LATENCY frames: the GPU is that far behind, give the slot up
+            if (m_Fences[slot]) {
+                glDeleteSync(m_Fences[slot]);
+                ++m_Dropped;
+            }
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, m_Buffers[slot]);
+            // with a pack buffer bound this only queues a copy into it
+            glGetTexImage(GL_TEXTURE_2D, LEVELS - 1, GL_RED, GL_FLOAT, (void *) 0);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            glBindTexture(GL_TEXTURE_2D, 0);
+            m_Fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            m_Issued[slot] = m_Frame++;
+
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        }
+
+        // picks up every read-back that has completed, oldest first, and moves the exposure
+        // towards the one that maps the average luminance to KEY; compensation is in stops.
+        // deterministic waits for the measurement from two frames back and takes nothing
+        // newer, so the exposure of a replayed frame doesn't depend on how fast the GPU was
+        float update(float deltaTime, float compensation, float speed, bool deterministic = false) {
+            long long newest = deterministic ? m_Frame - 2 : m_Frame - 1;
+            for (long long frame = m_Frame - LATENCY; frame <= newest; ++frame) {
+                if (frame < 0)
+                    continue;
+                int slot = (int) (frame % LATENCY);
+                if (!m_Fences[slot] || m_Issued[slot] != frame)
+                    continue;
+                if (deterministic)
+                    glClientWaitSync(m_Fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, WAIT_TIMEOUT_NS);
+                GLint status = GL_UNSIGNALED;
+                glGetSynciv(m_Fences[slot], GL_SYNC_STATUS, 1, NULL, &status);
+                // later copies can't have finished before this one
+                if (status != GL_SIGNALED)
+                    break;
+                glDeleteSync(m_Fences[slot]);
+                m_Fences[slot] = 0;
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, m_Buffers[slot]);
+                float *value = (float *) glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, sizeof(float), GL_MAP_READ_BIT);
+                if (value) {
+                    m_AverageLog = *value;
+                    m_Latency = (int) (m_Frame - frame);
+                    ++m_Readbacks;
+                    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+                }
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            }
+            if (m_Readbacks == 0)
+                return exposure();
+
+            float target = std::log2(KEY) - m_AverageLog + compensation;
+            target = std::min(std::max(target, MIN_EXPOSURE_LOG), MAX_EXPOSURE_LOG);
+            if (!m_Adapted) {
+                // nothing to adapt from on the first result
+                m_ExposureLog = target;
+                m_Adapted = true;
+            } else {
+                // frame-rate independent exponential approach
+                m_ExposureLog += (target - m_ExposureLog) * (1.0f - std::exp(-deltaTime * speed));
+            }
+            return exposure();
+        }
+
+        float exposure() const {
+            return std::exp2(m_ExposureLog);
+        }
+
+        float averageLuminance() const {
+            return std::exp2(m_AverageLog);
+        }
+
+        // frames between a measurement and the update that used it
+        int latency() const {
+            return m_Latency;
+        }
+
+        long long readbacks() const {
+            return m_Readbacks;
+        }
+
+        // measurements overwritten before their copy had finished
+        long long dropped() const {
+            return m_Dropped;
+        }
+
+    private:
+        static const int LEVELS = 9;
+        // average luminance the exposure maps to: middle grey
+        static constexpr float KEY = 0.18f;
+        static constexpr float MIN_EXPOSURE_LOG = -6.0f;
+        static constexpr float MAX_EXPOSURE_LOG = 6.0f;
+        // a second; a deterministic update that waits longer has a bigger problem than timing
+        static const GLuint64 WAIT_TIMEOUT_NS = 1000000000;
+
+        Shader m_LogLuminance;
+        GLuint m_Texture = 0;
+        GLuint m_Framebuffer = 0;
+        GLuint m_Buffers[LATENCY] = {};
+        GLsync m_Fences[LATENCY] = {};
+        long long m_Issued[LATENCY] = {};
+        long long m_Frame = 0;
+        long long m_Readbacks = 0;
+        long long m_Dropped = 0;
+        int m_Latency = 0;
+        float m_AverageLog = 0.0f;
+        float m_ExposureLog = 0.0f;
+        bool m_Adapted = false;
+    };
+
+};
+#endif //PROJECT_BASE_AUTOEXPOSURE_H
@@ -0,0 +1,463 @@
+#ifndef PROJECT_BASE_BENCHMARK_H
+#define PROJECT_BASE_BENCHMARK_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+namespace rg {
+
+    // Camera keys read from a text file, one per line: time in seconds, position x y z, yaw
+    // and pitch in degrees. Blank lines and lines starting with # are skipped. Between keys
+    // everything is interpolated linearly, yaw included, so a key at 400 degrees after one at
+    // 10 keeps turning the same way instead of swinging back.
+    class CameraPath {
+    public:
+        struct Key {
+            float time;
+            glm::vec3 position;
+            float yaw;
+            float pitch;
+        };
+
+        bool load(const std::string &path) {
+            std::ifstream in(path);
+            if (!in) {
+                std::cout << "ERROR::BENCHMARK::CAMERA_PATH_NOT_FOUND " << path << std::endl;
+                return false;
+            }
+            m_Keys.clear();
+            std::string line;
+            int lineNumber = 0;
+            while (std::getline(in, line)) {
+                ++lineNumber;
+                size_t first = line.find_first_not_of(" \t\r");
+                if (first == std::string::npos || line[first] == '#')
+                    continue;
+                std::istringstream fields(line);
+                Key key;
+                if (!(fields >> key.time >> key.position.x >> key.position.y >> key.position.z >> key.yaw >> key.pitch)) {
+                    std::cout << "ERROR::BENCHMARK::CAMERA_PATH " << path << ":" << lineNumber
+                              << ": expected time x y z yaw pitch" << std::endl;
+                    return false;
+                }
+                if (!m_Keys.empty() && key.time <= m_Keys.back().time) {
+                    std::cout << "ERROR::BENCHMARK::CAMERA_PATH " << path << ":" << lineNumber
+                              << ": times must increase" << std::endl;
+                    return false;
+                }
+                m_Keys.push_back(key);
+            }
+            if (m_Keys.empty()) {
+                std::cout << "ERROR::BENCHMARK::CAMERA_PATH " << path << ": no keys" << std::endl;
+                return false;
+            }
+            return true;
+        }
+
+        float duration() const {
+            return m_Keys.empty() ? 0.0f : m_Keys.back().time - m_Keys.front().time;
+        }
+
+        // the camera at time seconds after the first key, held at either end
+        Key sample(float time) const {
+            time += m_Keys.front().time;
+            if (time <= m_Keys.front().time)
+                return m_Keys.front();
+            if (time >= m_Keys.back().time)
+                return m_Keys.back();
+            size_t next = 1;
+            while (m_Keys[next].time < time)
+                ++next;
+            const Key &a = m_Keys[next - 1];
+            const Key &b = m_Keys[next];
+            float t = (time - a.time) / (b.time - a.time);
+            Key key;
+            key.time = time;
+            key.position = glm::mix(a.position, b.position, t);
+            key.yaw = a.yaw + (b.yaw - a.yaw) * t;
+            key.pitch = a.pitch + (b.pitch - a.pitch) * t;
+            return key;
+        }
+
+    private:
+        std::vector<Key> m_Keys;
+    };
+
+    // Command line of a benchmark run. A budget of 0 is not checked. The trace options are
+    // parsed here too, so there is one parser for the command line; they work with or
+    // without --benchmark.
+    struct BenchmarkOptions {
+        bool enabled = false;
+        std::string cameraPath;
+        // the path is spread evenly over the recorded frames, so every run renders the same
+        // frames however fast it goes
+        int frames = 600;
+        // rendered first and not recorded: shader compiles, pool growth, driver warm-up
+        int warmupFrames = 30;
+        unsigned int width = 1600;
+        unsigned int height = 900;
+        // <output>.csv and <output>.json
+        std::string output = "benchmark";
+        bool osmesa = false;
+        double cpuBudgetMs = 0.0;
+        double gpuBudgetMs = 0.0;
+        long long drawBudget = 0;
+        // GL calls go to rg::loadNullGL() and no context is made, so a run measures the CPU
+        // side of submission alone and counts every call
+        bool nullGL = false;
+        // most state changes a profiler scope may issue in a frame, from --budget-state-changes
+        // "<scope>=<max>"; needs --null-gl, which does the counting
+        std::vector<std::pair<std::string, long long>> stateChangeBudgets;
+        // a Chrome trace of frames [traceStart, traceStart + traceFrames); starting at frame 0
+        // also takes in the loading before it
+        std::string tracePath;
+        int traceStart = 0;
+        int traceFrames = 120;
+        // input log to write, or to play back; a replay is timed like a benchmark and
+        // written to <output>.csv and <output>.json the same way
+        std::string recordPath;
+        std::string replayPath;
+        // simulation step of a replay in seconds, 0 for the frame times that were recorded
+        float replayStep = 1.0f / 60.0f;
+        // every n-th replayed frame is saved as replay_<frame>.ppm, 0 for none
+        int replayCapture = 0;
+        // minimum severity of the driver messages to print through KHR_debug, "off" for none;
+        // Debug builds have them on by default, synchronously, with a backtrace per message
+#ifdef RG_GL_DEBUG
+        std::string glDebug = "medium";
+#else
+        std::string glDebug = "off";
+#endif
+        // comma separated message sources to leave out, e.g. "shader-compiler,third-party"
+        std::string glDebugIgnore;
+
+        static void usage() {
+            std::cout << "usage: project_base [--benchmark <camera path> [--frames <n>] [--warmup <n>]\n"
+                         "                    [--size <width>x<height>] [--output <prefix>] [--osmesa | --null-gl]\n"
+                         "                    [--budget-cpu-ms <p95>] [--budget-gpu-ms <p95>] [--budget-draws <max>]\n"
+                         "                    [--budget-state-changes <scope>=<max>]...]\n"
+                         "                   [--trace <file.json> [--trace-start <frame>] [--trace-frames <n>]]\n"
+                         "                   [--record <input log> | --replay <input log> [--replay-step <s>]\n"
+                         "                    [--replay-capture <every n frames>] [--output <prefix>]]\n"
+                         "                   [--gl-debug <off|notification|low|medium|high>] [--gl-debug-ignore <sources>]"
+                      << std::endl;
+        }
+
+        // false, after printing why, on anything it doesn't understand
+        bool parse(int argc, char **argv) {
+            for (int i = 1; i < argc; ++i) {
+                std::string arg = argv[i];
+                bool hasValue = i + 1 < argc;
+                std::string value = hasValue ? argv[i + 1] : "";
+                if (arg == "--osmesa") {
+                    osmesa = true;
+                    continue;
+                }
+                if (arg == "--null-gl") {
+                    nullGL = true;
+                    continue;
+                }
+                if (!hasValue) {
+                    std::cout << "ERROR::BENCHMARK::ARGUMENT " << arg << std::endl;
+                    usage();
+                    return false;
+                }
+                ++i;
+                if (arg == "--benchmark") {
+                    enabled = true;
+                    cameraPath = value;
+                } else if (arg == "--frames") {
+                    frames = std::max(1, std::atoi(value.c_str()));
+                } else if (arg == "--warmup") {
+                    warmupFrames = std::max(0, std::atoi(value.c_str()));
+                } else if (arg == "--output") {
+                    output = value;
+                } else if (arg == "--budget-cpu-ms") {
+                    cpuBudgetMs = std::atof(value.c_str());
+                } else if (arg == "--budget-gpu-ms") {
+                    gpuBudgetMs = std::atof(value.c_str());
+                } else if (arg == "--budget-draws") {
+                    drawBudget = std::atoll(value.c_str());
+                } else if (arg == "--budget-state-changes") {
+                    size_t equals = value.rfind('=');
+                    if (equals == std::string::npos || equals == 0) {
+                        std::cout << "ERROR::BENCHMARK::ARGUMENT --budget-state-changes " << value
+                                  << ": expected <scope>=<max>" << std::endl;
+                        return false;
+                    }
+                    stateChangeBudgets.emplace_back(value.substr(0, equals), std::atoll(value.c_str() + equals + 1));
+                } else if (arg == "--trace") {
+                    tracePath = value;
+                } else if (arg == "--trace-start") {
+                    traceStart = std::max(0, std::atoi(value.c_str()));
+                } else if (arg == "--trace-frames") {
+                    traceFrames = std::max(1, std::atoi(value.c_str()));
+                } else if (arg == "--record") {
+                    recordPath = value;
+                } else if (arg == "--replay") {
+                    replayPath = value;
+                } else if (arg == "--replay-step") {
+                    replayStep = std::max(0.0f, (float) std::atof(value.c_str()));
+                } else if (arg == "--replay-capture") {
+                    replayCapture = std::max(0, std::atoi(value.c_str()));
+                } else if (arg == "--gl-debug") {
+                    glDebug = value;
+                } else if (arg == "--gl-debug-ignore") {
+                    glDebugIgnore = value;
+                } else if (arg == "--size") {
+                    unsigned int w = 0, h = 0;
+                    if (std::sscanf(value.c_str(), "%ux%u", &w, &h) != 2 || w == 0 || h == 0) {
+                        std::cout << "ERROR::BENCHMARK::ARGUMENT --size " << value << std::endl;
+                        return false;
+                    }
+                    width = w;
+                    height = h;
+                } else {
+                    std::cout << "ERROR::BENCHMARK::ARGUMENT " << arg << std::endl;
+                    usage();
+                    return false;
+                }
+            }
+            if (enabled && !replayPath.empty()) {
+                std::cout << "ERROR::BENCHMARK::ARGUMENT --replay drives the camera itself, it can't be a --benchmark" << std::endl;
+                return false;
+            }
+            if (!recordPath.empty() && !replayPath.empty()) {
+                std::cout << "ERROR::BENCHMARK::ARGUMENT --record and --replay together" << std::endl;
+                return false;
+            }
+            if (nullGL && !enabled && replayPath.empty()) {
+                std::cout << "ERROR::BENCHMARK::ARGUMENT --null-gl shows nothing, it needs --benchmark or --replay" << std::endl;
+                return false;
+            }
+            if (!stateChangeBudgets.empty() && !nullGL) {
+                std::cout << "ERROR::BENCHMARK::ARGUMENT --budget-state-changes is counted by --null-gl" << std::endl;
+                return false;
+            }
+            return true;
+        }
+    };
+
+    // One row per recorded frame, written out as CSV and JSON, and checked against the
+    // budgets: p95 for the times, the worst frame for the draw and state change counts.
+    class BenchmarkRecorder {
+    public:
+        struct Frame {
+            int frame;
+            double cpuMs;
+            double gpuMs;
+            long long draws;
+            long long vertices;
+            // from the null GL, 0 without it
+            long long glCalls;
+            long long stateChanges;
+            double renderTargetMegabytes;
+            double residentMegabytes;
+        };
+
+        void record(const Frame &frame) {
+            m_Frames.push_back(frame);
+        }
+
+        size_t size() const {
+            return m_Frames.size();
+        }
+
+        // a profiler scope's counted state changes in a recorded frame; the worst is kept
+        void recordScopeStateChanges(const std::string &scope, long long count) {
+            auto it = m_ScopeStateChanges.find(scope);
+            if (it == m_ScopeStateChanges.end())
+                m_ScopeStateChanges[scope] = count;
+            else
+                it->second = std::max(it->second, count);
+        }
+
+        // calls per GL entry point over all the recorded frames
+        void setGLCalls(std::vector<std::pair<std::string, unsigned long long>> calls) {
+            m_GLCalls = std::move(calls);
+        }
+
+        bool writeCSV(const std::string &path) const {
+            std::ofstream out(path);
+            if (!out) {
+                std::cout << "ERROR::BENCHMARK::WRITE_FAILED " << path << std::endl;
+                return false;
+            }
+            out << "frame,cpu_ms,gpu_ms,draws,vertices,gl_calls,state_changes,render_target_mb,resident_mb\n";
+            for (const Frame &f : m_Frames)
+                out << f.frame << ',' << f.cpuMs << ',' << f.gpuMs << ',' << f.draws << ',' << f.vertices << ','
+                    << f.glCalls << ',' << f.stateChanges << ',' << f.renderTargetMegabytes << ','
+                    << f.residentMegabytes << '\n';
+            return true;
+        }
+
+        bool writeJSON(const std::string &path, const BenchmarkOptions &options, const std::string &renderer) const {
+            std::ofstream out(path);
+            if (!out) {
+                std::cout << "ERROR::BENCHMARK::WRITE_FAILED " << path << std::endl;
+                return false;
+            }
+            out << "{\n"
+                << "  \"renderer\": \"" << escape(renderer) << "\",\n"
+                << (options.replayPath.empty() ? "  \"camera_path\": \"" : "  \"input_log\": \"")
+                << escape(options.replayPath.empty() ? options.cameraPath : options.replayPath) << "\",\n"
+                << "  \"width\": " << options.width << ",\n"
+                << "  \"height\": " << options.height << ",\n"
+                << "  \"warmup_frames\": " << options.warmupFrames << ",\n"
+                << "  \"null_gl\": " << (options.nullGL ? "true" : "false") << ",\n"
+                << "  \"summary\": {\n"
+                << "    \"cpu_ms\": " << summary(&Frame::cpuMs) << ",\n"
+                << "    \"gpu_ms\": " << summary(&Frame::gpuMs) << ",\n"
+                << "    \"max_draws\": " << maxDraws() << ",\n"
+                << "    \"max_gl_calls\": " << maxOf(&Frame::glCalls) << ",\n"
+                << "    \"max_state_changes\": " << maxOf(&Frame::stateChanges) << ",\n"
+                << "    \"max_resident_mb\": " << maxOf(&Frame::residentMegabytes) << "\n"
+                << "  },\n"
+                << "  \"budgets\": {\"cpu_p95_ms\": " << options.cpuBudgetMs << ", \"gpu_p95_ms\": "
+                << options.gpuBudgetMs << ", \"max_draws\": " << options.drawBudget << ", \"state_changes\": {";
+            for (size_t i = 0; i < options.stateChangeBudgets.size(); ++i)
+                out << (i ? ", " : "") << "\"" << escape(options.stateChangeBudgets[i].first) << "\": "
+                    << options.stateChangeBudgets[i].second;
+            out << "}},\n"
+                << "  \"max_state_changes_per_scope\": {";
+            bool first = true;
+            for (const auto &scope : m_ScopeStateChanges) {
+                out << (first ? "" : ", ") << "\"" << escape(scope.first) << "\": " << scope.second;
+                first = false;
+            }
+            // per frame, so runs of different lengths compare
+            out << "},\n"
+                << "  \"gl_calls_per_frame\": {";
+            for (size_t i = 0; i < m_GLCalls.size(); ++i)
+                out << (i ? ", " : "") << "\"" << m_GLCalls[i].first << "\": "
+                    << (double) m_GLCalls[i].second / std::max((size_t) 1, m_Frames.size());
+            out << "},\n"
+                << "  \"frames\": [\n";
+            for (size_t i = 0; i < m_Frames.size(); ++i) {
+                const Frame &f = m_Frames[i];
+                out << "    {\"frame\": " << f.frame << ", \"cpu_ms\": " << f.cpuMs << ", \"gpu_ms\": " << f.gpuMs
+                    << ", \"draws\": " << f.draws << ", \"vertices\": " << f.vertices << ", \"gl_calls\": "
+                    << f.glCalls << ", \"state_changes\": " << f.stateChanges << ", \"render_target_mb\": "
+                    << f.renderTargetMegabytes << ", \"resident_mb\": " << f.residentMegabytes << "}"
+                    << (i + 1 < m_Frames.size() ? ",\n" : "\n");
+            }
+            out << "  ]\n}\n";
+            return true;
+        }
+
+        // prints every budget that was exceeded; true if none was
+        bool withinBudgets(const BenchmarkOptions &options) const {
+            bool within = true;
+            double cpu = percentile(&Frame::cpuMs, 0.95);
+            double gpu = percentile(&Frame::gpuMs, 0.95);
+            std::cout << "BENCHMARK:: " << m_Frames.size() << " frames, CPU p95 " << cpu << " ms, GPU p95 " << gpu
+                      << " ms, at most " << maxDraws() << " draws" << std::endl;
+            if (options.cpuBudgetMs > 0.0 && cpu > options.cpuBudgetMs) {
+                std::cout << "BENCHMARK::OVER_BUDGET CPU p95 " << cpu << " ms > " << options.cpuBudgetMs << " ms" << std::endl;
+                within = false;
+            }
+            if (options.gpuBudgetMs > 0.0 && gpu > options.gpuBudgetMs) {
+                std::cout << "BENCHMARK::OVER_BUDGET GPU p95 " << gpu << " ms > " << options.gpuBudgetMs << " ms" << std::endl;
+                within = false;
+            }
+            if (options.drawBudget > 0 && maxDraws() > options.drawBudget) {
+                std::cout << "BENCHMARK::OVER_BUDGET " << maxDraws() << " draws > " << options.drawBudget << std::endl;
+                within = false;
+            }
+            for (const auto &budget : options.stateChangeBudgets) {
+                auto it = m_ScopeStateChanges.find(budget.first);
+                if (it == m_ScopeStateChanges.end()) {
+                    std::cout << "ERROR::BENCHMARK::NO_SCOPE \"" << budget.first << "\" was never entered" << std::endl;
+                    within = false;
+                } else if (it->second > budget.second) {
+                    std::cout << "BENCHMARK::OVER_BUDGET " << budget.first << ": " << it->second << " state changes > "
+                              << budget.second << std::endl;
+                    within = false;
+                }
+            }
+            return within;
+        }
+
+        // resident set of the process, 0 where it can't be read
+        static double residentMegabytes() {
+#ifdef __linux__
+            std::ifstream statm("/proc/self/statm");
+            long long pages = 0, resident = 0;
+            if (statm >> pages >> resident)
+                return resident * (double) sysconf(_SC_PAGESIZE) / (1024.0 * 1024.0);
+#endif
+            return 0.0;
+        }
+
+    private:
+        // nearest rank, as the profiler does
+        double percentile(double Frame::*field, double p) const {
+            if (m_Frames.empty())
+                return 0.0;
+            std::vector<double> values;
+            for (const Frame &f : m_Frames)
+                values.push_back(f.*field);
+            std::sort(values.begin(), values.end());
+            size_t index = (size_t) std::ceil(p * values.size());
+            return values[std::min(std::max(index, (size_t) 1), values.size()) - 1];
+        }
+
+        double maxOf(double Frame::*field) const {
+            double result = 0.0;
+            for (const Frame &f : m_Frames)
+                result = std::max(result, f.*field);
+            return result;
+        }
+
+        long long maxOf(long long Frame::*field) const {
+            long long result = 0;
+            for (const Frame &f : m_Frames)
+                result = std::max(result, f.*field);
+            return result;
+        }
+
+        long long maxDraws() const {
+            return maxOf(&Frame::draws);
+        }
+
+        std::string summary(double Frame::*field) const {
+            double mean = 0.0;
+            for (const Frame &f : m_Frames)
+                mean += f.*field;
+            mean /= std::max((size_t) 1, m_Frames.size());
+            std::ostringstream out;
+            out << "{\"mean\": " << mean << ", \"p50\": " << percentile(field, 0.50) << ", \"p95\": "
+                << percentile(field, 0.95) << ", \"p99\": " << percentile(field, 0.99) << ", \"max\": "
+                << maxOf(field) << "}";
+            return out.str();
+        }
+
+        static std::string escape(const std::string &text) {
+            std::string result;
+            for (char c : text) {
+                if (c == '"' || c == '\\')
+                    result += '\\';
+                result += c;
+            }
+            return result;
+        }
+
+        std::vector<Frame> m_Frames;
+        std::map<std::string, long long> m_ScopeStateChanges;
+        std::vector<std::pair<std::string, unsigned long long>> m_GLCalls;
+    };
+
+};
+#endif //PROJECT_BASE_BENCHMARK_H
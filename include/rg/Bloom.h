@@ -0,0 +1,173 @@
+#ifndef PROJECT_BASE_BLOOM_H
+#define PROJECT_BASE_BLOOM_H
+
+#include <algorithm>
+#include <vector>
+#include <glad/glad.h>
+#include <learnopengl/shader.h>
+#include <rg/ShaderVariants.h>
+
+namespace rg {
+
+    // Bloom over a half-resolution pyramid. The first downsample thresholds the HDR scene, so
+    // no bright-pass target has to be written during the scene passes.
+    //  MIP_CHAIN: 13-tap downsamples to the smallest level, then 3x3 tent upsamples added back
+    //             up the chain (Jimenez, "Next Generation Post Processing in Call of Duty: AW")
+    //  GAUSSIAN:  the old ten separable Gaussian passes, now at half resolution and with the
+    //             9-tap kernel folded into 5 bilinear taps (blur.fs)
+    class Bloom {
+    public:
+        enum Mode {
+            MIP_CHAIN = 0,
+            GAUSSIAN = 1
+        };
+
+        static const unsigned int MAX_LEVELS = 6;
+        static const unsigned int GAUSSIAN_PASSES = 10;
+
+        // one level of the pyramid, handed in by the caller (the frame graph owns the textures)
+        struct Target {
+            unsigned int fbo;
+            unsigned int texture;
+            unsigned int width;
+            unsigned int height;
+            // only for the traffic estimate
+            unsigned int bytesPerTexel;
+        };
+
+        Bloom()
+                : m_Downsample("resources/shaders/bloomDownsample.vs", "resources/shaders/bloomDownsample.fs",
+                               {"PREFILTER"},
+                               [](Shader &shader) {
+                                   shader.setInt("source", 0);
+                               }),
+                  m_Upsample("resources/shaders/bloomUpsample.vs", "resources/shaders/bloomUpsample.fs"),
+                  m_Blur("resources/shaders/blur.vs", "resources/shaders/blur.fs",
+                         {"HORIZONTAL"},
+                         [](Shader &shader) {
+                             shader.setInt("image", 0);
+                         }) {
+            m_Downsample.warmAll();
+            m_Blur.warmAll();
+            m_Upsample.whenReady([](Shader &shader) {
+                shader.setInt("source", 0);
+            });
+        }
+
+        // finishes the warmed variants the driver is done with, see ShaderVariants::poll
+        void poll() {
+            m_Downsample.poll();
+            m_Blur.poll();
+        }
+
+        Bloom(const Bloom&) = delete;
+        Bloom& operator=(const Bloom&) = delete;
+
+        // sizes of the targets render() expects for a scene of the given size: the pyramid
+        // levels from half resolution down for MIP_CHAIN, two half-resolution ones for GAUSSIAN
+        static std::vector<std::pair<unsigned int, unsigned int>> targetSizes(unsigned int sceneWidth,
+                                                                             unsigned int sceneHeight, Mode mode) {
+            std::vector<std::pair<unsigned int, unsigned int>> sizes;
+            unsigned int w = std::max(1u, sceneWidth / 2), h = std::max(1u, sceneHeight / 2);
+            if (mode == GAUSSIAN) {
+                sizes.assign(2, std::make_pair(w, h));
+                return sizes;
+            }
+            do {
+                sizes.push_back(std::make_pair(w, h));
+                w /= 2;
+                h /= 2;
+            } while (sizes.size() < MAX_LEVELS && w >= 8 && h >= 8);
+            return sizes;
+        }
+
+        // runs the whole stage from the HDR scene texture; the result ends up in targets[0]
+        void render(unsigned int sceneTexture, unsigned int sceneWidth, unsigned int sceneHeight,
+                    unsigned int sceneBytesPerTexel, unsigned int quadVAO, Mode mode, float threshold,
+                    const std::vector<Target> &targets) {
+            GLint viewport[4];
+            glGetIntegerv(GL_VIEWPORT, viewport);
+            GLboolean blend = glIsEnabled(GL_BLEND);
+            GLint blendSrc, blendDst;
+            glGetIntegerv(GL_BLEND_SRC_RGB, &blendSrc);
+            glGetIntegerv(GL_BLEND_DST_RGB, &blendDst);
+            glDisable(GL_BLEND);
+            glBindVertexArray(quadVAO);
+            glActiveTexture(GL_TEXTURE0);
+            m_Bytes = 0;
+            m_LevelCount = targets.size();
+
+            Shader &prefilter = m_Downsample.get(1);
+            prefilter.use();
+            prefilter.setFloat("threshold", threshold);
+            drawInto(targets[0], prefilter, sceneTexture, sceneWidth, sceneHeight, sceneBytesPerTexel);
+
+            if (mode == MIP_CHAIN) {
+                Shader &downsample = m_Downsample.get(0);
+                downsample.use();
+                for (size_t i = 1; i < targets.size(); ++i)
+                    drawInto(targets[i], downsample, targets[i - 1]);
+
+                // each level adds its blurred copy onto the next larger one
+                glEnable(GL_BLEND);
+                glBlendFunc(GL_ONE, GL_ONE);
+                m_Upsample.use();
+                for (size_t i = targets.size() - 1; i > 0; --i) {
+                    drawInto(targets[i - 1], m_Upsample, targets[i]);
+                    m_Bytes += (size_t) targets[i - 1].width * targets[i - 1].height * targets[i - 1].bytesPerTexel;
+                }
+                glDisable(GL_BLEND);
+            } else {
+                // ping-pong between targets[1] and targets[0], an even pass count ends in targets[0]
+                for (unsigned int i = 0; i < GAUSSIAN_PASSES; ++i) {
+                    const Target &source = targets[i % 2 == 0 ? 0 : 1];
+                    Shader &blur = m_Blur.get(i % 2 == 0 ? 1 : 0);
+                    blur.use();
+                    drawInto(targets[i % 2 == 0 ? 1 : 0], blur, source);
+                }
+            }
+
+            glBindVertexArray(0);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+            if (blend)
+                glEnable(GL_BLEND);
+            glBlendFunc(blendSrc, blendDst);
+        }
+
+        // the upsampled chain sums every level, this brings it back to the scene's range
+        float intensity(Mode mode) const {
+            return mode == MIP_CHAIN && m_LevelCount > 0 ? 1.0f / m_LevelCount : 1.0f;
+        }
+
+        // estimate of the memory traffic of the last render(): every source texel read once,
+        // every target texel written once, plus the read-back of blended targets
+        size_t bytesPerFrame() const {
+            return m_Bytes;
+        }
+
+    private:
+        void drawInto(const Target &target, Shader &shader, const Target &source) {
+            drawInto(target, shader, source.texture, source.width, source.height, source.bytesPerTexel);
+        }
+
+        void drawInto(const Target &target, Shader &shader, unsigned int source, unsigned int sourceWidth,
+                      unsigned int sourceHeight, unsigned int sourceBytesPerTexel) {
+            glBindFramebuffer(GL_FRAMEBUFFER, target.fbo);
+            glViewport(0, 0, target.width, target.height);
+            glBindTexture(GL_TEXTURE_2D, source);
+            shader.setVec2("sourceTexelSize", 1.0f / sourceWidth, 1.0f / sourceHeight);
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            m_Bytes += (size_t) sourceWidth * sourceHeight * sourceBytesPerTexel
+                       + (size_t) target.width * target.height * target.bytesPerTexel;
+        }
+
+        ShaderVariants m_Downsample;
+        Shader m_Upsample;
+        ShaderVariants m_Blur;
+        size_t m_LevelCount = 0;
+        size_t m_Bytes = 0;
+    };
+
+};
+#endif //PROJECT_BASE_BLOOM_H
@@ -0,0 +1,122 @@
+#ifndef PROJECT_BASE_COLORGRADING_H
+#define PROJECT_BASE_COLORGRADING_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <glad/glad.h>
+#include <rg/MemoryTracker.h>
+
+namespace rg {
+
+    struct ColorGradingSettings {
+        float saturation = 1.0f;
+        float contrast = 1.0f;
+        // > 0 warmer, < 0 cooler
+        float temperature = 0.0f;
+        bool grayscale = false;
+
+        // nothing to do, the post pass can skip the lookup
+        bool isIdentity() const {
+            return saturation == 1.0f && contrast == 1.0f && temperature == 0.0f && !grayscale;
+        }
+
+        bool operator==(const ColorGradingSettings &other) const {
+            return saturation == other.saturation && contrast == other.contrast
+                   && temperature == other.temperature && grayscale == other.grayscale;
+        }
+    };
+
+    // Bakes every colour adjustment into a SIZE^3 RGBA8 3D texture indexed by the tonemapped,
+    // display-encoded colour, so the post pass grades with one filtered lookup however many
+    // adjustments there are. Rebaking only happens when the settings change.
+    // With linear output (the display encoding is left to GL_FRAMEBUFFER_SRGB) the post pass
+    // has no encoded colour to index with. It indexes with sqrt(linear) instead, which spends
+    // the texels on the darks about as well, and the table is SRGB8_ALPHA8 so the lookup
+    // returns linear colour. The adjustments themselves still work on sRGB-encoded values.
+    class ColorGrading {
+    public:
+        static const int SIZE = 32;
+
+        ColorGrading() {
+            glGenTextures(1, &m_Texture);
+            glBindTexture(GL_TEXTURE_3D, m_Texture);
+            glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+            glBindTexture(GL_TEXTURE_3D, 0);
+            bake(m_Settings, m_Linear);
+        }
+
+        ~ColorGrading() {
+            glDeleteTextures(1, &m_Texture);
+            memoryTracker().releaseTexture(m_Texture);
+        }
+
+        ColorGrading(const ColorGrading&) = delete;
+        ColorGrading& operator=(const ColorGrading&) = delete;
+
+        void update(const ColorGradingSettings &settings, bool linear) {
+            if (!(settings == m_Settings) || linear != m_Linear)
+                bake(settings, linear);
+        }
+
+        GLuint texture() const {
+            return m_Texture;
+        }
+
+    private:
+        void bake(const ColorGradingSettings &settings, bool linear) {
+            m_Settings = settings;
+            m_Linear = linear;
+            std::vector<unsigned char> texels(SIZE * SIZE * SIZE * 4);
+            unsigned char *texel = texels.data();
+            for (int b = 0; b < SIZE; ++b) {
+                for (int g = 0; g < SIZE; ++g) {
+                    for (int r = 0; r < SIZE; ++r) {
+                        float color[3] = {r / (SIZE - 1.0f), g / (SIZE - 1.0f), b / (SIZE - 1.0f)};
+                        if (linear) {
+                            for (int i = 0; i < 3; ++i)
+                                color[i] = encodeSRGB(color[i] * color[i]);
+                        }
+                        grade(settings, color);
+                        for (int i = 0; i < 3; ++i)
+                            *texel++ = (unsigned char) (std::min(std::max(color[i], 0.0f), 1.0f) * 255.0f + 0.5f);
+                        *texel++ = 255;
+                    }
+                }
+            }
+            glBindTexture(GL_TEXTURE_3D, m_Texture);
+            GLenum internalFormat = linear ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+            glTexImage3D(GL_TEXTURE_3D, 0, internalFormat, SIZE, SIZE, SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                         texels.data());
+            memoryTracker().texture(m_Texture, "Color grading LUT", MemoryTracker::TEXTURES, internalFormat, SIZE, SIZE,
+                                    SIZE);
+            glBindTexture(GL_TEXTURE_3D, 0);
+        }
+
+        static float encodeSRGB(float linear) {
+            return linear <= 0.0031308f ? linear * 12.92f : 1.055f * std::pow(linear, 1.0f / 2.4f) - 0.055f;
+        }
+
+        static void grade(const ColorGradingSettings &settings, float color[3]) {
+            color[0] *= 1.0f + 0.1f * settings.temperature;
+            color[2] *= 1.0f - 0.1f * settings.temperature;
+            for (int i = 0; i < 3; ++i)
+                color[i] = (color[i] - 0.5f) * settings.contrast + 0.5f;
+            // same weights the old grayscale effect used
+            float luma = 0.2126f * color[0] + 0.7162f * color[1] + 0.0722f * color[2];
+            float saturation = settings.grayscale ? 0.0f : settings.saturation;
+            for (int i = 0; i < 3; ++i)
+                color[i] = luma + (color[i] - luma) * saturation;
+        }
+
+        GLuint m_Texture = 0;
+        ColorGradingSettings m_Settings;
+        bool m_Linear = false;
+    };
+
+};
+#endif //PROJECT_BASE_COLORGRADING_H
@@ -0,0 +1,250 @@
+#ifndef PROJECT_BASE_COMMANDLIST_H
+#define PROJECT_BASE_COMMANDLIST_H
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <rg/ThreadPool.h>
+#include <rg/Trace.h>
+
+// A frame's draws as plain data: which object, its model matrix and material, its world-space
+// bounds and a sort key. The list is built off the GL thread and knows nothing of GL or of
+// the objects themselves, only the ids the renderer gave them; the renderer replays it.
+
+namespace rg {
+
+    // the six planes of a view-projection matrix, normals pointing inwards
+    struct Frustum {
+        glm::vec4 planes[6];
+
+        static Frustum fromMatrix(const glm::mat4 &viewProjection) {
+            Frustum frustum;
+            glm::vec4 rows[4];
+            for (int i = 0; i < 4; ++i)
+                rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i],
+                                    viewProjection[3][i]);
+            for (int i = 0; i < 3; ++i) {
+                frustum.planes[2 * i] = rows[3] + rows[i];
+                frustum.planes[2 * i + 1] = rows[3] - rows[i];
+            }
+            for (glm::vec4 &plane : frustum.planes)
+                plane /= glm::length(glm::vec3(plane));
+            return frustum;
+        }
+
+        // sphere: centre in xyz, radius in w
+        bool intersects(const glm::vec4 &sphere) const {
+            for (const glm::vec4 &plane : planes) {
+                if (glm::dot(glm::vec3(plane), glm::vec3(sphere)) + plane.w < -sphere.w)
+                    return false;
+            }
+            return true;
+        }
+    };
+
+    // the sphere around a box, as the object's local bounds
+    inline glm::vec4 boundingSphere(const glm::vec3 &min, const glm::vec3 &max) {
+        return glm::vec4((min + max) * 0.5f, glm::length(max - min) * 0.5f);
+    }
+
+    class CommandList {
+    public:
+        enum Bucket {
+            OPAQUE_BUCKET,
+            TRANSPARENT_BUCKET,
+            BUCKET_COUNT
+        };
+
+        enum Flags : uint32_t {
+            DOUBLE_SIDED = 1u << 0
+        };
+
+        struct Command {
+            // opaque front to back, transparent back to front
+            uint64_t key;
+            uint32_t object;
+            uint32_t flags;
+            // offset of the command's uniforms in the list's blob
+            uint32_t uniforms;
+            glm::vec4 bounds;
+        };
+
+        // per command: the model matrix, then the material shininess
+        static const uint32_t UNIFORM_FLOATS = 17;
+
+        void clear() {
+            for (std::vector<Command> &bucket : m_Buckets)
+                bucket.clear();
+            m_Uniforms.clear();
+        }
+
+        // localBounds is the object's bounding sphere in model space; eye orders the bucket
+        void add(Bucket bucket, uint32_t object, const glm::mat4 &model, float shininess,
+                 const glm::vec4 &localBounds, const glm::vec3 &eye, uint32_t flags = 0) {
+            Command command;
+            command.object = object;
+            command.flags = flags;
+            command.uniforms = (uint32_t) m_Uniforms.size();
+            float scale = std::max(glm::length(glm::vec3(model[0])),
+                                   std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+            glm::vec3 centre = glm::vec3(model * glm::vec4(glm::vec3(localBounds), 1.0f));
+            command.bounds = glm::vec4(centre, localBounds.w * scale);
+            // a non-negative float's bits order the same as its value
+            float distance = glm::length(centre - eye);
+            uint32_t bits;
+            std::memcpy(&bits, &distance, sizeof(bits));
+            command.key = bucket == TRANSPARENT_BUCKET ? ~bits : bits;
+            const float *matrix = glm::value_ptr(model);
+            m_Uniforms.insert(m_Uniforms.end(), matrix, matrix + 16);
+            m_Uniforms.push_back(shininess);
+            m_Buckets[bucket].push_back(command);
+        }
+
+        // other's commands after this list's own, in the same order
+        void append(const CommandList &other) {
+            uint32_t offset = (uint32_t) m_Uniforms.size();
+            for (int bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+                for (Command command : other.m_Buckets[bucket]) {
+                    command.uniforms += offset;
+                    m_Buckets[bucket].push_back(command);
+                }
+            }
+            m_Uniforms.insert(m_Uniforms.end(), other.m_Uniforms.begin(), other.m_Uniforms.end());
+        }
+
+        // stable, so that equal keys keep the order they were added in
+        void sort() {
+            for (std::vector<Command> &bucket : m_Buckets)
+                std::stable_sort(bucket.begin(), bucket.end(), [](const Command &a, const Command &b) {
+                    return a.key < b.key;
+                });
+        }
+
+        const std::vector<Command>& commands(Bucket bucket) const {
+            return m_Buckets[bucket];
+        }
+
+        glm::mat4 model(const Command &command) const {
+            return glm::make_mat4(&m_Uniforms[command.uniforms]);
+        }
+
+        float shininess(const Command &command) const {
+            return m_Uniforms[command.uniforms + 16];
+        }
+
+    private:
+        std::vector<Command> m_Buckets[BUCKET_COUNT];
+        std::vector<float> m_Uniforms;
+    };
+
+    // Two command lists: the GL thread replays one while a pool worker builds the other.
+    // Pipelined, next() hands out the list its last call started on the worker, waiting for
+    // it if need be, and starts the next one from the build it is given, so that frame N+1
+    // is prepared while frame N is submitted. The build has to carry everything it reads by
+    // value; it runs alongside the GL thread. Otherwise next() builds the list in place.
+    // A frame is a number of items, e.g. one per object, that build(item, list) adds the
+    // commands of. They are built in chunks across the pool, each into a list of its own,
+    // and joined in item order, so the result doesn't depend on which thread built what.
+    class FramePrep {
+    public:
+        typedef std::function<void(size_t, CommandList&)> Build;
+        // items per chunk, so that a handful of objects isn't spread over every core
+        static const size_t MIN_ITEMS_PER_CHUNK = 4;
+
+        explicit FramePrep(ThreadPool &pool) : m_Pool(pool) {
+        }
+
+        ~FramePrep() {
+            wait();
+        }
+
+        FramePrep(const FramePrep&) = delete;
+        FramePrep& operator=(const FramePrep&) = delete;
+
+        const CommandList& next(size_t items, const Build &build, bool pipelined) {
+            // a pool without workers would never get to the job
+            pipelined = pipelined && m_Pool.workerCount() > 0;
+            auto waitStart = std::chrono::steady_clock::now();
+            wait();
+            m_WaitMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - waitStart).count();
+            // the first frame, or one after the worker was switched off, has nothing prepared
+            if (!pipelined || !m_Prepared)
+                run(items, build, m_Lists[1 - m_Front]);
+            m_Front = 1 - m_Front;
+            m_Prepared = false;
+            if (pipelined) {
+                {
+                    std::lock_guard<std::mutex> lock(m_Mutex);
+                    m_Running = true;
+                }
+                CommandList &list = m_Lists[1 - m_Front];
+                Build job = build;
+                m_Pool.submit([this, &list, items, job] {
+                    TraceScope trace("prep", "Frame prep");
+                    run(items, job, list);
+                    std::lock_guard<std::mutex> lock(m_Mutex);
+                    m_Running = false;
+                    m_Finished.notify_all();
+                });
+                m_Prepared = true;
+            }
+            return m_Lists[m_Front];
+        }
+
+        // time the last build took, wherever it ran
+        double buildMs() const {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            return m_BuildMs;
+        }
+
+        // time the GL thread waited for the worker in the last next()
+        double waitMs() const {
+            return m_WaitMs;
+        }
+
+    private:
+        void run(size_t items, const Build &build, CommandList &list) {
+            auto start = std::chrono::steady_clock::now();
+            // only one build runs at a time, so the per-item lists are shared between them
+            m_Items.resize(items);
+            m_Pool.parallelFor(items, [this, &build](size_t begin, size_t end) {
+                for (size_t item = begin; item < end; ++item) {
+                    m_Items[item].clear();
+                    build(item, m_Items[item]);
+                }
+            }, MIN_ITEMS_PER_CHUNK);
+            list.clear();
+            for (size_t item = 0; item < items; ++item)
+                list.append(m_Items[item]);
+            list.sort();
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_BuildMs = ms;
+        }
+
+        void wait() {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_Finished.wait(lock, [this] { return !m_Running; });
+        }
+
+        ThreadPool &m_Pool;
+        CommandList m_Lists[2];
+        std::vector<CommandList> m_Items;
+        int m_Front = 0;
+        bool m_Prepared = false;
+        bool m_Running = false;
+        double m_BuildMs = 0.0;
+        double m_WaitMs = 0.0;
+        mutable std::mutex m_Mutex;
+        std::condition_variable m_Finished;
+    };
+
+};
+#endif //PROJECT_BASE_COMMANDLIST_H
@@ -0,0 +1,46 @@
+#ifndef PROJECT_BASE_CUBEMAP_H
+#define PROJECT_BASE_CUBEMAP_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+#include <stb_image.h>
+#include <rg/MemoryTracker.h>
+#include <rg/Trace.h>
+
+namespace rg {
+
+    // an sRGB cube map from six faces, in the order +X, -X, +Y, -Y, +Z, -Z
+    inline unsigned int loadCubemap(const std::vector<std::string> &faces) {
+        TraceScope trace("load", "Load cubemap", traceDetail(faces.empty() ? "" : faces[0]));
+        unsigned int textureID;
+        glGenTextures(1, &textureID);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+
+        int width = 0, height = 0, nrChannels;
+        for (unsigned int i = 0; i < faces.size(); i++) {
+            unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
+            if (data) {
+                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
+                             0, GL_SRGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data
+                );
+                stbi_image_free(data);
+            } else {
+                std::cout << "Cubemap tex failed to load at this path : " << faces[i] << std::endl;
+                stbi_image_free(data);
+            }
+        }
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        memoryTracker().texture(textureID, faces.empty() ? "(cubemap)" : faces[0], MemoryTracker::TEXTURES, GL_SRGB8,
+                                width, height, (int) faces.size());
+
+        return textureID;
+    }
+
+};
+#endif //PROJECT_BASE_CUBEMAP_H
@@ -0,0 +1,229 @@
+#ifndef PROJECT_BASE_DEBUGOUTPUT_H
+#define PROJECT_BASE_DEBUGOUTPUT_H
+
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <glad/glad.h>
+#include <rg/GLExtensions.h>
+#if defined(__GLIBC__)
+#include <execinfo.h>
+#include <unistd.h>
+#endif
+
+namespace rg {
+
+    // GL errors and warnings as the driver reports them through KHR_debug, instead of a
+    // glGetError() round trip after every call. Messages below the minimum severity, and
+    // those from the ignored sources, are switched off in the driver itself. Each distinct
+    // message (same source, type and id) is printed once; its repeats are only counted, and
+    // report() lists them at the end.
+    // Synchronous output calls back from inside the GL call that caused the message, so the
+    // backtrace printed with it leads to the call site. It keeps the driver from running
+    // ahead on its own thread, so it is meant for debug builds. Asynchronous output may call
+    // back on a driver thread, where a backtrace says nothing, so it prints none.
+    class DebugOutput {
+    public:
+        struct Options {
+            GLenum minimumSeverity = GL_DEBUG_SEVERITY_MEDIUM;
+            std::vector<GLenum> ignoredSources;
+            bool synchronous = true;
+        };
+
+        DebugOutput() = default;
+        DebugOutput(const DebugOutput&) = delete;
+        DebugOutput& operator=(const DebugOutput&) = delete;
+
+        // after loadGLExtensions; false if the context has no KHR_debug
+        bool install(const Options &options) {
+            if (!glExtensions().debugOutput) {
+                std::cout << "ERROR::DEBUG_OUTPUT::UNSUPPORTED no KHR_debug, GL errors go unreported" << std::endl;
+                return false;
+            }
+            GLint flags = 0;
+            glGetIntegerv(GL_CONTEXT_FLAGS, &flags);
+            if (!(flags & GL_CONTEXT_FLAG_DEBUG_BIT))
+                std::cout << "DEBUG_OUTPUT:: not a debug context, the driver may report little" << std::endl;
+            m_Synchronous = options.synchronous;
+            glEnable(GL_DEBUG_OUTPUT);
+            if (m_Synchronous)
+                glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+            else
+                glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+            glExtensions().DebugMessageCallback(callback, this);
+            PFNRGDEBUGMESSAGECONTROLPROC control = glExtensions().DebugMessageControl;
+            control(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr, GL_TRUE);
+            const GLenum severities[] = {GL_DEBUG_SEVERITY_NOTIFICATION, GL_DEBUG_SEVERITY_LOW,
+                                         GL_DEBUG_SEVERITY_MEDIUM, GL_DEBUG_SEVERITY_HIGH};
+            for (GLenum severity : severities) {
+                if (rank(severity) < rank(options.minimumSeverity))
+                    control(GL_DONT_CARE, GL_DONT_CARE, severity, 0, nullptr, GL_FALSE);
+            }
+            for (GLenum source : options.ignoredSources)
+                control(source, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr, GL_FALSE);
+            // the application's own debug groups would otherwise come back as notifications
+            control(GL_DONT_CARE, GL_DEBUG_TYPE_PUSH_GROUP, GL_DONT_CARE, 0, nullptr, GL_FALSE);
+            control(GL_DONT_CARE, GL_DEBUG_TYPE_POP_GROUP, GL_DONT_CARE, 0, nullptr, GL_FALSE);
+            m_Active = true;
+            return true;
+        }
+
+        bool active() const {
+            return m_Active;
+        }
+
+        // the messages that came more than once and how often
+        void report() {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            for (const auto &entry : m_Seen) {
+                if (entry.second.count > 1)
+                    std::cout << "[OpenGL debug] " << entry.second.count << "x " << entry.second.summary << std::endl;
+            }
+        }
+
+        // "notification", "low", "medium" or "high"
+        static bool parseSeverity(const std::string &name, GLenum &severity) {
+            const GLenum severities[] = {GL_DEBUG_SEVERITY_NOTIFICATION, GL_DEBUG_SEVERITY_LOW,
+                                         GL_DEBUG_SEVERITY_MEDIUM, GL_DEBUG_SEVERITY_HIGH};
+            for (GLenum candidate : severities) {
+                if (name == severityName(candidate)) {
+                    severity = candidate;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // comma separated: "api", "window-system", "shader-compiler", "third-party",
+        // "application", "other"
+        static bool parseSources(const std::string &names, std::vector<GLenum> &sources) {
+            const GLenum all[] = {GL_DEBUG_SOURCE_API, GL_DEBUG_SOURCE_WINDOW_SYSTEM, GL_DEBUG_SOURCE_SHADER_COMPILER,
+                                  GL_DEBUG_SOURCE_THIRD_PARTY, GL_DEBUG_SOURCE_APPLICATION, GL_DEBUG_SOURCE_OTHER};
+            std::istringstream in(names);
+            std::string name;
+            while (std::getline(in, name, ',')) {
+                bool found = false;
+                for (GLenum source : all) {
+                    if (name == sourceName(source)) {
+                        sources.push_back(source);
+                        found = true;
+                    }
+                }
+                if (!found)
+                    return false;
+            }
+            return true;
+        }
+
+    private:
+        struct Seen {
+            long long count;
+            std::string summary;
+        };
+
+        static int rank(GLenum severity) {
+            switch (severity) {
+                case GL_DEBUG_SEVERITY_HIGH:
+                    return 3;
+                case GL_DEBUG_SEVERITY_MEDIUM:
+                    return 2;
+                case GL_DEBUG_SEVERITY_LOW:
+                    return 1;
+                default:
+                    return 0;
+            }
+        }
+
+        static const char* severityName(GLenum severity) {
+            switch (severity) {
+                case GL_DEBUG_SEVERITY_HIGH:
+                    return "high";
+                case GL_DEBUG_SEVERITY_MEDIUM:
+                    return "medium";
+                case GL_DEBUG_SEVERITY_LOW:
+                    return "low";
+                default:
+                    return "notification";
+            }
+        }
+
+        static const char* sourceName(GLenum source) {
+            switch (source) {
+                case GL_DEBUG_SOURCE_API:
+                    return "api";
+                case GL_DEBUG_SOURCE_WINDOW_SYSTEM:
+                    return "window-system";
+                case GL_DEBUG_SOURCE_SHADER_COMPILER:
+                    return "shader-compiler";
+                case GL_DEBUG_SOURCE_THIRD_PARTY:
+                    return "third-party";
+                case GL_DEBUG_SOURCE_APPLICATION:
+                    return "application";
+                default:
+                    return "other";
+            }
+        }
+
+        static const char* typeName(GLenum type) {
+            switch (type) {
+                case GL_DEBUG_TYPE_ERROR:
+                    return "error";
+                case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR:
+                    return "deprecated";
+                case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR:
+                    return "undefined behavior";
+                case GL_DEBUG_TYPE_PORTABILITY:
+                    return "portability";
+                case GL_DEBUG_TYPE_PERFORMANCE:
+                    return "performance";
+                case GL_DEBUG_TYPE_MARKER:
+                    return "marker";
+                default:
+                    return "other";
+            }
+        }
+
+        // may run on a driver thread when the output is asynchronous
+        static void APIENTRY callback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length,
+                                      const GLchar *message, const void *userParam) {
+            DebugOutput &self = *(DebugOutput *) userParam;
+            // ids are unique within a source and type
+            uint64_t key = (uint64_t) (source & 0xFFFF) << 48 | (uint64_t) (type & 0xFFFF) << 32 | id;
+            std::lock_guard<std::mutex> lock(self.m_Mutex);
+            auto it = self.m_Seen.find(key);
+            if (it != self.m_Seen.end()) {
+                ++it->second.count;
+                return;
+            }
+            std::ostringstream summary;
+            summary << severityName(severity) << " " << sourceName(source) << " " << typeName(type) << " " << id << ": "
+                    << std::string(message, length >= 0 ? (size_t) length : std::char_traits<char>::length(message));
+            self.m_Seen[key] = Seen{1, summary.str()};
+            std::cerr << "[OpenGL debug] " << summary.str() << std::endl;
+#if defined(__GLIBC__)
+            if (self.m_Synchronous) {
+                void *frames[32];
+                int count = backtrace(frames, 32);
+                // the first two are this callback and the driver
+                backtrace_symbols_fd(frames + 2, count > 2 ? count - 2 : 0, STDERR_FILENO);
+            }
+#endif
+        }
+
+        std::mutex m_Mutex;
+        std::unordered_map<uint64_t, Seen> m_Seen;
+        bool m_Synchronous = true;
+        bool m_Active = false;
+    };
+
+    inline DebugOutput& debugOutput() {
+        static DebugOutput instance;
+        return instance;
+    }
+
+};
+#endif //PROJECT_BASE_DEBUGOUTPUT_H
@@ -0,0 +1,148 @@
+#ifndef PROJECT_BASE_DEBUGPANELS_H
+#define PROJECT_BASE_DEBUGPANELS_H
+
+#include <cfloat>
+#include <vector>
+#include "imgui.h"
+#include <rg/FramePacer.h>
+#include <rg/IdleThrottle.h>
+#include <rg/MemoryTracker.h>
+#include <rg/Profiler.h>
+
+namespace rg {
+
+    // ImGui windows and widgets over the profiling and pacing state; called between
+    // ImGui::NewFrame and ImGui::Render
+
+    // frame time percentiles and histogram, then every scope's CPU and GPU percentiles;
+    // enabled is the checkbox that turns the profiler on and off
+    inline void drawProfilerPanel(bool &enabled) {
+        ImGui::Begin("Profiler");
+        ImGui::Checkbox("Enabled", &enabled);
+        const Profiler &profiler = rg::profiler();
+        Profiler::Percentiles frame = profiler.frameTimeMs();
+        ImGui::Text("Frame: p50 %.2f ms, p95 %.2f ms, p99 %.2f ms", frame.p50, frame.p95, frame.p99);
+        std::vector<float> histogram = profiler.frameTimeHistogram(2.0f, 25);
+        ImGui::PlotHistogram("##frametimes", histogram.data(), (int) histogram.size(), 0,
+                             "frame time, 2 ms buckets", 0.0f, FLT_MAX, ImVec2(0, 80));
+        ImGui::Text("GPU samples lost to late frames: %lld", profiler.lateFrames());
+        ImGui::Columns(3);
+        ImGui::Text("Scope");
+        ImGui::NextColumn();
+        ImGui::Text("CPU p50/p95/p99 (ms)");
+        ImGui::NextColumn();
+        ImGui::Text("GPU p50/p95/p99 (ms)");
+        ImGui::NextColumn();
+        ImGui::Separator();
+        for (const Profiler::ScopeStats &scope : profiler.stats()) {
+            ImGui::Text("%*s%s", scope.depth * 2, "", scope.name.c_str());
+            ImGui::NextColumn();
+            ImGui::Text("%.3f %.3f %.3f", scope.cpuMs.p50, scope.cpuMs.p95, scope.cpuMs.p99);
+            ImGui::NextColumn();
+            if (scope.hasGpu)
+                ImGui::Text("%.3f %.3f %.3f", scope.gpuMs.p50, scope.gpuMs.p95, scope.gpuMs.p99);
+            ImGui::NextColumn();
+        }
+        ImGui::Columns(1);
+        ImGui::End();
+    }
+
+    // one table of MemoryTracker rows, under a separator
+    inline void drawMemoryTable(const char *title, const std::vector<MemoryTracker::Row> &rows) {
+        ImGui::Separator();
+        ImGui::Columns(4);
+        ImGui::Text("%s", title);
+        ImGui::NextColumn();
+        ImGui::Text("GPU (MB)");
+        ImGui::NextColumn();
+        ImGui::Text("CPU (MB)");
+        ImGui::NextColumn();
+        ImGui::Text("Objects");
+        ImGui::NextColumn();
+        for (const MemoryTracker::Row &row : rows) {
+            ImGui::Text("%s", row.name.c_str());
+            ImGui::NextColumn();
+            ImGui::Text("%.2f", row.gpuBytes / (1024.0 * 1024.0));
+            ImGui::NextColumn();
+            ImGui::Text("%.2f", row.cpuBytes / (1024.0 * 1024.0));
+            ImGui::NextColumn();
+            ImGui::Text("%d", row.objects);
+            ImGui::NextColumn();
+        }
+        ImGui::Columns(1);
+    }
+
+    // the tracked totals next to what the driver reports, then the totals by category and by asset
+    inline void drawMemoryPanel() {
+        ImGui::Begin("Memory");
+        const MemoryTracker &memory = memoryTracker();
+        const double MB = 1024.0 * 1024.0;
+        ImGui::Text("Tracked: %.1f MB GPU, %.1f MB CPU", memory.gpuBytes() / MB, memory.cpuBytes() / MB);
+        if (memory.unknownFormats())
+            ImGui::Text("%d objects of an unknown format counted as 0 bytes", memory.unknownFormats());
+        MemoryTracker::DriverMemory driver = MemoryTracker::driverMemory();
+        if (driver.source && driver.dedicatedKb >= 0)
+            ImGui::Text("%s: %.0f MB of %.0f MB free, %.0f MB evicted", driver.source, driver.availableKb / 1024.0,
+                        driver.dedicatedKb / 1024.0, driver.evictedKb / 1024.0);
+        else if (driver.source)
+            ImGui::Text("%s free: textures %.0f MB, buffers %.0f MB, renderbuffers %.0f MB", driver.source,
+                        driver.textureFreeKb / 1024.0, driver.bufferFreeKb / 1024.0,
+                        driver.renderbufferFreeKb / 1024.0);
+        else
+            ImGui::Text("The driver reports no video memory figures");
+        if (ImGui::Button("Write memory.json"))
+            memory.writeJSON("memory.json");
+        drawMemoryTable("Category", memory.byCategory());
+        drawMemoryTable("Asset", memory.byAsset());
+        ImGui::End();
+    }
+
+    // the vsync, limiter and latency settings, and where the CPU waited for them last frame
+    inline void framePacingControls(FramePacingSettings &pacing, const FramePacer::Stats &stats,
+                                    bool adaptiveSwapSupported) {
+        const char *swapModes[] = {"Off", "Every refresh", "Every other refresh", "Adaptive"};
+        int swapMode = pacing.swapInterval < 0 ? 3 : pacing.swapInterval;
+        if (ImGui::Combo("Vsync", &swapMode, swapModes, adaptiveSwapSupported ? 4 : 3))
+            pacing.swapInterval = swapMode == 3 ? -1 : swapMode;
+        ImGui::SliderInt("Frame rate limit", &pacing.frameRateLimit, 0, 240, pacing.frameRateLimit ? "%d fps" : "off");
+        ImGui::SliderFloat("Spin (ms)", &pacing.spinMs, 0.0f, 5.0f);
+        ImGui::SliderInt("Max frames in flight", &pacing.maxFramesInFlight, 0, 3,
+                         pacing.maxFramesInFlight ? "%d" : "driver");
+        ImGui::Checkbox("Late input sampling", &pacing.lateInput);
+        if (ImGui::Button("Low latency")) {
+            pacing.maxFramesInFlight = 1;
+            pacing.lateInput = true;
+        }
+        ImGui::Text("CPU waits: GPU fence %.2f ms, limiter %.2f ms, swap %.2f ms", stats.fenceWaitMs,
+                    stats.limiterWaitMs, stats.swapMs);
+        ImGui::Text("Frames in flight: %d", stats.framesInFlight);
+        ImGui::Text("Estimated input to photon: %.1f ms", stats.latencyMs);
+    }
+
+    // time, CPU and GPU use and frames spent in each throttling state, the current one starred
+    inline void idleThrottleUsageTable(const IdleThrottle &throttle) {
+        ImGui::Columns(5);
+        const char *headers[] = {"State", "Time (s)", "CPU", "GPU", "Frames (cached)"};
+        for (const char *header : headers) {
+            ImGui::Text("%s", header);
+            ImGui::NextColumn();
+        }
+        ImGui::Separator();
+        for (int s = 0; s < IdleThrottle::STATE_COUNT; ++s) {
+            const IdleThrottle::Usage &usage = throttle.usage((IdleThrottle::State) s);
+            ImGui::Text("%s%s", IdleThrottle::stateName((IdleThrottle::State) s), throttle.state() == s ? " *" : "");
+            ImGui::NextColumn();
+            ImGui::Text("%.1f", usage.wallSeconds);
+            ImGui::NextColumn();
+            ImGui::Text("%.1f%%", usage.cpuPercent());
+            ImGui::NextColumn();
+            ImGui::Text("%.1f%%", usage.gpuPercent());
+            ImGui::NextColumn();
+            ImGui::Text("%lld (%lld)", usage.frames, usage.represented);
+            ImGui::NextColumn();
+        }
+        ImGui::Columns(1);
+    }
+
+};
+#endif //PROJECT_BASE_DEBUGPANELS_H
@@ -0,0 +1,88 @@
+#ifndef PROJECT_BASE_DRAWCOUNTER_H
+#define PROJECT_BASE_DRAWCOUNTER_H
+
+#include <glad/glad.h>
+
+namespace rg {
+
+    // Counts the draw calls and the vertices they submit. install() swaps glad's draw entry
+    // points for counting wrappers that forward to the driver, so nothing at the call sites
+    // changes and a run that never installs it pays nothing.
+    class DrawCounter {
+    public:
+        struct Counts {
+            long long draws = 0;
+            long long vertices = 0;
+        };
+
+        // call once, after glad has loaded
+        static void install() {
+            State &s = state();
+            if (s.installed)
+                return;
+            s.installed = true;
+            s.drawArrays = glad_glDrawArrays;
+            s.drawElements = glad_glDrawElements;
+            s.drawArraysInstanced = glad_glDrawArraysInstanced;
+            s.drawElementsInstanced = glad_glDrawElementsInstanced;
+            glad_glDrawArrays = drawArrays;
+            glad_glDrawElements = drawElements;
+            glad_glDrawArraysInstanced = drawArraysInstanced;
+            glad_glDrawElementsInstanced = drawElementsInstanced;
+        }
+
+        static bool installed() {
+            return state().installed;
+        }
+
+        // what was counted since the last call
+        static Counts take() {
+            Counts counts = state().counts;
+            state().counts = Counts();
+            return counts;
+        }
+
+    private:
+        static void APIENTRY drawArrays(GLenum mode, GLint first, GLsizei count) {
+            ++state().counts.draws;
+            state().counts.vertices += count;
+            state().drawArrays(mode, first, count);
+        }
+
+        static void APIENTRY drawElements(GLenum mode, GLsizei count, GLenum type, const void *indices) {
+            ++state().counts.draws;
+            state().counts.vertices += count;
+            state().drawElements(mode, count, type, indices);
+        }
+
+        static void APIENTRY drawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instances) {
+            ++state().counts.draws;
+            state().counts.vertices += (long long) count * instances;
+            state().drawArraysInstanced(mode, first, count, instances);
+        }
+
+        static void APIENTRY drawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void *indices,
+                                                   GLsizei instances) {
+            ++state().counts.draws;
+            state().counts.vertices += (long long) count * instances;
+            state().drawElementsInstanced(mode, count, type, indices, instances);
+        }
+
+        // the wrappers are plain function pointers, so their state can't live in an instance
+        struct State {
+            bool installed = false;
+            Counts counts;
+            PFNGLDRAWARRAYSPROC drawArrays = nullptr;
+            PFNGLDRAWELEMENTSPROC drawElements = nullptr;
+            PFNGLDRAWARRAYSINSTANCEDPROC drawArraysInstanced = nullptr;
+            PFNGLDRAWELEMENTSINSTANCEDPROC drawElementsInstanced = nullptr;
+        };
+
+        static State& state() {
+            static State instance;
+            return instance;
+        }
+    };
+
+};
+#endif //PROJECT_BASE_DRAWCOUNTER_H
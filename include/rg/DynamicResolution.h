@@ -0,0 +1,47 @@
+#ifndef PROJECT_BASE_DYNAMICRESOLUTION_H
+#define PROJECT_BASE_DYNAMICRESOLUTION_H
+
+#include <algorithm>
+#include <cmath>
+
+namespace rg {
+
+    // Picks the scene's render scale (per axis) from the measured GPU frame time. A PID loop
+    // in velocity form works on the relative error (target - measured) / target and moves the
+    // scale by the result, so clamping the scale to its bounds can't wind the integral up.
+    // GPU times come back GpuQuery::LATENCY frames late; the gains are small enough for that.
+    class DynamicResolution {
+    public:
+        float update(double gpuMs, double targetMs, float minScale, float maxScale) {
+            // no timer result yet
+            if (gpuMs <= 0.0 || targetMs <= 0.0)
+                return m_Scale = std::min(std::max(m_Scale, minScale), maxScale);
+
+            double error = (targetMs - gpuMs) / targetMs;
+            // a few percent either side of the target is noise, not a reason to resize
+            if (std::fabs(error) < 0.03)
+                error = 0.0;
+            double step = 0.1 * (error - m_Error1) + 0.03 * error + 0.02 * (error - 2.0 * m_Error1 + m_Error2);
+            m_Error2 = m_Error1;
+            m_Error1 = error;
+            m_Scale = std::min(std::max(m_Scale + (float) step, minScale), maxScale);
+            return m_Scale;
+        }
+
+        float scale() const {
+            return m_Scale;
+        }
+
+        void reset(float scale = 1.0f) {
+            m_Scale = scale;
+            m_Error1 = m_Error2 = 0.0;
+        }
+
+    private:
+        float m_Scale = 1.0f;
+        double m_Error1 = 0.0;
+        double m_Error2 = 0.0;
+    };
+
+};
+#endif //PROJECT_BASE_DYNAMICRESOLUTION_H
@@ -7,12 +7,20 @@
 
 #include <iostream>
 #include <glad/glad.h>
+#include <rg/DebugOutput.h>
 
 #define LOG(stream) stream << "[" << __FILE__ << ", " << __func__ << ", " << __LINE__ << "] "
 #define BREAK_IF_FALSE(x) if (!(x)) __builtin_trap()
 #define ASSERT(x, msg) do { if (!(x)) { std::cerr << msg << '\n'; BREAK_IF_FALSE(false); } } while(0)
+// RG_GL_DEBUG is defined in Debug builds. Without it GLCALL is just the call. With it, an
+// installed rg::debugOutput() has the driver report errors as they happen, so the call is
+// still left alone; only a context without KHR_debug falls back to glGetError().
+#ifdef RG_GL_DEBUG
 #define GLCALL(x) \
-do{ rg::clearAllOpenGlErrors(); x; BREAK_IF_FALSE(rg::wasPreviousOpenGLCallSuccessful(__FILE__, __LINE__, #x)); } while (0)
+do{ if (rg::debugOutput().active()) { x; } else { rg::clearAllOpenGlErrors(); x; BREAK_IF_FALSE(rg::wasPreviousOpenGLCallSuccessful(__FILE__, __LINE__, #x)); } } while (0)
+#else
+#define GLCALL(x) do{ x; } while (0)
+#endif
 
 namespace rg {
 
@@ -0,0 +1,439 @@
+#ifndef PROJECT_BASE_FRAMEGRAPH_H
+#define PROJECT_BASE_FRAMEGRAPH_H
+
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+#include <rg/MemoryTracker.h>
+#include <rg/Profiler.h>
+
+namespace rg {
+
+    // Describes a render target; two targets with equal descriptions can share a texture.
+    struct TextureDesc {
+        unsigned int width = 1;
+        unsigned int height = 1;
+        GLenum format = GL_RGBA8;
+        unsigned int samples = 1;
+
+        TextureDesc() = default;
+        TextureDesc(unsigned int width, unsigned int height, GLenum format, unsigned int samples = 1)
+                : width(width), height(height), format(format), samples(samples) {
+        }
+
+        bool isDepth() const {
+            return format == GL_DEPTH_COMPONENT24 || format == GL_DEPTH_COMPONENT32F
+                   || format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH_COMPONENT16;
+        }
+
+        size_t bytesPerTexel() const {
+            return rg::bytesPerTexel(format);
+        }
+
+        size_t bytes() const {
+            return (size_t) width * height * samples * bytesPerTexel();
+        }
+
+        bool operator==(const TextureDesc &other) const {
+            return width == other.width && height == other.height && format == other.format && samples == other.samples;
+        }
+    };
+
+    // Per-frame render graph. Every frame the passes are declared again together with the
+    // targets they read and write; compile() drops passes nobody consumes, works out when
+    // each transient target is first and last used, and hands out pooled textures so that
+    // targets whose lifetimes don't overlap reuse the same texture. The pool outlives the
+    // frame, so nothing is allocated in steady state, and textures nobody asked for in the
+    // last frame (a feature was switched off, the window was resized) are freed.
+    class FrameGraph {
+    private:
+        struct Pass;
+
+    public:
+        typedef int Resource;
+
+        class PassBuilder {
+        public:
+            void read(Resource resource) {
+                if (resource >= 0)
+                    m_Pass.reads.push_back(resource);
+            }
+
+            void write(Resource resource) {
+                m_Pass.writes.push_back(resource);
+            }
+
+        private:
+            friend class FrameGraph;
+            explicit PassBuilder(Pass &pass) : m_Pass(pass) {
+            }
+            Pass &m_Pass;
+        };
+
+        class PassContext {
+        public:
+            GLuint texture(Resource resource) const {
+                return m_Graph.m_Resources[resource].texture;
+            }
+
+            const TextureDesc& desc(Resource resource) const {
+                return m_Graph.m_Resources[resource].desc;
+            }
+
+            // framebuffer with the given colour targets (in draw buffer order) and depth target
+            GLuint framebuffer(std::initializer_list<Resource> colors, Resource depth = -1) const {
+                return m_Graph.framebuffer(colors, depth);
+            }
+
+            // binds the framebuffer and sets the viewport to the size of its targets
+            void bindTarget(std::initializer_list<Resource> colors, Resource depth = -1) const {
+                Resource any = colors.size() > 0 ? *colors.begin() : depth;
+                glBindFramebuffer(GL_FRAMEBUFFER, framebuffer(colors, depth));
+                glViewport(0, 0, desc(any).width, desc(any).height);
+            }
+
+        private:
+            friend class FrameGraph;
+            explicit PassContext(FrameGraph &graph) : m_Graph(graph) {
+            }
+            FrameGraph &m_Graph;
+        };
+
+        FrameGraph() = default;
+
+        ~FrameGraph() {
+            for (const PooledTexture &pooled : m_Pool)
+                destroyTexture(pooled);
+            for (const auto &framebuffer : m_Framebuffers)
+                glDeleteFramebuffers(1, &framebuffer.second);
+        }
+
+        FrameGraph(const FrameGraph&) = delete;
+        FrameGraph& operator=(const FrameGraph&) = delete;
+
+        // forgets last frame's passes and resources, the texture pool is kept
+        void reset() {
+            m_Passes.clear();
+            m_Resources.clear();
+        }
+
+        Resource createTexture(const std::string &name, const TextureDesc &desc) {
+            ResourceNode node;
+            node.name = name;
+            node.desc = desc;
+            m_Resources.push_back(node);
+            return (Resource) m_Resources.size() - 1;
+        }
+
+        // a target owned outside the graph, e.g. the default framebuffer (texture 0); writing
+        // an imported target counts as a side effect, so such passes are never culled
+        Resource importTexture(const std::string &name, GLuint texture, const TextureDesc &desc) {
+            Resource resource = createTexture(name, desc);
+            m_Resources[resource].imported = true;
+            m_Resources[resource].texture = texture;
+            return resource;
+        }
+
+        void addPass(const std::string &name, const std::function<void(PassBuilder&)> &setup,
+                     std::function<void(const PassContext&)> execute) {
+            m_Passes.emplace_back();
+            Pass &pass = m_Passes.back();
+            pass.name = name;
+            pass.execute = std::move(execute);
+            PassBuilder builder(pass);
+            setup(builder);
+        }
+
+        void compile() {
+            cull();
+            assignTextures();
+            report();
+        }
+
+        void execute() {
+            PassContext context(*this);
+            for (const Pass &pass : m_Passes) {
+                if (pass.culled)
+                    continue;
+                // every pass is a profiler scope of its own, under its name
+                ProfileScope scope(pass.name.c_str());
+                pass.execute(context);
+            }
+        }
+
+        size_t passCount() const {
+            return m_Passes.size();
+        }
+
+        size_t culledPassCount() const {
+            return (size_t) std::count_if(m_Passes.begin(), m_Passes.end(), [](const Pass &pass) {
+                return pass.culled;
+            });
+        }
+
+        // what the live transient targets would take with one texture each
+        size_t unaliasedBytes() const {
+            return m_UnaliasedBytes;
+        }
+
+        // what the pool actually holds
+        size_t pooledBytes() const {
+            size_t bytes = 0;
+            for (const PooledTexture &pooled : m_Pool)
+                bytes += pooled.desc.bytes();
+            return bytes;
+        }
+
+        size_t pooledTextureCount() const {
+            return m_Pool.size();
+        }
+
+        // names of the passes that ran last frame, in order, with culled ones in brackets
+        std::string describe() const {
+            std::string description;
+            for (const Pass &pass : m_Passes) {
+                if (!description.empty())
+                    description += " -> ";
+                description += pass.culled ? "[" + pass.name + "]" : pass.name;
+            }
+            return description;
+        }
+
+    private:
+        struct Pass {
+            std::string name;
+            std::vector<Resource> reads;
+            std::vector<Resource> writes;
+            std::function<void(const PassContext&)> execute;
+            bool culled = false;
+        };
+
+        struct ResourceNode {
+            std::string name;
+            TextureDesc desc;
+            bool imported = false;
+            GLuint texture = 0;
+            int firstPass = -1;
+            int lastPass = -1;
+        };
+
+        struct PooledTexture {
+            TextureDesc desc;
+            GLuint texture;
+            // last pass index of this frame's current occupant, -1 while free
+            int busyUntil;
+            bool used;
+        };
+
+        // walks the passes backwards: a pass survives if it writes an imported target or
+        // something a surviving later pass reads, and then everything it reads is needed too
+        void cull() {
+            std::vector<bool> needed(m_Resources.size(), false);
+            for (size_t i = 0; i < m_Resources.size(); ++i)
+                needed[i] = m_Resources[i].imported;
+            for (int p = (int) m_Passes.size() - 1; p >= 0; --p) {
+                Pass &pass = m_Passes[p];
+                pass.culled = std::none_of(pass.writes.begin(), pass.writes.end(), [&needed](Resource r) {
+                    return needed[r];
+                });
+                if (pass.culled)
+                    continue;
+                for (Resource r : pass.reads)
+                    needed[r] = true;
+                // a pass that writes part of a target relies on what earlier passes put there
+                for (Resource r : pass.writes)
+                    needed[r] = true;
+            }
+        }
+
+        void assignTextures() {
+            for (ResourceNode &node : m_Resources) {
+                node.firstPass = node.lastPass = -1;
+            }
+            for (int p = 0; p < (int) m_Passes.size(); ++p) {
+                if (m_Passes[p].culled)
+                    continue;
+                auto touch = [this, p](Resource r) {
+                    ResourceNode &node = m_Resources[r];
+                    if (node.firstPass < 0)
+                        node.firstPass = p;
+                    node.lastPass = p;
+                };
+                std::for_each(m_Passes[p].reads.begin(), m_Passes[p].reads.end(), touch);
+                std::for_each(m_Passes[p].writes.begin(), m_Passes[p].writes.end(), touch);
+            }
+
+            for (PooledTexture &pooled : m_Pool) {
+                pooled.busyUntil = -1;
+                pooled.used = false;
+            }
+            // hand out textures in order of first use; a pooled texture is free again once
+            // the pass that last touches its current occupant has run
+            std::vector<Resource> order;
+            for (Resource r = 0; r < (Resource) m_Resources.size(); ++r) {
+                if (!m_Resources[r].imported && m_Resources[r].firstPass >= 0)
+                    order.push_back(r);
+            }
+            std::stable_sort(order.begin(), order.end(), [this](Resource a, Resource b) {
+                return m_Resources[a].firstPass < m_Resources[b].firstPass;
+            });
+            m_UnaliasedBytes = 0;
+            for (Resource r : order) {
+                ResourceNode &node = m_Resources[r];
+                m_UnaliasedBytes += node.desc.bytes();
+                PooledTexture *match = nullptr;
+                for (PooledTexture &pooled : m_Pool) {
+                    if (pooled.desc == node.desc && pooled.busyUntil < node.firstPass) {
+                        match = &pooled;
+                        break;
+                    }
+                }
+                if (!match) {
+                    m_Pool.push_back(createTexture(node.desc));
+                    match = &m_Pool.back();
+                }
+                match->busyUntil = node.lastPass;
+                match->used = true;
+                node.texture = match->texture;
+            }
+
+            // textures this frame didn't need: old sizes after a resize, switched-off features
+            for (size_t i = 0; i < m_Pool.size();) {
+                if (m_Pool[i].used) {
+                    ++i;
+                    continue;
+                }
+                destroyTexture(m_Pool[i]);
+                m_Pool.erase(m_Pool.begin() + i);
+            }
+        }
+
+        void report() {
+            size_t pooled = pooledBytes();
+            if (pooled == m_ReportedBytes && m_UnaliasedBytes == m_ReportedUnaliased)
+                return;
+            m_ReportedBytes = pooled;
+            m_ReportedUnaliased = m_UnaliasedBytes;
+            std::cout << "FRAMEGRAPH::" << describe() << "\n"
+                      << "FRAMEGRAPH::" << m_Pool.size() << " pooled targets, " << pooled / (1024.0 * 1024.0)
+                      << " MB (" << m_UnaliasedBytes / (1024.0 * 1024.0) << " MB without aliasing)" << std::endl;
+        }
+
+        GLuint framebuffer(std::initializer_list<Resource> colors, Resource depth) {
+            std::vector<GLuint> key;
+            for (Resource r : colors)
+                key.push_back(m_Resources[r].texture);
+            key.push_back(depth >= 0 ? m_Resources[depth].texture : 0);
+            // the default framebuffer is imported as texture 0
+            if (colors.size() == 1 && m_Resources[*colors.begin()].imported && key[0] == 0)
+                return 0;
+
+            auto it = m_Framebuffers.find(key);
+            if (it != m_Framebuffers.end())
+                return it->second;
+
+            GLuint fbo;
+            glGenFramebuffers(1, &fbo);
+            glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+            std::vector<GLenum> drawBuffers;
+            for (Resource r : colors) {
+                GLenum attachment = GL_COLOR_ATTACHMENT0 + (GLenum) drawBuffers.size();
+                glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, textureTarget(m_Resources[r].desc),
+                                       m_Resources[r].texture, 0);
+                drawBuffers.push_back(attachment);
+            }
+            if (depth >= 0) {
+                GLenum attachment = m_Resources[depth].desc.format == GL_DEPTH24_STENCIL8 ? GL_DEPTH_STENCIL_ATTACHMENT
+                                                                                          : GL_DEPTH_ATTACHMENT;
+                glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, textureTarget(m_Resources[depth].desc),
+                                       m_Resources[depth].texture, 0);
+            }
+            if (drawBuffers.empty()) {
+                // depth only, e.g. as a blit source
+                glDrawBuffer(GL_NONE);
+                glReadBuffer(GL_NONE);
+            } else {
+                glDrawBuffers((GLsizei) drawBuffers.size(), drawBuffers.data());
+            }
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+                std::cout << "ERROR::FRAMEBUFFER::FRAMEGRAPH!" << std::endl;
+            m_Framebuffers[key] = fbo;
+            return fbo;
+        }
+
+        static GLenum textureTarget(const TextureDesc &desc) {
+            return desc.samples > 1 ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D;
+        }
+
+        static PooledTexture createTexture(const TextureDesc &desc) {
+            PooledTexture pooled;
+            pooled.desc = desc;
+            pooled.busyUntil = -1;
+            pooled.used = false;
+            glGenTextures(1, &pooled.texture);
+            if (desc.samples > 1) {
+                glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, pooled.texture);
+                glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, desc.samples, desc.format, desc.width, desc.height, GL_TRUE);
+                glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
+                memoryTracker().texture(pooled.texture, "Frame graph pool", MemoryTracker::RENDER_TARGETS,
+                                        desc.format, desc.width, desc.height, 1, 1, desc.samples);
+                return pooled;
+            }
+            GLenum format = GL_RGBA, type = GL_UNSIGNED_BYTE;
+            if (desc.isDepth()) {
+                format = desc.format == GL_DEPTH24_STENCIL8 ? GL_DEPTH_STENCIL : GL_DEPTH_COMPONENT;
+                type = desc.format == GL_DEPTH24_STENCIL8 ? GL_UNSIGNED_INT_24_8 : GL_FLOAT;
+            } else if (desc.format == GL_RGB10_A2) {
+                type = GL_UNSIGNED_INT_2_10_10_10_REV;
+            } else if (desc.format == GL_RGBA16F || desc.format == GL_RGBA32F || desc.format == GL_R11F_G11F_B10F
+                       || desc.format == GL_RG16F || desc.format == GL_R16F || desc.format == GL_R32F) {
+                type = GL_FLOAT;
+                format = desc.format == GL_R11F_G11F_B10F ? GL_RGB
+                         : desc.format == GL_RG16F ? GL_RG
+                         : desc.format == GL_R16F || desc.format == GL_R32F ? GL_RED : GL_RGBA;
+            } else if (desc.format == GL_RGB8 || desc.format == GL_SRGB8) {
+                format = GL_RGB;
+            } else if (desc.format == GL_R8) {
+                format = GL_RED;
+            }
+            glBindTexture(GL_TEXTURE_2D, pooled.texture);
+            glTexImage2D(GL_TEXTURE_2D, 0, desc.format, desc.width, desc.height, 0, format, type, NULL);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glBindTexture(GL_TEXTURE_2D, 0);
+            memoryTracker().texture(pooled.texture, "Frame graph pool", MemoryTracker::RENDER_TARGETS,
+                                    desc.format, desc.width, desc.height);
+            return pooled;
+        }
+
+        void destroyTexture(const PooledTexture &pooled) {
+            // framebuffers built on this texture go with it
+            for (auto it = m_Framebuffers.begin(); it != m_Framebuffers.end();) {
+                if (std::find(it->first.begin(), it->first.end(), pooled.texture) != it->first.end()) {
+                    glDeleteFramebuffers(1, &it->second);
+                    it = m_Framebuffers.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+            glDeleteTextures(1, &pooled.texture);
+            memoryTracker().releaseTexture(pooled.texture);
+        }
+
+        std::vector<Pass> m_Passes;
+        std::vector<ResourceNode> m_Resources;
+        std::vector<PooledTexture> m_Pool;
+        std::map<std::vector<GLuint>, GLuint> m_Framebuffers;
+        size_t m_UnaliasedBytes = 0;
+        size_t m_ReportedBytes = 0;
+        size_t m_ReportedUnaliased = 0;
+    };
+
+};
+#endif //PROJECT_BASE_FRAMEGRAPH_H
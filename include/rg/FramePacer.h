@@ -0,0 +1,191 @@
+#ifndef PROJECT_BASE_FRAMEPACER_H
+#define PROJECT_BASE_FRAMEPACER_H
+
+#include <chrono>
+#include <deque>
+#include <thread>
+#include <vector>
+#include <glad/glad.h>
+
+namespace rg {
+
+    struct FramePacingSettings {
+        // for glfwSwapInterval: 0 unthrottled, 1 every refresh, 2 every other one, -1 adaptive
+        int swapInterval = 1;
+        // frames per second the limiter holds the loop to, 0 for no limit
+        int frameRateLimit = 0;
+        // frames the GPU may have queued when the next one starts, 0 leaves it to the driver
+        int maxFramesInFlight = 2;
+        // the limiter sleeps until this long before its deadline and spins the rest, as a
+        // sleep may overshoot by about a scheduler tick
+        float spinMs = 2.0f;
+        // input polled right before the camera matrices are built, after the waits, instead
+        // of at the end of the last frame
+        bool lateInput = true;
+    };
+
+    // Keeps the CPU from running ahead of the GPU and the display. wait(), at the top of the
+    // frame, blocks on the fence of an older frame until no more than maxFramesInFlight - 1
+    // are queued, then sleeps and spins up to the frame-rate limit, so that the input the
+    // frame samples afterwards is as fresh as the queue allows. presented(), after the
+    // swap, fences the frame and stamps the GPU time its commands complete at.
+    // The latency is from the input sample to the frame's completion on the GPU, mapped onto
+    // the CPU clock, plus what the display adds on top: a refresh on average with vsync, half
+    // of one without. It's an estimate; the compositor and the panel are not in it.
+    class FramePacer {
+    public:
+        typedef std::chrono::steady_clock Clock;
+
+        // running averages, in milliseconds
+        struct Stats {
+            double fenceWaitMs = 0.0;
+            double limiterWaitMs = 0.0;
+            double swapMs = 0.0;
+            double latencyMs = 0.0;
+            int framesInFlight = 0;
+        };
+
+        FramePacer() = default;
+
+        ~FramePacer() {
+            for (const Pending &pending : m_Pending) {
+                glDeleteSync(pending.fence);
+                m_FreeQueries.push_back(pending.query);
+            }
+            if (!m_FreeQueries.empty())
+                glDeleteQueries((GLsizei) m_FreeQueries.size(), m_FreeQueries.data());
+        }
+
+        FramePacer(const FramePacer&) = delete;
+        FramePacer& operator=(const FramePacer&) = delete;
+
+        void setRefreshRate(int hz) {
+            m_RefreshMs = hz > 0 ? 1000.0 / hz : 1000.0 / 60.0;
+        }
+
+        void wait(const FramePacingSettings &settings) {
+            m_Settings = settings;
+            Clock::time_point start = Clock::now();
+            // where GPU time 0 is on the CPU clock, for the completion stamps
+            GLint64 gpuNow = 0;
+            glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+            m_GpuOffsetNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    Clock::now().time_since_epoch()).count() - gpuNow;
+            retire(false);
+            while (settings.maxFramesInFlight > 0 && (int) m_Pending.size() >= settings.maxFramesInFlight)
+                retire(true);
+            Clock::time_point fenced = Clock::now();
+            limit(settings, fenced);
+            Clock::time_point end = Clock::now();
+            average(m_Stats.fenceWaitMs, msBetween(start, fenced));
+            average(m_Stats.limiterWaitMs, msBetween(fenced, end));
+            m_Stats.framesInFlight = (int) m_Pending.size();
+            m_InputTime = end;
+        }
+
+        // input was sampled and the camera is about to be built; without a call, the end of
+        // wait() counts as the sample
+        void inputSampled() {
+            m_InputTime = Clock::now();
+        }
+
+        // right after the swap, which started at swapStart
+        void presented(Clock::time_point swapStart) {
+            Clock::time_point now = Clock::now();
+            average(m_Stats.swapMs, msBetween(swapStart, now));
+            Pending pending;
+            if (m_FreeQueries.empty()) {
+                pending.query = 0;
+                glGenQueries(1, &pending.query);
+            } else {
+                pending.query = m_FreeQueries.back();
+                m_FreeQueries.pop_back();
+            }
+            glQueryCounter(pending.query, GL_TIMESTAMP);
+            pending.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            pending.inputTime = m_InputTime;
+            m_Pending.push_back(pending);
+            // with no limit the driver's own queue bounds this, only the stamps are kept
+            while (m_Pending.size() > MAX_PENDING)
+                retire(true);
+        }
+
+        const Stats& stats() const {
+            return m_Stats;
+        }
+
+    private:
+        static const size_t MAX_PENDING = 4;
+
+        struct Pending {
+            GLsync fence;
+            GLuint query;
+            Clock::time_point inputTime;
+        };
+
+        static double msBetween(Clock::time_point from, Clock::time_point to) {
+            return std::chrono::duration<double, std::milli>(to - from).count();
+        }
+
+        static void average(double &value, double sample) {
+            value = value * 0.95 + sample * 0.05;
+        }
+
+        // the oldest pending frame, if it has completed or, when blocking, once it has
+        void retire(bool blocking) {
+            while (!m_Pending.empty()) {
+                Pending &oldest = m_Pending.front();
+                GLenum status = glClientWaitSync(oldest.fence, blocking ? GL_SYNC_FLUSH_COMMANDS_BIT : 0,
+                                                 blocking ? 1000000000ull : 0);
+                if (status == GL_TIMEOUT_EXPIRED && !blocking)
+                    return;
+                if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) {
+                    GLuint64 completed = 0;
+                    glGetQueryObjectui64v(oldest.query, GL_QUERY_RESULT, &completed);
+                    long long inputNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            oldest.inputTime.time_since_epoch()).count();
+                    double display = m_Settings.swapInterval != 0 ? m_RefreshMs : m_RefreshMs * 0.5;
+                    average(m_Stats.latencyMs, (m_GpuOffsetNs + (long long) completed - inputNs) / 1.0e6 + display);
+                }
+                // a lost fence isn't waited on again
+                glDeleteSync(oldest.fence);
+                m_FreeQueries.push_back(oldest.query);
+                m_Pending.pop_front();
+                if (blocking)
+                    return;
+            }
+        }
+
+        void limit(const FramePacingSettings &settings, Clock::time_point now) {
+            if (settings.frameRateLimit <= 0) {
+                m_Deadline = now;
+                return;
+            }
+            Clock::duration period = std::chrono::duration_cast<Clock::duration>(
+                    std::chrono::duration<double>(1.0 / settings.frameRateLimit));
+            m_Deadline += period;
+            // a frame that ran over starts the schedule again rather than rushing to catch up
+            if (m_Deadline < now) {
+                m_Deadline = now;
+                return;
+            }
+            Clock::duration spin = std::chrono::duration_cast<Clock::duration>(
+                    std::chrono::duration<double, std::milli>(settings.spinMs));
+            if (m_Deadline - now > spin)
+                std::this_thread::sleep_for(m_Deadline - now - spin);
+            while (Clock::now() < m_Deadline)
+                std::this_thread::yield();
+        }
+
+        FramePacingSettings m_Settings;
+        std::deque<Pending> m_Pending;
+        std::vector<GLuint> m_FreeQueries;
+        Clock::time_point m_Deadline;
+        Clock::time_point m_InputTime;
+        long long m_GpuOffsetNs = 0;
+        double m_RefreshMs = 1000.0 / 60.0;
+        Stats m_Stats;
+    };
+
+};
+#endif //PROJECT_BASE_FRAMEPACER_H
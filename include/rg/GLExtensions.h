@@ -0,0 +1,173 @@
+#ifndef PROJECT_BASE_GLEXTENSIONS_H
+#define PROJECT_BASE_GLEXTENSIONS_H
+
+#include <glad/glad.h>
+#include <cstring>
+
+// glad is generated for a plain 3.3 core profile without any extensions, so the few
+// newer entry points we use opportunistically are declared and loaded here by hand.
+
+// ARB_get_program_binary
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#define GL_PROGRAM_BINARY_FORMATS 0x87FF
+#endif
+
+// KHR_parallel_shader_compile (same values as the ARB variant)
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+// ARB_pipeline_statistics_query (core in 4.6)
+#ifndef GL_FRAGMENT_SHADER_INVOCATIONS_ARB
+#define GL_FRAGMENT_SHADER_INVOCATIONS_ARB 0x82F4
+#endif
+
+// EXT_texture_sRGB_decode
+#ifndef GL_TEXTURE_SRGB_DECODE_EXT
+#define GL_TEXTURE_SRGB_DECODE_EXT 0x8A48
+#define GL_DECODE_EXT 0x8A49
+#define GL_SKIP_DECODE_EXT 0x8A4A
+#endif
+
+// KHR_debug (core in 4.3)
+#ifndef GL_DEBUG_OUTPUT
+#define GL_DEBUG_OUTPUT_SYNCHRONOUS 0x8242
+#define GL_DEBUG_SOURCE_API 0x8246
+#define GL_DEBUG_SOURCE_WINDOW_SYSTEM 0x8247
+#define GL_DEBUG_SOURCE_SHADER_COMPILER 0x8248
+#define GL_DEBUG_SOURCE_THIRD_PARTY 0x8249
+#define GL_DEBUG_SOURCE_APPLICATION 0x824A
+#define GL_DEBUG_SOURCE_OTHER 0x824B
+#define GL_DEBUG_TYPE_ERROR 0x824C
+#define GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR 0x824D
+#define GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR 0x824E
+#define GL_DEBUG_TYPE_PORTABILITY 0x824F
+#define GL_DEBUG_TYPE_PERFORMANCE 0x8250
+#define GL_DEBUG_TYPE_OTHER 0x8251
+#define GL_DEBUG_TYPE_MARKER 0x8268
+#define GL_DEBUG_TYPE_PUSH_GROUP 0x8269
+#define GL_DEBUG_TYPE_POP_GROUP 0x826A
+#define GL_DEBUG_SEVERITY_NOTIFICATION 0x826B
+#define GL_DEBUG_SEVERITY_HIGH 0x9146
+#define GL_DEBUG_SEVERITY_MEDIUM 0x9147
+#define GL_DEBUG_SEVERITY_LOW 0x9148
+#define GL_DEBUG_OUTPUT 0x92E0
+#define GL_CONTEXT_FLAG_DEBUG_BIT 0x00000002
+#endif
+
+// NVX_gpu_memory_info, values in kilobytes
+#ifndef GL_GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX
+#define GL_GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX 0x9047
+#define GL_GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX 0x9048
+#define GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX 0x9049
+#define GL_GPU_MEMORY_INFO_EVICTION_COUNT_NVX 0x904A
+#define GL_GPU_MEMORY_INFO_EVICTED_MEMORY_NVX 0x904B
+#endif
+
+// ATI_meminfo, four values in kilobytes per pool
+#ifndef GL_VBO_FREE_MEMORY_ATI
+#define GL_VBO_FREE_MEMORY_ATI 0x87FB
+#define GL_TEXTURE_FREE_MEMORY_ATI 0x87FC
+#define GL_RENDERBUFFER_FREE_MEMORY_ATI 0x87FD
+#endif
+
+namespace rg {
+
+    typedef void (APIENTRYP PFNRGGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+    typedef void (APIENTRYP PFNRGPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+    typedef void (APIENTRYP PFNRGPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+    typedef void (APIENTRYP PFNRGMAXSHADERCOMPILERTHREADSPROC)(GLuint count);
+    typedef void (APIENTRY *RGDEBUGPROC)(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length,
+                                         const GLchar *message, const void *userParam);
+    typedef void (APIENTRYP PFNRGDEBUGMESSAGECALLBACKPROC)(RGDEBUGPROC callback, const void *userParam);
+    typedef void (APIENTRYP PFNRGDEBUGMESSAGECONTROLPROC)(GLenum source, GLenum type, GLenum severity, GLsizei count,
+                                                          const GLuint *ids, GLboolean enabled);
+
+    struct GLExtensions {
+        bool programBinary = false;
+        PFNRGGETPROGRAMBINARYPROC GetProgramBinary = nullptr;
+        PFNRGPROGRAMBINARYPROC ProgramBinary = nullptr;
+        PFNRGPROGRAMPARAMETERIPROC ProgramParameteri = nullptr;
+
+        bool parallelShaderCompile = false;
+        PFNRGMAXSHADERCOMPILERTHREADSPROC MaxShaderCompilerThreads = nullptr;
+
+        // plain begin/end queries with new targets, nothing to load
+        bool pipelineStatistics = false;
+
+        // a texture parameter, sRGB textures can be sampled without the decode
+        bool textureSRGBDecode = false;
+
+        // video memory queries, plain glGetIntegerv
+        bool nvxGpuMemoryInfo = false;
+        bool atiMeminfo = false;
+
+        bool debugOutput = false;
+        PFNRGDEBUGMESSAGECALLBACKPROC DebugMessageCallback = nullptr;
+        PFNRGDEBUGMESSAGECONTROLPROC DebugMessageControl = nullptr;
+    };
+
+    inline GLExtensions& glExtensions() {
+        static GLExtensions extensions;
+        return extensions;
+    }
+
+    inline bool hasGLExtension(const char* name) {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; ++i) {
+            const char* extension = (const char*) glGetStringi(GL_EXTENSIONS, i);
+            if (extension && std::strcmp(extension, name) == 0)
+                return true;
+        }
+        return false;
+    }
+
+    // has to be called once after gladLoadGLLoader, with the same loader
+    inline void loadGLExtensions(GLADloadproc load) {
+        GLExtensions& ext = glExtensions();
+        GLint major = 0, minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        bool gl41 = major > 4 || (major == 4 && minor >= 1);
+        bool gl43 = major > 4 || (major == 4 && minor >= 3);
+        bool gl46 = major > 4 || (major == 4 && minor >= 6);
+
+        if (gl41 || hasGLExtension("GL_ARB_get_program_binary")) {
+            ext.GetProgramBinary = (PFNRGGETPROGRAMBINARYPROC) load("glGetProgramBinary");
+            ext.ProgramBinary = (PFNRGPROGRAMBINARYPROC) load("glProgramBinary");
+            ext.ProgramParameteri = (PFNRGPROGRAMPARAMETERIPROC) load("glProgramParameteri");
+            GLint formats = 0;
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+            ext.programBinary = ext.GetProgramBinary && ext.ProgramBinary && ext.ProgramParameteri && formats > 0;
+        }
+
+        if (hasGLExtension("GL_KHR_parallel_shader_compile"))
+            ext.MaxShaderCompilerThreads = (PFNRGMAXSHADERCOMPILERTHREADSPROC) load("glMaxShaderCompilerThreadsKHR");
+        else if (hasGLExtension("GL_ARB_parallel_shader_compile"))
+            ext.MaxShaderCompilerThreads = (PFNRGMAXSHADERCOMPILERTHREADSPROC) load("glMaxShaderCompilerThreadsARB");
+        if (ext.MaxShaderCompilerThreads) {
+            // 0xFFFFFFFF lets the driver pick as many compiler threads as it sees fit
+            ext.MaxShaderCompilerThreads(0xFFFFFFFFu);
+            ext.parallelShaderCompile = true;
+        }
+
+        ext.pipelineStatistics = gl46 || hasGLExtension("GL_ARB_pipeline_statistics_query");
+        ext.textureSRGBDecode = hasGLExtension("GL_EXT_texture_sRGB_decode");
+        ext.nvxGpuMemoryInfo = hasGLExtension("GL_NVX_gpu_memory_info");
+        ext.atiMeminfo = hasGLExtension("GL_ATI_meminfo");
+
+        // desktop KHR_debug has no suffix on its entry points
+        if (gl43 || hasGLExtension("GL_KHR_debug")) {
+            ext.DebugMessageCallback = (PFNRGDEBUGMESSAGECALLBACKPROC) load("glDebugMessageCallback");
+            ext.DebugMessageControl = (PFNRGDEBUGMESSAGECONTROLPROC) load("glDebugMessageControl");
+            ext.debugOutput = ext.DebugMessageCallback && ext.DebugMessageControl;
+        }
+    }
+
+};
+#endif //PROJECT_BASE_GLEXTENSIONS_H
@@ -0,0 +1,77 @@
+#ifndef PROJECT_BASE_GPUQUERY_H
+#define PROJECT_BASE_GPUQUERY_H
+
+#include <glad/glad.h>
+
+namespace rg {
+
+    // A begin/end query (GL_TIME_ELAPSED, GL_SAMPLES_PASSED, pipeline statistics...) issued
+    // once per frame. Results are read back LATENCY frames after they were issued, and only
+    // if they are available by then, so reading never stalls the pipeline; a frame whose
+    // result is late keeps the previous value and is counted. Only one query per target may
+    // be active at a time.
+    class GpuQuery {
+    public:
+        static const int LATENCY = 3;
+
+        explicit GpuQuery(GLenum target) : m_Target(target) {
+            glGenQueries(LATENCY, m_Queries);
+        }
+
+        ~GpuQuery() {
+            glDeleteQueries(LATENCY, m_Queries);
+        }
+
+        GpuQuery(const GpuQuery&) = delete;
+        GpuQuery& operator=(const GpuQuery&) = delete;
+
+        void begin() {
+            int slot = m_Frame % LATENCY;
+            if (m_Frame >= LATENCY) {
+                GLint available = 0;
+                glGetQueryObjectiv(m_Queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+                if (available) {
+                    GLuint64 result = 0;
+                    glGetQueryObjectui64v(m_Queries[slot], GL_QUERY_RESULT, &result);
+                    m_Last = (double) result;
+                    m_Average = m_Samples == 0 ? m_Last : m_Average * 0.95 + m_Last * 0.05;
+                    ++m_Samples;
+                } else {
+                    ++m_LateFrames;
+                }
+            }
+            glBeginQuery(m_Target, m_Queries[slot]);
+        }
+
+        void end() {
+            glEndQuery(m_Target);
+            ++m_Frame;
+        }
+
+        // result of the block LATENCY frames ago
+        double last() const {
+            return m_Last;
+        }
+
+        // exponentially smoothed, steadier for on-screen comparisons
+        double average() const {
+            return m_Average;
+        }
+
+        // results that weren't back LATENCY frames later and were dropped
+        long long lateFrames() const {
+            return m_LateFrames;
+        }
+
+    private:
+        GLenum m_Target;
+        GLuint m_Queries[LATENCY];
+        long long m_Frame = 0;
+        long long m_Samples = 0;
+        long long m_LateFrames = 0;
+        double m_Last = 0.0;
+        double m_Average = 0.0;
+    };
+
+};
+#endif //PROJECT_BASE_GPUQUERY_H
@@ -0,0 +1,110 @@
+#ifndef PROJECT_BASE_GPUTIMER_H
+#define PROJECT_BASE_GPUTIMER_H
+
+#include <rg/GpuQuery.h>
+
+namespace rg {
+
+    // GL_TIME_ELAPSED around a block of GL calls, see GpuQuery for the delayed readback.
+    // Timer queries can't nest: only one timer may be running.
+    class GpuTimer {
+    public:
+        GpuTimer() : m_Query(GL_TIME_ELAPSED) {
+        }
+
+        void begin() {
+            m_Query.begin();
+        }
+
+        void end() {
+            m_Query.end();
+        }
+
+        double lastMs() const {
+            return m_Query.last() / 1.0e6;
+        }
+
+        double averageMs() const {
+            return m_Query.average() / 1.0e6;
+        }
+
+    private:
+        GpuQuery m_Query;
+    };
+
+    // GPU time between two GL_TIMESTAMP counters, read back GpuQuery::LATENCY frames late and
+    // only if the end counter is available by then, so it never stalls; a late frame is
+    // skipped. Counters aren't begin/end queries, so this may span blocks timed by GpuTimers,
+    // e.g. the whole frame.
+    class GpuSpanTimer {
+    public:
+        static const int LATENCY = GpuQuery::LATENCY;
+
+        GpuSpanTimer() {
+            glGenQueries(2 * LATENCY, m_Queries);
+        }
+
+        ~GpuSpanTimer() {
+            glDeleteQueries(2 * LATENCY, m_Queries);
+        }
+
+        GpuSpanTimer(const GpuSpanTimer&) = delete;
+        GpuSpanTimer& operator=(const GpuSpanTimer&) = delete;
+
+        void begin() {
+            int slot = m_Frame % LATENCY;
+            m_Fresh = false;
+            if (m_Frame >= LATENCY) {
+                // counters complete in order, so the end one stands for both
+                GLint available = 0;
+                glGetQueryObjectiv(m_Queries[2 * slot + 1], GL_QUERY_RESULT_AVAILABLE, &available);
+                if (available) {
+                    GLuint64 start = 0, end = 0;
+                    glGetQueryObjectui64v(m_Queries[2 * slot], GL_QUERY_RESULT, &start);
+                    glGetQueryObjectui64v(m_Queries[2 * slot + 1], GL_QUERY_RESULT, &end);
+                    m_LastMs = (end - start) / 1.0e6;
+                    m_AverageMs = m_Samples == 0 ? m_LastMs : m_AverageMs * 0.95 + m_LastMs * 0.05;
+                    ++m_Samples;
+                    m_Fresh = true;
+                } else {
+                    ++m_LateFrames;
+                }
+            }
+            glQueryCounter(m_Queries[2 * slot], GL_TIMESTAMP);
+        }
+
+        void end() {
+            glQueryCounter(m_Queries[2 * (m_Frame % LATENCY) + 1], GL_TIMESTAMP);
+            ++m_Frame;
+        }
+
+        double lastMs() const {
+            return m_LastMs;
+        }
+
+        double averageMs() const {
+            return m_AverageMs;
+        }
+
+        // whether the last begin() read a new sample, rather than keeping the one before
+        bool fresh() const {
+            return m_Fresh;
+        }
+
+        // samples skipped because the end counter wasn't back LATENCY frames later
+        long long lateFrames() const {
+            return m_LateFrames;
+        }
+
+    private:
+        GLuint m_Queries[2 * LATENCY];
+        long long m_Frame = 0;
+        long long m_Samples = 0;
+        long long m_LateFrames = 0;
+        bool m_Fresh = false;
+        double m_LastMs = 0.0;
+        double m_AverageMs = 0.0;
+    };
+
+};
+#endif //PROJECT_BASE_GPUTIMER_H
@@ -0,0 +1,214 @@
+#ifndef PROJECT_BASE_IDLETHROTTLE_H
+#define PROJECT_BASE_IDLETHROTTLE_H
+
+#include <chrono>
+#include <ctime>
+#include <iostream>
+#include <glad/glad.h>
+#include <rg/MemoryTracker.h>
+
+namespace rg {
+
+    struct IdleThrottleSettings {
+        bool enabled = true;
+        // frames per second while another window has the focus
+        int unfocusedFrameRate = 10;
+        // frames rendered after the last change before the image counts as still: TAA and
+        // the exposure read-back take a few to settle
+        int settleFrames = 30;
+        // how often a still or minimised window wakes up without an event
+        float idleWakeSeconds = 0.5f;
+    };
+
+    // Decides, at the top of each iteration of the loop, whether it renders: at full rate
+    // while anything changes, at a reduced rate while the window is out of focus, and not
+    // at all once the image has been still for a while or the window is minimised; those
+    // wait for events instead, and a still window presents its cached last frame again
+    // when it wakes up with nothing to do. Anything that may change the image calls wake().
+    // The time spent in each state is accounted with the process's CPU time and the GPU
+    // time of the frames rendered in it.
+    class IdleThrottle {
+    public:
+        enum State {
+            ACTIVE,
+            UNFOCUSED,
+            IDLE,
+            ICONIFIED,
+            STATE_COUNT
+        };
+
+        struct Usage {
+            double wallSeconds = 0.0;
+            double cpuSeconds = 0.0;
+            double gpuMs = 0.0;
+            long long frames = 0;
+            long long represented = 0;
+
+            double cpuPercent() const {
+                return wallSeconds > 0.0 ? 100.0 * cpuSeconds / wallSeconds : 0.0;
+            }
+
+            double gpuPercent() const {
+                return wallSeconds > 0.0 ? 0.1 * gpuMs / wallSeconds : 0.0;
+            }
+        };
+
+        static const char* stateName(State state) {
+            static const char *names[STATE_COUNT] = {"Active", "Unfocused", "Idle", "Minimised"};
+            return names[state];
+        }
+
+        void wake() {
+            m_Changed = true;
+        }
+
+        // something called wake() since the last update()
+        bool woken() const {
+            return m_Changed;
+        }
+
+        // animating: state that changes on its own, so that every frame differs
+        State update(const IdleThrottleSettings &settings, bool iconified, bool focused, bool animating) {
+            account();
+            if (m_Changed || animating || !settings.enabled)
+                m_StillFrames = 0;
+            m_Changed = false;
+            if (iconified && settings.enabled)
+                m_State = ICONIFIED;
+            else if (m_StillFrames >= settings.settleFrames && m_HasCache)
+                m_State = IDLE;
+            else if (!focused && settings.enabled)
+                m_State = UNFOCUSED;
+            else
+                m_State = ACTIVE;
+            return m_State;
+        }
+
+        // a frame was rendered in the current state; gpuMs is the GPU frame time
+        void rendered(double gpuMs, bool cached) {
+            ++m_Usage[m_State].frames;
+            m_Usage[m_State].gpuMs += gpuMs;
+            ++m_StillFrames;
+            m_HasCache = cached;
+        }
+
+        // the cached frame was presented instead of a new one
+        void represented() {
+            ++m_Usage[m_State].represented;
+        }
+
+        // the frame about to be rendered is worth caching: nothing has changed for long
+        // enough that it may be the last one before going idle
+        bool cacheNext(const IdleThrottleSettings &settings) const {
+            return settings.enabled && m_StillFrames + 1 >= settings.settleFrames;
+        }
+
+        State state() const {
+            return m_State;
+        }
+
+        const Usage& usage(State state) const {
+            return m_Usage[state];
+        }
+
+    private:
+        typedef std::chrono::steady_clock Clock;
+
+        // the time since the last update() goes to the state it decided on
+        void account() {
+            Clock::time_point now = Clock::now();
+            std::clock_t cpu = std::clock();
+            if (m_Accounting) {
+                m_Usage[m_State].wallSeconds += std::chrono::duration<double>(now - m_Last).count();
+                m_Usage[m_State].cpuSeconds += (double) (cpu - m_LastCpu) / CLOCKS_PER_SEC;
+            }
+            m_Last = now;
+            m_LastCpu = cpu;
+            m_Accounting = true;
+        }
+
+        State m_State = ACTIVE;
+        Usage m_Usage[STATE_COUNT];
+        Clock::time_point m_Last;
+        std::clock_t m_LastCpu = 0;
+        bool m_Accounting = false;
+        bool m_Changed = true;
+        bool m_HasCache = false;
+        int m_StillFrames = 0;
+    };
+
+    // A copy of the last presented frame, to present again without rendering it. The copy
+    // is taken from the back buffer before the swap, after which its contents are undefined.
+    class FrameCache {
+    public:
+        FrameCache() = default;
+
+        ~FrameCache() {
+            release();
+        }
+
+        FrameCache(const FrameCache&) = delete;
+        FrameCache& operator=(const FrameCache&) = delete;
+
+        // before the swap; the blit copies the stored values, no sRGB conversion
+        void store(int width, int height) {
+            if (width != m_Width || height != m_Height)
+                allocate(width, height);
+            glDisable(GL_FRAMEBUFFER_SRGB);
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_Framebuffer);
+            glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        }
+
+        // into the back buffer, to be swapped; false if there is no frame of this size
+        bool present(int width, int height) {
+            if (!m_Framebuffer || width != m_Width || height != m_Height)
+                return false;
+            glDisable(GL_FRAMEBUFFER_SRGB);
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, m_Framebuffer);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+            glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            return true;
+        }
+
+        void release() {
+            if (!m_Framebuffer)
+                return;
+            glDeleteFramebuffers(1, &m_Framebuffer);
+            glDeleteTextures(1, &m_Texture);
+            memoryTracker().releaseTexture(m_Texture);
+            m_Framebuffer = m_Texture = 0;
+            m_Width = m_Height = 0;
+        }
+
+    private:
+        void allocate(int width, int height) {
+            release();
+            m_Width = width;
+            m_Height = height;
+            glGenTextures(1, &m_Texture);
+            glBindTexture(GL_TEXTURE_2D, m_Texture);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glBindTexture(GL_TEXTURE_2D, 0);
+            memoryTracker().texture(m_Texture, "Idle frame cache", MemoryTracker::RENDER_TARGETS, GL_RGBA8, width,
+                                    height);
+            glGenFramebuffers(1, &m_Framebuffer);
+            glBindFramebuffer(GL_FRAMEBUFFER, m_Framebuffer);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_Texture, 0);
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+                std::cout << "ERROR::FRAMEBUFFER::FRAME_CACHE!" << std::endl;
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        }
+
+        GLuint m_Framebuffer = 0;
+        GLuint m_Texture = 0;
+        int m_Width = 0;
+        int m_Height = 0;
+    };
+
+};
+#endif //PROJECT_BASE_IDLETHROTTLE_H
@@ -0,0 +1,176 @@
+#ifndef PROJECT_BASE_IMAGEDIFF_H
+#define PROJECT_BASE_IMAGEDIFF_H
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+
+namespace rg {
+
+    // RGB8 pixels in glReadPixels order, bottom row first
+    struct Image {
+        unsigned int width = 0;
+        unsigned int height = 0;
+        std::vector<unsigned char> pixels;
+
+        // the default framebuffer's back buffer, i.e. what is about to be presented; the bytes
+        // come back as stored, whatever encoding produced them
+        static Image readBackbuffer(unsigned int width, unsigned int height) {
+            Image image;
+            image.width = width;
+            image.height = height;
+            image.pixels.resize((size_t) width * height * 3);
+            // some drivers decode sRGB on read-back while GL_FRAMEBUFFER_SRGB is enabled
+            GLboolean srgb = glIsEnabled(GL_FRAMEBUFFER_SRGB);
+            glDisable(GL_FRAMEBUFFER_SRGB);
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+            glReadBuffer(GL_BACK);
+            glPixelStorei(GL_PACK_ALIGNMENT, 1);
+            glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, image.pixels.data());
+            glPixelStorei(GL_PACK_ALIGNMENT, 4);
+            if (srgb)
+                glEnable(GL_FRAMEBUFFER_SRGB);
+            return image;
+        }
+
+        // binary PPM, which every image viewer opens and which needs no encoder
+        bool writePPM(const std::string &path) const {
+            std::ofstream out(path, std::ios::binary);
+            if (!out) {
+                std::cout << "ERROR::IMAGE::WRITE_FAILED " << path << std::endl;
+                return false;
+            }
+            out << "P6\n" << width << " " << height << "\n255\n";
+            for (unsigned int y = height; y-- > 0;)
+                out.write((const char *) &pixels[(size_t) y * width * 3], (std::streamsize) width * 3);
+            return true;
+        }
+    };
+
+    // Per-channel comparison of two captures of the same size, in 8-bit steps.
+    struct ImageDiff {
+        bool sameSize = false;
+        double rmse = 0.0;
+        // dB, infinite for identical images
+        double psnr = 0.0;
+        int maxError = 0;
+        // pixels with any channel further off than the tolerance
+        double changedPercent = 0.0;
+
+        // heatmap, if given, gets the reference at a quarter brightness with the largest
+        // channel error of each pixel, times 16, on top in red
+        static ImageDiff compare(const Image &reference, const Image &image, int tolerance, Image *heatmap = nullptr) {
+            ImageDiff diff;
+            if (reference.width != image.width || reference.height != image.height)
+                return diff;
+            diff.sameSize = true;
+            if (heatmap) {
+                heatmap->width = reference.width;
+                heatmap->height = reference.height;
+                heatmap->pixels.assign(reference.pixels.size(), 0);
+            }
+
+            double squared = 0.0;
+            size_t changed = 0;
+            size_t pixelCount = (size_t) reference.width * reference.height;
+            for (size_t p = 0; p < pixelCount; ++p) {
+                int pixelError = 0;
+                for (size_t c = p * 3; c < p * 3 + 3; ++c) {
+                    int error = std::abs((int) reference.pixels[c] - (int) image.pixels[c]);
+                    squared += (double) error * error;
+                    pixelError = std::max(pixelError, error);
+                }
+                diff.maxError = std::max(diff.maxError, pixelError);
+                if (pixelError > tolerance)
+                    ++changed;
+                if (heatmap) {
+                    unsigned char *out = &heatmap->pixels[p * 3];
+                    const unsigned char *in = &reference.pixels[p * 3];
+                    out[0] = (unsigned char) std::min(255, in[0] / 4 + pixelError * 16);
+                    out[1] = (unsigned char) (in[1] / 4);
+                    out[2] = (unsigned char) (in[2] / 4);
+                }
+            }
+            if (pixelCount == 0)
+                return diff;
+            diff.rmse = std::sqrt(squared / (pixelCount * 3));
+            diff.psnr = diff.rmse > 0.0 ? 20.0 * std::log10(255.0 / diff.rmse)
+                                        : std::numeric_limits<double>::infinity();
+            diff.changedPercent = 100.0 * changed / pixelCount;
+            return diff;
+        }
+    };
+
+    // Renders the same frame once under each of a list of pipeline configurations, one per
+    // frame, and compares every capture with the first. The caller applies configuration
+    // step() before rendering and calls capture() once the frame is in the back buffer and
+    // before anything else (the UI) is drawn over it. The captures and heatmaps are written
+    // next to the executable as validation_<name>.ppm and validation_<name>_diff.ppm.
+    class ImageValidation {
+    public:
+        // channel errors up to this many steps count as rounding, not as a change
+        static const int TOLERANCE = 2;
+
+        struct Result {
+            std::string name;
+            ImageDiff diff;
+        };
+
+        void start(const std::vector<std::string> &configurations) {
+            m_Names = configurations;
+            m_Step = 0;
+            m_Reference = Image();
+            m_Results.clear();
+        }
+
+        bool active() const {
+            return m_Step < m_Names.size();
+        }
+
+        // index of the configuration this frame renders with
+        size_t step() const {
+            return m_Step;
+        }
+
+        void capture(unsigned int width, unsigned int height) {
+            Image image = Image::readBackbuffer(width, height);
+            const std::string &name = m_Names[m_Step];
+            image.writePPM("validation_" + name + ".ppm");
+            if (m_Step == 0) {
+                m_Reference = std::move(image);
+            } else {
+                Result result;
+                result.name = name;
+                Image heatmap;
+                result.diff = ImageDiff::compare(m_Reference, image, TOLERANCE, &heatmap);
+                if (!result.diff.sameSize) {
+                    std::cout << "VALIDATION::" << name << ": the window was resized, nothing to compare" << std::endl;
+                } else {
+                    heatmap.writePPM("validation_" + name + "_diff.ppm");
+                    std::cout << "VALIDATION::" << name << " vs " << m_Names[0] << ": RMSE " << result.diff.rmse
+                              << ", PSNR " << result.diff.psnr << " dB, max error " << result.diff.maxError << ", "
+                              << result.diff.changedPercent << "% of pixels off by more than " << TOLERANCE << std::endl;
+                }
+                m_Results.push_back(result);
+            }
+            ++m_Step;
+        }
+
+        const std::vector<Result>& results() const {
+            return m_Results;
+        }
+
+    private:
+        std::vector<std::string> m_Names;
+        size_t m_Step = 0;
+        Image m_Reference;
+        std::vector<Result> m_Results;
+    };
+
+};
+#endif //PROJECT_BASE_IMAGEDIFF_H
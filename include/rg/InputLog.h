@@ -0,0 +1,301 @@
+#ifndef PROJECT_BASE_INPUTLOG_H
+#define PROJECT_BASE_INPUTLOG_H
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+    // A session's input in a compact binary log, for replaying it frame by frame. The file
+    // is "RGIN", a uint32 version, then records in the byte order of the machine that wrote
+    // them. Each record is a uint8 type and a float32 timestamp (glfwGetTime() seconds),
+    // followed by:
+    //   FRAME   float32 frame time, uint32 mask of the polled keys that are held
+    //   KEY     int16 key, int16 scancode, uint8 action, uint8 mods
+    //   CURSOR  float64 x, float64 y
+    //   SCROLL  float64 x offset, float64 y offset
+    //   BUTTON  uint8 button, uint8 action, uint8 mods
+    //   CHAR    uint32 codepoint
+    // A FRAME record opens every frame, and the events that arrive while that frame polls
+    // follow it. The polled keys are the ones the frame reads with glfwGetKey. The log takes
+    // them from the caller, as bit i for polledKeys[i], so it needs nothing from GLFW.
+    // Buttons and characters only go to the UI, but without them a setting changed in a
+    // panel would be lost on replay. Replay also tracks the cursor and the held buttons,
+    // for the UI, which would otherwise read the live mouse.
+    class InputLog {
+    public:
+        static const uint32_t VERSION = 2;
+
+        enum EventType : uint8_t {
+            FRAME = 1,
+            KEY = 2,
+            CURSOR = 3,
+            SCROLL = 4,
+            BUTTON = 5,
+            CHAR = 6
+        };
+
+        struct Event {
+            EventType type;
+            float time;
+            // the button of a BUTTON, the codepoint of a CHAR
+            int key;
+            int scancode;
+            int action;
+            int mods;
+            double x;
+            double y;
+        };
+
+        explicit InputLog(std::vector<int> polledKeys) : m_PolledKeys(std::move(polledKeys)) {}
+
+        const std::vector<int>& polledKeys() const {
+            return m_PolledKeys;
+        }
+
+        bool record(const std::string &path) {
+            m_Out.open(path, std::ios::binary);
+            if (!m_Out) {
+                std::cout << "ERROR::INPUT_LOG::WRITE_FAILED " << path << std::endl;
+                return false;
+            }
+            m_Out.write("RGIN", 4);
+            put(VERSION);
+            m_Recording = true;
+            return true;
+        }
+
+        bool replay(const std::string &path) {
+            std::ifstream in(path, std::ios::binary);
+            if (!in) {
+                std::cout << "ERROR::INPUT_LOG::NOT_FOUND " << path << std::endl;
+                return false;
+            }
+            m_Data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+            uint32_t version = 0;
+            if (m_Data.size() < 8 || std::memcmp(m_Data.data(), "RGIN", 4) != 0) {
+                std::cout << "ERROR::INPUT_LOG::NOT_AN_INPUT_LOG " << path << std::endl;
+                return false;
+            }
+            std::memcpy(&version, &m_Data[4], sizeof(version));
+            if (version != VERSION) {
+                std::cout << "ERROR::INPUT_LOG::VERSION " << version << " in " << path << std::endl;
+                return false;
+            }
+            m_Read = 8;
+            m_Buttons = m_Pressed = 0;
+            m_Replaying = true;
+            return true;
+        }
+
+        bool recording() const {
+            return m_Recording;
+        }
+
+        bool replaying() const {
+            return m_Replaying;
+        }
+
+        long long frames() const {
+            return m_Frames;
+        }
+
+        void stop() {
+            if (m_Recording)
+                m_Out.close();
+            m_Recording = false;
+            m_Replaying = false;
+        }
+
+        // recording
+        // ---------
+        void recordFrame(float time, float deltaTime, uint32_t heldKeys) {
+            header(FRAME, time);
+            put(deltaTime);
+            put(heldKeys);
+            ++m_Frames;
+        }
+
+        void recordKey(float time, int key, int scancode, int action, int mods) {
+            header(KEY, time);
+            put((int16_t) key);
+            put((int16_t) scancode);
+            put((uint8_t) action);
+            put((uint8_t) mods);
+        }
+
+        void recordCursor(float time, double x, double y) {
+            header(CURSOR, time);
+            put(x);
+            put(y);
+        }
+
+        void recordScroll(float time, double x, double y) {
+            header(SCROLL, time);
+            put(x);
+            put(y);
+        }
+
+        void recordButton(float time, int button, int action, int mods) {
+            header(BUTTON, time);
+            put((uint8_t) button);
+            put((uint8_t) action);
+            put((uint8_t) mods);
+        }
+
+        void recordChar(float time, unsigned int codepoint) {
+            header(CHAR, time);
+            put((uint32_t) codepoint);
+        }
+
+        // replay
+        // ------
+        // moves on to the next frame and its held keys, skipping whatever events the last
+        // frame didn't take; false once the log is over, which also ends the replay
+        bool nextFrame(float &deltaTime) {
+            Event skipped;
+            while (nextEvent(skipped)) {}
+            if (m_Read >= m_Data.size()) {
+                stop();
+                return false;
+            }
+            uint8_t type = 0;
+            float time = 0.0f;
+            uint32_t held = 0;
+            if (!get(type) || type != FRAME || !get(time) || !get(deltaTime) || !get(held)) {
+                std::cout << "ERROR::INPUT_LOG::CORRUPT at byte " << m_Read << std::endl;
+                stop();
+                return false;
+            }
+            m_Held = held;
+            ++m_Frames;
+            return true;
+        }
+
+        // held during the current frame, for a key in polledKeys()
+        bool keyDown(int key) const {
+            for (size_t i = 0; i < m_PolledKeys.size(); ++i) {
+                if (m_PolledKeys[i] == key)
+                    return (m_Held >> i) & 1u;
+            }
+            return false;
+        }
+
+        // the current frame's events in the order they came, false after the last one
+        bool nextEvent(Event &event) {
+            if (m_Read >= m_Data.size() || m_Data[m_Read] == FRAME)
+                return false;
+            uint8_t type = 0;
+            get(type);
+            event = Event();
+            event.type = (EventType) type;
+            bool ok = get(event.time);
+            if (type == KEY) {
+                int16_t key = 0, scancode = 0;
+                uint8_t action = 0, mods = 0;
+                ok = ok && get(key) && get(scancode) && get(action) && get(mods);
+                event.key = key;
+                event.scancode = scancode;
+                event.action = action;
+                event.mods = mods;
+            } else if (type == CURSOR || type == SCROLL) {
+                ok = ok && get(event.x) && get(event.y);
+                if (ok && type == CURSOR) {
+                    m_CursorX = event.x;
+                    m_CursorY = event.y;
+                }
+            } else if (type == BUTTON) {
+                uint8_t button = 0, action = 0, mods = 0;
+                ok = ok && get(button) && get(action) && get(mods) && button < 32;
+                event.key = button;
+                event.action = action;
+                event.mods = mods;
+                if (ok && action != 0) {
+                    m_Buttons |= 1u << button;
+                    m_Pressed |= 1u << button;
+                } else if (ok) {
+                    m_Buttons &= ~(1u << button);
+                }
+            } else if (type == CHAR) {
+                uint32_t codepoint = 0;
+                ok = ok && get(codepoint);
+                event.key = (int) codepoint;
+            } else {
+                ok = false;
+            }
+            if (!ok) {
+                std::cout << "ERROR::INPUT_LOG::CORRUPT at byte " << m_Read << std::endl;
+                m_Read = m_Data.size();
+            }
+            return ok;
+        }
+
+        // where the replayed cursor last was
+        double cursorX() const {
+            return m_CursorX;
+        }
+
+        double cursorY() const {
+            return m_CursorY;
+        }
+
+        // held, or pressed since the last call, so that a click within one frame isn't lost
+        bool takeButton(int button) {
+            uint32_t bit = 1u << button;
+            bool down = ((m_Buttons | m_Pressed) & bit) != 0;
+            m_Pressed &= ~bit;
+            return down;
+        }
+
+        // bit i set for every polledKeys()[i] the given predicate reports held
+        template<typename IsDown>
+        uint32_t heldKeys(IsDown isDown) const {
+            uint32_t held = 0;
+            for (size_t i = 0; i < m_PolledKeys.size() && i < 32; ++i) {
+                if (isDown(m_PolledKeys[i]))
+                    held |= 1u << i;
+            }
+            return held;
+        }
+
+    private:
+        void header(EventType type, float time) {
+            put((uint8_t) type);
+            put(time);
+        }
+
+        template<typename T>
+        void put(T value) {
+            m_Out.write((const char *) &value, sizeof(T));
+        }
+
+        template<typename T>
+        bool get(T &value) {
+            if (m_Read + sizeof(T) > m_Data.size())
+                return false;
+            std::memcpy(&value, &m_Data[m_Read], sizeof(T));
+            m_Read += sizeof(T);
+            return true;
+        }
+
+        std::vector<int> m_PolledKeys;
+        std::ofstream m_Out;
+        std::vector<char> m_Data;
+        size_t m_Read = 0;
+        uint32_t m_Held = 0;
+        uint32_t m_Buttons = 0;
+        uint32_t m_Pressed = 0;
+        double m_CursorX = 0.0;
+        double m_CursorY = 0.0;
+        long long m_Frames = 0;
+        bool m_Recording = false;
+        bool m_Replaying = false;
+    };
+
+};
+#endif //PROJECT_BASE_INPUTLOG_H
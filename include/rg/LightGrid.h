@@ -0,0 +1,340 @@
+#ifndef PROJECT_BASE_LIGHTGRID_H
+#define PROJECT_BASE_LIGHTGRID_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include <rg/ThreadPool.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// CPU side of clustered forward shading. The view frustum is cut into X*Y screen tiles and
+// Z exponentially spaced depth slices ("froxels"); every frame each light's bounding sphere is
+// binned into the froxels it touches, and the fragment shader only loops over the list of the
+// froxel it falls into. Nothing in here touches GL, so the binning can be driven from tests
+// (tests/lightGridTest.cpp) and benchmarks.
+
+namespace rg {
+
+    // point lights are spot lights whose cone never cuts anything off (cutOff -1, outerCutOff -2)
+    struct ClusterLight {
+        glm::vec3 position;
+        glm::vec3 direction = glm::vec3(0.0f, -1.0f, 0.0f);
+        glm::vec3 ambient;
+        glm::vec3 diffuse;
+        glm::vec3 specular;
+        float constant = 1.0f;
+        float linear = 0.09f;
+        float quadratic = 0.032f;
+        float cutOff = -1.0f;
+        float outerCutOff = -2.0f;
+        // distance past which the light contributes less than LIGHT_CUTOFF of its peak
+        float range = 0.0f;
+    };
+
+    const float LIGHT_CUTOFF = 5.0f / 256.0f;
+
+    // solves constant + linear * d + quadratic * d^2 = peak / LIGHT_CUTOFF for d
+    inline float lightRange(const ClusterLight &light) {
+        float peak = std::max(std::max(light.diffuse.r, light.diffuse.g), light.diffuse.b);
+        peak = std::max(peak, std::max(std::max(light.ambient.r, light.ambient.g), light.ambient.b));
+        peak = std::max(peak, std::max(std::max(light.specular.r, light.specular.g), light.specular.b));
+        float c = light.constant - peak / LIGHT_CUTOFF;
+        if (c >= 0.0f)
+            return 0.0f;
+        if (light.quadratic <= 0.0f)
+            return light.linear > 0.0f ? -c / light.linear : 1e6f;
+        return (-light.linear + std::sqrt(light.linear * light.linear - 4.0f * light.quadratic * c)) / (2.0f * light.quadratic);
+    }
+
+    inline ClusterLight makePointLight(glm::vec3 position, glm::vec3 ambient, glm::vec3 diffuse, glm::vec3 specular,
+                                       float constant, float linear, float quadratic) {
+        ClusterLight light;
+        light.position = position;
+        light.ambient = ambient;
+        light.diffuse = diffuse;
+        light.specular = specular;
+        light.constant = constant;
+        light.linear = linear;
+        light.quadratic = quadratic;
+        light.range = lightRange(light);
+        return light;
+    }
+
+    inline ClusterLight makeSpotLight(glm::vec3 position, glm::vec3 direction, float cutOff, float outerCutOff,
+                                      glm::vec3 ambient, glm::vec3 diffuse, glm::vec3 specular,
+                                      float constant, float linear, float quadratic) {
+        ClusterLight light = makePointLight(position, ambient, diffuse, specular, constant, linear, quadratic);
+        light.direction = direction;
+        light.cutOff = cutOff;
+        light.outerCutOff = outerCutOff;
+        return light;
+    }
+
+    // small coloured lights scattered over the scene, always the same ones for a given count
+    inline void addScatteredLights(std::vector<ClusterLight> &lights, int count) {
+        unsigned int seed = 12345u;
+        auto random = [&seed]() {
+            seed = seed * 1664525u + 1013904223u;
+            return (seed >> 8) / 16777216.0f;
+        };
+        for (int i = 0; i < count; ++i) {
+            glm::vec3 position(random() * 60.0f - 30.0f, random() * 6.0f, random() * 60.0f - 30.0f);
+            glm::vec3 color(random(), random(), random());
+            lights.push_back(makePointLight(position, color * 0.05f, color * 0.5f, color * 0.5f, 1.0f, 0.35f, 0.44f));
+        }
+    }
+
+    struct ClusterGridConfig {
+        unsigned int tilesX = 16;
+        unsigned int tilesY = 9;
+        unsigned int slices = 24;
+        float zNear = 0.1f;
+        float zFar = 100.0f;
+        float tanHalfFovY = 0.41421356f;
+        float aspect = 16.0f / 9.0f;
+
+        static ClusterGridConfig fromPerspective(float fovYRadians, float aspect, float zNear, float zFar) {
+            ClusterGridConfig config;
+            config.tanHalfFovY = std::tan(fovYRadians * 0.5f);
+            config.aspect = aspect;
+            config.zNear = zNear;
+            config.zFar = zFar;
+            return config;
+        }
+
+        unsigned int clusterCount() const {
+            return tilesX * tilesY * slices;
+        }
+
+        // slice = log(depth) * sliceScale() - sliceBias(), the same formula the fragment shader uses
+        float sliceScale() const {
+            return slices / std::log(zFar / zNear);
+        }
+
+        float sliceBias() const {
+            return slices * std::log(zNear) / std::log(zFar / zNear);
+        }
+
+        unsigned int sliceOf(float depth) const {
+            float slice = std::floor(std::log(std::max(depth, zNear)) * sliceScale() - sliceBias());
+            return (unsigned int) std::min(std::max(slice, 0.0f), (float) (slices - 1));
+        }
+
+        unsigned int clusterIndex(unsigned int x, unsigned int y, unsigned int z) const {
+            return (z * tilesY + y) * tilesX + x;
+        }
+    };
+
+    // inclusive froxel ranges a light touches; visible is false when it is outside the frustum
+    struct LightBounds {
+        uint16_t x0, x1, y0, y1, z0, z1;
+        bool visible;
+    };
+
+    // offsets/counts are per cluster, indices holds the concatenated per-cluster light lists
+    struct LightGrid {
+        std::vector<uint32_t> offsets;
+        std::vector<uint32_t> counts;
+        std::vector<uint32_t> indices;
+    };
+
+    class LightGridBuilder {
+    public:
+        explicit LightGridBuilder(ThreadPool *pool = nullptr) : m_Pool(pool) {
+        }
+
+        void build(const ClusterGridConfig &config, const glm::mat4 &view, const std::vector<ClusterLight> &lights,
+                   LightGrid &grid) {
+            computeBounds(config, view, lights);
+            fillClusters(config, grid);
+        }
+
+        const std::vector<LightBounds>& bounds() const {
+            return m_Bounds;
+        }
+
+        // the SSE2 tile tests where the build has them; off, the scalar ones, for comparison
+        void setSimd(bool simd) {
+            m_Simd = simd;
+        }
+
+    private:
+        void forRange(size_t count, size_t minChunk, const std::function<void(size_t, size_t)> &fn) {
+            if (m_Pool)
+                m_Pool->parallelFor(count, fn, minChunk);
+            else
+                fn(0, count);
+        }
+
+        // tile boundary planes all pass through the eye. Boundary i of n sits at
+        // ndc = -1 + 2i/n, i.e. x/-z = k_i; the plane x + k_i z = 0 is stored as (k_i, 1/|n|)
+        static void boundaryPlanes(unsigned int tiles, float tanHalfFov, std::vector<float> &k, std::vector<float> &invNorm) {
+            k.resize(tiles + 1);
+            invNorm.resize(tiles + 1);
+            for (unsigned int i = 0; i <= tiles; ++i) {
+                k[i] = (-1.0f + 2.0f * i / tiles) * tanHalfFov;
+                invNorm[i] = 1.0f / std::sqrt(1.0f + k[i] * k[i]);
+            }
+        }
+
+        void computeBounds(const ClusterGridConfig &config, const glm::mat4 &view, const std::vector<ClusterLight> &lights) {
+            size_t count = lights.size();
+            size_t padded = (count + 3) & ~size_t(3);
+            m_ViewX.assign(padded, 0.0f);
+            m_ViewY.assign(padded, 0.0f);
+            m_ViewZ.assign(padded, -1.0f);
+            m_Radius.assign(padded, 0.0f);
+            m_Bounds.resize(count);
+            boundaryPlanes(config.tilesX, config.tanHalfFovY * config.aspect, m_PlaneKX, m_PlaneNormX);
+            boundaryPlanes(config.tilesY, config.tanHalfFovY, m_PlaneKY, m_PlaneNormY);
+
+            // transform to view space, structure of arrays so four lights fit in one SSE register
+            for (size_t i = 0; i < count; ++i) {
+                const glm::vec3 &p = lights[i].position;
+                m_ViewX[i] = view[0][0] * p.x + view[1][0] * p.y + view[2][0] * p.z + view[3][0];
+                m_ViewY[i] = view[0][1] * p.x + view[1][1] * p.y + view[2][1] * p.z + view[3][1];
+                m_ViewZ[i] = view[0][2] * p.x + view[1][2] * p.y + view[2][2] * p.z + view[3][2];
+                m_Radius[i] = lights[i].range;
+            }
+
+            forRange(padded / 4, 64, [this, &config, count](size_t begin, size_t end) {
+                for (size_t group = begin; group < end; ++group)
+                    boundsForGroup(config, group * 4, count);
+            });
+        }
+
+        // screen tile ranges for lights [first, first + 4) via plane distance tests, then depth slices
+        void boundsForGroup(const ClusterGridConfig &config, size_t first, size_t count) {
+            int rightOfX[4], leftOfX[4], aboveY[4], belowY[4];
+            tileTests(m_PlaneKX, m_PlaneNormX, &m_ViewX[first], &m_ViewZ[first], &m_Radius[first], rightOfX, leftOfX,
+                      m_Simd);
+            tileTests(m_PlaneKY, m_PlaneNormY, &m_ViewY[first], &m_ViewZ[first], &m_Radius[first], aboveY, belowY,
+                      m_Simd);
+
+            for (size_t lane = 0; lane < 4 && first + lane < count; ++lane) {
+                size_t i = first + lane;
+                LightBounds &b = m_Bounds[i];
+                float depth = -m_ViewZ[i];
+                float radius = m_Radius[i];
+                b.visible = depth + radius >= config.zNear && depth - radius <= config.zFar;
+                b.z0 = (uint16_t) config.sliceOf(depth - radius);
+                b.z1 = (uint16_t) config.sliceOf(std::min(depth + radius, config.zFar));
+                if (depth - radius < config.zNear) {
+                    // the sphere reaches behind the near plane where the tile planes flip sides,
+                    // so just cover the whole screen
+                    b.x0 = 0;
+                    b.x1 = (uint16_t) (config.tilesX - 1);
+                    b.y0 = 0;
+                    b.y1 = (uint16_t) (config.tilesY - 1);
+                    continue;
+                }
+                int x0 = rightOfX[lane], x1 = (int) config.tilesX - 1 - leftOfX[lane];
+                int y0 = aboveY[lane], y1 = (int) config.tilesY - 1 - belowY[lane];
+                b.visible = b.visible && x0 <= x1 && y0 <= y1;
+                b.x0 = (uint16_t) std::max(x0, 0);
+                b.x1 = (uint16_t) std::max(x1, 0);
+                b.y0 = (uint16_t) std::max(y0, 0);
+                b.y1 = (uint16_t) std::max(y1, 0);
+            }
+        }
+
+        // for the inner boundaries 1..n-1 counts how many a sphere lies entirely past (positive
+        // side) and entirely before; the planes are ordered, so those counts are the tile range
+        static void tileTests(const std::vector<float> &k, const std::vector<float> &invNorm,
+                              const float *coord, const float *z, const float *radius, int *past, int *before,
+                              bool simd) {
+            size_t boundaries = k.size() - 1;
+#if defined(__SSE2__)
+            if (simd) {
+                tileTestsSSE2(k, invNorm, coord, z, radius, past, before);
+                return;
+            }
+#endif
+            for (int lane = 0; lane < 4; ++lane) {
+                past[lane] = 0;
+                before[lane] = 0;
+                for (size_t i = 1; i < boundaries; ++i) {
+                    float distance = (coord[lane] + k[i] * z[lane]) * invNorm[i];
+                    past[lane] += distance > radius[lane] ? 1 : 0;
+                    before[lane] += distance < -radius[lane] ? 1 : 0;
+                }
+            }
+        }
+
+#if defined(__SSE2__)
+        static void tileTestsSSE2(const std::vector<float> &k, const std::vector<float> &invNorm,
+                                  const float *coord, const float *z, const float *radius, int *past, int *before) {
+            size_t boundaries = k.size() - 1;
+            __m128 c = _mm_loadu_ps(coord);
+            __m128 vz = _mm_loadu_ps(z);
+            __m128 r = _mm_loadu_ps(radius);
+            __m128 negR = _mm_sub_ps(_mm_setzero_ps(), r);
+            __m128i pastCount = _mm_setzero_si128();
+            __m128i beforeCount = _mm_setzero_si128();
+            for (size_t i = 1; i < boundaries; ++i) {
+                __m128 distance = _mm_mul_ps(_mm_add_ps(c, _mm_mul_ps(_mm_set1_ps(k[i]), vz)), _mm_set1_ps(invNorm[i]));
+                // comparison masks are all ones (-1) per lane, so subtracting them counts
+                pastCount = _mm_sub_epi32(pastCount, _mm_castps_si128(_mm_cmpgt_ps(distance, r)));
+                beforeCount = _mm_sub_epi32(beforeCount, _mm_castps_si128(_mm_cmplt_ps(distance, negR)));
+            }
+            _mm_storeu_si128((__m128i *) past, pastCount);
+            _mm_storeu_si128((__m128i *) before, beforeCount);
+        }
+#endif
+
+        // two passes over the bounds, both split by depth slice so every thread owns a
+        // contiguous block of clusters: count, prefix sum, then write the light indices
+        void fillClusters(const ClusterGridConfig &config, LightGrid &grid) {
+            unsigned int clusters = config.clusterCount();
+            unsigned int perSlice = config.tilesX * config.tilesY;
+            grid.counts.assign(clusters, 0);
+            grid.offsets.resize(clusters);
+
+            forRange(config.slices, 1, [this, &config, &grid, perSlice](size_t begin, size_t end) {
+                for (const LightBounds &b : m_Bounds) {
+                    if (!b.visible)
+                        continue;
+                    size_t z0 = std::max<size_t>(b.z0, begin), z1 = std::min<size_t>(b.z1 + 1, end);
+                    for (size_t z = z0; z < z1; ++z)
+                        for (unsigned int y = b.y0; y <= b.y1; ++y)
+                            for (unsigned int x = b.x0; x <= b.x1; ++x)
+                                grid.counts[z * perSlice + y * config.tilesX + x]++;
+                }
+            });
+
+            uint32_t total = 0;
+            for (unsigned int c = 0; c < clusters; ++c) {
+                grid.offsets[c] = total;
+                total += grid.counts[c];
+            }
+            grid.indices.resize(total);
+
+            forRange(config.slices, 1, [this, &config, &grid, perSlice](size_t begin, size_t end) {
+                std::vector<uint32_t> cursor(grid.offsets.begin() + begin * perSlice, grid.offsets.begin() + end * perSlice);
+                for (size_t i = 0; i < m_Bounds.size(); ++i) {
+                    const LightBounds &b = m_Bounds[i];
+                    if (!b.visible)
+                        continue;
+                    size_t z0 = std::max<size_t>(b.z0, begin), z1 = std::min<size_t>(b.z1 + 1, end);
+                    for (size_t z = z0; z < z1; ++z)
+                        for (unsigned int y = b.y0; y <= b.y1; ++y)
+                            for (unsigned int x = b.x0; x <= b.x1; ++x)
+                                grid.indices[cursor[(z - begin) * perSlice + y * config.tilesX + x]++] = (uint32_t) i;
+                }
+            });
+        }
+
+        ThreadPool *m_Pool;
+        bool m_Simd = true;
+        std::vector<float> m_ViewX, m_ViewY, m_ViewZ, m_Radius;
+        std::vector<float> m_PlaneKX, m_PlaneNormX, m_PlaneKY, m_PlaneNormY;
+        std::vector<LightBounds> m_Bounds;
+    };
+
+};
+#endif //PROJECT_BASE_LIGHTGRID_H
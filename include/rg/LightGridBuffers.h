@@ -0,0 +1,120 @@
+#ifndef PROJECT_BASE_LIGHTGRIDBUFFERS_H
+#define PROJECT_BASE_LIGHTGRIDBUFFERS_H
+
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <learnopengl/shader.h>
+#include <rg/LightGrid.h>
+#include <rg/MemoryTracker.h>
+
+namespace rg {
+
+    // GL 3.3 has no storage buffers, so the light list, the per-cluster (offset, count) pairs and
+    // the light index list are uploaded as texture buffers and read with texelFetch
+    class LightGridBuffers {
+    public:
+        // texels of GL_RGBA32F per light, see upload() for the layout
+        static const int TEXELS_PER_LIGHT = 5;
+
+        LightGridBuffers() {
+            createBufferTexture(m_LightBuffer, m_LightTexture, GL_RGBA32F);
+            createBufferTexture(m_ClusterBuffer, m_ClusterTexture, GL_RG32UI);
+            createBufferTexture(m_IndexBuffer, m_IndexTexture, GL_R32UI);
+        }
+
+        ~LightGridBuffers() {
+            GLuint textures[] = {m_LightTexture, m_ClusterTexture, m_IndexTexture};
+            GLuint buffers[] = {m_LightBuffer, m_ClusterBuffer, m_IndexBuffer};
+            glDeleteTextures(3, textures);
+            glDeleteBuffers(3, buffers);
+            for (GLuint buffer : buffers)
+                memoryTracker().releaseBuffer(buffer);
+        }
+
+        LightGridBuffers(const LightGridBuffers&) = delete;
+        LightGridBuffers& operator=(const LightGridBuffers&) = delete;
+
+        void upload(const std::vector<ClusterLight> &lights, const LightGrid &grid) {
+            // per light:  position.xyz constant | direction.xyz linear | ambient.rgb quadratic
+            //             diffuse.rgb cutOff    | specular.rgb outerCutOff
+            m_LightData.resize(lights.size() * TEXELS_PER_LIGHT);
+            for (size_t i = 0; i < lights.size(); ++i) {
+                const ClusterLight &l = lights[i];
+                glm::vec4 *texel = &m_LightData[i * TEXELS_PER_LIGHT];
+                texel[0] = glm::vec4(l.position, l.constant);
+                texel[1] = glm::vec4(l.direction, l.linear);
+                texel[2] = glm::vec4(l.ambient, l.quadratic);
+                texel[3] = glm::vec4(l.diffuse, l.cutOff);
+                texel[4] = glm::vec4(l.specular, l.outerCutOff);
+            }
+            m_ClusterData.resize(grid.counts.size() * 2);
+            for (size_t c = 0; c < grid.counts.size(); ++c) {
+                m_ClusterData[c * 2] = grid.offsets[c];
+                m_ClusterData[c * 2 + 1] = grid.counts[c];
+            }
+            stream(m_LightBuffer, m_LightData.data(), m_LightData.size() * sizeof(glm::vec4), m_Sizes[0]);
+            stream(m_ClusterBuffer, m_ClusterData.data(), m_ClusterData.size() * sizeof(uint32_t), m_Sizes[1]);
+            stream(m_IndexBuffer, grid.indices.data(), grid.indices.size() * sizeof(uint32_t), m_Sizes[2]);
+        }
+
+        // binds the three buffer textures to firstUnit, firstUnit + 1 and firstUnit + 2
+        void bind(unsigned int firstUnit) const {
+            glActiveTexture(GL_TEXTURE0 + firstUnit);
+            glBindTexture(GL_TEXTURE_BUFFER, m_LightTexture);
+            glActiveTexture(GL_TEXTURE0 + firstUnit + 1);
+            glBindTexture(GL_TEXTURE_BUFFER, m_ClusterTexture);
+            glActiveTexture(GL_TEXTURE0 + firstUnit + 2);
+            glBindTexture(GL_TEXTURE_BUFFER, m_IndexTexture);
+            glActiveTexture(GL_TEXTURE0);
+        }
+
+        // uniforms the LOCAL_LIGHTS path of modelLightingShader.fs expects
+        static void setUniforms(Shader &shader, const ClusterGridConfig &config, unsigned int firstUnit,
+                                float viewportWidth, float viewportHeight) {
+            shader.setInt("lightData", firstUnit);
+            shader.setInt("lightClusters", firstUnit + 1);
+            shader.setInt("lightIndices", firstUnit + 2);
+            shader.setUVec3("clusterDims", config.tilesX, config.tilesY, config.slices);
+            shader.setVec2("clusterTileSize", viewportWidth / config.tilesX, viewportHeight / config.tilesY);
+            shader.setFloat("clusterSliceScale", config.sliceScale());
+            shader.setFloat("clusterSliceBias", config.sliceBias());
+        }
+
+    private:
+        static void createBufferTexture(GLuint &buffer, GLuint &texture, GLenum format) {
+            glGenBuffers(1, &buffer);
+            glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+            glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+            memoryTracker().buffer(buffer, "Light grid", MemoryTracker::OTHER_BUFFERS, 16);
+            glGenTextures(1, &texture);
+            glBindTexture(GL_TEXTURE_BUFFER, texture);
+            glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+            glBindTexture(GL_TEXTURE_BUFFER, 0);
+            glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        }
+
+        // orphan and refill, so the driver never has to wait for last frame's reads;
+        // lastSize keeps the tracker from being told the same size every frame
+        static void stream(GLuint buffer, const void *data, size_t size, size_t &lastSize) {
+            glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+            glBufferData(GL_TEXTURE_BUFFER, size > 0 ? size : 16, nullptr, GL_STREAM_DRAW);
+            if (size != lastSize) {
+                memoryTracker().buffer(buffer, "Light grid", MemoryTracker::OTHER_BUFFERS, size > 0 ? size : 16);
+                lastSize = size;
+            }
+            if (size > 0)
+                glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+            glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        }
+
+        GLuint m_LightBuffer, m_LightTexture;
+        GLuint m_ClusterBuffer, m_ClusterTexture;
+        GLuint m_IndexBuffer, m_IndexTexture;
+        std::vector<glm::vec4> m_LightData;
+        std::vector<uint32_t> m_ClusterData;
+        size_t m_Sizes[3] = {0, 0, 0};
+    };
+
+};
+#endif //PROJECT_BASE_LIGHTGRIDBUFFERS_H
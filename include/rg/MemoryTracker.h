@@ -0,0 +1,368 @@
+#ifndef PROJECT_BASE_MEMORYTRACKER_H
+#define PROJECT_BASE_MEMORYTRACKER_H
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+#include <glad/glad.h>
+#include <rg/GLExtensions.h>
+
+namespace rg {
+
+    // bytes a texel of the internal format takes in video memory, as far as the format says;
+    // drivers pad three-channel formats to four channels. 0 for a format not listed here,
+    // which the tracker reports rather than guesses at.
+    inline size_t bytesPerTexel(GLenum format) {
+        switch (format) {
+            case GL_RGBA32F:
+            case GL_RGB32F:
+            case GL_RGBA32UI:
+            case GL_RGB32UI:
+                return 16;
+            case GL_RGBA16F:
+            case GL_RGB16F:
+            case GL_RG32F:
+            case GL_RG32UI:
+                return 8;
+            case GL_RGBA8:
+            case GL_SRGB8_ALPHA8:
+            case GL_RGBA:
+            case GL_RGB8:
+            case GL_SRGB8:
+            case GL_RGB:
+            case GL_RGB10_A2:
+            case GL_R11F_G11F_B10F:
+            case GL_RG16F:
+            case GL_R32F:
+            case GL_R32UI:
+            case GL_DEPTH_COMPONENT24:
+            case GL_DEPTH_COMPONENT32F:
+            case GL_DEPTH_COMPONENT:
+            case GL_DEPTH24_STENCIL8:
+            case GL_DEPTH_STENCIL:
+                return 4;
+            case GL_R16F:
+            case GL_RG8:
+            case GL_RG:
+            case GL_DEPTH_COMPONENT16:
+                return 2;
+            case GL_R8:
+            case GL_RED:
+                return 1;
+            default:
+                return 0;
+        }
+    }
+
+    // length of the full mip chain of a width x height image
+    inline int mipLevels(int width, int height) {
+        int levels = 1;
+        while ((width | height) >> levels)
+            ++levels;
+        return levels;
+    }
+
+    // Sizes of what the application allocates: GL textures, buffers and renderbuffers, and
+    // the CPU copies of asset data it keeps. Every creation site reports its object with a
+    // category and the asset it belongs to, and the report adds them up both ways. Sizes
+    // are worked out from formats and dimensions, so they are what the objects need, not
+    // what the driver actually reserved; the driver's own figures, from
+    // GL_NVX_gpu_memory_info or GL_ATI_meminfo, are read alongside where there are any.
+    // Only the GL thread reports. A disabled tracker ignores every report, e.g. in the
+    // benchmarks, which load the same assets over and over without releasing them.
+    class MemoryTracker {
+    public:
+        enum Category {
+            TEXTURES,
+            RENDER_TARGETS,
+            VERTEX_BUFFERS,
+            INDEX_BUFFERS,
+            OTHER_BUFFERS,
+            CPU_GEOMETRY,
+            CATEGORY_COUNT
+        };
+
+        struct Row {
+            std::string name;
+            size_t gpuBytes = 0;
+            size_t cpuBytes = 0;
+            int objects = 0;
+        };
+
+        // in kilobytes, -1 for what the driver doesn't say
+        struct DriverMemory {
+            const char *source = nullptr;
+            long long dedicatedKb = -1;
+            long long availableKb = -1;
+            long long evictedKb = -1;
+            long long textureFreeKb = -1;
+            long long bufferFreeKb = -1;
+            long long renderbufferFreeKb = -1;
+        };
+
+        static const char* categoryName(Category category) {
+            static const char *names[CATEGORY_COUNT] = {"Textures", "Render targets", "Vertex buffers",
+                                                        "Index buffers", "Other buffers", "CPU geometry"};
+            return names[category];
+        }
+
+        void setEnabled(bool enabled) {
+            m_Enabled = enabled;
+        }
+
+        // depth is the layers of an array, the slices of a 3D texture or the 6 faces of a
+        // cube map; all levels of the mip chain are counted, each a quarter of the last
+        void texture(GLuint id, const std::string &asset, Category category, GLenum format, int width, int height,
+                     int depth = 1, int levels = 1, int samples = 1) {
+            if (!m_Enabled)
+                return;
+            size_t bytes = 0;
+            for (int level = 0; level < levels; ++level)
+                bytes += (size_t) std::max(width >> level, 1) * std::max(height >> level, 1);
+            bytes *= (size_t) depth * std::max(samples, 1) * texelBytes(format, asset);
+            m_Gpu[key(TEXTURE_OBJECT, id)] = Allocation{asset, category, bytes};
+        }
+
+        // glBufferData on an existing buffer replaces its size
+        void buffer(GLuint id, const std::string &asset, Category category, size_t bytes) {
+            if (!m_Enabled)
+                return;
+            m_Gpu[key(BUFFER_OBJECT, id)] = Allocation{asset, category, bytes};
+        }
+
+        void renderbuffer(GLuint id, const std::string &asset, GLenum format, int width, int height, int samples = 1) {
+            if (!m_Enabled)
+                return;
+            m_Gpu[key(RENDERBUFFER_OBJECT, id)] = Allocation{asset, RENDER_TARGETS, (size_t) width * height
+                                                                                 * std::max(samples, 1)
+                                                                                 * texelBytes(format, asset)};
+        }
+
+        void releaseTexture(GLuint id) {
+            m_Gpu.erase(key(TEXTURE_OBJECT, id));
+        }
+
+        void releaseBuffer(GLuint id) {
+            m_Gpu.erase(key(BUFFER_OBJECT, id));
+        }
+
+        void releaseRenderbuffer(GLuint id) {
+            m_Gpu.erase(key(RENDERBUFFER_OBJECT, id));
+        }
+
+        // CPU memory the owner holds for the asset; reporting again replaces, 0 bytes removes
+        void cpu(const void *owner, const std::string &asset, Category category, size_t bytes) {
+            if (!m_Enabled)
+                return;
+            if (bytes)
+                m_Cpu[owner] = Allocation{asset, category, bytes};
+            else
+                m_Cpu.erase(owner);
+        }
+
+        // the asset that the objects created while the scope is open belong to, e.g. a model
+        // for its meshes and textures
+        class AssetScope {
+        public:
+            AssetScope(MemoryTracker &tracker, const std::string &asset) : m_Tracker(tracker),
+                                                                           m_Previous(tracker.m_Asset) {
+                tracker.m_Asset = asset;
+            }
+
+            ~AssetScope() {
+                m_Tracker.m_Asset = m_Previous;
+            }
+
+            AssetScope(const AssetScope&) = delete;
+            AssetScope& operator=(const AssetScope&) = delete;
+
+        private:
+            MemoryTracker &m_Tracker;
+            std::string m_Previous;
+        };
+
+        // the open AssetScope's asset, or fallback outside of one
+        const std::string& asset(const std::string &fallback) const {
+            return m_Asset.empty() ? fallback : m_Asset;
+        }
+
+        // one row per category, in Category order
+        std::vector<Row> byCategory() const {
+            std::vector<Row> rows(CATEGORY_COUNT);
+            for (int c = 0; c < CATEGORY_COUNT; ++c)
+                rows[c].name = categoryName((Category) c);
+            add(rows, [](const Allocation &a) { return (int) a.category; });
+            return rows;
+        }
+
+        // one row per asset, the largest first
+        std::vector<Row> byAsset() const {
+            std::map<std::string, int> index;
+            std::vector<Row> rows;
+            auto assetIndex = [&index, &rows](const Allocation &a) {
+                auto it = index.find(a.asset);
+                if (it != index.end())
+                    return it->second;
+                rows.emplace_back();
+                rows.back().name = a.asset;
+                return index[a.asset] = (int) rows.size() - 1;
+            };
+            add(rows, assetIndex);
+            std::stable_sort(rows.begin(), rows.end(), [](const Row &a, const Row &b) {
+                return a.gpuBytes + a.cpuBytes > b.gpuBytes + b.cpuBytes;
+            });
+            return rows;
+        }
+
+        size_t gpuBytes() const {
+            size_t bytes = 0;
+            for (const auto &entry : m_Gpu)
+                bytes += entry.second.bytes;
+            return bytes;
+        }
+
+        size_t cpuBytes() const {
+            size_t bytes = 0;
+            for (const auto &entry : m_Cpu)
+                bytes += entry.second.bytes;
+            return bytes;
+        }
+
+        // textures and renderbuffers reported in a format bytesPerTexel doesn't know, counted
+        // as 0 bytes; each such format is also logged the first time
+        int unknownFormats() const {
+            return m_UnknownFormats;
+        }
+
+        static DriverMemory driverMemory() {
+            DriverMemory memory;
+            if (glExtensions().nvxGpuMemoryInfo) {
+                GLint value = 0;
+                memory.source = "GL_NVX_gpu_memory_info";
+                glGetIntegerv(GL_GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX, &value);
+                memory.dedicatedKb = value;
+                glGetIntegerv(GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX, &value);
+                memory.availableKb = value;
+                glGetIntegerv(GL_GPU_MEMORY_INFO_EVICTED_MEMORY_NVX, &value);
+                memory.evictedKb = value;
+            } else if (glExtensions().atiMeminfo) {
+                // the first of the four values is the pool's total free memory
+                GLint values[4] = {0, 0, 0, 0};
+                memory.source = "GL_ATI_meminfo";
+                glGetIntegerv(GL_TEXTURE_FREE_MEMORY_ATI, values);
+                memory.textureFreeKb = values[0];
+                glGetIntegerv(GL_VBO_FREE_MEMORY_ATI, values);
+                memory.bufferFreeKb = values[0];
+                glGetIntegerv(GL_RENDERBUFFER_FREE_MEMORY_ATI, values);
+                memory.renderbufferFreeKb = values[0];
+            }
+            return memory;
+        }
+
+        bool writeJSON(const std::string &path) const {
+            std::ofstream out(path);
+            if (!out) {
+                std::cout << "ERROR::MEMORY::WRITE_FAILED " << path << std::endl;
+                return false;
+            }
+            out << "{\n  \"gpu_bytes\": " << gpuBytes() << ",\n  \"cpu_bytes\": " << cpuBytes()
+                << ",\n  \"unknown_formats\": " << unknownFormats() << ",\n  \"categories\": [\n";
+            writeRows(out, byCategory());
+            out << "  ],\n  \"assets\": [\n";
+            writeRows(out, byAsset());
+            DriverMemory driver = driverMemory();
+            out << "  ],\n  \"driver\": ";
+            if (!driver.source) {
+                out << "null\n}\n";
+                return true;
+            }
+            out << "{\"source\": \"" << driver.source << "\"";
+            const std::pair<const char *, long long> fields[] = {
+                    {"dedicated_kb", driver.dedicatedKb}, {"available_kb", driver.availableKb},
+                    {"evicted_kb", driver.evictedKb}, {"texture_free_kb", driver.textureFreeKb},
+                    {"buffer_free_kb", driver.bufferFreeKb}, {"renderbuffer_free_kb", driver.renderbufferFreeKb}};
+            for (const auto &field : fields) {
+                if (field.second >= 0)
+                    out << ", \"" << field.first << "\": " << field.second;
+            }
+            out << "}\n}\n";
+            return true;
+        }
+
+    private:
+        struct Allocation {
+            std::string asset;
+            Category category;
+            size_t bytes;
+        };
+
+        enum ObjectKind {
+            TEXTURE_OBJECT,
+            BUFFER_OBJECT,
+            RENDERBUFFER_OBJECT
+        };
+
+        // GL names are only unique within a kind of object
+        static unsigned long long key(ObjectKind kind, GLuint id) {
+            return (unsigned long long) kind << 32 | id;
+        }
+
+        size_t texelBytes(GLenum format, const std::string &asset) {
+            size_t bytes = bytesPerTexel(format);
+            if (bytes == 0) {
+                ++m_UnknownFormats;
+                if (m_LoggedFormats.insert(format).second)
+                    std::cout << "ERROR::MEMORY::UNKNOWN_FORMAT 0x" << std::hex << format << std::dec << " of " << asset
+                              << ", counted as 0 bytes" << std::endl;
+            }
+            return bytes;
+        }
+
+        template<typename RowOf>
+        void add(std::vector<Row> &rows, RowOf rowOf) const {
+            for (const auto &entry : m_Gpu) {
+                Row &row = rows[rowOf(entry.second)];
+                row.gpuBytes += entry.second.bytes;
+                ++row.objects;
+            }
+            for (const auto &entry : m_Cpu) {
+                Row &row = rows[rowOf(entry.second)];
+                row.cpuBytes += entry.second.bytes;
+                ++row.objects;
+            }
+        }
+
+        static void writeRows(std::ostream &out, const std::vector<Row> &rows) {
+            for (size_t i = 0; i < rows.size(); ++i) {
+                std::string name;
+                for (char c : rows[i].name) {
+                    if (c == '"' || c == '\\')
+                        name += '\\';
+                    name += c;
+                }
+                out << "    {\"name\": \"" << name << "\", \"gpu_bytes\": " << rows[i].gpuBytes << ", \"cpu_bytes\": "
+                    << rows[i].cpuBytes << ", \"objects\": " << rows[i].objects << "}"
+                    << (i + 1 < rows.size() ? ",\n" : "\n");
+            }
+        }
+
+        std::map<unsigned long long, Allocation> m_Gpu;
+        std::map<const void *, Allocation> m_Cpu;
+        std::string m_Asset;
+        std::set<GLenum> m_LoggedFormats;
+        int m_UnknownFormats = 0;
+        bool m_Enabled = true;
+    };
+
+    inline MemoryTracker& memoryTracker() {
+        static MemoryTracker instance;
+        return instance;
+    }
+
+};
+#endif //PROJECT_BASE_MEMORYTRACKER_H
@@ -0,0 +1,377 @@
+#ifndef PROJECT_BASE_NULLGL_H
+#define PROJECT_BASE_NULLGL_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <glad/glad.h>
+#include <rg/GLExtensions.h>
+
+namespace rg {
+
+    // A GL that does nothing, so that GL code can run without a context or a GPU, e.g. in
+    // the benchmarks. loadNullGL() hands glad a loader whose entry points are stubs. The ones
+    // that give something back are answered plausibly: fresh object names, successful
+    // compiles and links, complete framebuffers, signalled fences, writable mapped memory,
+    // and a 3.3 core version. Every other entry point gets a stub that ignores its arguments
+    // and returns 0. That relies on the caller removing the arguments, which every 64-bit ABI
+    // and cdecl do, but 32-bit Windows' stdcall doesn't.
+    // Every call is counted, per entry point. Each entry point is given a slot when it is
+    // loaded, and a stub that is instantiated for that slot, so counting is an increment and
+    // nothing more. The binds, enables, fixed-function settings and uniforms count as state
+    // changes as well.
+    namespace nullgl {
+
+        static const size_t MAX_ENTRY_POINTS = 1024;
+        // the entry points with stubs of their own have the slots below this one
+        static const size_t FIRST_GENERIC_SLOT = 64;
+
+        struct State {
+            GLuint nextName = 1;
+            GLint viewport[4] = {0, 0, 1, 1};
+            std::vector<char> mapped;
+            // per slot
+            std::string names[MAX_ENTRY_POINTS];
+            unsigned long long calls[MAX_ENTRY_POINTS] = {};
+            bool changesState[MAX_ENTRY_POINTS] = {};
+            unsigned long long totalCalls = 0;
+            unsigned long long stateChanges = 0;
+            std::unordered_map<std::string, size_t> slots;
+            size_t nextSlot = FIRST_GENERIC_SLOT;
+        };
+
+        inline State& state() {
+            static State instance;
+            return instance;
+        }
+
+        inline void count(size_t slot) {
+            State &s = state();
+            ++s.calls[slot];
+            ++s.totalCalls;
+            s.stateChanges += s.changesState[slot];
+        }
+
+        inline bool changesState(const std::string &name) {
+            static const char *prefixes[] = {
+                    "glBind", "glUseProgram", "glActiveTexture", "glEnable", "glDisable", "glBlend", "glDepthFunc",
+                    "glDepthMask", "glDepthRange", "glColorMask", "glStencil", "glCullFace", "glFrontFace",
+                    "glPolygon", "glViewport", "glScissor", "glDrawBuffer", "glReadBuffer", "glClearColor",
+                    "glClearDepth", "glPixelStore", "glTexParameter", "glSamplerParameter", "glUniform",
+                    "glVertexAttribPointer", "glVertexAttribIPointer", "glVertexAttribDivisor"
+            };
+            for (const char *prefix : prefixes) {
+                if (name.compare(0, std::strlen(prefix), prefix) == 0)
+                    return true;
+            }
+            return false;
+        }
+
+        template<size_t Slot>
+        void* APIENTRY nothing() {
+            count(Slot);
+            return nullptr;
+        }
+
+        template<size_t... Slots>
+        void* nothingFor(size_t slot, std::index_sequence<Slots...>) {
+            static void *const stubs[] = {(void *) &nothing<Slots>...};
+            return stubs[slot];
+        }
+
+        // a stub of its own, counted in the given slot
+        template<size_t Slot, typename F, F stub>
+        struct Counted;
+
+        template<size_t Slot, typename R, typename... Args, R (APIENTRY *stub)(Args...)>
+        struct Counted<Slot, R (APIENTRY *)(Args...), stub> {
+            static R APIENTRY call(Args... args) {
+                count(Slot);
+                return stub(args...);
+            }
+        };
+
+        inline const GLubyte* APIENTRY getString(GLenum name) {
+            switch (name) {
+                case GL_VERSION:
+                    return (const GLubyte *) "3.3.0 Null";
+                case GL_SHADING_LANGUAGE_VERSION:
+                    return (const GLubyte *) "3.30";
+                case GL_RENDERER:
+                    return (const GLubyte *) "Null GL";
+                case GL_VENDOR:
+                    return (const GLubyte *) "rg";
+                default:
+                    return (const GLubyte *) "";
+            }
+        }
+
+        // glad needs at least one extension to count the load as a success
+        inline const GLubyte* APIENTRY getStringi(GLenum name, GLuint index) {
+            return (const GLubyte *) "GL_RG_null";
+        }
+
+        inline void APIENTRY getIntegerv(GLenum pname, GLint *data) {
+            switch (pname) {
+                case GL_VIEWPORT:
+                    std::memcpy(data, state().viewport, sizeof(state().viewport));
+                    return;
+                case GL_MAJOR_VERSION:
+                case GL_MINOR_VERSION:
+                    *data = 3;
+                    return;
+                case GL_NUM_EXTENSIONS:
+                    *data = 1;
+                    return;
+                case GL_MAX_SAMPLES:
+                case GL_MAX_COLOR_TEXTURE_SAMPLES:
+                case GL_MAX_DEPTH_TEXTURE_SAMPLES:
+                case GL_MAX_COLOR_ATTACHMENTS:
+                case GL_MAX_DRAW_BUFFERS:
+                    *data = 8;
+                    return;
+                case GL_MAX_TEXTURE_SIZE:
+                    *data = 16384;
+                    return;
+                default:
+                    *data = 0;
+            }
+        }
+
+        inline void APIENTRY getInteger64v(GLenum pname, GLint64 *data) {
+            *data = pname == GL_TIMESTAMP ? std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count() : 0;
+        }
+
+        inline void APIENTRY getFloatv(GLenum pname, GLfloat *data) {
+            *data = 0.0f;
+        }
+
+        inline void APIENTRY getBooleanv(GLenum pname, GLboolean *data) {
+            *data = GL_FALSE;
+        }
+
+        inline void APIENTRY viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+            GLint *v = state().viewport;
+            v[0] = x;
+            v[1] = y;
+            v[2] = width;
+            v[3] = height;
+        }
+
+        // glGenBuffers, glGenTextures and the other glGen* share this signature
+        inline void APIENTRY genNames(GLsizei n, GLuint *names) {
+            for (GLsizei i = 0; i < n; ++i)
+                names[i] = state().nextName++;
+        }
+
+        inline GLuint APIENTRY createShader(GLenum type) {
+            return state().nextName++;
+        }
+
+        inline GLuint APIENTRY createProgram() {
+            return state().nextName++;
+        }
+
+        // every compile, link and parallel compile has succeeded; no logs, no binaries
+        inline void APIENTRY getObjectiv(GLuint object, GLenum pname, GLint *params) {
+            *params = pname == GL_COMPILE_STATUS || pname == GL_LINK_STATUS || pname == GL_COMPLETION_STATUS_KHR
+                      ? GL_TRUE : 0;
+        }
+
+        inline void APIENTRY getInfoLog(GLuint object, GLsizei bufSize, GLsizei *length, GLchar *infoLog) {
+            if (length)
+                *length = 0;
+            if (infoLog && bufSize > 0)
+                infoLog[0] = '\0';
+        }
+
+        inline GLint APIENTRY getUniformLocation(GLuint program, const GLchar *name) {
+            return 0;
+        }
+
+        inline GLenum APIENTRY checkFramebufferStatus(GLenum target) {
+            return GL_FRAMEBUFFER_COMPLETE;
+        }
+
+        inline GLboolean APIENTRY isEnabled(GLenum cap) {
+            return GL_FALSE;
+        }
+
+        inline void APIENTRY getFramebufferAttachmentParameteriv(GLenum target, GLenum attachment, GLenum pname,
+                                                                GLint *params) {
+            *params = pname == GL_FRAMEBUFFER_ATTACHMENT_COLOR_ENCODING ? GL_LINEAR : 0;
+        }
+
+        // glGetTexParameteriv, glGetBufferParameteriv and the like
+        inline void APIENTRY getParameteriv(GLenum target, GLenum pname, GLint *params) {
+            *params = 0;
+        }
+
+        inline void APIENTRY getTexLevelParameteriv(GLenum target, GLint level, GLenum pname, GLint *params) {
+            *params = 0;
+        }
+
+        // the query results are always there, and every span took no time
+        inline void APIENTRY getQueryObjectiv(GLuint id, GLenum pname, GLint *params) {
+            *params = pname == GL_QUERY_RESULT_AVAILABLE ? 1 : 0;
+        }
+
+        inline void APIENTRY getQueryObjectuiv(GLuint id, GLenum pname, GLuint *params) {
+            *params = pname == GL_QUERY_RESULT_AVAILABLE ? 1 : 0;
+        }
+
+        inline void APIENTRY getQueryObjecti64v(GLuint id, GLenum pname, GLint64 *params) {
+            *params = pname == GL_QUERY_RESULT_AVAILABLE ? 1 : 0;
+        }
+
+        inline void APIENTRY getQueryObjectui64v(GLuint id, GLenum pname, GLuint64 *params) {
+            *params = pname == GL_QUERY_RESULT_AVAILABLE ? 1 : 0;
+        }
+
+        inline GLsync APIENTRY fenceSync(GLenum condition, GLbitfield flags) {
+            return (GLsync) (uintptr_t) state().nextName++;
+        }
+
+        inline GLenum APIENTRY clientWaitSync(GLsync sync, GLbitfield flags, GLuint64 timeout) {
+            return GL_ALREADY_SIGNALED;
+        }
+
+        inline void APIENTRY getSynciv(GLsync sync, GLenum pname, GLsizei bufSize, GLsizei *length, GLint *values) {
+            if (length)
+                *length = 1;
+            if (bufSize > 0)
+                values[0] = pname == GL_SYNC_STATUS ? GL_SIGNALED : 0;
+        }
+
+        // scratch memory; what is written into it goes nowhere, what is read is zeros
+        inline void* APIENTRY mapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access) {
+            std::vector<char> &mapped = state().mapped;
+            if (mapped.size() < (size_t) length)
+                mapped.resize((size_t) length);
+            std::memset(mapped.data(), 0, (size_t) length);
+            return mapped.data();
+        }
+
+        inline void* APIENTRY mapBuffer(GLenum target, GLenum access) {
+            // the size isn't known here; the application only maps small buffers this way
+            return mapBufferRange(target, 0, 1 << 16, 0);
+        }
+
+        inline GLboolean APIENTRY unmapBuffer(GLenum target) {
+            return GL_TRUE;
+        }
+
+        // the loader glad and rg::loadGLExtensions are given
+        inline void* load(const char *name) {
+#define RG_NULLGL_STUB(slot, name, stub) {name, {slot, (void *) &Counted<slot, decltype(&stub), &stub>::call}}
+            static const std::unordered_map<std::string, std::pair<size_t, void *>> stubs = {
+                    RG_NULLGL_STUB(0, "glGetString", getString),
+                    RG_NULLGL_STUB(1, "glGetStringi", getStringi),
+                    RG_NULLGL_STUB(2, "glGetIntegerv", getIntegerv),
+                    RG_NULLGL_STUB(3, "glGetInteger64v", getInteger64v),
+                    RG_NULLGL_STUB(4, "glGetFloatv", getFloatv),
+                    RG_NULLGL_STUB(5, "glGetBooleanv", getBooleanv),
+                    RG_NULLGL_STUB(6, "glViewport", viewport),
+                    RG_NULLGL_STUB(7, "glGenBuffers", genNames),
+                    RG_NULLGL_STUB(8, "glGenVertexArrays", genNames),
+                    RG_NULLGL_STUB(9, "glGenTextures", genNames),
+                    RG_NULLGL_STUB(10, "glGenFramebuffers", genNames),
+                    RG_NULLGL_STUB(11, "glGenRenderbuffers", genNames),
+                    RG_NULLGL_STUB(12, "glGenQueries", genNames),
+                    RG_NULLGL_STUB(13, "glGenSamplers", genNames),
+                    RG_NULLGL_STUB(14, "glCreateShader", createShader),
+                    RG_NULLGL_STUB(15, "glCreateProgram", createProgram),
+                    RG_NULLGL_STUB(16, "glGetShaderiv", getObjectiv),
+                    RG_NULLGL_STUB(17, "glGetProgramiv", getObjectiv),
+                    RG_NULLGL_STUB(18, "glGetShaderInfoLog", getInfoLog),
+                    RG_NULLGL_STUB(19, "glGetProgramInfoLog", getInfoLog),
+                    RG_NULLGL_STUB(20, "glGetUniformLocation", getUniformLocation),
+                    RG_NULLGL_STUB(21, "glCheckFramebufferStatus", checkFramebufferStatus),
+                    RG_NULLGL_STUB(22, "glIsEnabled", isEnabled),
+                    RG_NULLGL_STUB(23, "glGetFramebufferAttachmentParameteriv", getFramebufferAttachmentParameteriv),
+                    RG_NULLGL_STUB(24, "glGetTexParameteriv", getParameteriv),
+                    RG_NULLGL_STUB(25, "glGetBufferParameteriv", getParameteriv),
+                    RG_NULLGL_STUB(26, "glGetRenderbufferParameteriv", getParameteriv),
+                    RG_NULLGL_STUB(27, "glGetTexLevelParameteriv", getTexLevelParameteriv),
+                    RG_NULLGL_STUB(28, "glGetQueryObjectiv", getQueryObjectiv),
+                    RG_NULLGL_STUB(29, "glGetQueryObjectuiv", getQueryObjectuiv),
+                    RG_NULLGL_STUB(30, "glGetQueryObjecti64v", getQueryObjecti64v),
+                    RG_NULLGL_STUB(31, "glGetQueryObjectui64v", getQueryObjectui64v),
+                    RG_NULLGL_STUB(32, "glFenceSync", fenceSync),
+                    RG_NULLGL_STUB(33, "glClientWaitSync", clientWaitSync),
+                    RG_NULLGL_STUB(34, "glGetSynciv", getSynciv),
+                    RG_NULLGL_STUB(35, "glMapBufferRange", mapBufferRange),
+                    RG_NULLGL_STUB(36, "glMapBuffer", mapBuffer),
+                    RG_NULLGL_STUB(37, "glUnmapBuffer", unmapBuffer),
+            };
+#undef RG_NULLGL_STUB
+            static_assert(38 <= FIRST_GENERIC_SLOT, "more stubs of their own than slots for them");
+            State &s = state();
+            auto it = stubs.find(name);
+            if (it != stubs.end()) {
+                s.names[it->second.first] = name;
+                s.changesState[it->second.first] = changesState(name);
+                return it->second.second;
+            }
+            // loaded again, e.g. by loadGLExtensions after glad; the last slot takes any overflow
+            auto known = s.slots.find(name);
+            size_t slot = known != s.slots.end() ? known->second : std::min(s.nextSlot++, MAX_ENTRY_POINTS - 1);
+            if (known == s.slots.end() && slot < MAX_ENTRY_POINTS - 1) {
+                s.slots[name] = slot;
+                s.names[slot] = name;
+                s.changesState[slot] = changesState(name);
+            } else if (known == s.slots.end()) {
+                s.names[slot] = "(others)";
+            }
+            return nothingFor(slot, std::make_index_sequence<MAX_ENTRY_POINTS>());
+        }
+
+    }
+
+    // points every GL entry point at the null implementation; no context needed
+    inline bool loadNullGL() {
+        if (!gladLoadGLLoader((GLADloadproc) nullgl::load))
+            return false;
+        loadGLExtensions((GLADloadproc) nullgl::load);
+        return true;
+    }
+
+    // calls through the null GL since the last reset
+    inline unsigned long long nullGLCalls() {
+        return nullgl::state().totalCalls;
+    }
+
+    // of those, the ones that change state
+    inline unsigned long long nullGLStateChanges() {
+        return nullgl::state().stateChanges;
+    }
+
+    // calls per entry point since the last reset, most called first; those not called are left out
+    inline std::vector<std::pair<std::string, unsigned long long>> nullGLCallsByEntryPoint() {
+        const nullgl::State &s = nullgl::state();
+        std::vector<std::pair<std::string, unsigned long long>> result;
+        for (size_t slot = 0; slot < nullgl::MAX_ENTRY_POINTS; ++slot) {
+            if (s.calls[slot])
+                result.emplace_back(s.names[slot], s.calls[slot]);
+        }
+        std::stable_sort(result.begin(), result.end(), [](const std::pair<std::string, unsigned long long> &a,
+                                                          const std::pair<std::string, unsigned long long> &b) {
+            return a.second > b.second;
+        });
+        return result;
+    }
+
+    inline void resetNullGLCalls() {
+        nullgl::State &s = nullgl::state();
+        std::fill(std::begin(s.calls), std::end(s.calls), 0ull);
+        s.totalCalls = 0;
+        s.stateChanges = 0;
+    }
+
+};
+#endif //PROJECT_BASE_NULLGL_H
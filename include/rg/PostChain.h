@@ -0,0 +1,400 @@
+#ifndef PROJECT_BASE_POSTCHAIN_H
+#define PROJECT_BASE_POSTCHAIN_H
+
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <learnopengl/shader.h>
+#include <rg/AutoExposure.h>
+#include <rg/Bloom.h>
+#include <rg/ColorGrading.h>
+#include <rg/FrameGraph.h>
+#include <rg/GpuTimer.h>
+#include <rg/ShaderVariants.h>
+#include <rg/TemporalAA.h>
+
+namespace rg {
+
+    // what the passes after the scene do this frame, copied from the program's settings
+    struct PostSettings {
+        // the targets' size, and the bottom-left part of them the scene was rendered to
+        unsigned int width = 0;
+        unsigned int height = 0;
+        unsigned int renderWidth = 0;
+        unsigned int renderHeight = 0;
+        GLenum hdrFormat = GL_RGBA16F;
+        // above one the scene colour is resolved into hdrColor first, by a blit or by the
+        // tonemap-aware resolve shader
+        unsigned int sceneSamples = 1;
+        bool blitResolve = true;
+        bool temporalAA = false;
+        bool fxaa = false;
+        // the edge-adaptive upscale of the rendered part to the full targets
+        bool upscale = false;
+        bool tonemap = true;
+        bool autoExposure = false;
+        bool bloom = false;
+        Bloom::Mode bloomMode = Bloom::MIP_CHAIN;
+        float bloomThreshold = 1.0f;
+        // the adapted exposure under auto exposure, the manual one otherwise
+        float exposure = 1.0f;
+        // sRGB writes encoded by the hardware; otherwise the post shader applies gamma
+        bool hardwareEncoding = true;
+        float gamma = 2.2f;
+        ColorGradingSettings grading;
+        // this frame's jittered view-projection and the unjittered one TAA reprojects through
+        glm::mat4 viewProjection = glm::mat4(1.0f);
+        glm::mat4 unjitteredViewProjection = glm::mat4(1.0f);
+    };
+
+    // The passes from the lit HDR scene to the back buffer: MSAA resolve, TAA, upscale, the
+    // luminance measurement, bloom, the post pass (bloom composite, tonemap, encoding and
+    // grading) and FXAA. addPasses() declares the ones the settings call for in the frame
+    // graph; they run, and are timed, when the graph is executed.
+    class PostChain {
+    public:
+        // post shader permutation bits, in the order of the feature names given to m_PostShaders
+        enum Feature {
+            HDR_FEATURE = 1 << 0,
+            BLOOM_FEATURE = 1 << 1,
+            COLOR_GRADING_FEATURE = 1 << 2,
+            MANUAL_GAMMA_FEATURE = 1 << 3
+        };
+
+        // quadVAO: the screen quad as a triangle strip of four vertices, owned by the caller
+        explicit PostChain(unsigned int quadVAO)
+                : m_PostShaders("resources/shaders/post.vs", "resources/shaders/post.fs",
+                                {"HDR", "BLOOM", "COLOR_GRADING", "MANUAL_GAMMA"},
+                                [](Shader &shader) {
+                                    shader.setInt("scene", 0);
+                                    shader.setInt("bloomBlur", 1);
+                                    shader.setInt("colorGrading", 2);
+                                }),
+                  m_FxaaShaders("resources/shaders/hdr.vs", "resources/shaders/fxaa.fs", {"LINEAR_INPUT"},
+                                [](Shader &shader) {
+                                    shader.setInt("image", 0);
+                                }),
+                  m_MsaaResolveShader("resources/shaders/hdr.vs", "resources/shaders/msaaResolve.fs"),
+                  m_UpscaleShader("resources/shaders/hdr.vs", "resources/shaders/upscale.fs"),
+                  m_QuadVAO(quadVAO) {
+            m_MsaaResolveShader.whenReady([](Shader &shader) {
+                shader.setInt("scene", 0);
+            });
+            m_UpscaleShader.whenReady([](Shader &shader) {
+                shader.setInt("source", 0);
+            });
+            // post.vs makes its triangle from gl_VertexID, but core profile still wants a VAO bound
+            glGenVertexArrays(1, &m_EmptyVAO);
+        }
+
+        ~PostChain() {
+            glDeleteVertexArrays(1, &m_EmptyVAO);
+        }
+
+        PostChain(const PostChain&) = delete;
+        PostChain& operator=(const PostChain&) = delete;
+
+        // submits every post shader permutation, see ShaderVariants::warmAll
+        void warmAll() {
+            m_PostShaders.warmAll();
+        }
+
+        // finishes the warmed variants the driver is done with, see ShaderVariants::poll
+        void poll() {
+            m_PostShaders.poll();
+            m_FxaaShaders.poll();
+            m_Bloom.poll();
+        }
+
+        const ShaderVariants& postShaders() const {
+            return m_PostShaders;
+        }
+
+        // the jitter is set up before the scene is drawn, so TAA is driven from outside as well
+        TemporalAA& temporalAA() {
+            return m_TemporalAA;
+        }
+
+        // read back and adapted before the frame, see AutoExposure::update
+        AutoExposure& autoExposure() {
+            return m_AutoExposure;
+        }
+
+        // sceneColor is the lit scene, multisampled or not, and hdrColor its single-sample
+        // version (the same resource without MSAA); TAA reads sceneDepth
+        void addPasses(FrameGraph &graph, const PostSettings &settings, FrameGraph::Resource sceneColor,
+                       FrameGraph::Resource hdrColor, FrameGraph::Resource sceneDepth,
+                       FrameGraph::Resource backbuffer) {
+            // the passes run later in the frame, they read the settings from here
+            m_Settings = settings;
+            if (m_Settings.sceneSamples > 1)
+                addResolvePass(graph, sceneColor, hdrColor);
+
+            // what bloom and the tonemap read: the resolved scene, or with TAA the new history
+            FrameGraph::Resource postInput = hdrColor;
+            if (m_Settings.temporalAA)
+                postInput = addTemporalAAPass(graph, hdrColor, sceneDepth);
+            // before bloom, so the whole post chain stays at output resolution
+            if (m_Settings.upscale)
+                postInput = addUpscalePass(graph, postInput);
+            // average scene luminance for the exposure a few frames from now; the tonemap uses the
+            // one adapted from earlier measurements, so nothing waits for this pass
+            if (m_Settings.autoExposure && m_Settings.tonemap)
+                addLuminancePass(graph, postInput);
+            addBloomPass(graph, postInput);
+
+            // FXAA works on the post pass's output, so it goes to an LDR target first then, an
+            // sRGB one when the encoding is left to the hardware
+            FrameGraph::Resource tonemapTarget = backbuffer;
+            if (m_Settings.fxaa)
+                tonemapTarget = graph.createTexture("ldrColor", TextureDesc(
+                        m_Settings.width, m_Settings.height, m_Settings.hardwareEncoding ? GL_SRGB8_ALPHA8 : GL_RGBA8));
+            m_ColorGrading.update(m_Settings.grading, m_Settings.hardwareEncoding);
+            addTonemapPass(graph, postInput, tonemapTarget);
+            estimatePostTraffic();
+            if (m_Settings.fxaa)
+                addFxaaPass(graph, tonemapTarget, backbuffer);
+        }
+
+        // GPU time of whichever of the MSAA resolve, TAA and FXAA passes ran
+        double antiAliasingMs() const {
+            return m_AntiAliasingTimer.averageMs();
+        }
+
+        double upscaleMs() const {
+            return m_UpscaleTimer.averageMs();
+        }
+
+        double luminanceMs() const {
+            return m_LuminanceTimer.averageMs();
+        }
+
+        double bloomMs() const {
+            return m_BloomTimer.averageMs();
+        }
+
+        double bloomMegabytes() const {
+            return m_Bloom.bytesPerFrame() / (1024.0 * 1024.0);
+        }
+
+        double postMs() const {
+            return m_PostTimer.averageMs();
+        }
+
+        // texels the post pass reads and writes, and what a separate grading pass would add
+        double postMegabytes() const {
+            return m_PostMegabytes;
+        }
+
+        double separateGradingMegabytes() const {
+            return m_SeparateGradingMegabytes;
+        }
+
+    private:
+        void addResolvePass(FrameGraph &graph, FrameGraph::Resource sceneColor, FrameGraph::Resource hdrColor) {
+            graph.addPass("Resolve", [=](FrameGraph::PassBuilder &pass) {
+                pass.read(sceneColor);
+                pass.write(hdrColor);
+            }, [this, sceneColor, hdrColor](const FrameGraph::PassContext &ctx) {
+                const PostSettings &s = m_Settings;
+                m_AntiAliasingTimer.begin();
+                if (s.blitResolve) {
+                    GLuint source = ctx.framebuffer({sceneColor}), destination = ctx.framebuffer({hdrColor});
+                    glBindFramebuffer(GL_READ_FRAMEBUFFER, source);
+                    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, destination);
+                    glBlitFramebuffer(0, 0, s.renderWidth, s.renderHeight, 0, 0, s.renderWidth, s.renderHeight,
+                                      GL_COLOR_BUFFER_BIT, GL_NEAREST);
+                } else {
+                    ctx.bindTarget({hdrColor});
+                    glViewport(0, 0, s.renderWidth, s.renderHeight);
+                    m_MsaaResolveShader.use();
+                    m_MsaaResolveShader.setInt("samples", s.sceneSamples);
+                    glActiveTexture(GL_TEXTURE0);
+                    glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, ctx.texture(sceneColor));
+                    drawQuad();
+                }
+                m_AntiAliasingTimer.end();
+            });
+        }
+
+        FrameGraph::Resource addTemporalAAPass(FrameGraph &graph, FrameGraph::Resource hdrColor,
+                                               FrameGraph::Resource sceneDepth) {
+            // the history stays RGBA16F, see TemporalAA
+            TextureDesc historyDesc(m_Settings.width, m_Settings.height, GL_RGBA16F);
+            FrameGraph::Resource history = graph.importTexture("taaHistory", m_TemporalAA.historyTexture(),
+                                                               historyDesc);
+            FrameGraph::Resource output = graph.importTexture("taaOutput", m_TemporalAA.outputTexture(),
+                                                              historyDesc);
+            graph.addPass("TAA", [=](FrameGraph::PassBuilder &pass) {
+                pass.read(hdrColor);
+                pass.read(sceneDepth);
+                pass.read(history);
+                pass.write(output);
+            }, [this, hdrColor, sceneDepth](const FrameGraph::PassContext &ctx) {
+                m_AntiAliasingTimer.begin();
+                m_TemporalAA.resolve(ctx.texture(hdrColor), ctx.texture(sceneDepth), m_QuadVAO,
+                                     m_Settings.viewProjection, m_Settings.unjitteredViewProjection);
+                m_AntiAliasingTimer.end();
+            });
+            return output;
+        }
+
+        FrameGraph::Resource addUpscalePass(FrameGraph &graph, FrameGraph::Resource source) {
+            FrameGraph::Resource upscaled = graph.createTexture(
+                    "upscaled", TextureDesc(m_Settings.width, m_Settings.height, m_Settings.hdrFormat));
+            graph.addPass("Upscale", [=](FrameGraph::PassBuilder &pass) {
+                pass.read(source);
+                pass.write(upscaled);
+            }, [this, source, upscaled](const FrameGraph::PassContext &ctx) {
+                const PostSettings &s = m_Settings;
+                m_UpscaleTimer.begin();
+                ctx.bindTarget({upscaled});
+                m_UpscaleShader.use();
+                m_UpscaleShader.setVec2("renderSize", (float) s.renderWidth, (float) s.renderHeight);
+                m_UpscaleShader.setVec2("outputSize", (float) s.width, (float) s.height);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, ctx.texture(source));
+                drawQuad();
+                m_UpscaleTimer.end();
+            });
+            return upscaled;
+        }
+
+        void addLuminancePass(FrameGraph &graph, FrameGraph::Resource postInput) {
+            FrameGraph::Resource luminance = graph.importTexture(
+                    "logLuminance", m_AutoExposure.texture(),
+                    TextureDesc(AutoExposure::SIZE, AutoExposure::SIZE, GL_R16F));
+            graph.addPass("Luminance", [=](FrameGraph::PassBuilder &pass) {
+                pass.read(postInput);
+                pass.write(luminance);
+            }, [this, postInput](const FrameGraph::PassContext &ctx) {
+                m_LuminanceTimer.begin();
+                m_AutoExposure.measure(ctx.texture(postInput), m_QuadVAO);
+                m_LuminanceTimer.end();
+            });
+        }
+
+        // declared whether bloom is on or not; the whole stage is culled, not just its result,
+        // when it is off, as nothing reads it then
+        void addBloomPass(FrameGraph &graph, FrameGraph::Resource postInput) {
+            m_BloomTargets.clear();
+            for (const auto &size : Bloom::targetSizes(m_Settings.width, m_Settings.height, m_Settings.bloomMode))
+                m_BloomTargets.push_back(graph.createTexture("bloom", TextureDesc(size.first, size.second,
+                                                                                   m_Settings.hdrFormat)));
+            graph.addPass("Bloom", [this, postInput](FrameGraph::PassBuilder &pass) {
+                pass.read(postInput);
+                for (FrameGraph::Resource target : m_BloomTargets)
+                    pass.write(target);
+            }, [this, postInput](const FrameGraph::PassContext &ctx) {
+                std::vector<Bloom::Target> targets;
+                for (FrameGraph::Resource target : m_BloomTargets)
+                    targets.push_back({ctx.framebuffer({target}), ctx.texture(target), ctx.desc(target).width,
+                                       ctx.desc(target).height, (unsigned int) ctx.desc(target).bytesPerTexel()});
+                m_BloomTimer.begin();
+                m_Bloom.render(ctx.texture(postInput), ctx.desc(postInput).width, ctx.desc(postInput).height,
+                               (unsigned int) ctx.desc(postInput).bytesPerTexel(), m_QuadVAO, m_Settings.bloomMode,
+                               m_Settings.bloomThreshold, targets);
+                m_BloomTimer.end();
+            });
+        }
+
+        // one pass from the HDR image to display colours: bloom composite, tonemap, encoding
+        // and grading
+        void addTonemapPass(FrameGraph &graph, FrameGraph::Resource postInput, FrameGraph::Resource target) {
+            FrameGraph::Resource bloom = m_Settings.bloom ? m_BloomTargets[0] : -1;
+            graph.addPass("Post", [=](FrameGraph::PassBuilder &pass) {
+                pass.read(postInput);
+                pass.read(bloom);
+                pass.write(target);
+            }, [this, postInput, bloom, target](const FrameGraph::PassContext &ctx) {
+                const PostSettings &s = m_Settings;
+                m_PostTimer.begin();
+                ctx.bindTarget({target});
+                bool grading = !s.grading.isIdentity();
+                Shader &postShader = m_PostShaders.get((s.tonemap ? HDR_FEATURE : 0) | (s.bloom ? BLOOM_FEATURE : 0)
+                                                       | (grading ? COLOR_GRADING_FEATURE : 0)
+                                                       | (s.hardwareEncoding ? 0 : MANUAL_GAMMA_FEATURE));
+                postShader.use();
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, ctx.texture(postInput));
+                glActiveTexture(GL_TEXTURE1);
+                glBindTexture(GL_TEXTURE_2D, s.bloom ? ctx.texture(bloom) : 0);
+                glActiveTexture(GL_TEXTURE2);
+                glBindTexture(GL_TEXTURE_3D, m_ColorGrading.texture());
+                glActiveTexture(GL_TEXTURE0);
+                postShader.setFloat("exposure", s.exposure);
+                postShader.setFloat("bloomIntensity", m_Bloom.intensity(s.bloomMode));
+                postShader.setFloat("gamma", s.gamma);
+
+                // every pixel is written, so nothing is cleared; the backbuffer's depth isn't either
+                glDisable(GL_DEPTH_TEST);
+                glBindVertexArray(m_EmptyVAO);
+                glDrawArrays(GL_TRIANGLES, 0, 3);
+                glBindVertexArray(0);
+                glEnable(GL_DEPTH_TEST);
+                m_PostTimer.end();
+            });
+        }
+
+        void addFxaaPass(FrameGraph &graph, FrameGraph::Resource source, FrameGraph::Resource backbuffer) {
+            graph.addPass("FXAA", [=](FrameGraph::PassBuilder &pass) {
+                pass.read(source);
+                pass.write(backbuffer);
+            }, [this, source, backbuffer](const FrameGraph::PassContext &ctx) {
+                m_AntiAliasingTimer.begin();
+                ctx.bindTarget({backbuffer});
+                Shader &fxaaShader = m_FxaaShaders.get(m_Settings.hardwareEncoding ? 1 : 0);
+                fxaaShader.use();
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, ctx.texture(source));
+                glDisable(GL_DEPTH_TEST);
+                drawQuad();
+                glEnable(GL_DEPTH_TEST);
+                m_AntiAliasingTimer.end();
+            });
+        }
+
+        // a separate grading/encoding pass, as in the old tonemap-then-antialias chain, would
+        // add a full-screen RGBA8 write and read
+        void estimatePostTraffic() {
+            const PostSettings &s = m_Settings;
+            size_t pixels = (size_t) s.width * s.height;
+            // the input is the TAA history unless the upscale wrote a new target after it
+            bool historyInput = s.temporalAA && !s.upscale;
+            size_t bytes = pixels * TextureDesc(1, 1, historyInput ? GL_RGBA16F : s.hdrFormat).bytesPerTexel()
+                           + pixels * 4;
+            if (s.bloom)
+                bytes += TextureDesc(s.width / 2, s.height / 2, s.hdrFormat).bytes();
+            m_PostMegabytes = bytes / (1024.0 * 1024.0);
+            m_SeparateGradingMegabytes = pixels * 4 * 2 / (1024.0 * 1024.0);
+        }
+
+        void drawQuad() const {
+            glBindVertexArray(m_QuadVAO);
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            glBindVertexArray(0);
+        }
+
+        ShaderVariants m_PostShaders;
+        ShaderVariants m_FxaaShaders;
+        Shader m_MsaaResolveShader;
+        Shader m_UpscaleShader;
+        TemporalAA m_TemporalAA;
+        AutoExposure m_AutoExposure;
+        Bloom m_Bloom;
+        ColorGrading m_ColorGrading;
+        unsigned int m_QuadVAO;
+        unsigned int m_EmptyVAO = 0;
+        GpuTimer m_AntiAliasingTimer;
+        GpuTimer m_UpscaleTimer;
+        GpuTimer m_LuminanceTimer;
+        GpuTimer m_BloomTimer;
+        GpuTimer m_PostTimer;
+        PostSettings m_Settings;
+        std::vector<FrameGraph::Resource> m_BloomTargets;
+        double m_PostMegabytes = 0.0;
+        double m_SeparateGradingMegabytes = 0.0;
+    };
+
+};
+#endif //PROJECT_BASE_POSTCHAIN_H
@@ -0,0 +1,371 @@
+#ifndef PROJECT_BASE_PROFILER_H
+#define PROJECT_BASE_PROFILER_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <glad/glad.h>
+#include <rg/GpuQuery.h>
+#include <rg/Trace.h>
+
+namespace rg {
+
+    // Named CPU and GPU scopes, with rolling percentiles over the last HISTORY frames.
+    // A scope's CPU time comes from steady_clock. Its GPU time comes from a pair of
+    // GL_TIMESTAMP counters, which, unlike GL_TIME_ELAPSED, may nest and overlap the
+    // GpuTimers. Each frame's counters are read LATENCY frames later, and only if the last
+    // one is available by then, so reading them never stalls; a late frame just loses its
+    // GPU sample. A scope entered several times in a frame (every tree drawn with the same
+    // Model, say) gets the sum as that frame's sample.
+    // While the tracer records, every scope also goes into the trace, the GPU ones shifted
+    // onto the CPU timeline by a GL_TIMESTAMP read at the start of their frame. Recording
+    // turns the profiler on even if it was switched off.
+    // A counter, such as the null GL's state changes, can be attached as well. Every scope
+    // then also gets the counter's increase over its frame, in the same way as its CPU time.
+    class Profiler {
+    public:
+        static const int LATENCY = GpuQuery::LATENCY;
+        static const int HISTORY = 240;
+
+        struct Percentiles {
+            double p50 = 0.0;
+            double p95 = 0.0;
+            double p99 = 0.0;
+        };
+
+        struct ScopeStats {
+            std::string name;
+            // nesting depth the first time it was entered, for indenting
+            int depth;
+            Percentiles cpuMs;
+            Percentiles gpuMs;
+            bool hasGpu;
+        };
+
+        Profiler() = default;
+
+        ~Profiler() {
+            shutdown();
+        }
+
+        // deletes the queries; the instance is a static that outlives the context, so this
+        // has to run before the context goes. A later frame creates new ones.
+        void shutdown() {
+            for (FrameQueries &frame : m_Frames) {
+                if (!frame.queries.empty())
+                    glDeleteQueries((GLsizei) frame.queries.size(), frame.queries.data());
+                frame.queries.clear();
+                frame.used = 0;
+                frame.records.clear();
+            }
+        }
+
+        Profiler(const Profiler&) = delete;
+        Profiler& operator=(const Profiler&) = delete;
+
+        // id of the scope with this name, created on first use; callers on hot paths keep it
+        int scope(const std::string &name) {
+            auto it = m_Ids.find(name);
+            if (it != m_Ids.end())
+                return it->second;
+            Scope scope;
+            scope.name = name;
+            scope.traceName = tracer().intern(name);
+            m_Scopes.push_back(scope);
+            int id = (int) m_Scopes.size() - 1;
+            m_Ids[name] = id;
+            return id;
+        }
+
+        // takes effect at the next beginFrame(), so no frame has unbalanced scopes
+        void setEnabled(bool enabled) {
+            m_RequestEnabled = enabled;
+        }
+
+        bool enabled() const {
+            return m_Enabled;
+        }
+
+        // a running total to sample at every begin() and end(), nullptr for none
+        void setCounter(unsigned long long (*counter)()) {
+            m_Counter = counter;
+        }
+
+        int scopeCount() const {
+            return (int) m_Scopes.size();
+        }
+
+        const std::string& scopeName(int id) const {
+            return m_Scopes[id].name;
+        }
+
+        // how much the counter went up in the scope during the last frame, -1 if it wasn't entered
+        long long frameCount(int id) const {
+            return m_Scopes[id].lastCount;
+        }
+
+        void beginFrame() {
+            Clock::time_point now = Clock::now();
+            if (m_Enabled && m_FrameStarted)
+                push(m_FrameTimes, m_FrameTimeCursor, msBetween(m_FrameStart, now));
+            m_FrameStart = now;
+            m_FrameStarted = true;
+            m_Enabled = m_RequestEnabled || tracer().recording();
+            if (!m_Enabled)
+                return;
+
+            FrameQueries &frame = m_Frames[m_Frame % LATENCY];
+            if (!frame.records.empty())
+                collect(frame);
+            frame.records.clear();
+            frame.used = 0;
+            frame.traced = tracer().recording();
+            if (frame.traced) {
+                GLint64 gpuNow = 0;
+                glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+                frame.gpuOffsetUs = tracer().now() - gpuNow / 1000;
+            }
+            begin(scope("Frame"));
+        }
+
+        void endFrame() {
+            if (!m_Enabled)
+                return;
+            end();
+            for (Scope &scope : m_Scopes) {
+                if (scope.enteredThisFrame)
+                    push(scope.cpuHistory, scope.cpuCursor, scope.cpuThisFrame);
+                scope.lastCount = scope.enteredThisFrame ? scope.countThisFrame : -1;
+                scope.enteredThisFrame = false;
+                scope.cpuThisFrame = 0.0f;
+                scope.countThisFrame = 0;
+            }
+            ++m_Frame;
+        }
+
+        void begin(int id, bool gpu = true) {
+            if (!m_Enabled)
+                return;
+            Scope &scope = m_Scopes[id];
+            if (!scope.enteredThisFrame && scope.depth < 0)
+                scope.depth = (int) m_Stack.size();
+            scope.enteredThisFrame = true;
+            Open open;
+            open.id = id;
+            open.record = -1;
+            if (gpu) {
+                FrameQueries &frame = m_Frames[m_Frame % LATENCY];
+                GpuRecord record;
+                record.id = id;
+                record.begin = query(frame);
+                record.end = query(frame);
+                glQueryCounter(record.begin, GL_TIMESTAMP);
+                frame.records.push_back(record);
+                open.record = (int) frame.records.size() - 1;
+                scope.hasGpu = true;
+            }
+            open.counterStart = m_Counter ? m_Counter() : 0;
+            m_Stack.push_back(open);
+            m_Stack.back().start = Clock::now();
+        }
+
+        void end() {
+            if (!m_Enabled || m_Stack.empty())
+                return;
+            Open open = m_Stack.back();
+            m_Stack.pop_back();
+            Clock::time_point now = Clock::now();
+            m_Scopes[open.id].cpuThisFrame += (float) msBetween(open.start, now);
+            if (m_Counter)
+                m_Scopes[open.id].countThisFrame += (long long) (m_Counter() - open.counterStart);
+            tracer().complete("cpu", m_Scopes[open.id].traceName, tracer().microseconds(open.start),
+                              tracer().microseconds(now));
+            if (open.record >= 0)
+                glQueryCounter(m_Frames[m_Frame % LATENCY].records[open.record].end, GL_TIMESTAMP);
+        }
+
+        // every scope seen so far, in the order they were first entered
+        std::vector<ScopeStats> stats() const {
+            std::vector<ScopeStats> stats;
+            for (const Scope &scope : m_Scopes) {
+                ScopeStats entry;
+                entry.name = scope.name;
+                entry.depth = std::max(scope.depth, 0);
+                entry.cpuMs = percentiles(scope.cpuHistory);
+                entry.gpuMs = percentiles(scope.gpuHistory);
+                entry.hasGpu = scope.hasGpu;
+                stats.push_back(entry);
+            }
+            return stats;
+        }
+
+        // wall time from one beginFrame() to the next, swap and event handling included
+        Percentiles frameTimeMs() const {
+            return percentiles(m_FrameTimes);
+        }
+
+        // frame time counts in buckets of bucketMs, the last bucket takes everything longer
+        std::vector<float> frameTimeHistogram(float bucketMs, int buckets) const {
+            std::vector<float> counts(buckets, 0.0f);
+            for (float ms : m_FrameTimes)
+                counts[std::min((int) (ms / bucketMs), buckets - 1)] += 1.0f;
+            return counts;
+        }
+
+        // GPU samples lost because their counters weren't back LATENCY frames later
+        long long lateFrames() const {
+            return m_LateFrames;
+        }
+
+    private:
+        typedef std::chrono::steady_clock Clock;
+
+        struct Scope {
+            std::string name;
+            const char *traceName = nullptr;
+            int depth = -1;
+            bool hasGpu = false;
+            bool enteredThisFrame = false;
+            float cpuThisFrame = 0.0f;
+            long long countThisFrame = 0;
+            long long lastCount = -1;
+            std::vector<float> cpuHistory;
+            std::vector<float> gpuHistory;
+            size_t cpuCursor = 0;
+            size_t gpuCursor = 0;
+        };
+
+        struct GpuRecord {
+            int id;
+            GLuint begin;
+            GLuint end;
+        };
+
+        // one frame's counters; the query objects are kept and reused
+        struct FrameQueries {
+            std::vector<GLuint> queries;
+            size_t used = 0;
+            std::vector<GpuRecord> records;
+            // recorded while tracing; GPU nanoseconds / 1000 + offset is the trace's time base
+            bool traced = false;
+            long long gpuOffsetUs = 0;
+        };
+
+        struct Open {
+            int id;
+            int record;
+            unsigned long long counterStart;
+            Clock::time_point start;
+        };
+
+        static double msBetween(Clock::time_point from, Clock::time_point to) {
+            return std::chrono::duration<double, std::milli>(to - from).count();
+        }
+
+        // a ring of HISTORY samples once full
+        static void push(std::vector<float> &history, size_t &cursor, double value) {
+            if (history.size() < (size_t) HISTORY) {
+                history.push_back((float) value);
+                return;
+            }
+            history[cursor] = (float) value;
+            cursor = (cursor + 1) % HISTORY;
+        }
+
+        // nearest rank
+        static Percentiles percentiles(const std::vector<float> &history) {
+            Percentiles result;
+            if (history.empty())
+                return result;
+            std::vector<float> sorted(history);
+            std::sort(sorted.begin(), sorted.end());
+            auto rank = [&sorted](double p) {
+                size_t index = (size_t) std::ceil(p * sorted.size());
+                return (double) sorted[std::min(std::max(index, (size_t) 1), sorted.size()) - 1];
+            };
+            result.p50 = rank(0.50);
+            result.p95 = rank(0.95);
+            result.p99 = rank(0.99);
+            return result;
+        }
+
+        GLuint query(FrameQueries &frame) {
+            if (frame.used == frame.queries.size()) {
+                GLuint query;
+                glGenQueries(1, &query);
+                frame.queries.push_back(query);
+            }
+            return frame.queries[frame.used++];
+        }
+
+        void collect(FrameQueries &frame) {
+            // counters complete in order, the last one stands for all of them
+            GLint available = 0;
+            glGetQueryObjectiv(frame.records.back().end, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) {
+                ++m_LateFrames;
+                return;
+            }
+            std::vector<double> sums(m_Scopes.size(), -1.0);
+            for (const GpuRecord &record : frame.records) {
+                GLuint64 begin = 0, end = 0;
+                glGetQueryObjectui64v(record.begin, GL_QUERY_RESULT, &begin);
+                glGetQueryObjectui64v(record.end, GL_QUERY_RESULT, &end);
+                sums[record.id] = std::max(sums[record.id], 0.0) + (end - begin) / 1.0e6;
+                if (frame.traced)
+                    tracer().gpu(m_Scopes[record.id].traceName, (long long) (begin / 1000) + frame.gpuOffsetUs,
+                                 (long long) (end / 1000) + frame.gpuOffsetUs);
+            }
+            for (size_t id = 0; id < sums.size(); ++id) {
+                if (sums[id] >= 0.0)
+                    push(m_Scopes[id].gpuHistory, m_Scopes[id].gpuCursor, sums[id]);
+            }
+        }
+
+        std::vector<Scope> m_Scopes;
+        std::unordered_map<std::string, int> m_Ids;
+        std::vector<Open> m_Stack;
+        FrameQueries m_Frames[LATENCY];
+        long long m_Frame = 0;
+        long long m_LateFrames = 0;
+        bool m_Enabled = true;
+        bool m_RequestEnabled = true;
+        bool m_FrameStarted = false;
+        unsigned long long (*m_Counter)() = nullptr;
+        Clock::time_point m_FrameStart;
+        std::vector<float> m_FrameTimes;
+        size_t m_FrameTimeCursor = 0;
+    };
+
+    // the application's profiler; it creates its queries lazily, so it is safe to reach
+    // from anywhere once a context is current
+    inline Profiler& profiler() {
+        static Profiler instance;
+        return instance;
+    }
+
+    // times the enclosing block
+    class ProfileScope {
+    public:
+        explicit ProfileScope(int id, bool gpu = true) {
+            profiler().begin(id, gpu);
+        }
+
+        explicit ProfileScope(const char *name, bool gpu = true) {
+            Profiler &p = profiler();
+            p.begin(p.scope(name), gpu);
+        }
+
+        ~ProfileScope() {
+            profiler().end();
+        }
+
+        ProfileScope(const ProfileScope&) = delete;
+        ProfileScope& operator=(const ProfileScope&) = delete;
+    };
+
+};
+#endif //PROJECT_BASE_PROFILER_H
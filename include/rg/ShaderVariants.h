@@ -0,0 +1,92 @@
+#ifndef PROJECT_BASE_SHADERVARIANTS_H
+#define PROJECT_BASE_SHADERVARIANTS_H
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <learnopengl/shader.h>
+
+namespace rg {
+
+    // Compile-time permutations of one vertex/fragment pair. Bit i of a feature mask turns on
+    // "#define features[i]", so a branch on a uniform becomes an #ifdef the compiler can strip.
+    // Variants are compiled the first time they are asked for and kept for the rest of the run;
+    // warm() submits a batch up front so the driver can build them while the app keeps loading,
+    // and poll() finishes the ones the driver is done with, whether or not they were ever bound.
+    class ShaderVariants {
+    public:
+        ShaderVariants(std::string vertexPath, std::string fragmentPath, std::vector<std::string> features,
+                       std::function<void(Shader&)> setup = nullptr)
+                : m_VertexPath(std::move(vertexPath)), m_FragmentPath(std::move(fragmentPath)),
+                  m_Features(std::move(features)), m_Setup(std::move(setup)) {
+        }
+
+        Shader& get(unsigned int mask) {
+            auto it = m_Variants.find(mask);
+            if (it != m_Variants.end())
+                return *it->second;
+
+            std::vector<std::string> defines;
+            for (unsigned int i = 0; i < m_Features.size(); ++i) {
+                if (mask & (1u << i))
+                    defines.push_back(m_Features[i]);
+            }
+            std::unique_ptr<Shader> shader(new Shader(m_VertexPath.c_str(), m_FragmentPath.c_str(), defines));
+            // samplers and other constant uniforms live in the program, so each new variant needs them once
+            if (m_Setup)
+                shader->whenReady(m_Setup);
+            Shader& result = *shader;
+            m_Variants[mask] = std::move(shader);
+            return result;
+        }
+
+        // submits every listed variant without waiting on any of them
+        void warm(const std::vector<unsigned int> &masks) {
+            for (unsigned int mask : masks)
+                get(mask);
+        }
+
+        // all masks up to 1 << features, for shaders with only a handful of permutations
+        void warmAll() {
+            for (unsigned int mask = 0; mask < (1u << m_Features.size()); ++mask)
+                get(mask);
+        }
+
+        // finishes every variant that is ready: reports its errors, releases its stage objects
+        // and stores its binary. Binds the finished programs, so call it between passes.
+        // Without KHR_parallel_shader_compile everything counts as ready, and the first call
+        // waits for the whole batch.
+        size_t poll() {
+            size_t finished = 0;
+            for (auto &variant : m_Variants) {
+                if (variant.second->isPending() && variant.second->isReady()) {
+                    variant.second->finish();
+                    ++finished;
+                }
+            }
+            return finished;
+        }
+
+        size_t compiledCount() const {
+            return m_Variants.size();
+        }
+
+        size_t readyCount() const {
+            size_t ready = 0;
+            for (const auto &variant : m_Variants)
+                ready += variant.second->isReady() ? 1 : 0;
+            return ready;
+        }
+
+    private:
+        std::string m_VertexPath;
+        std::string m_FragmentPath;
+        std::vector<std::string> m_Features;
+        std::function<void(Shader&)> m_Setup;
+        std::map<unsigned int, std::unique_ptr<Shader>> m_Variants;
+    };
+
+};
+#endif //PROJECT_BASE_SHADERVARIANTS_H
@@ -0,0 +1,177 @@
+#ifndef PROJECT_BASE_TEMPORALAA_H
+#define PROJECT_BASE_TEMPORALAA_H
+
+#include <iostream>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <learnopengl/shader.h>
+#include <rg/MemoryTracker.h>
+
+namespace rg {
+
+    // Temporal anti-aliasing on the HDR scene. Every frame the projection is shifted by a
+    // sub-pixel Halton offset, and resolve() blends the new frame into a history that is
+    // reprojected through last frame's view-projection and clamped to the new frame's 3x3
+    // neighbourhood. The scene has no moving geometry, so the camera reprojection from
+    // depth stands in for motion vectors.
+    // The two history textures outlive the frame, so they are owned here and imported into
+    // the frame graph rather than taken from its pool. With dynamic resolution the scene only
+    // covers the bottom-left renderWidth x renderHeight of the targets, and so does the history.
+    // Unlike the other HDR targets the history stays RGBA16F: it is blended into itself every
+    // frame, and the 5- and 6-bit mantissas of R11F_G11F_B10F would let the colour drift.
+    class TemporalAA {
+    public:
+        static const unsigned int JITTER_PHASES = 8;
+
+        TemporalAA() : m_Resolve("resources/shaders/hdr.vs", "resources/shaders/taa.fs") {
+            m_Resolve.whenReady([](Shader &shader) {
+                shader.setInt("current", 0);
+                shader.setInt("history", 1);
+                shader.setInt("depth", 2);
+            });
+        }
+
+        ~TemporalAA() {
+            release();
+        }
+
+        TemporalAA(const TemporalAA&) = delete;
+        TemporalAA& operator=(const TemporalAA&) = delete;
+
+        // picks this frame's history pair, (re)allocating it for a new size, and returns the
+        // offset to add to projection[2][0] and projection[2][1]
+        glm::vec2 beginFrame(unsigned int width, unsigned int height, unsigned int renderWidth,
+                             unsigned int renderHeight) {
+            if (width != m_Width || height != m_Height) {
+                release();
+                allocate(width, height);
+            }
+            m_RenderWidth = renderWidth;
+            m_RenderHeight = renderHeight;
+            m_Current = 1 - m_Current;
+            m_Phase = (m_Phase + 1) % JITTER_PHASES;
+            // Halton(2, 3) in (-0.5, 0.5) pixels, then to clip space
+            glm::vec2 offset(halton(m_Phase + 1, 2) - 0.5f, halton(m_Phase + 1, 3) - 0.5f);
+            return glm::vec2(offset.x * 2.0f / renderWidth, offset.y * 2.0f / renderHeight);
+        }
+
+        // last frame's result, read by resolve()
+        GLuint historyTexture() const {
+            return m_Textures[1 - m_Current];
+        }
+
+        // this frame's result, written by resolve() and read by everything after it
+        GLuint outputTexture() const {
+            return m_Textures[m_Current];
+        }
+
+        // viewProjection is this frame's jittered one, it rebuilds the position from depth;
+        // unjittered is remembered to reproject the next frame's history
+        void resolve(GLuint scene, GLuint depth, unsigned int quadVAO, const glm::mat4 &viewProjection,
+                     const glm::mat4 &unjittered) {
+            GLint viewport[4];
+            glGetIntegerv(GL_VIEWPORT, viewport);
+            glBindFramebuffer(GL_FRAMEBUFFER, m_Framebuffers[m_Current]);
+            glViewport(0, 0, m_RenderWidth, m_RenderHeight);
+
+            m_Resolve.use();
+            m_Resolve.setMat4("inverseViewProjection", glm::inverse(viewProjection));
+            m_Resolve.setMat4("previousViewProjection", m_HistoryValid ? m_PreviousViewProjection : unjittered);
+            // the first frame after (re)allocation has nothing to blend with
+            m_Resolve.setFloat("historyWeight", m_HistoryValid ? HISTORY_WEIGHT : 0.0f);
+            m_Resolve.setVec2("renderSize", (float) m_RenderWidth, (float) m_RenderHeight);
+            // last frame's rect may have had another size
+            glm::vec2 previous = m_HistoryValid ? m_PreviousRenderSize
+                                                : glm::vec2((float) m_RenderWidth, (float) m_RenderHeight);
+            glm::vec2 size((float) m_Width, (float) m_Height);
+            m_Resolve.setVec2("historyScale", previous / size);
+            m_Resolve.setVec2("historyMax", (previous - 0.5f) / size);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, scene);
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, historyTexture());
+            glActiveTexture(GL_TEXTURE2);
+            glBindTexture(GL_TEXTURE_2D, depth);
+            glActiveTexture(GL_TEXTURE0);
+            glBindVertexArray(quadVAO);
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            glBindVertexArray(0);
+
+            glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+            m_PreviousViewProjection = unjittered;
+            m_PreviousRenderSize = glm::vec2((float) m_RenderWidth, (float) m_RenderHeight);
+            m_HistoryValid = true;
+        }
+
+        // frees the history, e.g. while another AA mode is selected
+        void release() {
+            if (m_Width == 0)
+                return;
+            glDeleteFramebuffers(2, m_Framebuffers);
+            glDeleteTextures(2, m_Textures);
+            memoryTracker().releaseTexture(m_Textures[0]);
+            memoryTracker().releaseTexture(m_Textures[1]);
+            m_Width = m_Height = 0;
+            m_HistoryValid = false;
+        }
+
+        size_t bytes() const {
+            return (size_t) m_Width * m_Height * BYTES_PER_TEXEL * 2;
+        }
+
+    private:
+        static const unsigned int BYTES_PER_TEXEL = 8;
+        // share of the history in the blend, about ten frames of accumulation
+        static constexpr float HISTORY_WEIGHT = 0.9f;
+
+        static float halton(unsigned int index, unsigned int base) {
+            float result = 0.0f, fraction = 1.0f;
+            while (index > 0) {
+                fraction /= base;
+                result += fraction * (index % base);
+                index /= base;
+            }
+            return result;
+        }
+
+        void allocate(unsigned int width, unsigned int height) {
+            m_Width = width;
+            m_Height = height;
+            glGenTextures(2, m_Textures);
+            glGenFramebuffers(2, m_Framebuffers);
+            for (int i = 0; i < 2; ++i) {
+                glBindTexture(GL_TEXTURE_2D, m_Textures[i]);
+                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
+                memoryTracker().texture(m_Textures[i], "TAA history", MemoryTracker::RENDER_TARGETS, GL_RGBA16F,
+                                        width, height);
+                // the reprojected history is read between texels
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+                glBindFramebuffer(GL_FRAMEBUFFER, m_Framebuffers[i]);
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_Textures[i], 0);
+                if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+                    std::cout << "ERROR::FRAMEBUFFER::TAA!" << std::endl;
+            }
+            glBindTexture(GL_TEXTURE_2D, 0);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            m_HistoryValid = false;
+        }
+
+        Shader m_Resolve;
+        GLuint m_Textures[2] = {0, 0};
+        GLuint m_Framebuffers[2] = {0, 0};
+        unsigned int m_Width = 0;
+        unsigned int m_Height = 0;
+        unsigned int m_RenderWidth = 0;
+        unsigned int m_RenderHeight = 0;
+        int m_Current = 0;
+        unsigned int m_Phase = 0;
+        bool m_HistoryValid = false;
+        glm::mat4 m_PreviousViewProjection = glm::mat4(1.0f);
+        glm::vec2 m_PreviousRenderSize;
+    };
+
+};
+#endif //PROJECT_BASE_TEMPORALAA_H
@@ -0,0 +1,151 @@
+#ifndef PROJECT_BASE_THREADPOOL_H
+#define PROJECT_BASE_THREADPOOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <rg/Trace.h>
+
+namespace rg {
+
+    // Fixed set of worker threads that live as long as the pool. parallelFor splits a range,
+    // runs the chunks on the workers and on the calling thread, and returns once all of them
+    // are done; submit() leaves a job to the workers and returns at once.
+    class ThreadPool {
+    public:
+        explicit ThreadPool(unsigned int workers = defaultWorkerCount()) {
+            for (unsigned int i = 0; i < workers; ++i)
+                m_Threads.emplace_back([this, i] {
+                    tracer().nameThread("Worker " + std::to_string(i + 1));
+                    workerLoop();
+                });
+        }
+
+        ~ThreadPool() {
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                m_Stop = true;
+            }
+            m_WakeUp.notify_all();
+            for (std::thread &thread : m_Threads)
+                thread.join();
+        }
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        static unsigned int defaultWorkerCount() {
+            unsigned int cores = std::thread::hardware_concurrency();
+            return cores > 1 ? cores - 1 : 0;
+        }
+
+        unsigned int workerCount() const {
+            return (unsigned int) m_Threads.size();
+        }
+
+        // fn(begin, end) is called for disjoint chunks covering [0, count); chunks are never
+        // smaller than minChunk so tiny ranges don't pay for waking threads up.
+        // The chunks aren't handed to particular threads: the calling thread and the workers
+        // that get to the call's jobs take the next one in turn, so the caller goes on with
+        // them rather than waiting while the workers are busy with something else, and a pool
+        // job may call parallelFor as well.
+        void parallelFor(size_t count, const std::function<void(size_t, size_t)> &fn, size_t minChunk = 1) {
+            if (count == 0)
+                return;
+            size_t maxChunks = std::max<size_t>(1, count / std::max<size_t>(1, minChunk));
+            size_t chunks = std::min<size_t>(m_Threads.size() + 1, maxChunks);
+            if (chunks == 1) {
+                fn(0, count);
+                return;
+            }
+
+            // a job may only start after the call has returned, so it keeps the shared part
+            // alive; it no longer finds a chunk by then and never touches fn
+            std::shared_ptr<ParallelFor> call(new ParallelFor);
+            call->fn = &fn;
+            call->count = count;
+            call->chunks = chunks;
+            call->chunkSize = (count + chunks - 1) / chunks;
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                for (size_t c = 1; c < chunks; ++c)
+                    m_Jobs.push_back([this, call] {
+                        runChunks(*call);
+                    });
+            }
+            m_WakeUp.notify_all();
+
+            runChunks(*call);
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_Done.wait(lock, [&call] { return call->finished == call->chunks; });
+        }
+
+        // fire and forget, the job has to synchronise its own results
+        void submit(std::function<void()> job) {
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                m_Jobs.push_back(std::move(job));
+            }
+            m_WakeUp.notify_one();
+        }
+
+    private:
+        struct ParallelFor {
+            const std::function<void(size_t, size_t)> *fn;
+            size_t count;
+            size_t chunks;
+            size_t chunkSize;
+            std::atomic<size_t> next{0};
+            // under the pool's mutex
+            size_t finished = 0;
+        };
+
+        void runChunks(ParallelFor &call) {
+            for (;;) {
+                size_t chunk = call.next.fetch_add(1);
+                if (chunk >= call.chunks)
+                    return;
+                size_t begin = chunk * call.chunkSize;
+                size_t end = std::min(call.count, begin + call.chunkSize);
+                if (begin < end) {
+                    TraceScope scope("job", "parallelFor");
+                    (*call.fn)(begin, end);
+                }
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                if (++call.finished == call.chunks)
+                    m_Done.notify_all();
+            }
+        }
+
+        void workerLoop() {
+            for (;;) {
+                std::function<void()> job;
+                {
+                    std::unique_lock<std::mutex> lock(m_Mutex);
+                    m_WakeUp.wait(lock, [this] { return m_Stop || !m_Jobs.empty(); });
+                    if (m_Stop && m_Jobs.empty())
+                        return;
+                    job = std::move(m_Jobs.front());
+                    m_Jobs.pop_front();
+                }
+                job();
+            }
+        }
+
+        std::vector<std::thread> m_Threads;
+        std::deque<std::function<void()>> m_Jobs;
+        std::mutex m_Mutex;
+        std::condition_variable m_WakeUp;
+        std::condition_variable m_Done;
+        bool m_Stop = false;
+    };
+
+};
+#endif //PROJECT_BASE_THREADPOOL_H
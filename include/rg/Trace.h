@@ -0,0 +1,251 @@
+#ifndef PROJECT_BASE_TRACE_H
+#define PROJECT_BASE_TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace rg {
+
+    // Records spans as Chrome trace events (chrome://tracing, ui.perfetto.dev). Every thread
+    // writes into a buffer of its own that only it appends to: an event is stored, then the
+    // count is published with a release store, so recording takes no lock and never waits.
+    // A full buffer drops further events and counts them. A buffer is set up, under a lock,
+    // the first time its thread records something. Names and details are kept as pointers,
+    // so they must be literals or come from intern().
+    // write() only reads what the counts have published, so other threads may go on
+    // recording meanwhile. start() doesn't touch the buffers either: it begins a new
+    // generation, each thread rewinds its own buffer the next time it records, and write()
+    // leaves out the buffers still on an older one. Pool jobs may run across a start().
+    class Tracer {
+    public:
+        static const size_t EVENTS_PER_THREAD = 1 << 16;
+        typedef std::chrono::steady_clock Clock;
+
+        Tracer() : m_Epoch(Clock::now()) {}
+
+        Tracer(const Tracer&) = delete;
+        Tracer& operator=(const Tracer&) = delete;
+
+        // the trace's time base: microseconds since the tracer was created
+        long long microseconds(Clock::time_point time) const {
+            return std::chrono::duration_cast<std::chrono::microseconds>(time - m_Epoch).count();
+        }
+
+        long long now() const {
+            return microseconds(Clock::now());
+        }
+
+        bool recording() const {
+            return m_Recording.load(std::memory_order_relaxed);
+        }
+
+        // throws away whatever an earlier recording left
+        void start() {
+            // not while write() reads; a thread that sees the new generation rewinds after it
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Generation.fetch_add(1, std::memory_order_release);
+            m_Recording.store(true, std::memory_order_release);
+        }
+
+        void stop() {
+            m_Recording.store(false, std::memory_order_release);
+        }
+
+        // a finished span on the calling thread
+        void complete(const char *category, const char *name, long long startUs, long long endUs,
+                      const char *detail = nullptr) {
+            if (recording())
+                append(threadBuffer(), m_Generation.load(std::memory_order_acquire), category, name, startUs, endUs,
+                       detail);
+        }
+
+        // a finished span on the GPU track; its times are already on the CPU timeline. Only the
+        // thread that owns the GL context calls this, so the track has a single writer too
+        void gpu(const char *name, long long startUs, long long endUs) {
+            if (recording())
+                append(gpuBuffer(), m_Generation.load(std::memory_order_acquire), "gpu", name, startUs, endUs,
+                       nullptr);
+        }
+
+        // a copy of text that lives as long as the tracer, one per distinct string
+        const char* intern(const std::string &text) {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            auto it = m_Strings.find(text);
+            if (it == m_Strings.end())
+                it = m_Strings.emplace(text, std::unique_ptr<std::string>(new std::string(text))).first;
+            return it->second->c_str();
+        }
+
+        // shown in the viewer for the calling thread's events; call before it records anything
+        void nameThread(const std::string &name) {
+            threadName() = name;
+        }
+
+        // stops recording and writes everything recorded as trace-event JSON
+        bool write(const std::string &path) {
+            stop();
+            std::ofstream out(path);
+            if (!out) {
+                std::cout << "ERROR::TRACE::WRITE_FAILED " << path << std::endl;
+                return false;
+            }
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            unsigned int generation = m_Generation.load(std::memory_order_relaxed);
+            out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+            bool first = true;
+            size_t events = 0, dropped = 0;
+            for (const std::unique_ptr<Buffer> &buffer : m_Buffers) {
+                out << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": "
+                    << buffer->id << ", \"args\": {\"name\": \"" << escape(buffer->name) << "\"}}";
+                first = false;
+                // a thread that hasn't recorded since start() still holds the last recording
+                if (buffer->generation.load(std::memory_order_acquire) != generation)
+                    continue;
+                size_t count = buffer->count.load(std::memory_order_acquire);
+                for (size_t i = 0; i < count; ++i) {
+                    const Event &event = buffer->events[i];
+                    out << ",\n{\"name\": \"" << escape(event.name) << "\", \"cat\": \"" << event.category
+                        << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << buffer->id << ", \"ts\": " << event.start
+                        << ", \"dur\": " << event.duration;
+                    if (event.detail)
+                        out << ", \"args\": {\"detail\": \"" << escape(event.detail) << "\"}";
+                    out << "}";
+                }
+                events += count;
+                dropped += buffer->dropped.load(std::memory_order_relaxed);
+            }
+            out << "\n]}\n";
+            std::cout << "TRACE:: " << events << " events from " << m_Buffers.size() << " threads written to "
+                      << path;
+            if (dropped)
+                std::cout << ", " << dropped << " dropped on full buffers";
+            std::cout << std::endl;
+            return true;
+        }
+
+    private:
+        struct Event {
+            const char *category;
+            const char *name;
+            const char *detail;
+            long long start;
+            long long duration;
+        };
+
+        struct Buffer {
+            int id;
+            std::string name;
+            std::unique_ptr<Event[]> events;
+            std::atomic<size_t> count{0};
+            // the recording count belongs to; published after the rewind
+            std::atomic<unsigned int> generation{0};
+            // only changed by the owning thread
+            std::atomic<size_t> dropped{0};
+        };
+
+        static std::string& threadName() {
+            static thread_local std::string name;
+            return name;
+        }
+
+        // only ever on the buffer's own thread, which is also the one to rewind it
+        static void append(Buffer &buffer, unsigned int generation, const char *category, const char *name,
+                           long long startUs, long long endUs, const char *detail) {
+            if (buffer.generation.load(std::memory_order_relaxed) != generation) {
+                buffer.count.store(0, std::memory_order_relaxed);
+                buffer.dropped.store(0, std::memory_order_relaxed);
+                buffer.generation.store(generation, std::memory_order_release);
+            }
+            size_t count = buffer.count.load(std::memory_order_relaxed);
+            if (count == EVENTS_PER_THREAD) {
+                buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            buffer.events[count] = Event{category, name, detail, startUs, endUs - startUs};
+            buffer.count.store(count + 1, std::memory_order_release);
+        }
+
+        Buffer& addBuffer(const std::string &name) {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            std::unique_ptr<Buffer> buffer(new Buffer);
+            buffer->id = (int) m_Buffers.size() + 1;
+            buffer->name = name.empty() ? "Thread " + std::to_string(buffer->id) : name;
+            buffer->events.reset(new Event[EVENTS_PER_THREAD]);
+            m_Buffers.push_back(std::move(buffer));
+            return *m_Buffers.back();
+        }
+
+        Buffer& threadBuffer() {
+            static thread_local Buffer *buffer = nullptr;
+            if (!buffer)
+                buffer = &addBuffer(threadName());
+            return *buffer;
+        }
+
+        Buffer& gpuBuffer() {
+            if (!m_GpuBuffer)
+                m_GpuBuffer = &addBuffer("GPU");
+            return *m_GpuBuffer;
+        }
+
+        static std::string escape(const std::string &text) {
+            std::string result;
+            for (char c : text) {
+                if (c == '"' || c == '\\')
+                    result += '\\';
+                result += c;
+            }
+            return result;
+        }
+
+        Clock::time_point m_Epoch;
+        std::atomic<bool> m_Recording{false};
+        // starts at 1, so that a new buffer counts as left over until its thread records
+        std::atomic<unsigned int> m_Generation{1};
+        std::mutex m_Mutex;
+        std::vector<std::unique_ptr<Buffer>> m_Buffers;
+        Buffer *m_GpuBuffer = nullptr;
+        std::unordered_map<std::string, std::unique_ptr<std::string>> m_Strings;
+    };
+
+    inline Tracer& tracer() {
+        static Tracer instance;
+        return instance;
+    }
+
+    // detail for a trace event, e.g. the file a load event read; interned only while recording
+    inline const char* traceDetail(const std::string &text) {
+        return tracer().recording() ? tracer().intern(text) : nullptr;
+    }
+
+    // traces the enclosing block on the calling thread, if it starts while recording
+    class TraceScope {
+    public:
+        TraceScope(const char *category, const char *name, const char *detail = nullptr)
+                : m_Category(category), m_Name(name), m_Detail(detail),
+                  m_Start(tracer().recording() ? tracer().now() : -1) {}
+
+        ~TraceScope() {
+            if (m_Start >= 0)
+                tracer().complete(m_Category, m_Name, m_Start, tracer().now(), m_Detail);
+        }
+
+        TraceScope(const TraceScope&) = delete;
+        TraceScope& operator=(const TraceScope&) = delete;
+
+    private:
+        const char *m_Category;
+        const char *m_Name;
+        const char *m_Detail;
+        long long m_Start;
+    };
+
+};
+#endif //PROJECT_BASE_TRACE_H
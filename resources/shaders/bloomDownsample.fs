@@ -0,0 +1,70 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D source;
+uniform vec2 sourceTexelSize;
+uniform float threshold;
+
+// 13 bilinear taps covering a 6x6 texel footprint of the level above, as five overlapping
+// 2x2 boxes (Jimenez, "Next Generation Post Processing in Call of Duty: Advanced Warfare").
+// PREFILTER is compiled in for the first level only: it reads the HDR scene, weights the
+// boxes by their brightness so single hot pixels don't flicker, and applies the threshold.
+
+float karisWeight(vec3 c)
+{
+    return 1.0 / (1.0 + max(c.r, max(c.g, c.b)));
+}
+
+vec3 softThreshold(vec3 c)
+{
+    float brightness = max(c.r, max(c.g, c.b));
+    float knee = threshold * 0.5;
+    float soft = clamp(brightness - threshold + knee, 0.0, 2.0 * knee);
+    soft = soft * soft / (4.0 * knee + 0.0001);
+    return c * max(soft, brightness - threshold) / max(brightness, 0.0001);
+}
+
+void main()
+{
+    vec2 t = sourceTexelSize;
+    vec3 a = texture(source, TexCoords + t * vec2(-2.0,  2.0)).rgb;
+    vec3 b = texture(source, TexCoords + t * vec2( 0.0,  2.0)).rgb;
+    vec3 c = texture(source, TexCoords + t * vec2( 2.0,  2.0)).rgb;
+    vec3 d = texture(source, TexCoords + t * vec2(-2.0,  0.0)).rgb;
+    vec3 e = texture(source, TexCoords).rgb;
+    vec3 f = texture(source, TexCoords + t * vec2( 2.0,  0.0)).rgb;
+    vec3 g = texture(source, TexCoords + t * vec2(-2.0, -2.0)).rgb;
+    vec3 h = texture(source, TexCoords + t * vec2( 0.0, -2.0)).rgb;
+    vec3 i = texture(source, TexCoords + t * vec2( 2.0, -2.0)).rgb;
+    vec3 j = texture(source, TexCoords + t * vec2(-1.0,  1.0)).rgb;
+    vec3 k = texture(source, TexCoords + t * vec2( 1.0,  1.0)).rgb;
+    vec3 l = texture(source, TexCoords + t * vec2(-1.0, -1.0)).rgb;
+    vec3 m = texture(source, TexCoords + t * vec2( 1.0, -1.0)).rgb;
+
+#ifdef PREFILTER
+    vec3 boxes[5] = vec3[](
+        (j + k + l + m) * 0.25,
+        (a + b + d + e) * 0.25,
+        (b + c + e + f) * 0.25,
+        (d + e + g + h) * 0.25,
+        (e + f + h + i) * 0.25);
+    float weights[5] = float[](0.5, 0.125, 0.125, 0.125, 0.125);
+    vec3 result = vec3(0.0);
+    float total = 0.0;
+    for (int box = 0; box < 5; ++box) {
+        float w = weights[box] * karisWeight(boxes[box]);
+        result += boxes[box] * w;
+        total += w;
+    }
+    result = softThreshold(result / total);
+#else
+    vec3 result = e * 0.125;
+    result += (a + c + g + i) * 0.03125;
+    result += (b + d + f + h) * 0.0625;
+    result += (j + k + l + m) * 0.125;
+#endif
+
+    FragColor = vec4(max(result, vec3(0.0)), 1.0);
+}
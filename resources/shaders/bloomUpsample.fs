@@ -0,0 +1,23 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D source;
+uniform vec2 sourceTexelSize;
+
+// 3x3 tent over the smaller level, blended additively onto the larger one
+void main()
+{
+    vec2 t = sourceTexelSize;
+    vec3 result = texture(source, TexCoords).rgb * 4.0;
+    result += texture(source, TexCoords + vec2(-t.x, 0.0)).rgb * 2.0;
+    result += texture(source, TexCoords + vec2( t.x, 0.0)).rgb * 2.0;
+    result += texture(source, TexCoords + vec2(0.0, -t.y)).rgb * 2.0;
+    result += texture(source, TexCoords + vec2(0.0,  t.y)).rgb * 2.0;
+    result += texture(source, TexCoords + vec2(-t.x, -t.y)).rgb;
+    result += texture(source, TexCoords + vec2( t.x, -t.y)).rgb;
+    result += texture(source, TexCoords + vec2(-t.x,  t.y)).rgb;
+    result += texture(source, TexCoords + vec2( t.x,  t.y)).rgb;
+    FragColor = vec4(result / 16.0, 1.0);
+}
@@ -4,29 +4,26 @@ out vec4 FragColor;
 in vec2 TexCoords;
 
 uniform sampler2D image;
+uniform vec2 sourceTexelSize;
 
-uniform bool horizontal;
-uniform float weight[5] = float[] (0.2270270270, 0.1945945946, 0.1216216216, 0.0540540541, 0.0162162162);
+// HORIZONTAL is compiled in per variant
+// the 9-tap Gaussian (0.2270270270, 0.1945945946, 0.1216216216, 0.0540540541, 0.0162162162)
+// with each pair of neighbouring side taps merged into one bilinear fetch placed between them
+const float offsets[3] = float[] (0.0, 1.3846153846, 3.2307692308);
+const float weights[3] = float[] (0.2270270270, 0.3162162162, 0.0702702703);
 
 void main()
 {
-     vec2 tex_offset = 1.0 / textureSize(image, 0); // gets size of single texel
-     vec3 result = texture(image, TexCoords).rgb * weight[0];
-     if(horizontal)
+#ifdef HORIZONTAL
+     vec2 texelStep = vec2(sourceTexelSize.x, 0.0);
+#else
+     vec2 texelStep = vec2(0.0, sourceTexelSize.y);
+#endif
+     vec3 result = texture(image, TexCoords).rgb * weights[0];
+     for(int i = 1; i < 3; ++i)
      {
-         for(int i = 1; i < 5; ++i)
-         {
-            result += texture(image, TexCoords + vec2(tex_offset.x * i, 0.0)).rgb * weight[i];
-            result += texture(image, TexCoords - vec2(tex_offset.x * i, 0.0)).rgb * weight[i];
-         }
-     }
-     else
-     {
-         for(int i = 1; i < 5; ++i)
-         {
-             result += texture(image, TexCoords + vec2(0.0, tex_offset.y * i)).rgb * weight[i];
-             result += texture(image, TexCoords - vec2(0.0, tex_offset.y * i)).rgb * weight[i];
-         }
+        result += texture(image, TexCoords + texelStep * offsets[i]).rgb * weights[i];
+        result += texture(image, TexCoords - texelStep * offsets[i]).rgb * weights[i];
      }
      FragColor = vec4(result, 1.0);
-}
\ No newline at end of file
+}
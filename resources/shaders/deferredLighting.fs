@@ -0,0 +1,125 @@
+#version 330 core
+layout (location = 0) out vec4 FragColor;
+
+in vec2 TexCoords;
+
+struct DirLight {
+    vec3 direction;
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+uniform sampler2D gAlbedoSpec;
+uniform sampler2D gNormalShininess;
+uniform sampler2D gDepth;
+uniform mat4 inverseProjection;
+uniform mat4 inverseView;
+// size of the rendered area, smaller than the targets under dynamic resolution
+uniform vec2 renderSize;
+
+uniform DirLight dirLight;
+uniform vec3 viewPosition;
+
+// the same clustered light grid the forward path reads, see modelLightingShader.fs
+uniform samplerBuffer lightData;
+uniform usamplerBuffer lightClusters;
+uniform usamplerBuffer lightIndices;
+uniform uvec3 clusterDims;
+uniform vec2 clusterTileSize;
+uniform float clusterSliceScale;
+uniform float clusterSliceBias;
+
+// compiled in per variant: DIR_LIGHT, LOCAL_LIGHTS
+
+vec3 decodeNormal(vec2 encoded);
+vec3 CalculateLocalLight(int light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 albedo, float specularMap, float shininess);
+vec3 CalculateDirectLight(DirLight light, vec3 normal, vec3 viewDir, vec3 albedo, float specularMap, float shininess);
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gDepth, pixel, 0).r;
+    // nothing was drawn here, keep the skybox underneath
+    if (depth == 1.0)
+        discard;
+
+    vec2 uv = gl_FragCoord.xy / renderSize;
+    vec4 viewPos = inverseProjection * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+    viewPos /= viewPos.w;
+    vec3 fragPos = vec3(inverseView * viewPos);
+
+    vec4 albedoSpec = texelFetch(gAlbedoSpec, pixel, 0);
+    vec4 normalShininess = texelFetch(gNormalShininess, pixel, 0);
+    vec3 albedo = albedoSpec.rgb;
+    float specularMap = albedoSpec.a;
+    vec3 normal = decodeNormal(normalShininess.xy);
+    float shininess = normalShininess.z * 256.0;
+    vec3 viewDir = normalize(viewPosition - fragPos);
+
+    vec3 result = vec3(0.0);
+#ifdef DIR_LIGHT
+    result += CalculateDirectLight(dirLight, normal, viewDir, albedo, specularMap, shininess);
+#endif
+#ifdef LOCAL_LIGHTS
+    uvec2 tile = uvec2(gl_FragCoord.xy / clusterTileSize);
+    int slice = int(log(-viewPos.z) * clusterSliceScale - clusterSliceBias);
+    uint z = uint(clamp(slice, 0, int(clusterDims.z) - 1));
+    int cluster = int((z * clusterDims.y + min(tile.y, clusterDims.y - 1u)) * clusterDims.x + min(tile.x, clusterDims.x - 1u));
+    uvec2 lights = texelFetch(lightClusters, cluster).rg;
+    for (uint i = 0u; i < lights.y; ++i) {
+        int light = int(texelFetch(lightIndices, int(lights.x + i)).r);
+        result += CalculateLocalLight(light, normal, fragPos, viewDir, albedo, specularMap, shininess);
+    }
+#endif
+
+    FragColor = vec4(result, 1.0);
+}
+
+vec3 decodeNormal(vec2 encoded)
+{
+    encoded = encoded * 2.0 - 1.0;
+    vec3 n = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+vec3 CalculateLocalLight(int light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 albedo, float specularMap, float shininess)
+{
+    int base = light * 5;
+    vec4 positionConstant = texelFetch(lightData, base);
+    vec4 directionLinear = texelFetch(lightData, base + 1);
+    vec4 ambientQuadratic = texelFetch(lightData, base + 2);
+    vec4 diffuseCutOff = texelFetch(lightData, base + 3);
+    vec4 specularOuterCutOff = texelFetch(lightData, base + 4);
+
+    vec3 lightDir = normalize(positionConstant.xyz - fragPos);
+    float diff = max(dot(normal, lightDir), 0.0);
+
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(normal, halfwayDir), 0.0), shininess);
+
+    float distance = length(positionConstant.xyz - fragPos);
+    float attenuation = 1.0 / (positionConstant.w + directionLinear.w * distance + ambientQuadratic.w * (distance * distance));
+    float theta = dot(lightDir, normalize(-directionLinear.xyz));
+    float epsilon = diffuseCutOff.w - specularOuterCutOff.w;
+    float intensity = clamp((theta - specularOuterCutOff.w) / epsilon, 0.0, 1.0);
+
+    vec3 ambient = ambientQuadratic.rgb * albedo;
+    vec3 diffuse = diffuseCutOff.rgb * diff * albedo;
+    vec3 specular = specularOuterCutOff.rgb * spec * specularMap;
+    return (ambient + diffuse + specular) * attenuation * intensity;
+}
+
+vec3 CalculateDirectLight(DirLight light, vec3 normal, vec3 viewDir, vec3 albedo, float specularMap, float shininess)
+{
+    vec3 lightDir = normalize(-light.direction);
+    float diff = max(dot(normal, lightDir), 0.0);
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(normal, halfwayDir), 0.0), shininess);
+    vec3 ambient = light.ambient * albedo;
+    vec3 diffuse = light.diffuse * diff * albedo;
+    vec3 specular = light.specular * spec * specularMap;
+    return ambient + diffuse + specular;
+}
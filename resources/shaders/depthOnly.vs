@@ -0,0 +1,16 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+// the colour pass redraws with GL_EQUAL, so gl_Position has to come out bit-identical:
+// same expression as modelLightingShader.vs and gBuffer.vs, and invariant in all three
+invariant gl_Position;
+
+void main()
+{
+    vec3 worldPos = vec3(model * vec4(aPos, 1.0));
+    gl_Position = projection * (view * vec4(worldPos, 1.0));
+}
@@ -0,0 +1,56 @@
+#version 330 core
+out vec4 FragColor;
+
+uniform sampler2D image;
+
+// FXAA after Lottes' console version: estimate the edge direction from the four diagonal
+// neighbours, blur along it with two or four taps and keep the wider blur only if its
+// luma stays inside the local range. Runs on the tonemapped image.
+// LINEAR_INPUT: the image is an sRGB texture that samples as linear colour; the edge
+// thresholds are meant for perceptual luma, so it is brought back to roughly gamma 2.
+const float EDGE_THRESHOLD = 0.125;
+const float EDGE_THRESHOLD_MIN = 0.0312;
+const float REDUCE_MUL = 1.0 / 8.0;
+const float REDUCE_MIN = 1.0 / 128.0;
+const float SPAN_MAX = 8.0;
+
+float luma(vec3 color)
+{
+#ifdef LINEAR_INPUT
+    return sqrt(dot(color, vec3(0.299, 0.587, 0.114)));
+#else
+    return dot(color, vec3(0.299, 0.587, 0.114));
+#endif
+}
+
+void main()
+{
+    vec2 texel = 1.0 / vec2(textureSize(image, 0));
+    vec2 uv = gl_FragCoord.xy * texel;
+
+    vec3 rgbM = texture(image, uv).rgb;
+    float lumaNW = luma(texture(image, uv + vec2(-0.5, -0.5) * texel).rgb);
+    float lumaNE = luma(texture(image, uv + vec2(0.5, -0.5) * texel).rgb);
+    float lumaSW = luma(texture(image, uv + vec2(-0.5, 0.5) * texel).rgb);
+    float lumaSE = luma(texture(image, uv + vec2(0.5, 0.5) * texel).rgb);
+    float lumaM = luma(rgbM);
+
+    float lumaMin = min(lumaM, min(min(lumaNW, lumaNE), min(lumaSW, lumaSE)));
+    float lumaMax = max(lumaM, max(max(lumaNW, lumaNE), max(lumaSW, lumaSE)));
+    // flat areas, most of the screen, leave after five taps
+    if (lumaMax - lumaMin < max(EDGE_THRESHOLD_MIN, lumaMax * EDGE_THRESHOLD)) {
+        FragColor = vec4(rgbM, 1.0);
+        return;
+    }
+
+    vec2 dir = vec2(-((lumaNW + lumaNE) - (lumaSW + lumaSE)), (lumaNW + lumaSW) - (lumaNE + lumaSE));
+    float dirReduce = max((lumaNW + lumaNE + lumaSW + lumaSE) * 0.25 * REDUCE_MUL, REDUCE_MIN);
+    float rcpDirMin = 1.0 / (min(abs(dir.x), abs(dir.y)) + dirReduce);
+    dir = clamp(dir * rcpDirMin, vec2(-SPAN_MAX), vec2(SPAN_MAX)) * texel;
+
+    vec3 rgbA = 0.5 * (texture(image, uv + dir * (1.0 / 3.0 - 0.5)).rgb
+                       + texture(image, uv + dir * (2.0 / 3.0 - 0.5)).rgb);
+    vec3 rgbB = rgbA * 0.5 + 0.25 * (texture(image, uv - dir * 0.5).rgb + texture(image, uv + dir * 0.5).rgb);
+    float lumaB = luma(rgbB);
+    FragColor = vec4(lumaB < lumaMin || lumaB > lumaMax ? rgbA : rgbB, 1.0);
+}
@@ -0,0 +1,40 @@
+#version 330 core
+layout (location = 0) out vec4 gAlbedoSpec;
+layout (location = 1) out vec4 gNormalShininess;
+
+struct Material {
+    sampler2D texture_diffuse1;
+    sampler2D texture_specular1;
+
+    float shininess;
+};
+in vec2 TexCoords;
+in vec3 Normal;
+
+uniform Material material;
+
+// G-buffer layout:
+//  gAlbedoSpec       RGBA8    albedo.rgb, specular intensity
+//  gNormalShininess  RGB10A2  octahedral normal.xy, shininess / 256
+// position is not stored, deferredLighting.fs rebuilds it from the depth buffer
+
+vec2 octahedronWrap(vec2 v)
+{
+    return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec2 encodeNormal(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    n.xy = n.z >= 0.0 ? n.xy : octahedronWrap(n.xy);
+    return n.xy * 0.5 + 0.5;
+}
+
+void main()
+{
+    vec3 albedo = vec3(texture(material.texture_diffuse1, TexCoords));
+    float specular = texture(material.texture_specular1, TexCoords).r;
+
+    gAlbedoSpec = vec4(albedo, specular);
+    gNormalShininess = vec4(encodeNormal(normalize(Normal)), material.shininess / 256.0, 0.0);
+}
@@ -0,0 +1,23 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+
+out vec2 TexCoords;
+out vec3 Normal;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+// matches depthOnly.vs for the GL_EQUAL colour pass after a depth pre-pass
+invariant gl_Position;
+
+// same transforms as modelLightingShader.vs; world position is rebuilt from depth in the lighting pass
+void main()
+{
+    Normal = aNormal;
+    TexCoords = aTexCoords;
+    vec3 worldPos = vec3(model * vec4(aPos, 1.0));
+    gl_Position = projection * (view * vec4(worldPos, 1.0));
+}
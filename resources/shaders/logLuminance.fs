@@ -0,0 +1,28 @@
+#version 330 core
+out float FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D scene;
+
+// log2 of the scene luminance on a SIZE x SIZE grid; the mip chain of the target then
+// averages it down to one texel (see rg::AutoExposure). Four bilinear taps per cell, so
+// every output texel covers a good part of its share of the scene.
+const float SIZE = 256.0;
+// keeps log2 finite on black pixels, about 13 stops under 1.0
+const float MIN_LUMINANCE = 1.0 / 8192.0;
+
+float logLuminance(vec2 uv)
+{
+    vec3 color = texture(scene, uv).rgb;
+    return log2(max(dot(color, vec3(0.2126, 0.7152, 0.0722)), MIN_LUMINANCE));
+}
+
+void main()
+{
+    vec2 quarterCell = vec2(0.25 / SIZE);
+    FragColor = 0.25 * (logLuminance(TexCoords + vec2(-quarterCell.x, -quarterCell.y))
+                        + logLuminance(TexCoords + vec2(quarterCell.x, -quarterCell.y))
+                        + logLuminance(TexCoords + vec2(-quarterCell.x, quarterCell.y))
+                        + logLuminance(TexCoords + vec2(quarterCell.x, quarterCell.y)));
+}
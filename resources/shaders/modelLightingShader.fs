@@ -1,33 +1,5 @@
 #version 330 core
 layout (location = 0) out vec4 FragColor;
-layout (location = 1) out vec4 BrightColor;
-
-struct PointLight {
-    vec3 position;
-
-    vec3 specular;
-    vec3 diffuse;
-    vec3 ambient;
-
-    float constant;
-    float linear;
-    float quadratic;
-};
-
-struct SpotLight {
-    vec3 position;
-    vec3 direction;
-    float cutOff;
-    float outerCutOff;
-
-    float constant;
-    float linear;
-    float quadratic;
-
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
 
 struct Material {
     sampler2D texture_diffuse1;
@@ -38,6 +10,7 @@ struct Material {
 in vec2 TexCoords;
 in vec3 Normal;
 in vec3 FragPos;
+in float ViewDepth;
 
 struct DirLight {
     vec3 direction;
@@ -49,104 +22,99 @@ struct DirLight {
 
 
 
-uniform PointLight pointLight;
-uniform PointLight lampPointLight;
 uniform Material material;
 uniform DirLight dirLight;
-uniform SpotLight spotLight;
 
 uniform vec3 viewPosition;
 
-vec3 CalculatePointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
-vec3 CalculateDirectLight(DirLight light, vec3 normal, vec3 viewDir, vec3 FragPos);
-vec3 CalculateSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
+// point and spot lights come from the clustered light grid (see rg/LightGrid.h):
+// lightData holds 5 texels per light, lightClusters the (offset, count) of every cluster
+// and lightIndices the concatenated per-cluster light lists
+uniform samplerBuffer lightData;
+uniform usamplerBuffer lightClusters;
+uniform usamplerBuffer lightIndices;
+uniform uvec3 clusterDims;
+uniform vec2 clusterTileSize;
+uniform float clusterSliceScale;
+uniform float clusterSliceBias;
+
+// compiled in per variant: DIR_LIGHT, LOCAL_LIGHTS
+
+vec3 CalculateLocalLight(int light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 albedo, vec4 specularSample);
+vec3 CalculateDirectLight(DirLight light, vec3 normal, vec3 viewDir, vec3 albedo, vec3 specularMap);
 
 void main()
 {
 
     vec3 normal = normalize(Normal);
     vec3 viewDir = normalize(viewPosition - FragPos);
-
-
-    vec3 result = CalculateDirectLight(dirLight, normal, viewDir, FragPos);
-    result += CalculatePointLight(pointLight, normal, FragPos, viewDir);
-    result += CalculatePointLight(lampPointLight, normal, FragPos, viewDir);
-    result += CalculateSpotLight(spotLight, normal, FragPos, viewDir);
+    vec3 albedo = vec3(texture(material.texture_diffuse1, TexCoords));
+    vec4 specularSample = texture(material.texture_specular1, TexCoords);
+
+
+    vec3 result = vec3(0.0);
+#ifdef DIR_LIGHT
+    result += CalculateDirectLight(dirLight, normal, viewDir, albedo, specularSample.xxx);
+#endif
+#ifdef LOCAL_LIGHTS
+    uvec2 tile = uvec2(gl_FragCoord.xy / clusterTileSize);
+    int slice = int(log(ViewDepth) * clusterSliceScale - clusterSliceBias);
+    uint z = uint(clamp(slice, 0, int(clusterDims.z) - 1));
+    int cluster = int((z * clusterDims.y + min(tile.y, clusterDims.y - 1u)) * clusterDims.x + min(tile.x, clusterDims.x - 1u));
+    uvec2 lights = texelFetch(lightClusters, cluster).rg;
+    for (uint i = 0u; i < lights.y; ++i) {
+        int light = int(texelFetch(lightIndices, int(lights.x + i)).r);
+        result += CalculateLocalLight(light, normal, FragPos, viewDir, albedo, specularSample);
+    }
+#endif
 
 
     FragColor = vec4(result, 1.0);
-
-    float brightness = dot(FragColor.rgb, vec3(0.2126, 0.7152, 0.0722));
-        if (brightness > 1.0) {
-            BrightColor = vec4(0.0, 0.0, 0.0, 1.0);
-        } else {
-            BrightColor = vec4(0.0, 0.0, 0.0, 1.0);
-        }
-}
-vec3 CalculateSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
-{
-    vec3 lightDir = normalize(light.position - fragPos);
-    float diff = max(dot(normal, lightDir), 0.0);
-    vec3 normalNew = normalize(Normal);
-    vec3 halfwayDir = normalize(lightDir + viewDir);
-    float spec = pow(max(dot(normalNew, halfwayDir), 0.0), material.shininess);
-    float distance = length(light.position - fragPos);
-    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
-    float theta = dot(lightDir, normalize(-light.direction));
-    float epsilon = light.cutOff - light.outerCutOff;
-    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
-    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, TexCoords));
-    ambient *= attenuation * intensity;
-    diffuse *= attenuation * intensity;
-    specular *= attenuation * intensity;
-
-    return (ambient + diffuse + specular);
 }
 
-
-vec3 CalculatePointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
+// point lights are stored as spot lights with cutOff -1 and outerCutOff -2, which makes the cone factor 1.
+// As before the light grid, point lights take the specular map's red channel and spot lights all three
+vec3 CalculateLocalLight(int light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 albedo, vec4 specularSample)
 {
-    vec3 lightDir = normalize(light.position - fragPos);
-
-
+    int base = light * 5;
+    vec4 positionConstant = texelFetch(lightData, base);
+    vec4 directionLinear = texelFetch(lightData, base + 1);
+    vec4 ambientQuadratic = texelFetch(lightData, base + 2);
+    vec4 diffuseCutOff = texelFetch(lightData, base + 3);
+    vec4 specularOuterCutOff = texelFetch(lightData, base + 4);
+
+    vec3 lightDir = normalize(positionConstant.xyz - fragPos);
     float diff = max(dot(normal, lightDir), 0.0);
-    vec3 reflectDir = reflect(-lightDir, normal);
-
 
     //Blinn-Phongov model osvetljenja
     vec3 halfwayDir = normalize(lightDir + viewDir);
     float spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
 
-
-    //float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-    float distance = length(light.position - fragPos);
-    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
-
-    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, TexCoords).xxx);
-    ambient *= attenuation;
-    diffuse *= attenuation;
-    specular *= attenuation;
-    return (ambient + diffuse + specular);
+    float distance = length(positionConstant.xyz - fragPos);
+    float attenuation = 1.0 / (positionConstant.w + directionLinear.w * distance + ambientQuadratic.w * (distance * distance));
+    float theta = dot(lightDir, normalize(-directionLinear.xyz));
+    float epsilon = diffuseCutOff.w - specularOuterCutOff.w;
+    float intensity = clamp((theta - specularOuterCutOff.w) / epsilon, 0.0, 1.0);
+
+    vec3 ambient = ambientQuadratic.rgb * albedo;
+    vec3 diffuse = diffuseCutOff.rgb * diff * albedo;
+    vec3 specularMap = specularOuterCutOff.w < -1.5 ? specularSample.xxx : specularSample.rgb;
+    vec3 specular = specularOuterCutOff.rgb * spec * specularMap;
+    return (ambient + diffuse + specular) * attenuation * intensity;
 }
 
-vec3 CalculateDirectLight(DirLight light, vec3 normal, vec3 viewDir, vec3 FragPos)
+vec3 CalculateDirectLight(DirLight light, vec3 normal, vec3 viewDir, vec3 albedo, vec3 specularMap)
 {
     vec3 lightDir = normalize(-light.direction);
     float diff = max(dot(normal, lightDir), 0.0);
-    //vec3 reflectDir = reflect(-lightDir, normal);
-    vec3 normalNew = normalize(Normal);
     vec3 halfwayDir = normalize(lightDir+viewDir);
-    float spec = pow(max(dot(normalNew, halfwayDir), 0.0), material.shininess);
-    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, TexCoords).xxx);
+    float spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
+    vec3 ambient = light.ambient * albedo;
+    vec3 diffuse = light.diffuse * diff * albedo;
+    vec3 specular = light.specular * spec * specularMap;
 
     vec3 result = ambient + diffuse + specular;
 
 
     return (result);
-}
\ No newline at end of file
+}
@@ -6,15 +6,21 @@ layout (location = 2) in vec2 aTexCoords;
 out vec2 TexCoords;
 out vec3 Normal;
 out vec3 FragPos;
+out float ViewDepth;
 
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
+// matches depthOnly.vs for the GL_EQUAL colour pass after a depth pre-pass
+invariant gl_Position;
+
 void main()
 {
     FragPos = vec3(model * vec4(aPos, 1.0));
     Normal = aNormal;
     TexCoords = aTexCoords;    
-    gl_Position = projection * view * vec4(FragPos, 1.0);
+    vec4 viewPos = view * vec4(FragPos, 1.0);
+    ViewDepth = -viewPos.z;
+    gl_Position = projection * viewPos;
 }
\ No newline at end of file
@@ -0,0 +1,22 @@
+#version 330 core
+out vec4 FragColor;
+
+uniform sampler2DMS scene;
+uniform int samples;
+
+// Averages the samples weighted by 1 / (1 + max channel), so a single very bright sample
+// doesn't turn the whole edge pixel white once it is tonemapped (Karis). The result is
+// still linear HDR for bloom and the tonemap pass.
+void main()
+{
+    ivec2 coord = ivec2(gl_FragCoord.xy);
+    vec3 sum = vec3(0.0);
+    float weights = 0.0;
+    for (int i = 0; i < samples; ++i) {
+        vec3 color = texelFetch(scene, coord, i).rgb;
+        float weight = 1.0 / (1.0 + max(color.r, max(color.g, color.b)));
+        sum += color * weight;
+        weights += weight;
+    }
+    FragColor = vec4(sum / weights, 1.0);
+}
@@ -0,0 +1,47 @@
+#version 330 core
+
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D scene;
+uniform sampler2D bloomBlur;
+uniform sampler3D colorGrading;
+uniform float exposure;
+uniform float bloomIntensity;
+uniform float gamma;
+
+// Everything after the HDR scene in one pass: bloom composite, exposure and tonemap, output
+// encoding, then grading through a baked 3D LUT (see rg::ColorGrading), which covers the
+// grayscale effect and any other adjustment.
+// The output normally stays linear and GL_FRAMEBUFFER_SRGB encodes it on the write;
+// MANUAL_GAMMA encodes here instead, for a target that isn't sRGB.
+// features are compiled in per variant: HDR, BLOOM, COLOR_GRADING, MANUAL_GAMMA
+
+const float LUT_SIZE = 32.0;
+
+void main() {
+    vec3 hdrColor = texture(scene, TexCoords).rgb;
+
+#ifdef BLOOM
+    hdrColor += texture(bloomBlur, TexCoords).rgb * bloomIntensity;
+#endif
+
+    vec3 result = hdrColor;
+#ifdef HDR
+    result = vec3(1.0) - exp(-hdrColor * exposure);
+#endif
+
+#ifdef MANUAL_GAMMA
+    result = pow(result, vec3(1.0 / gamma));
+    vec3 lutIndex = clamp(result, 0.0, 1.0);
+#else
+    // the linear table is laid out over sqrt(colour), so the darks get their share of texels
+    vec3 lutIndex = sqrt(clamp(result, 0.0, 1.0));
+#endif
+#ifdef COLOR_GRADING
+    // texel centres sit at (i + 0.5) / size, so the 0..1 range maps onto first to last centre
+    result = texture(colorGrading, lutIndex * ((LUT_SIZE - 1.0) / LUT_SIZE) + 0.5 / LUT_SIZE).rgb;
+#endif
+    FragColor = vec4(result, 1.0);
+}
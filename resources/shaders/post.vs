@@ -0,0 +1,11 @@
+#version 330 core
+out vec2 TexCoords;
+
+// one triangle covering the screen, built from gl_VertexID with no vertex buffer; unlike two
+// triangles it has no diagonal seam where 2x2 pixel quads get shaded twice
+void main()
+{
+    vec2 position = vec2(gl_VertexID == 1 ? 3.0 : -1.0, gl_VertexID == 2 ? 3.0 : -1.0);
+    TexCoords = position * 0.5 + 0.5;
+    gl_Position = vec4(position, 0.0, 1.0);
+}
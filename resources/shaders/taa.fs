@@ -0,0 +1,56 @@
+#version 330 core
+out vec4 FragColor;
+
+uniform sampler2D current;
+uniform sampler2D history;
+uniform sampler2D depth;
+uniform mat4 inverseViewProjection;
+uniform mat4 previousViewProjection;
+uniform float historyWeight;
+// the scene covers the bottom-left renderSize pixels; historyScale takes last frame's
+// viewport coordinates to history texture coordinates, historyMax keeps taps inside its rect
+uniform vec2 renderSize;
+uniform vec2 historyScale;
+uniform vec2 historyMax;
+
+float luminance(vec3 color)
+{
+    return dot(color, vec3(0.2126, 0.7152, 0.0722));
+}
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    ivec2 size = ivec2(renderSize);
+    vec2 uv = gl_FragCoord.xy / renderSize;
+
+    // the history may only hold colours this frame could have produced around the pixel,
+    // anything else was disoccluded or changed and would ghost
+    vec3 color = texelFetch(current, pixel, 0).rgb;
+    vec3 minColor = color;
+    vec3 maxColor = color;
+    for (int y = -1; y <= 1; ++y) {
+        for (int x = -1; x <= 1; ++x) {
+            vec3 neighbour = texelFetch(current, clamp(pixel + ivec2(x, y), ivec2(0), size - 1), 0).rgb;
+            minColor = min(minColor, neighbour);
+            maxColor = max(maxColor, neighbour);
+        }
+    }
+
+    // where this pixel was last frame; the sky (depth 1) reprojects as the far plane
+    float z = texelFetch(depth, pixel, 0).r;
+    vec4 world = inverseViewProjection * vec4(vec3(uv, z) * 2.0 - 1.0, 1.0);
+    world /= world.w;
+    vec4 previous = previousViewProjection * world;
+    vec2 previousUV = previous.xy / previous.w * 0.5 + 0.5;
+
+    float weight = historyWeight;
+    if (any(lessThan(previousUV, vec2(0.0))) || any(greaterThan(previousUV, vec2(1.0))))
+        weight = 0.0;
+    vec3 past = clamp(texture(history, min(previousUV * historyScale, historyMax)).rgb, minColor, maxColor);
+
+    // weighting by 1 / (1 + luminance) keeps single bright samples from flickering (Karis)
+    float currentWeight = (1.0 - weight) / (1.0 + luminance(color));
+    float pastWeight = weight / (1.0 + luminance(past));
+    FragColor = vec4((color * currentWeight + past * pastWeight) / max(currentWeight + pastWeight, 1e-5), 1.0);
+}
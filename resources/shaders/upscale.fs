@@ -0,0 +1,121 @@
+#version 330 core
+out vec4 FragColor;
+
+uniform sampler2D source;
+// the scene covers the bottom-left renderSize pixels of source, the output is outputSize
+uniform vec2 renderSize;
+uniform vec2 outputSize;
+
+// Edge-adaptive upscale after the EASU pass of AMD FidelityFX Super Resolution 1.0. The 12
+// source texels around the output position give a luma gradient, i.e. the local edge
+// direction and how strong it is. The taps are then weighted by an approximated Lanczos-2
+// kernel that is stretched along the edge and narrowed across it, and the result is clamped
+// to the nearest 2x2 texels so the negative lobes don't ring.
+//
+//      b c
+//    e f g h
+//    i j k l
+//      n o
+
+ivec2 maxTexel;
+
+vec3 tap(ivec2 texel)
+{
+    return texelFetch(source, clamp(texel, ivec2(0), maxTexel), 0).rgb;
+}
+
+float luma(vec3 color)
+{
+    return color.g + 0.5 * (color.r + color.b);
+}
+
+// gradient at one of the centre texels, weighted by its bilinear weight
+void accumulate(inout vec2 dir, inout float len, float weight, float lA, float lB, float lC, float lD, float lE)
+{
+    //   lA
+    // lB lC lD
+    //   lE
+    float dc = lD - lC;
+    float cb = lC - lB;
+    float lenX = max(abs(dc), abs(cb));
+    lenX = lenX > 0.0 ? clamp(abs(lD - lB) / lenX, 0.0, 1.0) : 0.0;
+    float dirX = lD - lB;
+
+    float ec = lE - lC;
+    float ca = lC - lA;
+    float lenY = max(abs(ec), abs(ca));
+    lenY = lenY > 0.0 ? clamp(abs(lE - lA) / lenY, 0.0, 1.0) : 0.0;
+    float dirY = lE - lA;
+
+    dir += vec2(dirX, dirY) * weight;
+    len += (lenX * lenX + lenY * lenY) * weight;
+}
+
+void addTap(inout vec3 color, inout float weights, vec2 offset, vec2 dir, vec2 len2, float lob, float clp, vec3 value)
+{
+    // rotate into the edge's frame and scale, then the kernel is a function of distance
+    vec2 v = vec2(offset.x * dir.x + offset.y * dir.y, offset.x * -dir.y + offset.y * dir.x) * len2;
+    float d2 = min(dot(v, v), clp);
+    // (25/16 * (2/5 * x^2 - 1)^2 - (25/16 - 1)) * (lob * x^2 - 1)^2, Lanczos-2 without sin()
+    float base = 0.4 * d2 - 1.0;
+    float window = lob * d2 - 1.0;
+    float weight = (1.5625 * base * base - 0.5625) * (window * window);
+    color += value * weight;
+    weights += weight;
+}
+
+void main()
+{
+    maxTexel = ivec2(renderSize) - 1;
+    // output pixel centre in source texels, with texel centres on integers
+    vec2 position = gl_FragCoord.xy * renderSize / outputSize - 0.5;
+    ivec2 base = ivec2(floor(position));
+    vec2 pp = position - floor(position);
+
+    vec3 b = tap(base + ivec2(0, -1)), c = tap(base + ivec2(1, -1));
+    vec3 e = tap(base + ivec2(-1, 0)), f = tap(base), g = tap(base + ivec2(1, 0)), h = tap(base + ivec2(2, 0));
+    vec3 i = tap(base + ivec2(-1, 1)), j = tap(base + ivec2(0, 1)), k = tap(base + ivec2(1, 1)), l = tap(base + ivec2(2, 1));
+    vec3 n = tap(base + ivec2(0, 2)), o = tap(base + ivec2(1, 2));
+
+    float bL = luma(b), cL = luma(c), eL = luma(e), fL = luma(f), gL = luma(g), hL = luma(h);
+    float iL = luma(i), jL = luma(j), kL = luma(k), lL = luma(l), nL = luma(n), oL = luma(o);
+
+    vec2 dir = vec2(0.0);
+    float len = 0.0;
+    accumulate(dir, len, (1.0 - pp.x) * (1.0 - pp.y), bL, eL, fL, gL, jL);
+    accumulate(dir, len, pp.x * (1.0 - pp.y), cL, fL, gL, hL, kL);
+    accumulate(dir, len, (1.0 - pp.x) * pp.y, fL, iL, jL, kL, nL);
+    accumulate(dir, len, pp.x * pp.y, gL, jL, kL, lL, oL);
+
+    // flat areas have no direction, use a plain round kernel there
+    float dirLength = dot(dir, dir);
+    bool noEdge = dirLength < 1.0 / 32768.0;
+    dir = noEdge ? vec2(1.0, 0.0) : dir * inversesqrt(dirLength);
+    len = len * 0.5;
+    len *= len;
+
+    // diagonal edges get a longer kernel than axis-aligned ones
+    float stretch = dot(dir, dir) / max(abs(dir.x), abs(dir.y));
+    vec2 len2 = vec2(1.0 + (stretch - 1.0) * len, 1.0 - 0.5 * len);
+    float lob = 0.5 - 0.29 * len;
+    float clp = 1.0 / lob;
+
+    vec3 color = vec3(0.0);
+    float weights = 0.0;
+    addTap(color, weights, vec2(0.0, -1.0) - pp, dir, len2, lob, clp, b);
+    addTap(color, weights, vec2(1.0, -1.0) - pp, dir, len2, lob, clp, c);
+    addTap(color, weights, vec2(-1.0, 1.0) - pp, dir, len2, lob, clp, i);
+    addTap(color, weights, vec2(0.0, 1.0) - pp, dir, len2, lob, clp, j);
+    addTap(color, weights, vec2(0.0, 0.0) - pp, dir, len2, lob, clp, f);
+    addTap(color, weights, vec2(-1.0, 0.0) - pp, dir, len2, lob, clp, e);
+    addTap(color, weights, vec2(1.0, 1.0) - pp, dir, len2, lob, clp, k);
+    addTap(color, weights, vec2(2.0, 1.0) - pp, dir, len2, lob, clp, l);
+    addTap(color, weights, vec2(2.0, 0.0) - pp, dir, len2, lob, clp, h);
+    addTap(color, weights, vec2(1.0, 0.0) - pp, dir, len2, lob, clp, g);
+    addTap(color, weights, vec2(1.0, 2.0) - pp, dir, len2, lob, clp, o);
+    addTap(color, weights, vec2(0.0, 2.0) - pp, dir, len2, lob, clp, n);
+
+    vec3 minColor = min(min(f, g), min(j, k));
+    vec3 maxColor = max(max(f, g), max(j, k));
+    FragColor = vec4(clamp(color / weights, minColor, maxColor), 1.0);
+}
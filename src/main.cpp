@@ -13,24 +13,61 @@
 #include <learnopengl/shader.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
-
+#include <rg/ShaderVariants.h>
+#include <rg/ThreadPool.h>
+#include <rg/LightGrid.h>
+#include <rg/LightGridBuffers.h>
+#include <rg/GpuQuery.h>
+#include <rg/GpuTimer.h>
+#include <rg/Bloom.h>
+#include <rg/FrameGraph.h>
+#include <rg/TemporalAA.h>
+#include <rg/DynamicResolution.h>
+#include <rg/ColorGrading.h>
+#include <rg/ImageDiff.h>
+#include <rg/AutoExposure.h>
+#include <rg/Profiler.h>
+#include <rg/DrawCounter.h>
+#include <rg/Benchmark.h>
+#include <rg/Trace.h>
+#include <rg/InputLog.h>
+#include <rg/Cubemap.h>
+#include <rg/NullGL.h>
+#include <rg/DebugOutput.h>
+#include <rg/MemoryTracker.h>
+#include <rg/FramePacer.h>
+#include <rg/IdleThrottle.h>
+#include <rg/CommandList.h>
+#include <rg/PostChain.h>
+#include <rg/DebugPanels.h>
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
 #include <iostream>
 #include <vector>
 
-unsigned int loadTexture(const char *path);
+unsigned int loadTexture(const char *path, bool gamma = false);
 void framebuffer_size_callback(GLFWwindow *window, int width, int height);
 void mouse_callback(GLFWwindow *window, double xpos, double ypos);
 void scroll_callback(GLFWwindow *window, double xoffset, double yoffset);
+void mouse_button_callback(GLFWwindow *window, int button, int action, int mods);
+void char_callback(GLFWwindow *window, unsigned int codepoint);
 void processInput(GLFWwindow *window);
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods);
 unsigned int loadCubemap(vector<std::string> faces);
-unsigned int loadTexture(const char *path);
 void renderQuad();
 
 
 // settings
 const unsigned int SCR_WIDTH = 1600;
 const unsigned int SCR_HEIGHT = 900;
+// size of the default framebuffer, kept up to date by framebuffer_size_callback
+unsigned int framebufferWidth = SCR_WIDTH;
+unsigned int framebufferHeight = SCR_HEIGHT;
+// the part of the scene targets actually rendered, smaller under dynamic resolution
+unsigned int renderWidth = SCR_WIDTH;
+unsigned int renderHeight = SCR_HEIGHT;
 bool hdr = true;
 bool hdrKeyPressed = false;
 
@@ -47,6 +84,114 @@ float heightScale = 0.045;
 //normal/parallax rendering flag
 bool normalON = true;
 
+// every colour texture uploaded as sRGB, with its target, so that the old pipeline can
+// sample them undecoded for comparison
+std::vector<std::pair<GLenum, unsigned int>> srgbTextures;
+void setSRGBDecode(bool decode);
+
+// input of the session for --record, or the recorded input --replay plays back instead of the
+// real one; the keys are everything processInput polls
+rg::InputLog inputLog({GLFW_KEY_ESCAPE, GLFW_KEY_W, GLFW_KEY_S, GLFW_KEY_A, GLFW_KEY_D, GLFW_KEY_Q, GLFW_KEY_E,
+                       GLFW_KEY_B, GLFW_KEY_H, GLFW_KEY_J, GLFW_KEY_K});
+// set while a replayed event is dispatched, so the callbacks can tell it from real input
+bool dispatchingReplay = false;
+// woken by every callback, as input may change the image
+rg::IdleThrottle idleThrottle;
+bool keyPressed(GLFWwindow *window, int key);
+
+// shader permutation bits, in the same order as the feature names given to rg::ShaderVariants
+enum ModelLightingFeature {
+    DIR_LIGHT_FEATURE = 1 << 0,
+    LOCAL_LIGHTS_FEATURE = 1 << 1
+};
+enum AntiAliasing {
+    MSAA_ANTI_ALIASING = 0,
+    FXAA_ANTI_ALIASING = 1,
+    TAA_ANTI_ALIASING = 2
+};
+// how the multisampled scene is brought down to one sample before the post chain
+enum MsaaResolve {
+    BLIT_RESOLVE = 0,
+    TONEMAP_AWARE_RESOLVE = 1
+};
+// the objects the prepared command lists refer to
+enum SceneObject {
+    HOUSE_OBJECT,
+    LAMP_OBJECT,
+    SNOW_PILE_OBJECT,
+    SNOW_PILE_2_OBJECT,
+    SNOW_PILE_3_OBJECT,
+    MOUNTAIN_OBJECT,
+    MOUNTAIN_2_OBJECT,
+    MOUNTAIN_3_OBJECT,
+    TREE_OBJECT,
+    TREE_2_OBJECT,
+    ROCK_OBJECT,
+    SLED_OBJECT,
+    FENCE_OBJECT,
+    FENCE_2_OBJECT,
+    FENCE_3_OBJECT,
+    FLOOR_OBJECT,
+    BED_OBJECT,
+    TABLE_OBJECT,
+    SHACK_OBJECT,
+    LANTERN_OBJECT,
+    SNOWMAN_OBJECT,
+    WINDOW_OBJECT,
+    SCENE_OBJECT_COUNT
+};
+// the groups the frame's command list is prepared in, one case of prepareSceneItem each;
+// the windows come after them, one item per window
+enum SceneItem {
+    HOUSE_ITEM,
+    LAMP_ITEM,
+    SNOW_PILES_ITEM,
+    MOUNTAINS_ITEM,
+    TREES_ITEM,
+    ROCK_ITEM,
+    SLED_ITEM,
+    FENCES_ITEM,
+    FLOOR_ITEM,
+    BED_ITEM,
+    TABLE_ITEM,
+    SHACK_ITEM,
+    MOUNTAIN_RANGE_ITEM,
+    LANTERN_ITEM,
+    SNOWMAN_ITEM,
+    FIRST_WINDOW_ITEM
+};
+// what the frame preparation reads of the program state, copied for the worker
+struct ScenePrepInput {
+    glm::vec3 eye;
+    glm::vec3 mountainPositions[3];
+    float mountainAngles[3];
+    float mountainScales[3];
+    glm::vec3 modelPosition;
+};
+
+// where a window pane goes: translation, scale, rotation axis and angle in degrees
+typedef struct{
+    glm::vec3 trans;
+    glm::vec3 skal;
+    glm::vec3 rotatV;
+    float rotatU;
+}triD;
+
+// a frame's draws: its command list, the camera frustum their bounds are tested against, and
+// what the commands' objects are drawn from; the list may be a frame old, the frustum never is,
+// so nothing pops in late at the edges
+struct FrameDraws {
+    const rg::CommandList *commands = nullptr;
+    rg::Frustum frustum;
+    // a model per SceneObject, null for the floor and the windows
+    Model *const *models = nullptr;
+    unsigned int floorVAO = 0;
+    unsigned int floorTexture = 0;
+};
+
+// texture units 8, 9 and 10 hold the light grid buffers, well clear of the material maps
+const unsigned int LIGHT_GRID_TEXTURE_UNIT = 8;
+
 // camera
 
 float lastX = SCR_WIDTH / 2.0f;
@@ -114,6 +259,77 @@ struct ProgramState {
     SpotLight spotLight;
     PointLight lampPointLight;
     DirLight dirLight;
+    bool dirLightEnabled = true;
+    bool pointLightEnabled = true;
+    bool lampPointLightEnabled = true;
+    bool spotLightEnabled = true;
+    int extraLights = 0;
+    bool deferredShading = false;
+    double litPassMs = 0.0;
+    bool depthPrePass = false;
+    double shadedFragments = 0.0;
+    int bloomMode = rg::Bloom::MIP_CHAIN;
+    float bloomThreshold = 1.0f;
+    double bloomMs = 0.0;
+    double bloomMegabytes = 0.0;
+    std::string framePasses;
+    double renderTargetMegabytes = 0.0;
+    double unaliasedMegabytes = 0.0;
+    int msaaSamples = 4;
+    int msaaResolve = BLIT_RESOLVE;
+    double sceneMs = 0.0;
+    double antiAliasingMs = 0.0;
+    int antiAliasing = MSAA_ANTI_ALIASING;
+    // last GPU time (lit pass, rest of the scene, resolve) and scene target memory seen
+    // at each sample count, indexed by log2: 1x, 2x, 4x, 8x
+    double msaaMs[4] = {};
+    double msaaMegabytes[4] = {};
+    // the same per anti-aliasing mode: its own pass, the scene including it, and the
+    // memory it adds over a plain single-sample scene
+    double antiAliasingPassMs[3] = {};
+    double antiAliasingSceneMs[3] = {};
+    double antiAliasingMegabytes[3] = {};
+    bool dynamicResolution = false;
+    float targetFrameMs = 16.6f;
+    float minRenderScale = 0.5f;
+    float maxRenderScale = 1.0f;
+    float renderScale = 1.0f;
+    double gpuFrameMs = 0.0;
+    double upscaleMs = 0.0;
+    rg::FramePacingSettings framePacing;
+    rg::FramePacer::Stats framePacingStats;
+    bool adaptiveSwapSupported = false;
+    rg::IdleThrottleSettings idleThrottle;
+    // the skybox and bell rotation; while it runs every frame differs, so the window
+    // never goes idle
+    bool animate = true;
+    // the next frame's command list built on a worker while this one is submitted
+    bool pipelinedPrep = true;
+    double prepBuildMs = 0.0;
+    double prepWaitMs = 0.0;
+    // eye adaptation; the J/K keys and the slider then set a compensation in stops
+    bool autoExposure = true;
+    float exposureCompensation = 0.0f;
+    float adaptationSpeed = 1.5f;
+    double autoExposureMs = 0.0;
+    double autoExposureReadbackUs = 0.0;
+    float adaptedExposure = 1.0f;
+    float averageLuminance = 0.0f;
+    int exposureLatency = 0;
+    long long exposureReadbacks = 0;
+    long long exposureDropped = 0;
+    rg::ColorGradingSettings colorGrading;
+    double postMs = 0.0;
+    double postMegabytes = 0.0;
+    double separateGradingMegabytes = 0.0;
+    // R11F_G11F_B10F instead of RGBA16F for the HDR targets
+    bool leanTargetFormats = true;
+    // sRGB albedo textures and G-buffer, output encoded by GL_FRAMEBUFFER_SRGB; off is the
+    // old linear-texture pipeline with gamma 1.4 applied in the post shader
+    bool srgbPipeline = true;
+    bool imageValidationRequested = false;
+    std::vector<rg::ImageValidation::Result> imageValidation;
+    bool profiler = true;
     ProgramState()
             : camera(glm::vec3(0.0f, 0.0f, 3.0f)) {}
 
@@ -200,46 +416,197 @@ ProgramState *programState;
 
 void DrawImGui(ProgramState *programState);
 
-int main() {
+int runScene(GLFWwindow *window, rg::BenchmarkOptions &benchmark, const rg::CameraPath &cameraPath,
+             bool srgbBackbuffer, GLuint benchmarkTarget, rg::BenchmarkRecorder &benchmarkRecorder);
+void collectSceneLights(std::vector<rg::ClusterLight> &lights);
+void setSceneLighting(Shader &shader, const rg::ClusterGridConfig &config);
+void setupSceneLights(ProgramState *programState);
+ScenePrepInput scenePrepInput(const ProgramState *programState);
+unsigned int createVertexArray(const float *vertices, GLsizeiptr size, const char *asset,
+                               std::initializer_list<int> components);
+glm::vec4 sceneObjectBounds(SceneObject object, const Model *model);
+void prepareSceneItem(const ScenePrepInput &in, size_t item, const glm::vec4 *sceneBounds,
+                      const vector<triD> &winPos, rg::CommandList &list);
+void drawLitModels(Shader &shader, bool positionsOnly, const FrameDraws &draws);
+void drawDeferredLighting(Shader &lightingShader, const rg::ClusterGridConfig &config, const glm::mat4 &projection,
+                          const glm::mat4 &view, unsigned int albedoSpec, unsigned int normalShininess,
+                          unsigned int depth, unsigned int quadVAO);
+void drawSkybox(Shader &skyShader, unsigned int skyboxVAO, unsigned int cubemapTexture, const glm::mat4 &projection,
+                const glm::mat4 &view, float h);
+void drawBell(Shader &reflectShader, Model &bellModel, unsigned int cubemapTexture, const glm::mat4 &projection,
+              const glm::mat4 &view, const glm::vec3 &eye, float h);
+void drawParallaxWalls(Shader &brickShader, unsigned int diffuseMap, unsigned int normalMap, unsigned int depthMap,
+                       const glm::mat4 &projection, const glm::mat4 &view, const glm::vec3 &eye,
+                       const glm::vec3 &ambient);
+void drawRug(Shader &rugShader, unsigned int diffuseMap, unsigned int normalMap, const glm::mat4 &projection,
+             const glm::mat4 &view, const glm::vec3 &eye);
+void drawWindows(Shader &windowShader, unsigned int windowVAO, unsigned int windowTexture, const glm::mat4 &projection,
+                 const glm::mat4 &view, const FrameDraws &draws);
+void recordAntiAliasingStats(unsigned int sceneSamples, GLenum hdrFormat, size_t temporalAABytes);
+
+int main(int argc, char **argv) {
+    // a benchmark run renders a camera path offscreen, records every frame and exits
+    rg::BenchmarkOptions benchmark;
+    if (!benchmark.parse(argc, argv))
+        return -1;
+    rg::CameraPath cameraPath;
+    if (benchmark.enabled && !cameraPath.load(benchmark.cameraPath))
+        return -1;
+    // GL errors come from the driver's KHR_debug messages, never from glGetError()
+    bool glDebug = benchmark.glDebug != "off" && !benchmark.nullGL;
+    rg::DebugOutput::Options debugOptions;
+    if (glDebug && !rg::DebugOutput::parseSeverity(benchmark.glDebug, debugOptions.minimumSeverity)) {
+        std::cout << "ERROR::DEBUG_OUTPUT::ARGUMENT --gl-debug " << benchmark.glDebug << std::endl;
+        return -1;
+    }
+    if (!rg::DebugOutput::parseSources(benchmark.glDebugIgnore, debugOptions.ignoredSources)) {
+        std::cout << "ERROR::DEBUG_OUTPUT::ARGUMENT --gl-debug-ignore " << benchmark.glDebugIgnore << std::endl;
+        return -1;
+    }
+#ifndef RG_GL_DEBUG
+    // a release build asked for the messages doesn't give up the driver's threading for them
+    debugOptions.synchronous = false;
+#endif
+    rg::tracer().nameThread("Main");
+    if (!benchmark.tracePath.empty() && benchmark.traceStart == 0)
+        rg::tracer().start();
+
     // glfw: initialize and configure
     // ------------------------------
+#ifndef GLFW_PLATFORM_NULL
+    // the null GL still opens a window for the input, and before GLFW 3.4 that needs a display
+    if (benchmark.nullGL) {
+        std::cout << "ERROR::BENCHMARK::ARGUMENT --null-gl needs GLFW 3.4 or newer, this build has "
+                  << GLFW_VERSION_MAJOR << "." << GLFW_VERSION_MINOR << std::endl;
+        return -1;
+    }
+#endif
+#ifdef GLFW_PLATFORM_NULL
+    // GLFW 3.4 can run without a display at all: EGL surfaceless or OSMesa, e.g. on llvmpipe
+    if (benchmark.enabled || benchmark.nullGL)
+        glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#endif
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    // lets GL_FRAMEBUFFER_SRGB encode the final output
+    glfwWindowHint(GLFW_SRGB_CAPABLE, GLFW_TRUE);
+    if (glDebug)
+        glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GLFW_TRUE);
 
 #ifdef __APPLE__
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
+    // older GLFW still needs a display, the window just never shows
+    if (benchmark.enabled) {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+#ifdef GLFW_OSMESA_CONTEXT_API
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, benchmark.osmesa ? GLFW_OSMESA_CONTEXT_API : GLFW_EGL_CONTEXT_API);
+#endif
+    }
+    // the null GL needs no context, only a window for the input callbacks
+    if (benchmark.nullGL) {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+    }
 
     // glfw window creation
     // --------------------
-    GLFWwindow *window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
+    GLFWwindow *window = benchmark.enabled
+                         ? glfwCreateWindow(benchmark.width, benchmark.height, "LearnOpenGL benchmark", NULL, NULL)
+                         : glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
     if (window == NULL) {
         std::cout << "Failed to create GLFW window" << std::endl;
         glfwTerminate();
         return -1;
     }
-    glfwMakeContextCurrent(window);
+    if (!benchmark.nullGL)
+        glfwMakeContextCurrent(window);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetScrollCallback(window, scroll_callback);
     glfwSetKeyCallback(window, key_callback);
+    glfwSetMouseButtonCallback(window, mouse_button_callback);
+    glfwSetCharCallback(window, char_callback);
     // tell GLFW to capture our mouse
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    if (!benchmark.enabled)
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
     // glad: load all OpenGL function pointers
     // ---------------------------------------
-    if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress)) {
-        std::cout << "Failed to initialize GLAD" << std::endl;
+    if (benchmark.nullGL) {
+        if (!rg::loadNullGL()) {
+            std::cout << "Failed to initialize the null GL" << std::endl;
+            return -1;
+        }
+        // every profiler scope counts the state changes it issues, for the budgets
+        rg::profiler().setCounter(rg::nullGLStateChanges);
+    } else {
+        if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress)) {
+            std::cout << "Failed to initialize GLAD" << std::endl;
+            return -1;
+        }
+        rg::loadGLExtensions((GLADloadproc) glfwGetProcAddress);
+        if (glDebug)
+            rg::debugOutput().install(debugOptions);
+    }
+    int width, height;
+    glfwGetFramebufferSize(window, &width, &height);
+    framebuffer_size_callback(window, width, height);
+    // the hint isn't binding; without an sRGB back buffer the post shader encodes the output.
+    // Benchmark contexts may have no back buffer to ask about, they render into an sRGB
+    // texture, see below
+    GLint backbufferEncoding = GL_LINEAR;
+    if (!benchmark.enabled)
+        glGetFramebufferAttachmentParameteriv(GL_FRAMEBUFFER, GL_BACK_LEFT, GL_FRAMEBUFFER_ATTACHMENT_COLOR_ENCODING,
+                                              &backbufferEncoding);
+    bool srgbBackbuffer = backbufferEncoding == GL_SRGB;
+    // a surfaceless context has no default framebuffer to render into, so a benchmark run
+    // renders into a texture of the requested size instead; the swap is unthrottled
+    GLuint benchmarkTarget = 0;
+    rg::BenchmarkRecorder benchmarkRecorder;
+    if (!benchmark.recordPath.empty() && !inputLog.record(benchmark.recordPath))
         return -1;
+    if (!benchmark.replayPath.empty()) {
+        if (!inputLog.replay(benchmark.replayPath))
+            return -1;
+        if (!benchmark.nullGL)
+            glfwSwapInterval(0);
+        rg::DrawCounter::install();
+        benchmark.warmupFrames = 0;
+    }
+    if (benchmark.enabled) {
+        framebuffer_size_callback(window, benchmark.width, benchmark.height);
+        glGenTextures(1, &benchmarkTarget);
+        glBindTexture(GL_TEXTURE_2D, benchmarkTarget);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8_ALPHA8, benchmark.width, benchmark.height, 0, GL_RGBA,
+                     GL_UNSIGNED_BYTE, NULL);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        rg::memoryTracker().texture(benchmarkTarget, "Benchmark target", rg::MemoryTracker::RENDER_TARGETS,
+                                    GL_SRGB8_ALPHA8, benchmark.width, benchmark.height);
+        srgbBackbuffer = true;
+        if (!benchmark.nullGL)
+            glfwSwapInterval(0);
+        rg::DrawCounter::install();
+        std::cout << "BENCHMARK:: " << (const char *) glGetString(GL_RENDERER) << ", " << benchmark.width << "x"
+                  << benchmark.height << ", " << benchmark.warmupFrames << " + " << benchmark.frames << " frames"
+                  << std::endl;
     }
 
     // tell stb_image.h to flip loaded texture's on the y-axis (before loading model).
     stbi_set_flip_vertically_on_load(true);
 
     programState = new ProgramState;
-    programState->LoadFromFile("resources/program_state.txt");
+    // a benchmark starts from the defaults, whatever was last saved; a recording keeps the
+    // state it started from next to the log, so its replay starts from the same place
+    if (!benchmark.replayPath.empty()) {
+        programState->LoadFromFile(benchmark.replayPath + ".state");
+    } else if (!benchmark.enabled) {
+        programState->LoadFromFile("resources/program_state.txt");
+        if (!benchmark.recordPath.empty())
+            programState->SaveToFile(benchmark.recordPath + ".state");
+    }
     if (programState->ImGuiEnabled) {
         glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
     }
@@ -251,7 +618,8 @@ int main() {
 
 
 
-    ImGui_ImplGlfw_InitForOpenGL(window, true);
+    // our callbacks pass the events on to ImGui, so that input log replays reach it too
+    ImGui_ImplGlfw_InitForOpenGL(window, false);
     ImGui_ImplOpenGL3_Init("#version 330 core");
 
     // configure global opengl state
@@ -265,20 +633,83 @@ int main() {
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
+    int exitCode = runScene(window, benchmark, cameraPath, srgbBackbuffer, benchmarkTarget, benchmarkRecorder);
+    if (!benchmark.enabled && benchmark.replayPath.empty()) {
+        programState->SaveToFile("resources/program_state.txt");
+    }
+    delete programState;
+    ImGui_ImplOpenGL3_Shutdown();
+    ImGui_ImplGlfw_Shutdown();
+    ImGui::DestroyContext();
+    rg::debugOutput().report();
+    // the last GL calls; the renderer's own objects went with runScene's scope
+    rg::profiler().shutdown();
+    // glfw: terminate, clearing all previously allocated GLFW resources.
+    // ------------------------------------------------------------------
+    glfwTerminate();
+    return exitCode;
+}
+
+// loads the scene and runs the render loop until the window closes or the benchmark is over;
+// every GL object it creates is released when it returns, while the context is still there.
+// The exit code: what the benchmark run returns, 0 otherwise
+int runScene(GLFWwindow *window, rg::BenchmarkOptions &benchmark, const rg::CameraPath &cameraPath,
+             bool srgbBackbuffer, GLuint benchmarkTarget, rg::BenchmarkRecorder &benchmarkRecorder) {
     // build and compile shaders
     // -------------------------
-    Shader modelShader("resources/shaders/modelLightingShader.vs", "resources/shaders/modelLightingShader.fs");
-    Shader antiAliasingShader("resources/shaders/antial.vs","resources/shaders/antial.fs");
-    Shader hdrShader("resources/shaders/hdr.vs", "resources/shaders/hdr.fs");
-    Shader blurShader("resources/shaders/blur.vs", "resources/shaders/blur.fs");
+    rg::ShaderVariants modelShaders("resources/shaders/modelLightingShader.vs", "resources/shaders/modelLightingShader.fs",
+                                    {"DIR_LIGHT", "LOCAL_LIGHTS"},
+                                    [](Shader &shader) {
+                                        shader.setInt("material.texture_diffuse1", 0);
+                                        shader.setInt("lightData", LIGHT_GRID_TEXTURE_UNIT);
+                                        shader.setInt("lightClusters", LIGHT_GRID_TEXTURE_UNIT + 1);
+                                        shader.setInt("lightIndices", LIGHT_GRID_TEXTURE_UNIT + 2);
+                                    });
+    rg::ShaderVariants deferredLightingShaders("resources/shaders/deferredLighting.vs",
+                                               "resources/shaders/deferredLighting.fs",
+                                               {"DIR_LIGHT", "LOCAL_LIGHTS"},
+                                               [](Shader &shader) {
+                                                   shader.setInt("gAlbedoSpec", 0);
+                                                   shader.setInt("gNormalShininess", 1);
+                                                   shader.setInt("gDepth", 2);
+                                                   shader.setInt("lightData", LIGHT_GRID_TEXTURE_UNIT);
+                                                   shader.setInt("lightClusters", LIGHT_GRID_TEXTURE_UNIT + 1);
+                                                   shader.setInt("lightIndices", LIGHT_GRID_TEXTURE_UNIT + 2);
+                                               });
+    Shader gBufferShader("resources/shaders/gBuffer.vs", "resources/shaders/gBuffer.fs");
+    Shader depthOnlyShader("resources/shaders/depthOnly.vs", "resources/shaders/depthOnly.fs");
+    rg::DynamicResolution dynamicResolution;
 
+    //screen vertices
+    float quadVertices[] = {
+            // positions        // texture Coords
+            -1.0f, 1.0f, 0.0f, 0.0f, 1.0f,
+            -1.0f, -1.0f, 0.0f, 0.0f, 0.0f,
+            1.0f, 1.0f, 0.0f, 1.0f, 1.0f,
+            1.0f, -1.0f, 0.0f, 1.0f, 0.0f,
+    };
+    unsigned int quadVAO = createVertexArray(quadVertices, sizeof(quadVertices), "Screen quad", {3, 2});
+    // everything from the lit scene to the back buffer, see the render loop
+    rg::PostChain postChain(quadVAO);
 
     Shader rugShader("resources/shaders/rugShader.vs", "resources/shaders/rugShader.fs");
-    unsigned int rugTextureDiff = loadTexture("resources/textures/rug.png");
+    Shader reflectShader("resources/shaders/reflectShader.vs", "resources/shaders/reflectShader.fs");
+    Shader skyShader("resources/shaders/skyShader.vs", "resources/shaders/skyShader.fs");
+    Shader windowShader("resources/shaders/transparentShader.vs", "resources/shaders/transparentShader.fs");
+    Shader brickShader("resources/shaders/normalShader.vs", "resources/shaders/normalShader.fs");
+
+    // submit every permutation now; none of them is checked until its first use,
+    // so the driver compiles them while the models below are being loaded
+    modelShaders.warmAll();
+    deferredLightingShaders.warmAll();
+    postChain.warmAll();
+
+    unsigned int rugTextureDiff = loadTexture("resources/textures/rug.png", true);
     unsigned int rugTextureNormal = loadTexture("resources/textures/rugNormal.png");
-    rugShader.use();
-    rugShader.setInt("diffuseMap", 0);
-    rugShader.setInt("normalMap", 1);
+    rugShader.whenReady([](Shader &shader) {
+        shader.setInt("diffuseMap", 0);
+        shader.setInt("normalMap", 1);
+    });
 
 
     // load models
@@ -286,87 +717,96 @@ int main() {
 
 
     //load house model
-    Model houseModel("resources/objects/house/highpoly_town_house_01.obj");
+    Model houseModel("resources/objects/house/highpoly_town_house_01.obj", true);
     houseModel.SetShaderTextureNamePrefix("material.");
 
 
     //load snow model
-    Model snowModel("resources/objects/snow model/terrain5.obj");
+    Model snowModel("resources/objects/snow model/terrain5.obj", true);
     snowModel.SetShaderTextureNamePrefix("material.");
-    Model snowModel2("resources/objects/snow model/terrain3.obj");
+    Model snowModel2("resources/objects/snow model/terrain3.obj", true);
     snowModel.SetShaderTextureNamePrefix("material.");
-    Model snowModel3("resources/objects/snow model/terrain4.obj");
+    Model snowModel3("resources/objects/snow model/terrain4.obj", true);
     snowModel.SetShaderTextureNamePrefix("material.");
 
     //load furniture models(bed,table,bookcase...)
-    Model bedModel("resources/objects/bed/untitled.obj");
+    Model bedModel("resources/objects/bed/untitled.obj", true);
     bedModel.SetShaderTextureNamePrefix("material.");
-    Model tableModel("resources/objects/table/Table_Chair.obj");
+    Model tableModel("resources/objects/table/Table_Chair.obj", true);
     tableModel.SetShaderTextureNamePrefix("material.");
-    Model shackModel("resources/objects/shack/MedievalShackWood.obj");
+    Model shackModel("resources/objects/shack/MedievalShackWood.obj", true);
     shackModel.SetShaderTextureNamePrefix("material.");
-    Model lanternModel("resources/objects/lantern/untitled.obj");
+    Model lanternModel("resources/objects/lantern/untitled.obj", true);
     lanternModel.SetShaderTextureNamePrefix("material.");
-    Model snowManModel("/home/milan/RG Projekat/prototip2/resources/objects/snowman/untitled.obj");
+    Model snowManModel("/home/milan/RG Projekat/prototip2/resources/objects/snowman/untitled.obj", true);
     snowManModel.SetShaderTextureNamePrefix("material.");
 
 
 
-    Model mt1Model("resources/objects/mount2/untitled.obj");
+    Model mt1Model("resources/objects/mount2/untitled.obj", true);
     mt1Model.SetShaderTextureNamePrefix("material.");
-    Model mt3Model("resources/objects/mount2/untitled.obj");
+    Model mt3Model("resources/objects/mount2/untitled.obj", true);
     mt1Model.SetShaderTextureNamePrefix("material.");
-    Model mt2Model("resources/objects/mount2/untitled.obj");
+    Model mt2Model("resources/objects/mount2/untitled.obj", true);
     mt1Model.SetShaderTextureNamePrefix("material.");
 
     //load tree models
-    Model modelTree("resources/objects/tree/3d-model.obj");
+    Model modelTree("resources/objects/tree/3d-model.obj", true);
     modelTree.SetShaderTextureNamePrefix("material.");
-    Model modelTree2("resources/objects/tree/3d-model.obj");
+    Model modelTree2("resources/objects/tree/3d-model.obj", true);
     modelTree2.SetShaderTextureNamePrefix("material.");
-    Model modelTree3("resources/objects/tree/3d-model.obj");
+    Model modelTree3("resources/objects/tree/3d-model.obj", true);
     modelTree3.SetShaderTextureNamePrefix("material.");
 
     //load fence
-    Model modelFence("resources/objects/fence/untitled.obj");
+    Model modelFence("resources/objects/fence/untitled.obj", true);
     modelFence.SetShaderTextureNamePrefix("material.");
-    Model modelFence2("resources/objects/fence/untitled.obj");
+    Model modelFence2("resources/objects/fence/untitled.obj", true);
     modelFence2.SetShaderTextureNamePrefix("material.");
-    Model modelFence3("resources/objects/fence/untitled.obj");
+    Model modelFence3("resources/objects/fence/untitled.obj", true);
     modelFence3.SetShaderTextureNamePrefix("material.");
-    Model modelFence4("resources/objects/fence/untitled.obj");
+    Model modelFence4("resources/objects/fence/untitled.obj", true);
     modelFence4.SetShaderTextureNamePrefix("material.");
 
     //load rock
-    Model modelRock("resources/objects/rock/untitled.obj");
+    Model modelRock("resources/objects/rock/untitled.obj", true);
     modelFence4.SetShaderTextureNamePrefix("material.");
 
     //load sled
-    Model modelSled("resources/objects/sled/Sled01Old.obj");
+    Model modelSled("resources/objects/sled/Sled01Old.obj", true);
     modelSled.SetShaderTextureNamePrefix("material.");
 
 
 
     //load mt model
-    Model modelMountain("resources/objects/great_mountain/untitled.obj");
+    Model modelMountain("resources/objects/great_mountain/untitled.obj", true);
     modelMountain.SetShaderTextureNamePrefix("material.");
-    Model modelMountain2("resources/objects/great_mountain/untitled.obj");
+    Model modelMountain2("resources/objects/great_mountain/untitled.obj", true);
     modelMountain2.SetShaderTextureNamePrefix("material.");
-    Model modelMountain3("resources/objects/great_mountain/untitled.obj");
+    Model modelMountain3("resources/objects/great_mountain/untitled.obj", true);
     modelMountain3.SetShaderTextureNamePrefix("material.");
-    Model modelLamp("resources/objects/lamp/Lamp Old Street.obj");
+    Model modelLamp("resources/objects/lamp/Lamp Old Street.obj", true);
     modelLamp.SetShaderTextureNamePrefix("material.");
 
 
 
     //load bell model
-    Shader reflectShader("resources/shaders/reflectShader.vs", "resources/shaders/reflectShader.fs");
-    Model bellModel("resources/objects/bell/bell.obj");
+    Model bellModel("resources/objects/bell/bell.obj", true);
+
+    // the diffuse maps went up as sRGB as well (the gamma argument above)
+    for (const Model *model : {&houseModel, &snowModel, &snowModel2, &snowModel3, &bedModel, &tableModel,
+                               &shackModel, &lanternModel, &snowManModel, &mt1Model, &mt2Model, &mt3Model,
+                               &modelTree, &modelTree2, &modelTree3, &modelFence, &modelFence2, &modelFence3,
+                               &modelFence4, &modelRock, &modelSled, &modelMountain, &modelMountain2,
+                               &modelMountain3, &modelLamp, &bellModel}) {
+        for (const Texture &texture : model->textures_loaded) {
+            if (texture.type == "texture_diffuse")
+                srgbTextures.push_back(std::make_pair(GL_TEXTURE_2D, texture.id));
+        }
+    }
 
 
     //skybox vertices/cubemapping
-    Shader skyShader("resources/shaders/skyShader.vs", "resources/shaders/skyShader.fs");
-
     float skyboxVertices[] = {
             // positions
             -1.0f,  1.0f, -1.0f,
@@ -414,14 +854,7 @@ int main() {
 
 
 
-    unsigned int skyboxVAO, skyboxVBO;
-    glGenVertexArrays(1, &skyboxVAO);
-    glGenBuffers(1, &skyboxVBO);
-    glBindVertexArray(skyboxVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    unsigned int skyboxVAO = createVertexArray(skyboxVertices, sizeof(skyboxVertices), "Skybox", {3});
 
     //vector of cubemap component paths
     vector<std::string> faces
@@ -436,8 +869,9 @@ int main() {
     //load maps
     unsigned int cubemapTexture = loadCubemap(faces);
 
-    skyShader.use();
-    skyShader.setInt("skybox", 0);
+    skyShader.whenReady([](Shader &shader) {
+        shader.setInt("skybox", 0);
+    });
 
 
 
@@ -453,74 +887,34 @@ int main() {
             10.0f, -0.5f, -10.0f,  0.0f, 1.0f, 0.0f,  10.0f, 10.0f
     };
 
-    unsigned int planeVAO, planeVBO;
-    glGenVertexArrays(1, &planeVAO);
-    glGenBuffers(1, &planeVBO);
-    glBindVertexArray(planeVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, planeVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(planeVertices), planeVertices, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-    glBindVertexArray(0);
+    unsigned int planeVAO = createVertexArray(planeVertices, sizeof(planeVertices), "Floor", {3, 3, 2});
 
-    unsigned int planeTexture = loadTexture("resources/textures/Snow1Albedo.png");
-    modelShader.use();
-    modelShader.setInt("material.texture_diffuse1", 0);
+    unsigned int planeTexture = loadTexture("resources/textures/Snow1Albedo.png", true);
 
+    setupSceneLights(programState);
 
-
-
-
-
-    //directional light
-    DirLight& dirLight = programState->dirLight;
-    dirLight.direction = glm::vec3(0.0, -5.0, 0.0);
-    dirLight.ambient = glm::vec3(0.05, 0.05, 0.05);
-    //dirLight.diffuse = glm::vec3(0.4, 0.4, 0.4);
-    //dirLight.specular = glm::vec3(0.4, 0.4, 0.4);
-    dirLight.diffuse = glm::vec3(0.1, 0.1, 0.1);
-    dirLight.specular = glm::vec3(0.1, 0.1, 0.1);
-
-    //point light
-    PointLight& pointLight = programState->pointLight;
-    pointLight.position = glm::vec3(4.0f, 4.0, 0.0);
-    pointLight.ambient = glm::vec3(0.1, 0.1, 0.1);
-    pointLight.diffuse = glm::vec3(0.6, 0.6, 0.6);
-    pointLight.specular = glm::vec3(1.0, 1.0, 1.0);
-    pointLight.constant = 1.0f;
-    pointLight.linear = 0.09f;
-    pointLight.quadratic = 0.032f;
-
-    //spotlight lamp
-    SpotLight& spotLight = programState->spotLight;
-    spotLight.position = glm::vec3(4.0f, 4.0, 0.0);
-    spotLight.ambient = glm::vec3(0.1, 0.1, 0.1);
-    spotLight.diffuse = glm::vec3(0.9f, 0.25f, 0.1f);
-    spotLight.specular = glm::vec3(1.0f, 1.0f, 1.0f);
-    spotLight.constant = 1.0f;
-    spotLight.linear = 0.09f;
-    spotLight.quadratic = 0.032f;
-    spotLight.cutOff = glm::cos(glm::radians(20.0f));
-    spotLight.outerCutOff = glm::cos(glm::radians(35.0f));
-
-    //lamp
-    PointLight& lampPointLight = programState->lampPointLight;
-    lampPointLight.position = glm::vec3(4.0f, 4.0, 0.0);
-    lampPointLight.ambient = glm::vec3(0.1, 0.1, 0.1);
-    lampPointLight.diffuse = glm::vec3(0.6, 0.6, 0.6);
-    lampPointLight.specular = glm::vec3(1.0, 1.0, 1.0);
-    lampPointLight.constant = 1.0f;
-    lampPointLight.linear = 0.09f;
-    lampPointLight.quadratic = 0.032f;
+    // point and spot lights are binned into view-space clusters every frame, so the
+    // lighting shader only loops over the lights that can reach the fragment's cluster
+    rg::ThreadPool threadPool;
+    rg::LightGridBuilder lightGridBuilder(&threadPool);
+    // declared after the pool, so that it waits for its job before the pool stops
+    rg::FramePrep framePrep(threadPool);
+    rg::LightGrid lightGrid;
+    rg::LightGridBuffers lightGridBuffers;
+    std::vector<rg::ClusterLight> sceneLights;
+    rg::GpuTimer litPassTimer;
+    // the rest of the scene after the lit pass; timers can't nest
+    rg::GpuTimer sceneTimer;
+    // everything the frame graph runs, the input of the dynamic resolution controller
+    rg::GpuSpanTimer gpuFrameTimer;
+    // fragment shader invocations where the driver exposes them; samples passing the depth
+    // test otherwise, which is the same number whenever early depth testing kicks in
+    rg::GpuQuery shadedFragments(rg::glExtensions().pipelineStatistics ? GL_FRAGMENT_SHADER_INVOCATIONS_ARB
+                                                                       : GL_SAMPLES_PASSED);
 
 
 
     //transparent window vertices
-    Shader windowShader("resources/shaders/transparentShader.vs", "resources/shaders/transparentShader.fs");
     float windowVertices[] = {
             4.0f, -0.4f,  4.0f,  1.0f, 0.0f,
             -4.0f, -0.4f,  4.0f,  0.0f, 0.0f,
@@ -531,932 +925,1576 @@ int main() {
             4.0f, -0.4f, -4.0f,  1.0f, 1.0f
     };
 
-    unsigned int windowVAO, windowVBO;
-    glGenVertexArrays(1, &windowVAO);
-    glGenBuffers(1, &windowVBO);
-    glBindVertexArray(windowVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, windowVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(windowVertices), windowVertices, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-    glBindVertexArray(0);
+    unsigned int windowVAO = createVertexArray(windowVertices, sizeof(windowVertices), "Windows", {3, 2});
 
 
-    unsigned int windowTexture = loadTexture(FileSystem::getPath("resources/textures/window.png").c_str());
+    unsigned int windowTexture = loadTexture(FileSystem::getPath("resources/textures/window.png").c_str(), true);
 
-    windowShader.use();
-    windowShader.setInt("diffTex", 0);
+    windowShader.whenReady([](Shader &shader) {
+        shader.setInt("diffTex", 0);
+    });
 
 
 
 
     //stone wall shader and tex
-    Shader brickShader("resources/shaders/normalShader.vs", "resources/shaders/normalShader.fs");
-
-    unsigned int brickTextureDiff = loadTexture(FileSystem::getPath("resources/textures/brickWallDiff.jpg").c_str());
+    unsigned int brickTextureDiff = loadTexture(FileSystem::getPath("resources/textures/brickWallDiff.jpg").c_str(), true);
     //unsigned int brickTextureSpec = loadTexture(FileSystem::getPath("resources/textures/brickWallSpec.jpg").c_str());
     unsigned int brickTextureNormal = loadTexture(FileSystem::getPath("resources/textures/brickWallNormal.jpg").c_str());
     unsigned int brickTextureDisp = loadTexture(FileSystem::getPath("resources/textures/brickWallDisp.jpg").c_str());
 
-    brickShader.use();
-    brickShader.setInt("diffuseMap", 0);
-    brickShader.setInt("normalMap", 1);
-    brickShader.setInt("depthMap", 2);
-    //brickShader.setInt("specularMap", 3);
-
-
-    //screen vertices
-    float quadVertices[] = {
-            // positions        // texture Coords
-            -1.0f, 1.0f, 0.0f, 0.0f, 1.0f,
-            -1.0f, -1.0f, 0.0f, 0.0f, 0.0f,
-            1.0f, 1.0f, 0.0f, 1.0f, 1.0f,
-            1.0f, -1.0f, 0.0f, 1.0f, 0.0f,
-    };
-    unsigned int quadVAO, quadVBO;
-    glGenVertexArrays(1, &quadVAO);
-    glGenBuffers(1, &quadVBO);
-    glBindVertexArray(quadVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void *) 0);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void *) (3 * sizeof(float)));
-
-
-
-    //hdr and bloom
-    unsigned int hdrFBO;
-    glGenFramebuffers(1, &hdrFBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
-    unsigned int colorBuffers[2];
-    glGenTextures(2, colorBuffers);
-    for (unsigned int i = 0; i < 2; i++)
-    {
-        glBindTexture(GL_TEXTURE_2D, colorBuffers[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, colorBuffers[i], 0);
-    }
-    // renderbuffer
-    unsigned int rboDepth;
-    glGenRenderbuffers(1, &rboDepth);
-    glBindRenderbuffer(GL_RENDERBUFFER, rboDepth);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, SCR_WIDTH, SCR_HEIGHT);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rboDepth);
-
-    unsigned int attachments[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
-    glDrawBuffers(2, attachments);
-
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        std::cout << "ERROR::FRAMEBUFFER!" << std::endl;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-
-    unsigned int pingpongFBO[2];
-    unsigned int pingpongColorBuffers[2];
-    glGenFramebuffers(2, pingpongFBO);
-    glGenTextures(2, pingpongColorBuffers);
-    for (unsigned int i = 0; i < 2; ++i) {
-        glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[i]);
-        glBindTexture(GL_TEXTURE_2D, pingpongColorBuffers[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pingpongColorBuffers[i], 0);
-    }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-    //MSAA
-    unsigned int msFBO;
-    glGenFramebuffers(1, &msFBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, msFBO);
-
-    unsigned int textureColorBufferMultiSampled;
-    glGenTextures(1, &textureColorBufferMultiSampled);
-    glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, textureColorBufferMultiSampled);
-    glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, 4, GL_RGB, SCR_WIDTH,SCR_HEIGHT, GL_TRUE);
-    glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
-    //napravili smo tekstura obj i treba da ga nakacimo sad
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,GL_TEXTURE_2D_MULTISAMPLE, textureColorBufferMultiSampled, 0);
-
-    unsigned  int rbo;
-    glGenRenderbuffers(1, &rbo);
-    glBindRenderbuffer(GL_RENDERBUFFER, rbo);
-    glRenderbufferStorageMultisample(GL_RENDERBUFFER, 4, GL_DEPTH24_STENCIL8, SCR_WIDTH, SCR_HEIGHT);
-    glBindRenderbuffer(GL_RENDERBUFFER, 0);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rbo);
-
-    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE){
-        std::cerr << "ERROR: FRAMEBUFFER\n";
-    }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    brickShader.whenReady([](Shader &shader) {
+        shader.setInt("diffuseMap", 0);
+        shader.setInt("normalMap", 1);
+        shader.setInt("depthMap", 2);
+        //shader.setInt("specularMap", 3);
+    });
 
 
+    // every render target now comes from the frame graph's pool, see the render loop
+    rg::FrameGraph frameGraph;
 
-    antiAliasingShader.use();
-    antiAliasingShader.setInt("screenTex", 0);
+    // the scene is multisampled into textures, both limits apply
+    GLint maxColorSamples, maxDepthSamples;
+    glGetIntegerv(GL_MAX_COLOR_TEXTURE_SAMPLES, &maxColorSamples);
+    glGetIntegerv(GL_MAX_DEPTH_TEXTURE_SAMPLES, &maxDepthSamples);
+    const int maxSceneSamples = std::max(1, std::min(maxColorSamples, maxDepthSamples));
 
-    hdrShader.use();
-    hdrShader.setInt("scene", 0);
-    hdrShader.setInt("bloomBlur", 1);
 
-    blurShader.use();
-    blurShader.setInt("image", 0);
 
     // draw in wireframe
     //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
+    // the warmed variants that are never bound only get finished here and in the loop
+    auto pollShaderVariants = [&]() {
+        modelShaders.poll();
+        deferredLightingShaders.poll();
+        postChain.poll();
+    };
+    std::cout << "SHADER::" << modelShaders.readyCount() + deferredLightingShaders.readyCount()
+                               + postChain.postShaders().readyCount() << " of "
+              << modelShaders.compiledCount() + deferredLightingShaders.compiledCount()
+                 + postChain.postShaders().compiledCount()
+              << " variants ready after asset loading" << std::endl;
+    pollShaderVariants();
+
     float h = 0;
-    typedef struct{
-        glm::vec3 trans;
-        glm::vec3 skal;
-        glm::vec3 rotatV;
-        float rotatU;
-    }triD;
     vector<triD>winPos(3);
     winPos.push_back({glm::vec3(-1.25f,1.75f,-3.25f), glm::vec3(0.39f,0.45f,0.4f), glm::vec3(1.0, 0, 0) ,43.0f});
     winPos.push_back({glm::vec3(-1.25f,3.05f,2.35f), glm::vec3(0.39f,0.45f,0.4f), glm::vec3(1.0, 0, 0) ,43.0f});
     winPos.push_back({glm::vec3(3.2753f,1.72f,1.35f), glm::vec3(0.39f,0.45f,0.4f), glm::vec3(0.0f, 0.0f, 1.0f) ,43.0f});
+
+    // local bounds of every scene object, and the model it draws; the floor and the windows
+    // are drawn from their own vertex arrays
+    Model *sceneModels[SCENE_OBJECT_COUNT] = {
+            &houseModel, &modelLamp, &snowModel, &snowModel2, &snowModel3, &mt1Model, &mt2Model, &mt3Model,
+            &modelTree, &modelTree2, &modelRock, &modelSled, &modelFence, &modelFence2, &modelFence3, nullptr,
+            &bedModel, &tableModel, &shackModel, &lanternModel, &snowManModel, nullptr};
+    glm::vec4 sceneBounds[SCENE_OBJECT_COUNT];
+    for (int object = 0; object < SCENE_OBJECT_COUNT; ++object)
+        sceneBounds[object] = sceneObjectBounds((SceneObject) object, sceneModels[object]);
+
+    // the house, terrain, mountains and props, then the windows, as the items of one frame's
+    // command list: model matrices, materials, bounds and draw order. Item by item they are
+    // prepared across the pool while the GL thread submits the frame before, and read nothing
+    // but the input, the tables above and winPos, none of which change after loading.
+    const size_t sceneItems = FIRST_WINDOW_ITEM + winPos.size();
+
+    FrameDraws frameDraws;
+    frameDraws.models = sceneModels;
+    frameDraws.floorVAO = planeVAO;
+    frameDraws.floorTexture = planeTexture;
+
+    rg::ImageValidation imageValidation;
+    // the draws inside the scene pass; the frame graph times every pass on its own
+    const int skyboxScope = rg::profiler().scope("Skybox");
+    const int depthPrePassScope = rg::profiler().scope("Depth pre-pass");
+    const int opaqueModelsScope = rg::profiler().scope("Opaque models");
+    const int deferredLightingScope = rg::profiler().scope("Deferred lighting");
+    const int bellScope = rg::profiler().scope("Bell");
+    const int parallaxWallsScope = rg::profiler().scope("Parallax walls");
+    const int rugScope = rg::profiler().scope("Rug");
+    const int windowsScope = rg::profiler().scope("Windows");
+    // what the user had selected while a validation run overrides it
+    bool userLeanTargetFormats = true, userSrgbPipeline = true;
+    bool srgbDecode = true;
+    int benchmarkFrame = 0;
+    int frameNumber = 0;
+    // a replay feeds the events the recording saw where the real ones arrive, after polling;
+    // the first call takes those that came in before the first frame
+    auto dispatchReplayedEvents = [window]() {
+        if (!inputLog.replaying())
+            return;
+        rg::InputLog::Event event;
+        dispatchingReplay = true;
+        while (inputLog.nextEvent(event)) {
+            if (event.type == rg::InputLog::KEY)
+                key_callback(window, event.key, event.scancode, event.action, event.mods);
+            else if (event.type == rg::InputLog::CURSOR)
+                mouse_callback(window, event.x, event.y);
+            else if (event.type == rg::InputLog::SCROLL)
+                scroll_callback(window, event.x, event.y);
+            else if (event.type == rg::InputLog::BUTTON)
+                mouse_button_callback(window, event.key, event.action, event.mods);
+            else if (event.type == rg::InputLog::CHAR)
+                char_callback(window, (unsigned int) event.key);
+        }
+        dispatchingReplay = false;
+    };
+    dispatchReplayedEvents();
+    // benchmark and replay runs go as fast as they can, everything else is paced
+    rg::FramePacer framePacer;
+    bool paced = !benchmark.enabled && !inputLog.replaying();
+    int swapInterval = 0;
+    if (paced) {
+        GLFWmonitor *monitor = glfwGetPrimaryMonitor();
+        const GLFWvidmode *mode = monitor ? glfwGetVideoMode(monitor) : nullptr;
+        framePacer.setRefreshRate(mode ? mode->refreshRate : 0);
+        programState->adaptiveSwapSupported = glfwExtensionSupported("WGL_EXT_swap_control_tear")
+                                              || glfwExtensionSupported("GLX_EXT_swap_control_tear");
+        swapInterval = programState->framePacing.swapInterval;
+        glfwSwapInterval(swapInterval);
+    }
+    rg::FrameCache frameCache;
+    bool wasIconified = false;
+    float lastAdaptedExposure = 0.0f;
+    // the null GL's counts start with the first recorded frame, its per-frame counts at the
+    // same point as the frame's CPU time
+    rg::resetNullGLCalls();
+    unsigned long long glCallsAtFrameStart = 0, stateChangesAtFrameStart = 0;
     // render loop
     // -----------
     while (!glfwWindowShouldClose(window)) {
+        if (benchmark.enabled && benchmarkFrame == benchmark.warmupFrames + benchmark.frames)
+            break;
+        pollShaderVariants();
+        // the --trace window; F9 records by hand as well
+        if (!benchmark.tracePath.empty()) {
+            if (frameNumber == benchmark.traceStart && !rg::tracer().recording())
+                rg::tracer().start();
+            if (frameNumber == benchmark.traceStart + benchmark.traceFrames)
+                rg::tracer().write(benchmark.tracePath);
+        }
+        // a minimised window, or one whose image has been still for a while, renders nothing
+        // and sleeps until an event or the wake-up timeout; a still one woken without a change
+        // shows its last frame again. Out of focus, frames come at a reduced rate.
+        if (paced) {
+            const rg::IdleThrottleSettings &throttling = programState->idleThrottle;
+            bool iconified = glfwGetWindowAttrib(window, GLFW_ICONIFIED);
+            if (iconified != wasIconified)
+                idleThrottle.wake();
+            wasIconified = iconified;
+            // the exposure keeps adapting for a while after the scene changed
+            bool adapting = programState->autoExposure
+                            && std::fabs(programState->adaptedExposure - lastAdaptedExposure)
+                               > 1e-3f * lastAdaptedExposure;
+            lastAdaptedExposure = programState->adaptedExposure;
+            bool animating = programState->animate || adapting || imageValidation.active()
+                             || programState->imageValidationRequested;
+            rg::IdleThrottle::State state = idleThrottle.update(throttling, iconified,
+                                                                glfwGetWindowAttrib(window, GLFW_FOCUSED), animating);
+            if (state == rg::IdleThrottle::ICONIFIED || state == rg::IdleThrottle::IDLE) {
+                glfwWaitEventsTimeout(throttling.idleWakeSeconds);
+                if (state == rg::IdleThrottle::IDLE && !idleThrottle.woken()
+                    && frameCache.present(framebufferWidth, framebufferHeight)) {
+                    glfwSwapBuffers(window);
+                    idleThrottle.represented();
+                }
+                // the simulation doesn't make up for the time it stood still
+                lastFrame = glfwGetTime();
+                continue;
+            }
+            if (state == rg::IdleThrottle::UNFOCUSED) {
+                double next = lastFrame + 1.0 / std::max(throttling.unfocusedFrameRate, 1);
+                while (glfwGetTime() < next && !idleThrottle.woken() && !glfwWindowShouldClose(window))
+                    glfwWaitEventsTimeout(next - glfwGetTime());
+            }
+        }
+        // before the frame's clock starts: the wait for the GPU and the limiter aren't its work
+        bool lateInput = paced && programState->framePacing.lateInput;
+        if (paced) {
+            if (programState->framePacing.swapInterval != swapInterval) {
+                swapInterval = programState->framePacing.swapInterval;
+                glfwSwapInterval(swapInterval);
+            }
+            framePacer.wait(programState->framePacing);
+            programState->framePacingStats = framePacer.stats();
+        }
+        ++frameNumber;
+        auto frameStart = std::chrono::steady_clock::now();
+        glCallsAtFrameStart = rg::nullGLCalls();
+        stateChangesAtFrameStart = rg::nullGLStateChanges();
         // per-frame time logic
         // --------------------
+        rg::profiler().setEnabled(programState->profiler || benchmark.nullGL);
+        rg::profiler().beginFrame();
         float currentFrame = glfwGetTime();
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
 
         // input
         // -----
-        processInput(window);
+        if (benchmark.enabled) {
+            // the warm-up holds the first key; after it the path advances by frame, not by time
+            int recorded = std::max(benchmarkFrame - benchmark.warmupFrames, 0);
+            float step = cameraPath.duration() / std::max(benchmark.frames - 1, 1);
+            rg::CameraPath::Key key = cameraPath.sample(recorded * step);
+            programState->camera.Position = key.position;
+            programState->camera.Yaw = key.yaw;
+            programState->camera.Pitch = key.pitch;
+            programState->camera.ProcessMouseMovement(0.0f, 0.0f);
+            deltaTime = step;
+            rg::DrawCounter::take();
+        } else {
+            // a replay steps the simulation by a fixed time, whatever the real frame took
+            if (inputLog.replaying()) {
+                float recordedDelta = 0.0f;
+                if (!inputLog.nextFrame(recordedDelta))
+                    break;
+                deltaTime = benchmark.replayStep > 0.0f ? benchmark.replayStep : recordedDelta;
+                rg::DrawCounter::take();
+            } else if (inputLog.recording() && !lateInput) {
+                inputLog.recordFrame(currentFrame, deltaTime, inputLog.heldKeys([window](int key) {
+                    return glfwGetKey(window, key) == GLFW_PRESS;
+                }));
+            }
+            if (!lateInput)
+                processInput(window);
+        }
 
+        // a validation run renders its next frames under fixed configurations and diffs them:
+        // the old pipeline, the lean formats alone, then the sRGB pipeline on top of them
+        if (programState->imageValidationRequested) {
+            programState->imageValidationRequested = false;
+            userLeanTargetFormats = programState->leanTargetFormats;
+            userSrgbPipeline = programState->srgbPipeline;
+            imageValidation.start({"reference", "r11g11b10", "srgb"});
+        }
+        if (imageValidation.active()) {
+            programState->leanTargetFormats = imageValidation.step() > 0;
+            programState->srgbPipeline = imageValidation.step() > 1;
+        }
+        // alpha is never read from the HDR targets, and R11F_G11F_B10F is half of RGBA16F
+        GLenum hdrFormat = programState->leanTargetFormats ? GL_R11F_G11F_B10F : GL_RGBA16F;
+        // sRGB writes are encoded in hardware where the target allows it, so the post shader
+        // only has to encode for a back buffer that isn't sRGB
+        bool hardwareEncoding = programState->srgbPipeline && srgbBackbuffer;
+        if (programState->srgbPipeline != srgbDecode) {
+            srgbDecode = programState->srgbPipeline;
+            setSRGBDecode(srgbDecode);
+        }
+        if (programState->srgbPipeline)
+            glEnable(GL_FRAMEBUFFER_SRGB);
+        else
+            glDisable(GL_FRAMEBUFFER_SRGB);
+
+
+        // the luminance measured a few frames ago, if it has arrived; the timing is the CPU
+        // cost of the read-back, which only ever maps buffers the GPU has finished with
+        if (programState->autoExposure && !imageValidation.active()) {
+            auto readbackStart = std::chrono::steady_clock::now();
+            programState->adaptedExposure = postChain.autoExposure().update(deltaTime, programState->exposureCompensation,
+                                                                programState->adaptationSpeed,
+                                                                inputLog.replaying());
+            programState->autoExposureReadbackUs = std::chrono::duration<double, std::micro>(
+                    std::chrono::steady_clock::now() - readbackStart).count();
+            programState->averageLuminance = postChain.autoExposure().averageLuminance();
+            programState->exposureLatency = postChain.autoExposure().latency();
+            programState->exposureReadbacks = postChain.autoExposure().readbacks();
+            programState->exposureDropped = postChain.autoExposure().dropped();
+        }
 
         // render
         // ------
         glClearColor(0.1,0.1,0.1, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        /*glBindFramebuffer(GL_FRAMEBUFFER, msFBO);
-        glClearColor(0.1,0.1,0.1, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glEnable(GL_DEPTH_TEST);*/
-
 
+        // the scene renders into the bottom-left of full-size targets, scaled down while the
+        // GPU misses the frame-time target, and the upscale pass brings it back to full size;
+        // the targets themselves never change size with the scale
+        float renderScale = 1.0f;
+        // held while validating or replaying, so the frames don't depend on GPU timing
+        if (programState->dynamicResolution && (imageValidation.active() || inputLog.replaying()))
+            renderScale = dynamicResolution.scale();
+        else if (programState->dynamicResolution)
+            // a frame whose GPU time is late holds the scale rather than counting the old one twice
+            renderScale = dynamicResolution.update(gpuFrameTimer.fresh() ? gpuFrameTimer.lastMs() : 0.0,
+                                                   programState->targetFrameMs,
+                                                   programState->minRenderScale, programState->maxRenderScale);
+        else
+            dynamicResolution.reset();
+        renderWidth = std::max(1u, (unsigned int) (framebufferWidth * renderScale + 0.5f));
+        renderHeight = std::max(1u, (unsigned int) (framebufferHeight * renderScale + 0.5f));
+        programState->renderScale = renderScale;
+
+        // late input: the events and keys as of now, just before the camera is built, rather
+        // than as of the end of the last frame; a recording logs the frame here, so that the
+        // events polled now belong to the frame before, as they would without late input
+        if (lateInput) {
+            glfwPollEvents();
+            if (inputLog.recording())
+                inputLog.recordFrame(currentFrame, deltaTime, inputLog.heldKeys([window](int key) {
+                    return glfwGetKey(window, key) == GLFW_PRESS;
+                }));
+            processInput(window);
+        }
+        if (paced)
+            framePacer.inputSampled();
         glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom),
-                                                (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
+                                                (float) framebufferWidth / (float) framebufferHeight, 0.1f, 100.0f);
         glm::mat4 view = programState->camera.GetViewMatrix();
-
-
-        //skybox rendering
-        glDepthMask(GL_FALSE);
-
-        skyShader.use();
-
-        glm::mat4 viewCube = glm::mat4(glm::mat3(view));
-
-        //glm::mat4 skyModel = glm::mat4(1.0f);
-        //skyModel = glm::translate(skyModel, glm::vec3(0.0f, 0.0f, 0.0f));
-
-        glm::mat4 skyModel = glm::mat4(1.0f);
-        skyModel = glm::rotate(skyModel, glm::radians(0.01f * (h)), glm::vec3(0.3f, 1.0f, 1.0f));
-        h++;
-        if(h > 36000){
-            h = 0;
+        // TAA shifts every draw by a different sub-pixel offset each frame
+        glm::mat4 unjitteredProjection = projection;
+        if (programState->antiAliasing == TAA_ANTI_ALIASING) {
+            glm::vec2 jitter = postChain.temporalAA().beginFrame(framebufferWidth, framebufferHeight, renderWidth,
+                                                                 renderHeight);
+            projection[2][0] += jitter.x;
+            projection[2][1] += jitter.y;
+        } else {
+            postChain.temporalAA().release();
         }
 
-        skyShader.setMat4("view", viewCube);
-        skyShader.setMat4("projection", projection);
-        skyShader.setMat4("model", skyModel);
-        // skybox cube
-        glBindVertexArray(skyboxVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
-
-        glDepthMask(GL_TRUE);
-
-
-
-
-
-        // house rendering
-        modelShader.use();
-
-        // directional light
-        modelShader.setVec3("dirLight.direction", dirLight.direction);
-        modelShader.setVec3("dirLight.ambient", dirLight.ambient);
-        modelShader.setVec3("dirLight.diffuse", dirLight.diffuse);
-        modelShader.setVec3("dirLight.specular", dirLight.specular);
-
-        //point light
-        pointLight.position = glm::vec3(0.0f, 2.4635f, 2.12f);
-        modelShader.setVec3("pointLight.position", pointLight.position);
-        modelShader.setVec3("pointLight.ambient", glm::vec3(0.85f, 0.25f, 0.0f));
-        modelShader.setVec3("pointLight.diffuse", glm::vec3(0.65f, 0.25f, 0.1f));
-        //modelShader.setVec3("pointLight.specular", glm::vec3(1.0f, 1.0f, 1.0f));
-        modelShader.setVec3("pointLight.specular", glm::vec3(1.0f, 0.45f, 0.4f));
-        modelShader.setFloat("pointLight.constant", pointLight.constant);
-        modelShader.setFloat("pointLight.linear", pointLight.linear);
-        modelShader.setFloat("pointLight.quadratic", pointLight.quadratic);
-
-
-        //lamp point light
-        lampPointLight.position = glm::vec3(programState->lampLightPosition);
-        modelShader.setVec3("lampPointLight.position", lampPointLight.position);
-        modelShader.setVec3("lampPointLight.ambient", glm::vec3(0.85f, 0.25f, 0.0f));
-        modelShader.setVec3("lampPointLight.diffuse", glm::vec3(0.65f, 0.25f, 0.1f));
-        modelShader.setVec3("lampPointLight.specular", glm::vec3(1.0f, 0.35, 0.35));
-        modelShader.setFloat("lampPointLight.constant", lampPointLight.constant);
-        modelShader.setFloat("lampPointLight.linear", lampPointLight.linear);
-        modelShader.setFloat("lampPointLight.quadratic", lampPointLight.quadratic);
-        modelShader.setVec3("viewPosition", programState->camera.Position);
-        modelShader.setFloat("material.shininess", 32.0f);
-
-        //spot light
-        modelShader.setVec3("spotLight.direction", glm::vec3(0.0f,-1.0f,0.0f));
-        modelShader.setVec3("spotLight.position", glm::vec3(10.25, 7.25,13.25));
-        modelShader.setVec3("spotLight.ambient", spotLight.ambient);
-        modelShader.setVec3("spotLight.diffuse", glm::vec3(0.85f, 0.25f, 0.0f));
-        modelShader.setVec3("spotLight.specular", spotLight.specular);
-        modelShader.setFloat("spotLight.constant", spotLight.constant);
-        modelShader.setFloat("spotLight.linear", spotLight.linear);
-        modelShader.setFloat("spotLight.quadratic", spotLight.quadratic);
-        modelShader.setFloat("spotLight.cutOff", spotLight.cutOff);
-        modelShader.setFloat("spotLight.outerCutOff", spotLight.outerCutOff);
-
-        modelShader.setMat4("projection", projection);
-        modelShader.setMat4("view", view);
-
-        //transforming models
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(0.0f));
-        model = glm::scale(model, glm::vec3(0.8f));
-
-        modelShader.setMat4("model", model);
-        houseModel.Draw(modelShader);
-
-        //lamp
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(10.f, -1.0f, 12.0f));
-        model = glm::scale(model, glm::vec3(0.3f));
-        model = glm::rotate(model, glm::radians(-180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-
-        modelShader.setMat4("model", model);
-        modelLamp.Draw(modelShader);
-
-        //snow pile rendering
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(4.f, 0.0f, -20.0f));
-        model = glm::scale(model, glm::vec3(4.0f));
-        modelShader.setMat4("model", model);
-        snowModel.Draw(modelShader);
-
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(4.f, 0.0f, -20.0f));
-        model = glm::scale(model, glm::vec3(4.0f));
-        modelShader.setMat4("model", model);
-        snowModel2.Draw(modelShader);
-
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(4.f, 0.0f, -20.0f));
-        model = glm::scale(model, glm::vec3(4.0f));
-        modelShader.setMat4("model", model);
-        snowModel3.Draw(modelShader);
-
-
-
-        //mountains
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, programState->mountainPosition);
-        model = glm::rotate(model, glm::radians(programState->angleMountain1), glm::vec3(0.0f, 1.0f, 0.0f));
-        model = glm::scale(model, glm::vec3(programState->mountainScale));
-
-        modelShader.setMat4("model", model);
-        mt1Model.Draw(modelShader);
-
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, programState->mountainPosition2);
-        model = glm::rotate(model, glm::radians(programState->angleMountain2), glm::vec3(0.0f, 1.0f, 0.0f));
-        model = glm::scale(model, glm::vec3(programState->mountainScale2));
-
-        modelShader.setMat4("model", model);
-        mt2Model.Draw(modelShader);
-
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, programState->mountainPosition3);
-        model = glm::rotate(model, glm::radians(programState->angleMountain3), glm::vec3(0.0f, 1.0f, 0.0f));
-        model = glm::scale(model, glm::vec3(programState->mountainScale3));
-
-        modelShader.setMat4("model", model);
-        mt3Model.Draw(modelShader);
-
-        //trees
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-10.0f, 0.0f, 15.0f));
-        model = glm::scale(model, glm::vec3(0.09));
-        modelShader.setMat4("model",model);
-        modelTree.Draw(modelShader);
-
-
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(3.0f, 0.0f, 25.0f));
-        model = glm::scale(model, glm::vec3(0.09));
-        modelShader.setMat4("model",model);
-        modelTree2.Draw(modelShader);
-
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(8.0f, 0.0f, -9.0f));
-        model = glm::scale(model, glm::vec3(0.09));
-        modelShader.setMat4("model",model);
-        modelTree2.Draw(modelShader);
-
-
-
-        //rock
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-14.0f,1.0f,-10.0f));
-        model = glm::scale(model, glm::vec3(0.5f));
-        modelShader.setMat4("model",model);
-        modelRock.Draw(modelShader);
-
-
-        //sled
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(3.0f, 0.2f, 11.0f));
-        model = glm::scale(model, glm::vec3(5.0f));
-        model = glm::rotate(model, glm::radians(45.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        modelShader.setMat4("model",model);
-        modelSled.Draw(modelShader);
-
-        //fence
-
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-6.0f,0.0f,23.0f));
-        model = glm::scale(model, glm::vec3(4.0));
-        modelShader.setMat4("model",model);
-        modelFence2.Draw(modelShader);
-
-
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-6.0f, 0.0f, -15.0f));
-        model = glm::scale(model, glm::vec3(4.0));
-        modelShader.setMat4("model",model);
-        modelFence.Draw(modelShader);
-
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-16.0f, 0.0f, -5.0f));
-        model = glm::scale(model, glm::vec3(4.0));
-        model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        modelShader.setMat4("model",model);
-        modelFence3.Draw(modelShader);
-
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-16.0f, 0.0f, 13.0f));
-        model = glm::scale(model, glm::vec3(4.0));
-        model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        modelShader.setMat4("model",model);
-        modelFence3.Draw(modelShader);
-
-        //plane rendering
-        glDisable(GL_CULL_FACE);
-        model = glm::mat4(1.0f);
-        model = glm::scale(model, glm::vec3(30.0f, 30.0f, 30.0f));
-        model = glm::translate(model, glm::vec3(4.0f, 0.505f, 0.0f));
-        modelShader.setMat4("model", model);
-        glBindVertexArray(planeVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, planeTexture);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-
-
-
-
-
-        //bed rendering
-        modelShader.use();
-        modelShader.setVec3("pointLight.position", programState->pointLight.position);
-        modelShader.setMat4("projection", projection);
-        modelShader.setMat4("view", view);
-
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-3.0f, 2.0f, 2.1f));
-        model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        model = glm::scale(model, glm::vec3(0.12f, 0.12f, 0.12f));
-        modelShader.setFloat("material.shininess", 5);
-        modelShader.setMat4("model", model);
-        bedModel.Draw(modelShader);
-
-
-
-        //table rendering
-        modelShader.use();
-        modelShader.setVec3("pointLight.position", programState->pointLight.position);
-        modelShader.setMat4("projection", projection);
-        modelShader.setMat4("view", view);
-
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(0.5f, 2.45f, 2.0f));
-        model = glm::rotate(model, glm::radians(-9.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        model = glm::scale(model, glm::vec3(0.01f, 0.01f, 0.014f));
-        modelShader.setFloat("material.shininess", 48);
-        modelShader.setMat4("model", model);
-        tableModel.Draw(modelShader);
-
-
-        //shack rendering
-        modelShader.use();
-        modelShader.setVec3("pointLight.position", glm::vec3(-12.5f, 2.2f, -12.0f));
-        modelShader.setMat4("projection", projection);
-        modelShader.setMat4("view", view);
-
-        model = glm::mat4(1.0f);
-
-        model = glm::translate(model, glm::vec3(-16.2f, 0.2f, -22.0f));
-        model = glm::rotate(model, glm::radians(47.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        model = glm::scale(model, glm::vec3(0.023f, 0.023f, 0.023f));
-
-        modelShader.setMat4("model", model);
-        shackModel.Draw(modelShader);
-
-
-
-        //mt rendering
-        modelShader.use();
-        modelShader.setVec3("pointLight.position", glm::vec3(-12.5f, 2.2f, 32.0f));
-        modelShader.setMat4("projection", projection);
-        modelShader.setMat4("view", view);
-
-        model = glm::mat4(1.0f);
-
-        model = glm::translate(model, glm::vec3(programState->modelPosition));
-        model = glm::rotate(model, glm::radians(47.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        model = glm::scale(model, glm::vec3(10.0f, 7.0f, 10.0f));
-
-        modelShader.setMat4("model", model);
-        mt1Model.Draw(modelShader);
-
-
-
-        model = glm::mat4(1.0f);
-
-        model = glm::translate(model, glm::vec3(100.0f, -3.0f, -53.0f));
-        model = glm::rotate(model, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        model = glm::scale(model, glm::vec3(23.0f, 10.0f, 10.0f));
-
-        modelShader.setMat4("model", model);
-        mt1Model.Draw(modelShader);
-
-
-        model = glm::mat4(1.0f);
-
-        model = glm::translate(model, glm::vec3(50.0f, -10.0f, -63.0f));
-        model = glm::rotate(model, glm::radians(-43.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        model = glm::scale(model, glm::vec3(23.0f, 10.0f, 10.0f));
-
-        modelShader.setMat4("model", model);
-        mt1Model.Draw(modelShader);
-
-
-
-        model = glm::mat4(1.0f);
-
-        model = glm::translate(model, glm::vec3(70.0f, -5.0f, 20.0f));
-        model = glm::rotate(model, glm::radians(-43.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        model = glm::scale(model, glm::vec3(0.2f, 5.0f, 10.0f));
-
-        modelShader.setMat4("model", model);
-        mt1Model.Draw(modelShader);
-
-
-
-
-
-        //lantern rendering
-        modelShader.use();
-
-        modelShader.setVec3("pointLight.position", glm::vec3(0.0f, 2.4635f, 2.12f));
-
-        modelShader.setVec3("pointLight.ambient", glm::vec3(1.0f, 0.45f, 0.0f));
-        modelShader.setVec3("pointLight.diffuse", glm::vec3(1.0f, 0.45f, 0.0f));
+        // the draws of the frame; pipelined, these were prepared from the last frame's state
+        ScenePrepInput prepInput = scenePrepInput(programState);
+        frameDraws.commands = &framePrep.next(sceneItems, [&sceneBounds, &winPos, prepInput](size_t item,
+                                                                                             rg::CommandList &list) {
+            prepareSceneItem(prepInput, item, sceneBounds, winPos, list);
+        }, programState->pipelinedPrep);
+        frameDraws.frustum = rg::Frustum::fromMatrix(unjitteredProjection * view);
+        programState->prepBuildMs = programState->prepBuildMs * 0.95 + framePrep.buildMs() * 0.05;
+        programState->prepWaitMs = programState->prepWaitMs * 0.95 + framePrep.waitMs() * 0.05;
+
+        rg::ClusterGridConfig clusterConfig = rg::ClusterGridConfig::fromPerspective(
+                glm::radians(programState->camera.Zoom), (float) framebufferWidth / (float) framebufferHeight,
+                0.1f, 100.0f);
+        collectSceneLights(sceneLights);
+        rg::addScatteredLights(sceneLights, programState->extraLights);
+        lightGridBuilder.build(clusterConfig, view, sceneLights, lightGrid);
+        lightGridBuffers.upload(sceneLights, lightGrid);
+
+        // house, terrain, mountains and props
+        unsigned int lightFeatures = (programState->dirLightEnabled ? DIR_LIGHT_FEATURE : 0)
+                                     | (!sceneLights.empty() ? LOCAL_LIGHTS_FEATURE : 0);
+        lightGridBuffers.bind(LIGHT_GRID_TEXTURE_UNIT);
+
+        // optional depth pre-pass, then the lit models into the bound target: the G-buffer
+        // attributes when deferred, the shaded colour when forward
+        auto drawLitPass = [&]() {
+            if (programState->depthPrePass) {
+                // depth from the position-only streams first, so the colour pass below shades
+                // each visible pixel once instead of every overdrawn fragment
+                rg::profiler().begin(depthPrePassScope);
+                glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+                depthOnlyShader.use();
+                depthOnlyShader.setMat4("projection", projection);
+                depthOnlyShader.setMat4("view", view);
+                drawLitModels(depthOnlyShader, true, frameDraws);
+                glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+                rg::profiler().end();
+                glDepthFunc(GL_EQUAL);
+                glDepthMask(GL_FALSE);
+            }
+
+            rg::profiler().begin(opaqueModelsScope);
+            shadedFragments.begin();
+            if (programState->deferredShading) {
+                // geometry pass: material attributes only, blending would mix the packed channels
+                glDisable(GL_BLEND);
+                gBufferShader.use();
+                gBufferShader.setMat4("projection", projection);
+                gBufferShader.setMat4("view", view);
+                drawLitModels(gBufferShader, false, frameDraws);
+                glEnable(GL_BLEND);
+            } else {
+                Shader &modelShader = modelShaders.get(lightFeatures);
+                modelShader.use();
+                setSceneLighting(modelShader, clusterConfig);
+                modelShader.setMat4("projection", projection);
+                modelShader.setMat4("view", view);
+                drawLitModels(modelShader, false, frameDraws);
+            }
+            shadedFragments.end();
+            rg::profiler().end();
+            programState->shadedFragments = shadedFragments.average();
+
+            if (programState->depthPrePass) {
+                glDepthFunc(GL_LESS);
+                glDepthMask(GL_TRUE);
+            }
+        };
 
-        modelShader.setMat4("projection", projection);
-        modelShader.setMat4("view", view);
+        // the passes are declared again every frame with the targets they read and write;
+        // the graph drops the ones nothing consumes and sizes the targets from the window
+        frameGraph.reset();
+        rg::FrameGraph::Resource backbuffer = frameGraph.importTexture(
+                "backbuffer", benchmarkTarget, rg::TextureDesc(framebufferWidth, framebufferHeight, GL_RGBA8));
+        rg::FrameGraph::Resource hdrColor = frameGraph.createTexture(
+                "hdrColor", rg::TextureDesc(framebufferWidth, framebufferHeight, hdrFormat));
+        // forward shading draws the scene multisampled and resolves it into hdrColor; the deferred
+        // lighting pass shades from single-sample G-buffer attributes, so it stays at one sample
+        unsigned int sceneSamples = programState->deferredShading || programState->antiAliasing != MSAA_ANTI_ALIASING
+                                    ? 1 : (unsigned int) std::min(programState->msaaSamples, maxSceneSamples);
+        rg::FrameGraph::Resource sceneColor = sceneSamples > 1 ? frameGraph.createTexture(
+                "sceneColor", rg::TextureDesc(framebufferWidth, framebufferHeight, hdrFormat, sceneSamples))
+                                                               : hdrColor;
+        // the G-buffer depth too, the forward objects drawn after the lighting pass test against it
+        rg::FrameGraph::Resource sceneDepth = frameGraph.createTexture(
+                "sceneDepth", rg::TextureDesc(framebufferWidth, framebufferHeight, GL_DEPTH_COMPONENT24, sceneSamples));
+
+        //G-buffer for the deferred path: 8 bytes of material per pixel plus depth, no position;
+        //linear albedo is stored sRGB-encoded so the darks keep their precision
+        rg::FrameGraph::Resource gAlbedoSpec = -1, gNormalShininess = -1;
+        if (programState->deferredShading) {
+            gAlbedoSpec = frameGraph.createTexture(
+                    "gAlbedoSpec", rg::TextureDesc(framebufferWidth, framebufferHeight,
+                                                   programState->srgbPipeline ? GL_SRGB8_ALPHA8 : GL_RGBA8));
+            gNormalShininess = frameGraph.createTexture(
+                    "gNormalShininess", rg::TextureDesc(framebufferWidth, framebufferHeight, GL_RGB10_A2));
+            frameGraph.addPass("G-buffer", [&](rg::FrameGraph::PassBuilder &pass) {
+                pass.write(gAlbedoSpec);
+                pass.write(gNormalShininess);
+                pass.write(sceneDepth);
+            }, [&](const rg::FrameGraph::PassContext &ctx) {
+                litPassTimer.begin();
+                ctx.bindTarget({gAlbedoSpec, gNormalShininess}, sceneDepth);
+                glViewport(0, 0, renderWidth, renderHeight);
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                drawLitPass();
+            });
+        }
 
+        frameGraph.addPass("Scene", [&](rg::FrameGraph::PassBuilder &pass) {
+            pass.read(gAlbedoSpec);
+            pass.read(gNormalShininess);
+            pass.write(sceneColor);
+            pass.write(sceneDepth);
+        }, [&](const rg::FrameGraph::PassContext &ctx) {
+            if (programState->deferredShading) {
+                // the lighting pass samples the depth, it is attached again once that is done
+                ctx.bindTarget({sceneColor});
+                glClear(GL_COLOR_BUFFER_BIT);
+            } else {
+                ctx.bindTarget({sceneColor}, sceneDepth);
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            }
+            glViewport(0, 0, renderWidth, renderHeight);
+
+            //skybox rendering
+            rg::profiler().begin(skyboxScope);
+            drawSkybox(skyShader, skyboxVAO, cubemapTexture, projection, view, h);
+            // held still while validation compares frames; it advances by simulation time,
+            // one step per 60th of a second, so a replay at a fixed step always lands on the same h
+            if (!imageValidation.active() && programState->animate)
+                h += 60.0f * deltaTime;
+            if(h > 36000){
+                h -= 36000;
+            }
+            rg::profiler().end();
+
+
+            if (programState->deferredShading) {
+                // lighting pass: one screen quad over the sky, every pixel looks up its own cluster
+                rg::profiler().begin(deferredLightingScope);
+                drawDeferredLighting(deferredLightingShaders.get(lightFeatures), clusterConfig, projection, view,
+                                     ctx.texture(gAlbedoSpec), ctx.texture(gNormalShininess), ctx.texture(sceneDepth),
+                                     quadVAO);
+                rg::profiler().end();
+
+                // the forward-shaded objects below (bell, walls, rug, windows) test against the G-buffer depth
+                glActiveTexture(GL_TEXTURE2);
+                glBindTexture(GL_TEXTURE_2D, 0);
+                glActiveTexture(GL_TEXTURE0);
+                ctx.bindTarget({sceneColor}, sceneDepth);
+                glViewport(0, 0, renderWidth, renderHeight);
+            } else {
+                litPassTimer.begin();
+                drawLitPass();
+            }
+            litPassTimer.end();
+            programState->litPassMs = litPassTimer.averageMs();
+            sceneTimer.begin();
+
+            //bell rendering (reflective surface)
+            rg::profiler().begin(bellScope);
+            drawBell(reflectShader, bellModel, cubemapTexture, projection, view, programState->camera.Position, h);
+            rg::profiler().end();
+
+            //normal/parallax supported rendering
+            rg::profiler().begin(parallaxWallsScope);
+            drawParallaxWalls(brickShader, brickTextureDiff, brickTextureNormal, brickTextureDisp, projection, view,
+                              programState->camera.Position, programState->pointLight.ambient);
+            rg::profiler().end();
+
+            //rug rendering with normal maps
+            rg::profiler().begin(rugScope);
+            drawRug(rugShader, rugTextureDiff, rugTextureNormal, projection, view, programState->camera.Position);
+            rg::profiler().end();
+
+            glEnable(GL_CULL_FACE);
+
+            //transparent objects are rendered last
+            //windows rendering
+            rg::profiler().begin(windowsScope);
+            drawWindows(windowShader, windowVAO, windowTexture, projection, view, frameDraws);
+            rg::profiler().end();
+            sceneTimer.end();
+            programState->sceneMs = sceneTimer.averageMs();
+        });
 
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(0.0f, 2.4635f, 2.12f));
-        model = glm::rotate(model, glm::radians(43.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        model = glm::scale(model, glm::vec3(0.15f, 0.15f, 0.15f));
-        modelShader.setMat4("model", model);
-        lanternModel.Draw(modelShader);
+        // resolve, TAA, upscale, luminance, bloom, tonemap and FXAA, as far as they are enabled
+        rg::PostSettings post;
+        post.width = framebufferWidth;
+        post.height = framebufferHeight;
+        post.renderWidth = renderWidth;
+        post.renderHeight = renderHeight;
+        post.hdrFormat = hdrFormat;
+        post.sceneSamples = sceneSamples;
+        post.blitResolve = programState->msaaResolve == BLIT_RESOLVE;
+        post.temporalAA = programState->antiAliasing == TAA_ANTI_ALIASING;
+        post.fxaa = programState->antiAliasing == FXAA_ANTI_ALIASING;
+        post.upscale = programState->dynamicResolution;
+        post.tonemap = hdr;
+        post.autoExposure = programState->autoExposure;
+        post.bloom = bloom;
+        post.bloomMode = (rg::Bloom::Mode) programState->bloomMode;
+        post.bloomThreshold = programState->bloomThreshold;
+        post.exposure = programState->autoExposure ? programState->adaptedExposure : programState->exposure;
+        post.hardwareEncoding = hardwareEncoding;
+        // the old pipeline's 1.4, or close to sRGB for a back buffer that can't encode
+        post.gamma = programState->srgbPipeline ? 2.2f : 1.4f;
+        programState->colorGrading.grayscale = grayEffect;
+        post.grading = programState->colorGrading;
+        post.viewProjection = projection * view;
+        post.unjitteredViewProjection = unjitteredProjection * view;
+        postChain.addPasses(frameGraph, post, sceneColor, hdrColor, sceneDepth, backbuffer);
+
+        frameGraph.compile();
+        gpuFrameTimer.begin();
+        frameGraph.execute();
+        gpuFrameTimer.end();
+        programState->antiAliasingMs = postChain.antiAliasingMs();
+        programState->upscaleMs = postChain.upscaleMs();
+        programState->autoExposureMs = postChain.luminanceMs();
+        programState->bloomMs = postChain.bloomMs();
+        programState->bloomMegabytes = postChain.bloomMegabytes();
+        programState->postMs = postChain.postMs();
+        programState->postMegabytes = postChain.postMegabytes();
+        programState->separateGradingMegabytes = postChain.separateGradingMegabytes();
+        // before the UI goes on top
+        if (imageValidation.active()) {
+            imageValidation.capture(framebufferWidth, framebufferHeight);
+            if (!imageValidation.active()) {
+                programState->leanTargetFormats = userLeanTargetFormats;
+                programState->srgbPipeline = userSrgbPipeline;
+                programState->imageValidation = imageValidation.results();
+            }
+        }
+        if (inputLog.replaying() && benchmark.replayCapture > 0 && inputLog.frames() % benchmark.replayCapture == 0)
+            rg::Image::readBackbuffer(framebufferWidth, framebufferHeight)
+                    .writePPM("replay_" + std::to_string(inputLog.frames()) + ".ppm");
+        programState->gpuFrameMs = gpuFrameTimer.averageMs();
+        programState->framePasses = frameGraph.describe();
+        programState->renderTargetMegabytes = frameGraph.pooledBytes() / (1024.0 * 1024.0);
+        programState->unaliasedMegabytes = frameGraph.unaliasedBytes() / (1024.0 * 1024.0);
+        recordAntiAliasingStats(sceneSamples, hdrFormat, postChain.temporalAA().bytes());
 
 
+        if (programState->ImGuiEnabled) {
+            rg::ProfileScope imGuiScope("ImGui");
+            DrawImGui(programState);
+        }
 
 
-        //snowman :)
-        modelShader.use();
 
-        modelShader.setMat4("projection", projection);
-        modelShader.setMat4("view", view);
+        // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+        // -------------------------------------------------------------------------------
+        bool measured = benchmark.enabled || inputLog.replaying();
+        bool recorded = measured && benchmarkFrame++ >= benchmark.warmupFrames;
+        if (recorded) {
+            rg::DrawCounter::Counts counts = rg::DrawCounter::take();
+            rg::BenchmarkRecorder::Frame frame;
+            frame.frame = (int) benchmarkRecorder.size();
+            frame.cpuMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+            frame.gpuMs = gpuFrameTimer.lastMs();
+            frame.draws = counts.draws;
+            frame.vertices = counts.vertices;
+            frame.glCalls = (long long) (rg::nullGLCalls() - glCallsAtFrameStart);
+            frame.stateChanges = (long long) (rg::nullGLStateChanges() - stateChangesAtFrameStart);
+            frame.renderTargetMegabytes = programState->renderTargetMegabytes;
+            frame.residentMegabytes = rg::BenchmarkRecorder::residentMegabytes();
+            benchmarkRecorder.record(frame);
+        }
 
-        model  = glm::mat4(1.0f);
+        rg::profiler().endFrame();
+        if (benchmark.nullGL && recorded) {
+            for (int id = 0; id < rg::profiler().scopeCount(); ++id) {
+                long long count = rg::profiler().frameCount(id);
+                if (count >= 0)
+                    benchmarkRecorder.recordScopeStateChanges(rg::profiler().scopeName(id), count);
+            }
+        } else if (benchmark.nullGL && measured && benchmarkFrame == benchmark.warmupFrames) {
+            rg::resetNullGLCalls();
+        }
+        // a frame that may turn out to be the last before the window goes idle is kept
+        bool cached = paced && idleThrottle.cacheNext(programState->idleThrottle);
+        if (cached)
+            frameCache.store(framebufferWidth, framebufferHeight);
+        auto swapStart = std::chrono::steady_clock::now();
+        if (!benchmark.nullGL)
+            glfwSwapBuffers(window);
+        if (paced) {
+            framePacer.presented(swapStart);
+            idleThrottle.rendered(gpuFrameTimer.lastMs(), cached);
+        }
+        if (!lateInput)
+            glfwPollEvents();
+        dispatchReplayedEvents();
+    }
+    bool replayed = !benchmark.replayPath.empty();
+    if (replayed)
+        std::cout << "REPLAY:: " << inputLog.frames() << " frames from " << benchmark.replayPath << std::endl;
+    inputLog.stop();
+
+    // closed before the trace window was over
+    if (rg::tracer().recording())
+        rg::tracer().write(benchmark.tracePath.empty() ? "trace.json" : benchmark.tracePath);
+    int exitCode = 0;
+    if (benchmark.enabled || replayed) {
+        benchmark.width = framebufferWidth;
+        benchmark.height = framebufferHeight;
+        const char *renderer = (const char *) glGetString(GL_RENDERER);
+        if (benchmark.nullGL)
+            benchmarkRecorder.setGLCalls(rg::nullGLCallsByEntryPoint());
+        bool written = benchmarkRecorder.writeCSV(benchmark.output + ".csv")
+                       && benchmarkRecorder.writeJSON(benchmark.output + ".json", benchmark, renderer ? renderer : "")
+                       && rg::memoryTracker().writeJSON(benchmark.output + ".memory.json");
+        // 1 for a run over budget, so a build can fail on it; -1 as for any other failure
+        exitCode = !written ? -1 : benchmarkRecorder.withinBudgets(benchmark) ? 0 : 1;
+        glDeleteTextures(1, &benchmarkTarget);
+        rg::memoryTracker().releaseTexture(benchmarkTarget);
+    }
+    return exitCode;
+}
 
-        model = glm::translate(model, glm::vec3(-7.0f, 0.7f, 10.3f));
-        model = glm::rotate(model, glm::radians(111.0f), glm::vec3(0.0f,1.0f,0.0f));
-        model = glm::scale(model, glm::vec3(0.7f,0.7f,0.7f));
+// process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
+// ---------------------------------------------------------------------------------------------------------
+void processInput(GLFWwindow *window) {
+    if (keyPressed(window, GLFW_KEY_ESCAPE))
+        glfwSetWindowShouldClose(window, true);
 
-        modelShader.setMat4("model", model);
-        snowManModel.Draw(modelShader);
+    if (keyPressed(window, GLFW_KEY_W))
+        programState->camera.ProcessKeyboard(FORWARD, deltaTime * 2);
+    if (keyPressed(window, GLFW_KEY_S))
+        programState->camera.ProcessKeyboard(BACKWARD, deltaTime * 2);
+    if (keyPressed(window, GLFW_KEY_A))
+        programState->camera.ProcessKeyboard(LEFT, deltaTime * 2);
+    if (keyPressed(window, GLFW_KEY_D))
+        programState->camera.ProcessKeyboard(RIGHT, deltaTime * 2);
 
 
 
+    //changing height scale of parralax using Q and E
+    if (keyPressed(window, GLFW_KEY_Q))
+    {
+        if (heightScale > 0.0f)
+            heightScale -= 0.0005f;
+        else
+            heightScale = 0.0f;
+    }
+    else if (keyPressed(window, GLFW_KEY_E))
+    {
+        if (heightScale < 1.0f)
+            heightScale += 0.0005f;
+        else
+            heightScale = 1.0f;
+    }
 
-        //bell rendering (reflective surface)
-        reflectShader.use();
+    if (keyPressed(window, GLFW_KEY_B) && !bloomKeyPressed)
+    {
+        bloom = !bloom;
+        bloomKeyPressed = true;
+    }
+    if (!keyPressed(window, GLFW_KEY_B))
+    {
+        bloomKeyPressed = false;
+    }
 
-        reflectShader.setMat4("projection", projection);
-        reflectShader.setMat4("view", view);
+    if (keyPressed(window, GLFW_KEY_H) && !hdrKeyPressed)
+    {
+        hdr = !hdr;
+        hdrKeyPressed = true;
+    }
+    if (!keyPressed(window, GLFW_KEY_H))
+    {
+        hdrKeyPressed = false;
+    }
 
-        glm::mat4 rot = glm::mat4(1.0f);
-        rot = glm::rotate(rot, glm::radians(0.01f * (h)), glm::vec3(0.3f, 1.0f, 1.0f));
+    if (programState->autoExposure)
+    {
+        if (keyPressed(window, GLFW_KEY_J))
+            programState->exposureCompensation = std::max(programState->exposureCompensation - 0.01f, -4.0f);
+        else if (keyPressed(window, GLFW_KEY_K))
+            programState->exposureCompensation = std::min(programState->exposureCompensation + 0.01f, 4.0f);
+    }
+    else if (keyPressed(window, GLFW_KEY_J))
+    {
+        if (programState->exposure > 0.0f)
+            programState->exposure -= 0.001f;
+        else
+            programState->exposure = 0.0f;
+    }
+    else if (keyPressed(window, GLFW_KEY_K))
+    {
+        programState->exposure += 0.001f;
+    }
+}
 
-        reflectShader.setMat4("rot", rot);
+// the replayed key state during a replay, the keyboard otherwise
+bool keyPressed(GLFWwindow *window, int key) {
+    if (inputLog.replaying())
+        return inputLog.keyDown(key);
+    return glfwGetKey(window, key) == GLFW_PRESS;
+}
 
-        reflectShader.setVec3("cameraPos", programState->camera.Position);
+// glfw: whenever the window size changed (by OS or user resize) this callback function executes
+// ---------------------------------------------------------------------------------------------
+void framebuffer_size_callback(GLFWwindow *window, int width, int height) {
+    idleThrottle.wake();
+    // make sure the viewport matches the new window dimensions; note that width and
+    // height will be significantly larger than specified on retina displays.
+    glViewport(0, 0, width, height);
+    // a minimised window reports 0x0, the frame graph can't make empty targets
+    framebufferWidth = std::max(width, 1);
+    framebufferHeight = std::max(height, 1);
+}
 
-        model = glm::mat4(1.0f);
+// glfw: whenever the mouse moves, this callback is called
+// -------------------------------------------------------
+void mouse_callback(GLFWwindow *window, double xpos, double ypos) {
+    idleThrottle.wake();
+    if (inputLog.replaying() && !dispatchingReplay)
+        return;
+    if (inputLog.recording())
+        inputLog.recordCursor((float) glfwGetTime(), xpos, ypos);
+    if (firstMouse) {
+        lastX = xpos;
+        lastY = ypos;
+        firstMouse = false;
+    }
 
-        model = glm::translate(model, glm::vec3(4.85f, 4.5f, -2.55f));
-        //model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        model = glm::scale(model, glm::vec3(0.9f, 0.9f, 0.9f));
+    float xoffset = xpos - lastX;
+    float yoffset = lastY - ypos; // reversed since y-coordinates go from bottom to top
 
-        reflectShader.setMat4("model", model);
+    lastX = xpos;
+    lastY = ypos;
 
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+    if (programState->CameraMouseMovementUpdateEnabled)
+        programState->camera.ProcessMouseMovement(xoffset, yoffset);
+}
 
-        bellModel.Draw(reflectShader);
+// glfw: whenever the mouse scroll wheel scrolls, this callback is called
+// ----------------------------------------------------------------------
+void scroll_callback(GLFWwindow *window, double xoffset, double yoffset) {
+    idleThrottle.wake();
+    if (inputLog.replaying() && !dispatchingReplay)
+        return;
+    if (inputLog.recording())
+        inputLog.recordScroll((float) glfwGetTime(), xoffset, yoffset);
+    ImGui_ImplGlfw_ScrollCallback(window, xoffset, yoffset);
+    programState->camera.ProcessMouseScroll(yoffset);
+}
 
+// clicks and typed characters only matter to ImGui
+void mouse_button_callback(GLFWwindow *window, int button, int action, int mods) {
+    idleThrottle.wake();
+    if (inputLog.replaying() && !dispatchingReplay)
+        return;
+    if (inputLog.recording())
+        inputLog.recordButton((float) glfwGetTime(), button, action, mods);
+    ImGui_ImplGlfw_MouseButtonCallback(window, button, action, mods);
+}
 
+void char_callback(GLFWwindow *window, unsigned int codepoint) {
+    idleThrottle.wake();
+    if (inputLog.replaying() && !dispatchingReplay)
+        return;
+    if (inputLog.recording())
+        inputLog.recordChar((float) glfwGetTime(), codepoint);
+    ImGui_ImplGlfw_CharCallback(window, codepoint);
+}
 
+// directional light plus the clustered point, lamp and spot lights; the forward and the
+// deferred lighting shaders take the same uniforms
+void setSceneLighting(Shader &shader, const rg::ClusterGridConfig &config) {
+    const DirLight &dirLight = programState->dirLight;
+    shader.setVec3("dirLight.direction", dirLight.direction);
+    shader.setVec3("dirLight.ambient", dirLight.ambient);
+    shader.setVec3("dirLight.diffuse", dirLight.diffuse);
+    shader.setVec3("dirLight.specular", dirLight.specular);
+
+    rg::LightGridBuffers::setUniforms(shader, config, LIGHT_GRID_TEXTURE_UNIT, (float) renderWidth,
+                                     (float) renderHeight);
+    shader.setVec3("viewPosition", programState->camera.Position);
+}
 
-        //normal/parallax supported rendering
-        brickShader.use();
-        //brickShader.setVec3("lightPos", programState->pointLight.position);
-        brickShader.setVec3("lightPos", glm::vec3( 1.3f, 2.85f, -3.85f));
-        brickShader.setVec3("viewPos", programState->camera.Position);
+void collectSceneLights(std::vector<rg::ClusterLight> &lights) {
+    lights.clear();
+    const PointLight &pointLight = programState->pointLight;
+    const SpotLight &spotLight = programState->spotLight;
+    const PointLight &lampPointLight = programState->lampPointLight;
+
+    if (programState->pointLightEnabled) {
+        // fireplace in the house, the shack and the mountain cabin
+        glm::vec3 positions[] = {glm::vec3(0.0f, 2.4635f, 2.12f), glm::vec3(-12.5f, 2.2f, -12.0f),
+                                 glm::vec3(-12.5f, 2.2f, 32.0f)};
+        for (const glm::vec3 &position : positions) {
+            lights.push_back(rg::makePointLight(position, glm::vec3(0.85f, 0.25f, 0.0f), glm::vec3(0.65f, 0.25f, 0.1f),
+                                                glm::vec3(1.0f, 0.45f, 0.4f), pointLight.constant,
+                                                pointLight.linear, pointLight.quadratic));
+        }
+    }
+    if (programState->lampPointLightEnabled) {
+        lights.push_back(rg::makePointLight(programState->lampLightPosition, glm::vec3(0.85f, 0.25f, 0.0f),
+                                            glm::vec3(0.65f, 0.25f, 0.1f), glm::vec3(1.0f, 0.35f, 0.35f),
+                                            lampPointLight.constant, lampPointLight.linear, lampPointLight.quadratic));
+    }
+    if (programState->spotLightEnabled) {
+        lights.push_back(rg::makeSpotLight(glm::vec3(10.25f, 7.25f, 13.25f), glm::vec3(0.0f, -1.0f, 0.0f),
+                                           spotLight.cutOff, spotLight.outerCutOff, spotLight.ambient,
+                                           glm::vec3(0.85f, 0.25f, 0.0f), spotLight.specular, spotLight.constant,
+                                           spotLight.linear, spotLight.quadratic));
+    }
+}
 
-        glm::mat4 brickModel = glm::mat4(1.0f);
-        brickModel = glm::translate(brickModel, glm::vec3( 1.5f, 2.85f, -3.65f));
-        brickModel = glm::scale(brickModel ,glm::vec3(2.3f, 1.279f, 1.0f));
-        //brickModel = glm::rotate(brickModel, glm::radians((float)glfwGetTime() * -10.0f), glm::normalize(glm::vec3(1.0, 0.0, 1.0)));
-        brickModel = glm::rotate(brickModel, glm::radians((float)90.0f * -10.0f), glm::normalize(glm::vec3(1.0f, 0.0f, 0.0f)));
+// the lights' colours and attenuation; their positions are set where the lights are collected
+void setupSceneLights(ProgramState *programState) {
+    //directional light
+    DirLight& dirLight = programState->dirLight;
+    dirLight.direction = glm::vec3(0.0, -5.0, 0.0);
+    dirLight.ambient = glm::vec3(0.05, 0.05, 0.05);
+    //dirLight.diffuse = glm::vec3(0.4, 0.4, 0.4);
+    //dirLight.specular = glm::vec3(0.4, 0.4, 0.4);
+    dirLight.diffuse = glm::vec3(0.1, 0.1, 0.1);
+    dirLight.specular = glm::vec3(0.1, 0.1, 0.1);
 
-        //brickShader.setVec3("diffuseL", pointLight.diffuse);
-        brickShader.setVec3("diffuseL", glm::vec3(1.0f, 0.45f, 0.15f));
-        brickShader.setVec3("ambientL", pointLight.ambient);
+    //point light
+    PointLight& pointLight = programState->pointLight;
+    pointLight.position = glm::vec3(4.0f, 4.0, 0.0);
+    pointLight.ambient = glm::vec3(0.1, 0.1, 0.1);
+    pointLight.diffuse = glm::vec3(0.6, 0.6, 0.6);
+    pointLight.specular = glm::vec3(1.0, 1.0, 1.0);
+    pointLight.constant = 1.0f;
+    pointLight.linear = 0.09f;
+    pointLight.quadratic = 0.032f;
 
-        brickShader.setMat4("projection", projection);
-        brickShader.setMat4("view", view);
-        brickShader.setMat4("model", brickModel);
+    //spotlight lamp
+    SpotLight& spotLight = programState->spotLight;
+    spotLight.position = glm::vec3(4.0f, 4.0, 0.0);
+    spotLight.ambient = glm::vec3(0.1, 0.1, 0.1);
+    spotLight.diffuse = glm::vec3(0.9f, 0.25f, 0.1f);
+    spotLight.specular = glm::vec3(1.0f, 1.0f, 1.0f);
+    spotLight.constant = 1.0f;
+    spotLight.linear = 0.09f;
+    spotLight.quadratic = 0.032f;
+    spotLight.cutOff = glm::cos(glm::radians(20.0f));
+    spotLight.outerCutOff = glm::cos(glm::radians(35.0f));
 
-        /* brickShader.setFloat("constant", pointLight.constant);
-         brickShader.setFloat("linear", pointLight.linear);
-         brickShader.setFloat("quadratic", pointLight.quadratic);*/
+    //lamp
+    PointLight& lampPointLight = programState->lampPointLight;
+    lampPointLight.position = glm::vec3(4.0f, 4.0, 0.0);
+    lampPointLight.ambient = glm::vec3(0.1, 0.1, 0.1);
+    lampPointLight.diffuse = glm::vec3(0.6, 0.6, 0.6);
+    lampPointLight.specular = glm::vec3(1.0, 1.0, 1.0);
+    lampPointLight.constant = 1.0f;
+    lampPointLight.linear = 0.09f;
+    lampPointLight.quadratic = 0.032f;
+}
 
-        brickShader.setFloat("heightScale", heightScale); // adjust with Q and E
+// what the frame's command list is prepared from, see ScenePrepInput
+ScenePrepInput scenePrepInput(const ProgramState *programState) {
+    ScenePrepInput prepInput;
+    prepInput.eye = programState->camera.Position;
+    prepInput.mountainPositions[0] = programState->mountainPosition;
+    prepInput.mountainPositions[1] = programState->mountainPosition2;
+    prepInput.mountainPositions[2] = programState->mountainPosition3;
+    prepInput.mountainAngles[0] = programState->angleMountain1;
+    prepInput.mountainAngles[1] = programState->angleMountain2;
+    prepInput.mountainAngles[2] = programState->angleMountain3;
+    prepInput.mountainScales[0] = programState->mountainScale;
+    prepInput.mountainScales[1] = programState->mountainScale2;
+    prepInput.mountainScales[2] = programState->mountainScale3;
+    prepInput.modelPosition = programState->modelPosition;
+    return prepInput;
+}
 
-        brickShader.setFloat("factorD", 1.1f);
-        brickShader.setFloat("factorL", 1.4f);
+// a static vertex array of interleaved floats, one attribute per entry of components, counting
+// from location 0
+unsigned int createVertexArray(const float *vertices, GLsizeiptr size, const char *asset,
+                               std::initializer_list<int> components) {
+    int stride = 0;
+    for (int count : components)
+        stride += count;
+    unsigned int vao, vbo;
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &vbo);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, size, vertices, GL_STATIC_DRAW);
+    rg::memoryTracker().buffer(vbo, asset, rg::MemoryTracker::VERTEX_BUFFERS, size);
+    unsigned int location = 0;
+    int offset = 0;
+    for (int count : components) {
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location++, count, GL_FLOAT, GL_FALSE, stride * sizeof(float),
+                              (void *) (offset * sizeof(float)));
+        offset += count;
+    }
+    glBindVertexArray(0);
+    return vao;
+}
 
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, brickTextureDiff);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, brickTextureNormal);
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, brickTextureDisp);
-        //glActiveTexture(GL_TEXTURE3);
-        //glBindTexture(GL_TEXTURE_2D, brickTextureSpec);
+// bounding sphere of a scene object in its local space: of its model's vertices, or of the
+// floor's or a window's quad
+glm::vec4 sceneObjectBounds(SceneObject object, const Model *model) {
+    glm::vec3 min(0.0f), max(0.0f);
+    if (model) {
+        bool first = true;
+        for (const Mesh &mesh : model->meshes) {
+            for (const Vertex &vertex : mesh.vertices) {
+                min = first ? vertex.Position : glm::min(min, vertex.Position);
+                max = first ? vertex.Position : glm::max(max, vertex.Position);
+                first = false;
+            }
+        }
+    } else if (object == FLOOR_OBJECT) {
+        min = glm::vec3(-10.0f, -0.5f, -10.0f);
+        max = glm::vec3(10.0f, -0.5f, 10.0f);
+    } else {
+        min = glm::vec3(-4.0f, -0.4f, -4.0f);
+        max = glm::vec3(4.0f, -0.4f, 4.0f);
+    }
+    return rg::boundingSphere(min, max);
+}
 
-        renderQuad();
+// adds one item of the frame's command list, see SceneItem; called on the pool's workers
+void prepareSceneItem(const ScenePrepInput &in, size_t item, const glm::vec4 *sceneBounds,
+                      const vector<triD> &winPos, rg::CommandList &list) {
+    auto add = [&](SceneObject object, const glm::mat4 &model, float shininess, uint32_t flags) {
+        list.add(object == WINDOW_OBJECT ? rg::CommandList::TRANSPARENT_BUCKET : rg::CommandList::OPAQUE_BUCKET,
+                 object, model, shininess, sceneBounds[object], in.eye, flags);
+    };
+    // back faces are drawn from the floor on
+    const uint32_t culled = 0, doubleSided = rg::CommandList::DOUBLE_SIDED;
 
-        brickShader.setVec3("lightPos", glm::vec3( 1.3f, 2.85f, 3.85f));
-        brickModel = glm::translate(brickModel, glm::vec3( -0.12f, 0.0f, 0.255f));
-        brickModel = glm::scale(brickModel ,glm::vec3(.97f, 1.06f, 1.0f));
-        brickShader.setMat4("model", brickModel);
+    glm::mat4 model;
+    switch (item < FIRST_WINDOW_ITEM ? (SceneItem) item : FIRST_WINDOW_ITEM) {
+        case HOUSE_ITEM:
+            //house
+            model = glm::mat4(1.0f);
+            model = glm::translate(model, glm::vec3(0.0f));
+            model = glm::scale(model, glm::vec3(0.8f));
+            add(HOUSE_OBJECT, model, 32.0f, culled);
+            break;
+        case LAMP_ITEM:
+            //lamp
+            model = glm::mat4(1.0f);
+            model = glm::translate(model, glm::vec3(10.f, -1.0f, 12.0f));
+            model = glm::scale(model, glm::vec3(0.3f));
+            model = glm::rotate(model, glm::radians(-180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+            add(LAMP_OBJECT, model, 32.0f, culled);
+            break;
+        case SNOW_PILES_ITEM:
+            //snow piles, all three under the same transform
+            model = glm::mat4(1.0f);
+            model = glm::translate(model, glm::vec3(4.f, 0.0f, -20.0f));
+            model = glm::scale(model, glm::vec3(4.0f));
+            add(SNOW_PILE_OBJECT, model, 32.0f, culled);
+            add(SNOW_PILE_2_OBJECT, model, 32.0f, culled);
+            add(SNOW_PILE_3_OBJECT, model, 32.0f, culled);
+            break;
+        case MOUNTAINS_ITEM: {
+            //mountains
+            const SceneObject mountains[3] = {MOUNTAIN_OBJECT, MOUNTAIN_2_OBJECT, MOUNTAIN_3_OBJECT};
+            for (int i = 0; i < 3; ++i) {
+                model = glm::mat4(1.0f);
+                model = glm::translate(model, in.mountainPositions[i]);
+                model = glm::rotate(model, glm::radians(in.mountainAngles[i]), glm::vec3(0.0f, 1.0f, 0.0f));
+                model = glm::scale(model, glm::vec3(in.mountainScales[i]));
+                add(mountains[i], model, 32.0f, culled);
+            }
+            break;
+        }
+        case TREES_ITEM:
+            //trees
+            model = glm::mat4(1.0f);
+            model = glm::translate(model, glm::vec3(-10.0f, 0.0f, 15.0f));
+            model = glm::scale(model, glm::vec3(0.09));
+            add(TREE_OBJECT, model, 32.0f, culled);
 
-        /* brickShader.setVec3("diffuseL", pointLight.diffuse);
-         brickShader.setVec3("ambientL", pointLight.ambient);
+            model = glm::mat4(1.0f);
+            model = glm::translate(model, glm::vec3(3.0f, 0.0f, 25.0f));
+            model = glm::scale(model, glm::vec3(0.09));
+            add(TREE_2_OBJECT, model, 32.0f, culled);
 
-         brickShader.setFloat("factorD", 0.5f);
-         brickShader.setFloat("factorL", 0.7f);
+            model = glm::mat4(1.0f);
+            model = glm::translate(model, glm::vec3(8.0f, 0.0f, -9.0f));
+            model = glm::scale(model, glm::vec3(0.09));
+            add(TREE_2_OBJECT, model, 32.0f, culled);
+            break;
+        case ROCK_ITEM:
+            //rock
+            model = glm::mat4(1.0f);
+            model = glm::translate(model, glm::vec3(-14.0f,1.0f,-10.0f));
+            model = glm::scale(model, glm::vec3(0.5f));
+            add(ROCK_OBJECT, model, 32.0f, culled);
+            break;
+        case SLED_ITEM:
+            //sled
+            model = glm::mat4(1.0f);
+            model = glm::translate(model, glm::vec3(3.0f, 0.2f, 11.0f));
+            model = glm::scale(model, glm::vec3(5.0f));
+            model = glm::rotate(model, glm::radians(45.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+            add(SLED_OBJECT, model, 32.0f, culled);
+            break;
+        case FENCES_ITEM:
+            //fence
+            model = glm::mat4(1.0f);
+            model = glm::translate(model, glm::vec3(-6.0f,0.0f,23.0f));
+            model = glm::scale(model, glm::vec3(4.0));
+            add(FENCE_2_OBJECT, model, 32.0f, culled);
 
-         renderQuad(); */
+            model = glm::mat4(1.0f);
+            model = glm::translate(model, glm::vec3(-6.0f, 0.0f, -15.0f));
+            model = glm::scale(model, glm::vec3(4.0));
+            add(FENCE_OBJECT, model, 32.0f, culled);
 
-        brickShader.setVec3("lightPos", glm::vec3( 1.3f, 2.85f, 3.65f));
-        brickModel = glm::translate(brickModel, glm::vec3( 0.5f, 0.0f, -7.6f));
-        brickModel = glm::scale(brickModel ,glm::vec3(0.7f, 1.06f, 0.5f));
-        brickShader.setMat4("model", brickModel);
+            model = glm::mat4(1.0f);
+            model = glm::translate(model, glm::vec3(-16.0f, 0.0f, -5.0f));
+            model = glm::scale(model, glm::vec3(4.0));
+            model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+            add(FENCE_3_OBJECT, model, 32.0f, culled);
 
-        brickShader.setVec3("diffuseL", glm::vec3(1.0f, 0.45f, 0.2f));
-        brickShader.setVec3("ambientL", pointLight.ambient);
+            model = glm::mat4(1.0f);
+            model = glm::translate(model, glm::vec3(-16.0f, 0.0f, 13.0f));
+            model = glm::scale(model, glm::vec3(4.0));
+            model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+            add(FENCE_3_OBJECT, model, 32.0f, culled);
+            break;
+        case FLOOR_ITEM:
+            //plane
+            model = glm::mat4(1.0f);
+            model = glm::scale(model, glm::vec3(30.0f, 30.0f, 30.0f));
+            model = glm::translate(model, glm::vec3(4.0f, 0.505f, 0.0f));
+            add(FLOOR_OBJECT, model, 32.0f, doubleSided);
+            break;
+        case BED_ITEM:
+            //bed
+            model = glm::mat4(1.0f);
+            model = glm::translate(model, glm::vec3(-3.0f, 2.0f, 2.1f));
+            model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+            model = glm::scale(model, glm::vec3(0.12f, 0.12f, 0.12f));
+            add(BED_OBJECT, model, 5.0f, doubleSided);
+            break;
+        case TABLE_ITEM:
+            //table
+            model = glm::mat4(1.0f);
+            model = glm::translate(model, glm::vec3(0.5f, 2.45f, 2.0f));
+            model = glm::rotate(model, glm::radians(-9.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+            model = glm::scale(model, glm::vec3(0.01f, 0.01f, 0.014f));
+            add(TABLE_OBJECT, model, 48.0f, doubleSided);
+            break;
+        case SHACK_ITEM:
+            //shack
+            model = glm::mat4(1.0f);
+            model = glm::translate(model, glm::vec3(-16.2f, 0.2f, -22.0f));
+            model = glm::rotate(model, glm::radians(47.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+            model = glm::scale(model, glm::vec3(0.023f, 0.023f, 0.023f));
+            add(SHACK_OBJECT, model, 48.0f, doubleSided);
+            break;
+        case MOUNTAIN_RANGE_ITEM:
+            //mt
+            model = glm::mat4(1.0f);
+            model = glm::translate(model, glm::vec3(in.modelPosition));
+            model = glm::rotate(model, glm::radians(47.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+            model = glm::scale(model, glm::vec3(10.0f, 7.0f, 10.0f));
+            add(MOUNTAIN_OBJECT, model, 48.0f, doubleSided);
 
-        brickShader.setFloat("factorD", 1.1f);
-        brickShader.setFloat("factorL", 1.4f);
+            model = glm::mat4(1.0f);
+            model = glm::translate(model, glm::vec3(100.0f, -3.0f, -53.0f));
+            model = glm::rotate(model, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+            model = glm::scale(model, glm::vec3(23.0f, 10.0f, 10.0f));
+            add(MOUNTAIN_OBJECT, model, 48.0f, doubleSided);
 
-        renderQuad();
+            model = glm::mat4(1.0f);
+            model = glm::translate(model, glm::vec3(50.0f, -10.0f, -63.0f));
+            model = glm::rotate(model, glm::radians(-43.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+            model = glm::scale(model, glm::vec3(23.0f, 10.0f, 10.0f));
+            add(MOUNTAIN_OBJECT, model, 48.0f, doubleSided);
 
+            model = glm::mat4(1.0f);
+            model = glm::translate(model, glm::vec3(70.0f, -5.0f, 20.0f));
+            model = glm::rotate(model, glm::radians(-43.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+            model = glm::scale(model, glm::vec3(0.2f, 5.0f, 10.0f));
+            add(MOUNTAIN_OBJECT, model, 48.0f, doubleSided);
+            break;
+        case LANTERN_ITEM:
+            //lantern
+            model = glm::mat4(1.0f);
+            model = glm::translate(model, glm::vec3(0.0f, 2.4635f, 2.12f));
+            model = glm::rotate(model, glm::radians(43.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+            model = glm::scale(model, glm::vec3(0.15f, 0.15f, 0.15f));
+            add(LANTERN_OBJECT, model, 48.0f, doubleSided);
+            break;
+        case SNOWMAN_ITEM:
+            //snowman :)
+            model = glm::mat4(1.0f);
+            model = glm::translate(model, glm::vec3(-7.0f, 0.7f, 10.3f));
+            model = glm::rotate(model, glm::radians(111.0f), glm::vec3(0.0f,1.0f,0.0f));
+            model = glm::scale(model, glm::vec3(0.7f,0.7f,0.7f));
+            add(SNOWMAN_OBJECT, model, 48.0f, doubleSided);
+            break;
+        case FIRST_WINDOW_ITEM: {
+            //windows, sorted back to front with the rest of their bucket
+            assert(item - FIRST_WINDOW_ITEM < winPos.size());
+            const triD &window = winPos[item - FIRST_WINDOW_ITEM];
+            model = glm::mat4(1.0f);
+            model = glm::translate(model, window.trans);
+            model = glm::scale(model, window.skal);
+            model = glm::rotate(model, glm::radians(window.rotatU), window.rotatV);
+            add(WINDOW_OBJECT, model, 0.0f, doubleSided);
+            break;
+        }
+        default:
+            assert(false && "scene item without a case");
+            break;
+    }
+}
 
+// everything shaded by modelLightingShader; the forward pass, the G-buffer pass and the
+// depth pre-pass all replay it, the caller binds the program and sets the camera and
+// lighting uniforms. positionsOnly draws from the meshes' position-only streams.
+void drawLitModels(Shader &shader, bool positionsOnly, const FrameDraws &draws) {
+    float shininess = -1.0f;
+    int culling = -1;
+    for (const rg::CommandList::Command &command : draws.commands->commands(rg::CommandList::OPAQUE_BUCKET)) {
+        if (!draws.frustum.intersects(command.bounds))
+            continue;
+        int cull = command.flags & rg::CommandList::DOUBLE_SIDED ? 0 : 1;
+        if (cull != culling) {
+            if (cull)
+                glEnable(GL_CULL_FACE);
+            else
+                glDisable(GL_CULL_FACE);
+            culling = cull;
+        }
+        if (draws.commands->shininess(command) != shininess) {
+            shininess = draws.commands->shininess(command);
+            shader.setFloat("material.shininess", shininess);
+        }
+        shader.setMat4("model", draws.commands->model(command));
+        Model *object = draws.models[command.object];
+        if (!object) {
+            glBindVertexArray(draws.floorVAO);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, draws.floorTexture);
+            glDrawArrays(GL_TRIANGLES, 0, 6);
+        } else if (positionsOnly) {
+            object->DrawPositions();
+        } else {
+            object->Draw(shader);
+        }
+    }
+    // as the fixed draw order used to leave it
+    glDisable(GL_CULL_FACE);
+}
 
+// the deferred lighting pass: one screen quad over the sky, every pixel shaded from the G-buffer
+// and the lights of its own cluster
+void drawDeferredLighting(Shader &lightingShader, const rg::ClusterGridConfig &config, const glm::mat4 &projection,
+                          const glm::mat4 &view, unsigned int albedoSpec, unsigned int normalShininess,
+                          unsigned int depth, unsigned int quadVAO) {
+    glDisable(GL_DEPTH_TEST);
+    lightingShader.use();
+    setSceneLighting(lightingShader, config);
+    lightingShader.setMat4("inverseProjection", glm::inverse(projection));
+    lightingShader.setMat4("inverseView", glm::inverse(view));
+    lightingShader.setVec2("renderSize", (float) renderWidth, (float) renderHeight);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, albedoSpec);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, normalShininess);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, depth);
+    glActiveTexture(GL_TEXTURE0);
+    glBindVertexArray(quadVAO);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glBindVertexArray(0);
+    glEnable(GL_DEPTH_TEST);
+}
 
+// the sky cube around the camera, turned by h; drawn first and without writing depth
+void drawSkybox(Shader &skyShader, unsigned int skyboxVAO, unsigned int cubemapTexture, const glm::mat4 &projection,
+                const glm::mat4 &view, float h) {
+    glDepthMask(GL_FALSE);
 
-        //rug rendering with normal maps
-        rugShader.use();
-        //rugShader.setVec3("lightPos", programState->pointLight.position);
-        rugShader.setVec3("lightPos", glm::vec3( 1.5f, 0.84f, -1.65f));
-        rugShader.setVec3("viewPos", programState->camera.Position);
+    skyShader.use();
 
-        glm::mat4 rugModel = glm::mat4(1.0f);
+    glm::mat4 viewCube = glm::mat4(glm::mat3(view));
 
-        rugModel = glm::rotate(rugModel, glm::radians(90.0f), glm::vec3( 1.0f, 0.0f, 0.0f));
+    //glm::mat4 skyModel = glm::mat4(1.0f);
+    //skyModel = glm::translate(skyModel, glm::vec3(0.0f, 0.0f, 0.0f));
 
-        rugModel = glm::translate(rugModel, glm::vec3( 0.5f, 0.44f, -1.65f));
+    glm::mat4 skyModel = glm::mat4(1.0f);
+    skyModel = glm::rotate(skyModel, glm::radians(0.01f * (h)), glm::vec3(0.3f, 1.0f, 1.0f));
+    skyShader.setMat4("view", viewCube);
+    skyShader.setMat4("projection", projection);
+    skyShader.setMat4("model", skyModel);
+    // skybox cube
+    glBindVertexArray(skyboxVAO);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+    glDrawArrays(GL_TRIANGLES, 0, 36);
+    glBindVertexArray(0);
 
-        rugShader.setMat4("projection", projection);
-        rugShader.setMat4("view", view);
-        rugShader.setMat4("model", rugModel);
+    glDepthMask(GL_TRUE);
+}
 
+// the reflective bell under the roof, mirroring the sky cube and turning with it
+void drawBell(Shader &reflectShader, Model &bellModel, unsigned int cubemapTexture, const glm::mat4 &projection,
+              const glm::mat4 &view, const glm::vec3 &eye, float h) {
+    reflectShader.use();
 
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, rugTextureDiff);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, rugTextureNormal);
+    reflectShader.setMat4("projection", projection);
+    reflectShader.setMat4("view", view);
 
-        renderQuad();
+    glm::mat4 rot = glm::mat4(1.0f);
+    rot = glm::rotate(rot, glm::radians(0.01f * (h)), glm::vec3(0.3f, 1.0f, 1.0f));
 
-        glEnable(GL_CULL_FACE);
+    reflectShader.setMat4("rot", rot);
 
+    reflectShader.setVec3("cameraPos", eye);
 
+    glm::mat4 model = glm::mat4(1.0f);
 
-        //transparent objects are rendered last
-        //windows rendering
+    model = glm::translate(model, glm::vec3(4.85f, 4.5f, -2.55f));
+    //model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    model = glm::scale(model, glm::vec3(0.9f, 0.9f, 0.9f));
 
-        std::sort(winPos.begin(), winPos.end(), [](triD a, triD b){
-                float d1 = glm::distance(a.trans, programState->camera.Position);
-                float d2 = glm::distance(b.trans, programState->camera.Position);
-                return d1 > d2;
-        });
+    reflectShader.setMat4("model", model);
 
-        //this goes before window implementation
-        glDisable(GL_CULL_FACE);
-        windowShader.use();
-        glBindVertexArray(windowVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, windowTexture);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
 
-        windowShader.setMat4("view", view);
-        windowShader.setMat4("projection", projection);
+    bellModel.Draw(reflectShader);
+}
 
-        for(int i = 0 ;i < winPos.size(); i++){
+// the normal and parallax mapped brick walls by the fireplace; ambient is the point light's
+void drawParallaxWalls(Shader &brickShader, unsigned int diffuseMap, unsigned int normalMap, unsigned int depthMap,
+                       const glm::mat4 &projection, const glm::mat4 &view, const glm::vec3 &eye,
+                       const glm::vec3 &ambient) {
+    brickShader.use();
+    //brickShader.setVec3("lightPos", programState->pointLight.position);
+    brickShader.setVec3("lightPos", glm::vec3( 1.3f, 2.85f, -3.85f));
+    brickShader.setVec3("viewPos", eye);
 
-            model = glm::mat4(1.0f);
+    glm::mat4 brickModel = glm::mat4(1.0f);
+    brickModel = glm::translate(brickModel, glm::vec3( 1.5f, 2.85f, -3.65f));
+    brickModel = glm::scale(brickModel ,glm::vec3(2.3f, 1.279f, 1.0f));
+    //brickModel = glm::rotate(brickModel, glm::radians((float)glfwGetTime() * -10.0f), glm::normalize(glm::vec3(1.0, 0.0, 1.0)));
+    brickModel = glm::rotate(brickModel, glm::radians((float)90.0f * -10.0f), glm::normalize(glm::vec3(1.0f, 0.0f, 0.0f)));
 
-            model = glm::translate(model, winPos[i].trans);
-            model = glm::scale(model, winPos[i].skal);
-            model = glm::rotate(model, glm::radians(winPos[i].rotatU), winPos[i].rotatV);
+    //brickShader.setVec3("diffuseL", pointLight.diffuse);
+    brickShader.setVec3("diffuseL", glm::vec3(1.0f, 0.45f, 0.15f));
+    brickShader.setVec3("ambientL", ambient);
 
-            /*if(glm::vec3(3.0f,2.7f,1.0f) == winPos[i].trans){
-                model = glm::rotate(model, glm::radians(winPos[i].rotatU), glm::vec3(1.0f,0.0f,0.0f));
-            }*/
+    brickShader.setMat4("projection", projection);
+    brickShader.setMat4("view", view);
+    brickShader.setMat4("model", brickModel);
 
-            windowShader.setMat4("model", model);
+    /* brickShader.setFloat("constant", pointLight.constant);
+     brickShader.setFloat("linear", pointLight.linear);
+     brickShader.setFloat("quadratic", pointLight.quadratic);*/
 
-            glDrawArrays(GL_TRIANGLES, 0, 6);
+    brickShader.setFloat("heightScale", heightScale); // adjust with Q and E
 
-        }
+    brickShader.setFloat("factorD", 1.1f);
+    brickShader.setFloat("factorL", 1.4f);
 
-        /*model = glm::rotate(model, glm::radians(-43.0f), glm::vec3(1.0, 0, 0));
-        model = glm::translate(model, glm::vec3(0.03f,2.87f,13.91f));
-        model = glm::rotate(model, glm::radians(43.0f), glm::vec3(1.0, 0, 0));
-        windowShader.setMat4("model", model);*/
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, diffuseMap);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, normalMap);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, depthMap);
+    //glActiveTexture(GL_TEXTURE3);
+    //glBindTexture(GL_TEXTURE_2D, brickTextureSpec);
 
-        //this goes after window implementation
-        glEnable(GL_CULL_FACE);
+    renderQuad();
 
+    brickShader.setVec3("lightPos", glm::vec3( 1.3f, 2.85f, 3.85f));
+    brickModel = glm::translate(brickModel, glm::vec3( -0.12f, 0.0f, 0.255f));
+    brickModel = glm::scale(brickModel ,glm::vec3(.97f, 1.06f, 1.0f));
+    brickShader.setMat4("model", brickModel);
 
+    /* brickShader.setVec3("diffuseL", pointLight.diffuse);
+     brickShader.setVec3("ambientL", pointLight.ambient);
 
+     brickShader.setFloat("factorD", 0.5f);
+     brickShader.setFloat("factorL", 0.7f);
 
-        //POST PROCESSING
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+     renderQuad(); */
 
-        bool horizontal = true, first_iteration = true;
-        unsigned int amount = 10;
-        blurShader.use();
-        for (unsigned int i = 0; i < amount; i++)
-        {
-            glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[horizontal]);
-            blurShader.setInt("horizontal", horizontal);
-            glBindTexture(GL_TEXTURE_2D, first_iteration ? colorBuffers[1] : pingpongColorBuffers[!horizontal]);
-            glBindVertexArray(quadVAO);
-            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-            glBindVertexArray(0);
-            horizontal = !horizontal;
-            if (first_iteration)
-                first_iteration = false;
-        }
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    brickShader.setVec3("lightPos", glm::vec3( 1.3f, 2.85f, 3.65f));
+    brickModel = glm::translate(brickModel, glm::vec3( 0.5f, 0.0f, -7.6f));
+    brickModel = glm::scale(brickModel ,glm::vec3(0.7f, 1.06f, 0.5f));
+    brickShader.setMat4("model", brickModel);
 
-        glBindFramebuffer(GL_FRAMEBUFFER, msFBO);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        hdrShader.use();
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, colorBuffers[0]);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, pingpongColorBuffers[!horizontal]);
-        hdrShader.setBool("hdr", hdr);
-        hdrShader.setBool("bloom", bloom);
-        hdrShader.setFloat("exposure", programState->exposure);
+    brickShader.setVec3("diffuseL", glm::vec3(1.0f, 0.45f, 0.2f));
+    brickShader.setVec3("ambientL", ambient);
 
-        glBindVertexArray(quadVAO);
-        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-        glBindVertexArray(0);
+    brickShader.setFloat("factorD", 1.1f);
+    brickShader.setFloat("factorL", 1.4f);
 
+    renderQuad();
+}
 
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        antiAliasingShader.use();
-        antiAliasingShader.setInt("grayEffect", grayEffect);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, textureColorBufferMultiSampled);
+// the normal mapped rug on the floor of the house
+void drawRug(Shader &rugShader, unsigned int diffuseMap, unsigned int normalMap, const glm::mat4 &projection,
+             const glm::mat4 &view, const glm::vec3 &eye) {
+    rugShader.use();
+    //rugShader.setVec3("lightPos", programState->pointLight.position);
+    rugShader.setVec3("lightPos", glm::vec3( 1.5f, 0.84f, -1.65f));
+    rugShader.setVec3("viewPos", eye);
 
-        glBindVertexArray(quadVAO);
-        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-        glBindVertexArray(0);
+    glm::mat4 rugModel = glm::mat4(1.0f);
 
+    rugModel = glm::rotate(rugModel, glm::radians(90.0f), glm::vec3( 1.0f, 0.0f, 0.0f));
 
-        if (programState->ImGuiEnabled)
-            DrawImGui(programState);
+    rugModel = glm::translate(rugModel, glm::vec3( 0.5f, 0.44f, -1.65f));
 
+    rugShader.setMat4("projection", projection);
+    rugShader.setMat4("view", view);
+    rugShader.setMat4("model", rugModel);
 
 
-        // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
-        // -------------------------------------------------------------------------------
-        glfwSwapBuffers(window);
-        glfwPollEvents();
-    }
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, diffuseMap);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, normalMap);
 
-    programState->SaveToFile("resources/program_state.txt");
-    delete programState;
-    ImGui_ImplOpenGL3_Shutdown();
-    ImGui_ImplGlfw_Shutdown();
-    ImGui::DestroyContext();
-    // glfw: terminate, clearing all previously allocated GLFW resources.
-    // ------------------------------------------------------------------
-    glfwTerminate();
-    return 0;
+    renderQuad();
 }
 
-// process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
-// ---------------------------------------------------------------------------------------------------------
-void processInput(GLFWwindow *window) {
-    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
-        glfwSetWindowShouldClose(window, true);
+// the window panes of the frame's transparent bucket, back to front; drawn last
+void drawWindows(Shader &windowShader, unsigned int windowVAO, unsigned int windowTexture, const glm::mat4 &projection,
+                 const glm::mat4 &view, const FrameDraws &draws) {
+    //this goes before window implementation
+    glDisable(GL_CULL_FACE);
+    windowShader.use();
+    glBindVertexArray(windowVAO);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, windowTexture);
 
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-        programState->camera.ProcessKeyboard(FORWARD, deltaTime * 2);
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-        programState->camera.ProcessKeyboard(BACKWARD, deltaTime * 2);
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-        programState->camera.ProcessKeyboard(LEFT, deltaTime * 2);
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-        programState->camera.ProcessKeyboard(RIGHT, deltaTime * 2);
+    windowShader.setMat4("view", view);
+    windowShader.setMat4("projection", projection);
 
+    for (const rg::CommandList::Command &command : draws.commands->commands(rg::CommandList::TRANSPARENT_BUCKET)) {
+        if (!draws.frustum.intersects(command.bounds))
+            continue;
+        windowShader.setMat4("model", draws.commands->model(command));
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+    }
 
+    /*model = glm::rotate(model, glm::radians(-43.0f), glm::vec3(1.0, 0, 0));
+    model = glm::translate(model, glm::vec3(0.03f,2.87f,13.91f));
+    model = glm::rotate(model, glm::radians(43.0f), glm::vec3(1.0, 0, 0));
+    windowShader.setMat4("model", model);*/
 
-    //changing height scale of parralax using Q and E
-    if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS)
-    {
-        if (heightScale > 0.0f)
-            heightScale -= 0.0005f;
-        else
-            heightScale = 0.0f;
-    }
-    else if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS)
-    {
-        if (heightScale < 1.0f)
-            heightScale += 0.0005f;
-        else
-            heightScale = 1.0f;
-    }
+    //this goes after window implementation
+    glEnable(GL_CULL_FACE);
+}
 
-    if (glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS && !bloomKeyPressed)
-    {
-        bloom = !bloom;
-        bloomKeyPressed = true;
+// the GPU time and target memory of the scene at the sample count and anti-aliasing mode of
+// this frame, for the comparisons in the UI
+void recordAntiAliasingStats(unsigned int sceneSamples, GLenum hdrFormat, size_t temporalAABytes) {
+    if (!programState->deferredShading && programState->antiAliasing == MSAA_ANTI_ALIASING) {
+        int setting = sceneSamples >= 8 ? 3 : sceneSamples >= 4 ? 2 : sceneSamples >= 2 ? 1 : 0;
+        size_t sceneBytes = rg::TextureDesc(framebufferWidth, framebufferHeight, hdrFormat).bytes()
+                            + rg::TextureDesc(framebufferWidth, framebufferHeight, GL_DEPTH_COMPONENT24,
+                                              sceneSamples).bytes();
+        if (sceneSamples > 1)
+            sceneBytes += rg::TextureDesc(framebufferWidth, framebufferHeight, hdrFormat, sceneSamples).bytes();
+        programState->msaaMs[setting] = programState->litPassMs + programState->sceneMs
+                                        + (sceneSamples > 1 ? programState->antiAliasingMs : 0.0);
+        programState->msaaMegabytes[setting] = sceneBytes / (1024.0 * 1024.0);
     }
-    if (glfwGetKey(window, GLFW_KEY_B) == GLFW_RELEASE)
     {
-        bloomKeyPressed = false;
+        int mode = programState->antiAliasing;
+        bool ownPass = mode != MSAA_ANTI_ALIASING || sceneSamples > 1;
+        size_t addedBytes = 0;
+        if (mode == MSAA_ANTI_ALIASING && sceneSamples > 1)
+            addedBytes = rg::TextureDesc(framebufferWidth, framebufferHeight, hdrFormat, sceneSamples).bytes()
+                         + rg::TextureDesc(framebufferWidth, framebufferHeight, GL_DEPTH_COMPONENT24,
+                                           sceneSamples - 1).bytes();
+        else if (mode == FXAA_ANTI_ALIASING)
+            addedBytes = rg::TextureDesc(framebufferWidth, framebufferHeight, GL_RGBA8).bytes();
+        else if (mode == TAA_ANTI_ALIASING)
+            addedBytes = temporalAABytes;
+        programState->antiAliasingPassMs[mode] = ownPass ? programState->antiAliasingMs : 0.0;
+        programState->antiAliasingSceneMs[mode] = programState->litPassMs + programState->sceneMs
+                                                  + programState->antiAliasingPassMs[mode];
+        programState->antiAliasingMegabytes[mode] = addedBytes / (1024.0 * 1024.0);
     }
+}
 
-    if (glfwGetKey(window, GLFW_KEY_H) == GLFW_PRESS && !hdrKeyPressed)
-    {
-        hdr = !hdr;
-        hdrKeyPressed = true;
+// rendering settings and the statistics that go with them
+void DrawSettingsWindow(ProgramState *programState) {
+    ImGui::Begin("Hello!");
+    ImGui::Checkbox("Auto exposure", &programState->autoExposure);
+    if (programState->autoExposure) {
+        ImGui::SliderFloat("Exposure compensation (EV)", &programState->exposureCompensation, -4.0f, 4.0f);
+        ImGui::SliderFloat("Adaptation speed", &programState->adaptationSpeed, 0.1f, 10.0f);
+        ImGui::Text("Exposure %.3f, average luminance %.4f", programState->adaptedExposure,
+                    programState->averageLuminance);
+        ImGui::Text("Luminance (GPU): %.3f ms, read-back %.1f us (CPU), %d frames late",
+                    programState->autoExposureMs, programState->autoExposureReadbackUs,
+                    programState->exposureLatency);
+        ImGui::Text("Read-backs: %lld, given up on: %lld", programState->exposureReadbacks,
+                    programState->exposureDropped);
+    } else {
+        ImGui::SliderFloat("Exposure", &programState->exposure, 0.0, 2.0);
     }
-    if (glfwGetKey(window, GLFW_KEY_H) == GLFW_RELEASE)
-    {
-        hdrKeyPressed = false;
+    ImGui::Checkbox("Directional light", &programState->dirLightEnabled);
+    ImGui::Checkbox("Point lights", &programState->pointLightEnabled);
+    ImGui::Checkbox("Lamp point light", &programState->lampPointLightEnabled);
+    ImGui::Checkbox("Spot light", &programState->spotLightEnabled);
+    ImGui::SliderInt("Extra lights", &programState->extraLights, 0, 4096);
+    ImGui::Checkbox("Deferred shading", &programState->deferredShading);
+    ImGui::Checkbox("Depth pre-pass", &programState->depthPrePass);
+    ImGui::Checkbox("Bloom", &bloom);
+    ImGui::Combo("Bloom mode", &programState->bloomMode, "Mip chain\0Gaussian (10 passes)\0");
+    ImGui::SliderFloat("Bloom threshold", &programState->bloomThreshold, 0.0f, 4.0f);
+    if (bloom)
+        ImGui::Text("Bloom (GPU): %.3f ms, ~%.1f MB/frame", programState->bloomMs, programState->bloomMegabytes);
+    ImGui::Combo("Anti-aliasing", &programState->antiAliasing, "MSAA\0FXAA\0TAA\0");
+    const char *antiAliasingNames[] = {"MSAA", "FXAA", "TAA"};
+    for (int i = 0; i < 3; ++i) {
+        if (programState->antiAliasingSceneMs[i] > 0.0)
+            ImGui::Text("%s: pass %.3f ms, scene %.3f ms (GPU), +%.1f MB", antiAliasingNames[i],
+                        programState->antiAliasingPassMs[i], programState->antiAliasingSceneMs[i],
+                        programState->antiAliasingMegabytes[i]);
     }
-
-    if (glfwGetKey(window, GLFW_KEY_J) == GLFW_PRESS)
-    {
-        if (programState->exposure > 0.0f)
-            programState->exposure -= 0.001f;
-        else
-            programState->exposure = 0.0f;
+    int msaaSetting = programState->msaaSamples >= 8 ? 3 : programState->msaaSamples >= 4 ? 2
+                      : programState->msaaSamples >= 2 ? 1 : 0;
+    if (ImGui::Combo("MSAA", &msaaSetting, "Off\0" "2x\0" "4x\0" "8x\0"))
+        programState->msaaSamples = 1 << msaaSetting;
+    ImGui::Combo("MSAA resolve", &programState->msaaResolve, "Blit\0Tonemap-aware\0");
+    if (programState->deferredShading)
+        ImGui::Text("MSAA applies to forward shading only");
+    for (int i = 0; i < 4; ++i) {
+        if (programState->msaaMegabytes[i] > 0.0)
+            ImGui::Text("%dx: scene %.3f ms (GPU), %.1f MB", 1 << i, programState->msaaMs[i],
+                        programState->msaaMegabytes[i]);
     }
-    else if (glfwGetKey(window, GLFW_KEY_K) == GLFW_PRESS)
-    {
-        programState->exposure += 0.001f;
+    ImGui::Text("Lit pass (GPU): %.3f ms", programState->litPassMs);
+    ImGui::SliderFloat("Saturation", &programState->colorGrading.saturation, 0.0f, 2.0f);
+    ImGui::SliderFloat("Contrast", &programState->colorGrading.contrast, 0.5f, 1.5f);
+    ImGui::SliderFloat("Temperature", &programState->colorGrading.temperature, -1.0f, 1.0f);
+    ImGui::Checkbox("Grayscale", &grayEffect);
+    ImGui::Text("Post (GPU): %.3f ms, ~%.1f MB/frame (a separate grading pass: +%.1f MB)",
+                programState->postMs, programState->postMegabytes, programState->separateGradingMegabytes);
+    ImGui::Text("Rest of scene (GPU): %.3f ms, anti-aliasing %.3f ms", programState->sceneMs,
+                programState->antiAliasingMs);
+    ImGui::Text("%s: %.0f", rg::glExtensions().pipelineStatistics ? "Fragment shader invocations"
+                                                                  : "Samples passed",
+                programState->shadedFragments);
+    ImGui::Text("Frame: %.3f ms, GPU %.3f ms", deltaTime * 1000.0f, programState->gpuFrameMs);
+    ImGui::Checkbox("Dynamic resolution", &programState->dynamicResolution);
+    if (programState->dynamicResolution) {
+        ImGui::SliderFloat("Target GPU time (ms)", &programState->targetFrameMs, 2.0f, 50.0f);
+        ImGui::SliderFloat("Min render scale", &programState->minRenderScale, 0.25f, 1.0f);
+        ImGui::SliderFloat("Max render scale", &programState->maxRenderScale, programState->minRenderScale, 1.0f);
+        ImGui::Text("Render %ux%u (%.0f%%), upscale %.3f ms", renderWidth, renderHeight,
+                    programState->renderScale * 100.0f, programState->upscaleMs);
     }
+    ImGui::TextWrapped("Passes: %s", programState->framePasses.c_str());
+    ImGui::Text("Render targets: %.1f MB (%.1f MB without aliasing)", programState->renderTargetMegabytes,
+                programState->unaliasedMegabytes);
+    ImGui::Checkbox("R11F_G11F_B10F HDR targets", &programState->leanTargetFormats);
+    ImGui::Checkbox("sRGB pipeline", &programState->srgbPipeline);
+    if (!rg::glExtensions().textureSRGBDecode)
+        ImGui::Text("No EXT_texture_sRGB_decode: albedo is decoded either way");
+    if (ImGui::Button("Validate against the old pipeline"))
+        programState->imageValidationRequested = true;
+    if (programState->antiAliasing == TAA_ANTI_ALIASING)
+        ImGui::Text("TAA blends each capture with the frames before it");
+    for (const rg::ImageValidation::Result &result : programState->imageValidation)
+        ImGui::Text("%s: RMSE %.2f, PSNR %.1f dB, max %d, %.2f%% changed", result.name.c_str(),
+                    result.diff.rmse, result.diff.psnr, result.diff.maxError, result.diff.changedPercent);
+    ImGui::End();
 }
 
-// glfw: whenever the window size changed (by OS or user resize) this callback function executes
-// ---------------------------------------------------------------------------------------------
-void framebuffer_size_callback(GLFWwindow *window, int width, int height) {
-    // make sure the viewport matches the new window dimensions; note that width and
-    // height will be significantly larger than specified on retina displays.
-    glViewport(0, 0, width, height);
+void DrawCameraWindow(ProgramState *programState) {
+    ImGui::Begin("Camera info");
+    const Camera& c = programState->camera;
+    ImGui::Text("Camera position: (%f, %f, %f)", c.Position.x, c.Position.y, c.Position.z);
+    ImGui::Text("(Yaw, Pitch): (%f, %f)", c.Yaw, c.Pitch);
+    ImGui::Text("Camera front: (%f, %f, %f)", c.Front.x, c.Front.y, c.Front.z);
+    ImGui::Checkbox("Camera mouse update", &programState->CameraMouseMovementUpdateEnabled);
+    ImGui::End();
 }
 
-// glfw: whenever the mouse moves, this callback is called
-// -------------------------------------------------------
-void mouse_callback(GLFWwindow *window, double xpos, double ypos) {
-    if (firstMouse) {
-        lastX = xpos;
-        lastY = ypos;
-        firstMouse = false;
-    }
-
-    float xoffset = xpos - lastX;
-    float yoffset = lastY - ypos; // reversed since y-coordinates go from bottom to top
-
-    lastX = xpos;
-    lastY = ypos;
-
-    if (programState->CameraMouseMovementUpdateEnabled)
-        programState->camera.ProcessMouseMovement(xoffset, yoffset);
-}
-
-// glfw: whenever the mouse scroll wheel scrolls, this callback is called
-// ----------------------------------------------------------------------
-void scroll_callback(GLFWwindow *window, double xoffset, double yoffset) {
-    programState->camera.ProcessMouseScroll(yoffset);
+// vsync, the frame limiter, idle throttling and the frame preparation worker
+void DrawFramePacingWindow(ProgramState *programState) {
+    ImGui::Begin("Frame pacing");
+    rg::framePacingControls(programState->framePacing, programState->framePacingStats,
+                            programState->adaptiveSwapSupported);
+
+    ImGui::Separator();
+    rg::IdleThrottleSettings &throttling = programState->idleThrottle;
+    ImGui::Checkbox("Idle throttling", &throttling.enabled);
+    ImGui::Checkbox("Animate sky and bell", &programState->animate);
+    ImGui::SliderInt("Unfocused frame rate", &throttling.unfocusedFrameRate, 1, 60);
+    ImGui::SliderInt("Frames to settle", &throttling.settleFrames, 1, 120);
+    rg::idleThrottleUsageTable(idleThrottle);
+
+    ImGui::Separator();
+    ImGui::Checkbox("Prepare next frame on a worker", &programState->pipelinedPrep);
+    ImGui::Text("Command list: build %.3f ms, waited %.3f ms", programState->prepBuildMs,
+                programState->prepWaitMs);
+    ImGui::End();
 }
 
 void DrawImGui(ProgramState *programState) {
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplGlfw_NewFrame();
+    // the backend reads the mouse from GLFW; a replay puts the recorded one in its place
+    if (inputLog.replaying()) {
+        ImGuiIO &io = ImGui::GetIO();
+        io.MousePos = ImVec2((float) inputLog.cursorX(), (float) inputLog.cursorY());
+        for (int button = 0; button < IM_ARRAYSIZE(io.MouseDown); ++button)
+            io.MouseDown[button] = inputLog.takeButton(button);
+    }
     ImGui::NewFrame();
 
-
-    {
-        ImGui::Begin("Hello!");
-        ImGui::SliderFloat("Exposure", &programState->exposure, 0.0, 2.0);
-
-        
-        ImGui::End();
-    }
-
-    {
-        ImGui::Begin("Camera info");
-        const Camera& c = programState->camera;
-        ImGui::Text("Camera position: (%f, %f, %f)", c.Position.x, c.Position.y, c.Position.z);
-        ImGui::Text("(Yaw, Pitch): (%f, %f)", c.Yaw, c.Pitch);
-        ImGui::Text("Camera front: (%f, %f, %f)", c.Front.x, c.Front.y, c.Front.z);
-        ImGui::Checkbox("Camera mouse update", &programState->CameraMouseMovementUpdateEnabled);
-        ImGui::End();
-    }
+    DrawSettingsWindow(programState);
+    DrawCameraWindow(programState);
+    rg::drawProfilerPanel(programState->profiler);
+    DrawFramePacingWindow(programState);
+    rg::drawMemoryPanel();
 
     ImGui::Render();
+    // the UI colours are already display colours
+    glDisable(GL_FRAMEBUFFER_SRGB);
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
 
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods) {
+    idleThrottle.wake();
+    if (inputLog.replaying() && !dispatchingReplay)
+        return;
+    if (inputLog.recording())
+        inputLog.recordKey((float) glfwGetTime(), key, scancode, action, mods);
+    ImGui_ImplGlfw_KeyCallback(window, key, scancode, action, mods);
     if (key == GLFW_KEY_F1 && action == GLFW_PRESS) {
         programState->ImGuiEnabled = !programState->ImGuiEnabled;
         if (programState->ImGuiEnabled) {
@@ -1470,10 +2508,19 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
     if(key == GLFW_KEY_G && action == GLFW_PRESS){
         grayEffect = !grayEffect;
     }
+
+    // first press starts a trace, the second writes it
+    if (key == GLFW_KEY_F9 && action == GLFW_PRESS) {
+        if (rg::tracer().recording())
+            rg::tracer().write("trace.json");
+        else
+            rg::tracer().start();
+    }
 }
 
-unsigned int loadTexture(char const * path)
+unsigned int loadTexture(char const * path, bool gamma)
 {
+    rg::TraceScope trace("load", "Load texture", rg::traceDetail(path));
     unsigned int textureID;
     glGenTextures(1, &textureID);
 
@@ -1488,10 +2535,20 @@ unsigned int loadTexture(char const * path)
             format = GL_RGB;
         else if (nrComponents == 4)
             format = GL_RGBA;
+        // gamma: colour maps, stored sRGB-encoded and decoded to linear by the sampler
+        GLenum internalFormat = format;
+        if (gamma && format == GL_RGB)
+            internalFormat = GL_SRGB8;
+        else if (gamma && format == GL_RGBA)
+            internalFormat = GL_SRGB8_ALPHA8;
+        if (internalFormat != format)
+            srgbTextures.push_back(std::make_pair(GL_TEXTURE_2D, textureID));
 
         glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, data);
         glGenerateMipmap(GL_TEXTURE_2D);
+        rg::memoryTracker().texture(textureID, path, rg::MemoryTracker::TEXTURES, internalFormat, width, height, 1,
+                                    rg::mipLevels(width, height));
 
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -1515,34 +2572,21 @@ unsigned int loadTexture(char const * path)
 
 unsigned int loadCubemap(vector<std::string> faces)
 {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+    unsigned int textureID = rg::loadCubemap(faces);
+    srgbTextures.push_back(std::make_pair(GL_TEXTURE_CUBE_MAP, textureID));
+    return textureID;
+}
 
-    int width, height, nrChannels;
-    for (unsigned int i = 0; i < faces.size(); i++)
-    {
-        unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-        if (data)
-        {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
-                         0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data
-            );
-            stbi_image_free(data);
-        }
-        else
-        {
-            std::cout << "Cubemap tex failed to load at this path : " << faces[i] << std::endl;
-            stbi_image_free(data);
-        }
+void setSRGBDecode(bool decode)
+{
+    if (!rg::glExtensions().textureSRGBDecode)
+        return;
+    for (const auto &texture : srgbTextures) {
+        glBindTexture(texture.first, texture.second);
+        glTexParameteri(texture.first, GL_TEXTURE_SRGB_DECODE_EXT, decode ? GL_DECODE_EXT : GL_SKIP_DECODE_EXT);
     }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-    return textureID;
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
 }
 
 
@@ -1626,6 +2670,7 @@ void renderQuad() {
         glBindVertexArray(sqVAO);
         glBindBuffer(GL_ARRAY_BUFFER, sqVBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(sqVertices), &sqVertices, GL_STATIC_DRAW);
+        rg::memoryTracker().buffer(sqVBO, "Normal mapped quad", rg::MemoryTracker::VERTEX_BUFFERS, sizeof(sqVertices));
         glEnableVertexAttribArray(0);
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 14 * sizeof(float), (void *) 0);
         glEnableVertexAttribArray(1);
@@ -0,0 +1,163 @@
+// Checks rg::LightGridBuilder against a brute-force reference: every light against every
+// cluster, one at a time, with none of the builder's shortcuts. Runs the SSE2 and the scalar
+// tile tests (where the build has SSE2), each without pool workers and with several.
+//
+//   lightGridTest
+//
+// Exits with 1 and prints the first mismatch of each case if the grids differ.
+
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <rg/LightGrid.h>
+#include <rg/ThreadPool.h>
+
+// the light lists of every cluster, in light order like the builder writes them
+typedef std::vector<std::vector<uint32_t>> ClusterLists;
+
+// The rules the builder applies, cluster by cluster:
+//  - a sphere is in a tile unless it lies entirely outside one of the tile's inner side
+//    planes; the outer planes of the edge tiles aren't tested, those take what is off screen
+//  - a sphere that reaches in front of the near plane is in every tile
+//  - the first and the last slice reach past the near and far planes
+static ClusterLists referenceGrid(const rg::ClusterGridConfig &config, const glm::mat4 &view,
+                                  const std::vector<rg::ClusterLight> &lights) {
+    ClusterLists clusters(config.clusterCount());
+    float tanHalfFovX = config.tanHalfFovY * config.aspect;
+    // distance of p from boundary i of n; positive to the right of (or above) it
+    auto planeDistance = [](unsigned int i, unsigned int n, float tanHalfFov, float coord, float z) {
+        float k = (-1.0f + 2.0f * i / n) * tanHalfFov;
+        return (coord + k * z) / std::sqrt(1.0f + k * k);
+    };
+    auto sliceStart = [&config](unsigned int z) {
+        return config.zNear * std::pow(config.zFar / config.zNear, (float) z / config.slices);
+    };
+    for (size_t l = 0; l < lights.size(); ++l) {
+        glm::vec4 p = view * glm::vec4(lights[l].position, 1.0f);
+        float radius = lights[l].range;
+        float depth = -p.z;
+        if (depth + radius < config.zNear || depth - radius > config.zFar)
+            continue;
+        bool crossesNear = depth - radius < config.zNear;
+        float nearest = depth - radius, farthest = std::min(depth + radius, config.zFar);
+        for (unsigned int z = 0; z < config.slices; ++z) {
+            if (z > 0 && farthest < sliceStart(z))
+                continue;
+            if (z + 1 < config.slices && nearest >= sliceStart(z + 1))
+                continue;
+            for (unsigned int y = 0; y < config.tilesY; ++y) {
+                if (!crossesNear) {
+                    if (y > 0 && planeDistance(y, config.tilesY, config.tanHalfFovY, p.y, p.z) < -radius)
+                        continue;
+                    if (y + 1 < config.tilesY
+                        && planeDistance(y + 1, config.tilesY, config.tanHalfFovY, p.y, p.z) > radius)
+                        continue;
+                }
+                for (unsigned int x = 0; x < config.tilesX; ++x) {
+                    if (!crossesNear) {
+                        if (x > 0 && planeDistance(x, config.tilesX, tanHalfFovX, p.x, p.z) < -radius)
+                            continue;
+                        if (x + 1 < config.tilesX
+                            && planeDistance(x + 1, config.tilesX, tanHalfFovX, p.x, p.z) > radius)
+                            continue;
+                    }
+                    clusters[config.clusterIndex(x, y, z)].push_back((uint32_t) l);
+                }
+            }
+        }
+    }
+    return clusters;
+}
+
+static ClusterLists builtGrid(const rg::LightGrid &grid) {
+    ClusterLists clusters(grid.counts.size());
+    for (size_t c = 0; c < clusters.size(); ++c)
+        clusters[c].assign(grid.indices.begin() + grid.offsets[c],
+                           grid.indices.begin() + grid.offsets[c] + grid.counts[c]);
+    return clusters;
+}
+
+static std::string describe(const std::vector<uint32_t> &list) {
+    std::string text = "{";
+    for (size_t i = 0; i < list.size(); ++i)
+        text += (i ? ", " : "") + std::to_string(list[i]);
+    return text + "}";
+}
+
+// lights around and behind the camera, some crossing the near and the far plane
+static std::vector<rg::ClusterLight> testLights(int count, unsigned int seed) {
+    auto random = [&seed]() {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) / 16777216.0f;
+    };
+    std::vector<rg::ClusterLight> lights;
+    for (int i = 0; i < count; ++i) {
+        rg::ClusterLight light;
+        light.position = glm::vec3(random() * 240.0f - 120.0f, random() * 40.0f - 20.0f, random() * 240.0f - 120.0f);
+        light.range = random() < 0.1f ? random() * 40.0f : random() * 4.0f;
+        lights.push_back(light);
+    }
+    return lights;
+}
+
+int main() {
+    struct Camera {
+        const char *name;
+        glm::vec3 eye;
+        glm::vec3 target;
+        float fovY;
+        float aspect;
+    };
+    const Camera cameras[] = {
+            {"scene", glm::vec3(0.0f, 2.0f, 10.0f), glm::vec3(0.0f), 45.0f, 16.0f / 9.0f},
+            {"down", glm::vec3(5.0f, 30.0f, 5.0f), glm::vec3(0.0f, 0.0f, 1.0f), 60.0f, 4.0f / 3.0f},
+            {"wide", glm::vec3(-20.0f, 1.0f, -3.0f), glm::vec3(10.0f, 3.0f, 8.0f), 90.0f, 21.0f / 9.0f},
+    };
+    const int lightCounts[] = {0, 1, 3, 4, 5, 257, 4096};
+
+    std::vector<bool> simdModes = {false};
+#if defined(__SSE2__)
+    simdModes.push_back(true);
+#endif
+    rg::ThreadPool serial(0);
+    rg::ThreadPool threaded(3);
+    rg::ThreadPool *pools[] = {&serial, &threaded};
+
+    int cases = 0, failures = 0;
+    for (const Camera &camera : cameras) {
+        rg::ClusterGridConfig config = rg::ClusterGridConfig::fromPerspective(glm::radians(camera.fovY), camera.aspect,
+                                                                              0.1f, 100.0f);
+        glm::mat4 view = glm::lookAt(camera.eye, camera.target, glm::vec3(0.0f, 1.0f, 0.0f));
+        for (int count : lightCounts) {
+            std::vector<rg::ClusterLight> lights = testLights(count, 77u + count);
+            ClusterLists expected = referenceGrid(config, view, lights);
+            for (bool simd : simdModes) {
+                for (rg::ThreadPool *pool : pools) {
+                    rg::LightGridBuilder builder(pool);
+                    builder.setSimd(simd);
+                    rg::LightGrid grid;
+                    builder.build(config, view, lights, grid);
+                    ClusterLists actual = builtGrid(grid);
+                    ++cases;
+                    for (size_t c = 0; c < expected.size(); ++c) {
+                        if (actual[c] == expected[c])
+                            continue;
+                        ++failures;
+                        std::cout << "ERROR::LIGHT_GRID_TEST::" << camera.name << ", " << count << " lights, "
+                                  << (simd ? "SSE2" : "scalar") << ", " << pool->workerCount() << " workers: cluster "
+                                  << c << " has " << describe(actual[c]) << ", expected " << describe(expected[c])
+                                  << std::endl;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    std::cout << "LIGHT_GRID_TEST::" << cases - failures << " of " << cases << " cases match" << std::endl;
+    return failures ? 1 : 0;
+}